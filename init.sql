@@ -69,13 +69,18 @@ LANGUAGE C STRICT;
  *		auto - enable automatic partition creation
  *		init_callback - text signature of cb to be executed on partition
  * 						creation
+ *		spawn_using_bgw - create partitions using background worker
+ *		zone_map_columns - columns summarized by zone maps
+ *		premake - number of RANGE partitions to be created ahead of time
  */
 CREATE TABLE IF NOT EXISTS @extschema@.pathman_config_params (
 	partrel			REGCLASS NOT NULL PRIMARY KEY,
 	enable_parent	BOOLEAN NOT NULL DEFAULT FALSE,
 	auto			BOOLEAN NOT NULL DEFAULT TRUE,
 	init_callback	TEXT DEFAULT NULL,
-	spawn_using_bgw	BOOLEAN NOT NULL DEFAULT FALSE
+	spawn_using_bgw	BOOLEAN NOT NULL DEFAULT FALSE,
+	zone_map_columns TEXT[] DEFAULT NULL,
+	premake			INTEGER DEFAULT NULL CHECK (premake > 0),
 
 	/* check callback's signature */
 	CHECK (@extschema@.validate_part_callback(CASE WHEN init_callback IS NULL
@@ -84,8 +89,28 @@ CREATE TABLE IF NOT EXISTS @extschema@.pathman_config_params (
 											  END))
 );
 
+/*
+ * Zone maps (min/max summaries) of partitions
+ *		partrel - partition (regclass, stored as Oid)
+ *		attname - summarized column
+ *		valid - false if summary has never been computed or has been
+ *				spoiled by writes (such partitions are always scanned)
+ *		min_value, max_value - bounds of column's non-NULL values as strings
+ */
+CREATE TABLE IF NOT EXISTS @extschema@.pathman_zone_maps (
+	partrel			REGCLASS NOT NULL,
+	attname			TEXT NOT NULL,
+	valid			BOOLEAN NOT NULL DEFAULT FALSE,
+	min_value		TEXT,
+	max_value		TEXT,
+
+	PRIMARY KEY (partrel, attname)
+);
+
 GRANT SELECT, INSERT, UPDATE, DELETE
-ON @extschema@.pathman_config, @extschema@.pathman_config_params
+ON @extschema@.pathman_config,
+   @extschema@.pathman_config_params,
+   @extschema@.pathman_zone_maps
 TO public;
 
 /*
@@ -105,10 +130,18 @@ FOR ALL USING (check_security_policy(partrel));
 
 CREATE POLICY allow_select ON @extschema@.pathman_config FOR SELECT USING (true);
 
+CREATE POLICY deny_modification ON @extschema@.pathman_zone_maps
+FOR ALL USING (check_security_policy(partrel));
+
+CREATE POLICY allow_select ON @extschema@.pathman_config FOR SELECT USING (true);
+
 CREATE POLICY allow_select ON @extschema@.pathman_config_params FOR SELECT USING (true);
 
+CREATE POLICY allow_select ON @extschema@.pathman_zone_maps FOR SELECT USING (true);
+
 ALTER TABLE @extschema@.pathman_config ENABLE ROW LEVEL SECURITY;
 ALTER TABLE @extschema@.pathman_config_params ENABLE ROW LEVEL SECURITY;
+ALTER TABLE @extschema@.pathman_zone_maps ENABLE ROW LEVEL SECURITY;
 
 /*
  * Invalidate relcache every time someone changes parameters config.
@@ -121,11 +154,24 @@ CREATE TRIGGER pathman_config_params_trigger
 BEFORE INSERT OR UPDATE OR DELETE ON @extschema@.pathman_config_params
 FOR EACH ROW EXECUTE PROCEDURE @extschema@.pathman_config_params_trigger_func();
 
+/*
+ * Invalidate relcache of partition (and its parent) every time
+ * someone changes its zone maps.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.pathman_zone_maps_trigger_func()
+RETURNS TRIGGER AS 'pg_pathman', 'pathman_zone_maps_trigger_func'
+LANGUAGE C;
+
+CREATE TRIGGER pathman_zone_maps_trigger
+BEFORE INSERT OR UPDATE OR DELETE ON @extschema@.pathman_zone_maps
+FOR EACH ROW EXECUTE PROCEDURE @extschema@.pathman_zone_maps_trigger_func();
+
 /*
  * Enable dump of config tables with pg_dump.
  */
 SELECT pg_catalog.pg_extension_config_dump('@extschema@.pathman_config', '');
 SELECT pg_catalog.pg_extension_config_dump('@extschema@.pathman_config_params', '');
+SELECT pg_catalog.pg_extension_config_dump('@extschema@.pathman_zone_maps', '');
 
 
 /*
@@ -219,6 +265,58 @@ END
 $$
 LANGUAGE plpgsql STRICT;
 
+/*
+ * Set (or reset with NULL) columns summarized by zone maps
+ */
+CREATE OR REPLACE FUNCTION @extschema@.set_zone_map_columns(
+	relation	REGCLASS,
+	columns		TEXT[])
+RETURNS VOID AS
+$$
+DECLARE
+	col			TEXT;
+
+BEGIN
+	IF NOT EXISTS (SELECT * FROM @extschema@.pathman_config
+				   WHERE partrel = relation) THEN
+		RAISE EXCEPTION 'relation "%" has no partitions', relation;
+	END IF;
+
+	IF coalesce(array_length(columns, 1), 0) > 8 THEN
+		RAISE EXCEPTION 'zone maps support at most 8 columns';
+	END IF;
+
+	/* Check that columns exist */
+	FOREACH col IN ARRAY coalesce(columns, '{}'::TEXT[])
+	LOOP
+		IF NOT EXISTS (SELECT * FROM pg_catalog.pg_attribute
+					   WHERE attrelid = relation AND attname = col AND
+							 attnum > 0 AND NOT attisdropped) THEN
+			RAISE EXCEPTION 'column "%" of relation "%" does not exist',
+							col, relation;
+		END IF;
+	END LOOP;
+
+	IF columns = '{}'::TEXT[] THEN
+		columns := NULL;
+	END IF;
+
+	PERFORM @extschema@.pathman_set_param(relation, 'zone_map_columns', columns);
+
+	/* Remove summaries of columns which are not tracked anymore */
+	DELETE FROM @extschema@.pathman_zone_maps
+	WHERE partrel IN (SELECT inhrelid FROM pg_catalog.pg_inherits
+					  WHERE inhparent = relation) AND
+		  attname != ALL(coalesce(columns, '{}'::TEXT[]));
+
+	/* Drop triggers of partitions */
+	IF columns IS NULL THEN
+		PERFORM @extschema@.refresh_zone_maps(relation);
+	END IF;
+END
+$$
+LANGUAGE plpgsql;
+
 /*
  * Set (or reset) default interval for auto created partitions
  */
@@ -244,6 +342,31 @@ END
 $$
 LANGUAGE plpgsql;
 
+/*
+ * Set (or reset with NULL) number of RANGE partitions
+ * to be created ahead of time by PremakeWorker
+ */
+CREATE OR REPLACE FUNCTION @extschema@.set_premake(
+	relation		REGCLASS,
+	value			INTEGER DEFAULT NULL)
+RETURNS VOID AS
+$$
+BEGIN
+	IF NOT EXISTS (SELECT * FROM @extschema@.pathman_config
+				   WHERE partrel = relation AND parttype = 2) THEN
+		RAISE EXCEPTION 'table "%" is not partitioned by RANGE', relation;
+	END IF;
+
+	PERFORM @extschema@.pathman_set_param(relation, 'premake', value);
+
+	/* Make sure there's a worker serving this database */
+	IF value IS NOT NULL THEN
+		PERFORM @extschema@.start_premake_worker();
+	END IF;
+END
+$$
+LANGUAGE plpgsql;
+
 
 /*
  * Show all existing parents and partitions.
@@ -267,6 +390,148 @@ AS SELECT * FROM @extschema@.show_partition_list();
 
 GRANT SELECT ON @extschema@.pathman_partition_list TO PUBLIC;
 
+/*
+ * Recompute zone maps of a partition. If 'only_stale' is set, do
+ * nothing unless some of them are missing or have been spoiled.
+ * Returns true if zone maps have been recomputed.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.refresh_partition_zone_map(
+	partition_relid	REGCLASS,
+	only_stale		BOOLEAN DEFAULT FALSE)
+RETURNS BOOLEAN AS
+$$
+DECLARE
+	parent_relid	REGCLASS;
+	columns			TEXT[];
+	col				TEXT;
+	v_min			TEXT;
+	v_max			TEXT;
+
+BEGIN
+	parent_relid := @extschema@.get_parent_of_partition(partition_relid);
+
+	SELECT zone_map_columns FROM @extschema@.pathman_config_params
+	WHERE partrel = parent_relid
+	INTO columns;
+
+	/* Remove summaries of columns which are not tracked anymore */
+	DELETE FROM @extschema@.pathman_zone_maps
+	WHERE partrel = partition_relid AND
+		  attname != ALL(coalesce(columns, '{}'::TEXT[]));
+
+	IF columns IS NULL THEN
+		EXECUTE format('DROP TRIGGER IF EXISTS pathman_zone_map_trigger ON %s',
+					   partition_relid::TEXT);
+		RETURN false;
+	END IF;
+
+	IF only_stale AND
+	   NOT EXISTS (SELECT * FROM unnest(columns) AS c(attname)
+				   WHERE NOT EXISTS (SELECT * FROM @extschema@.pathman_zone_maps AS zm
+									 WHERE zm.partrel = partition_relid AND
+										   zm.attname = c.attname AND
+										   zm.valid)) THEN
+		RETURN false;
+	END IF;
+
+	/* Snapshot must be taken after the lock, see below */
+	IF current_setting('transaction_isolation') != 'read committed' THEN
+		RAISE EXCEPTION 'zone maps can only be refreshed in READ COMMITTED transactions';
+	END IF;
+
+	/* Block writers until we're done */
+	EXECUTE format('LOCK TABLE %s IN SHARE ROW EXCLUSIVE MODE',
+				   partition_relid::TEXT);
+
+	/*
+	 * Track writes which could spoil summaries. BEFORE ROW triggers fire
+	 * in name order and may change the row, so we have to check the final
+	 * one in an AFTER ROW trigger.
+	 */
+	IF NOT EXISTS (SELECT * FROM pg_catalog.pg_trigger
+				   WHERE tgrelid = partition_relid AND
+						 tgname = 'pathman_zone_map_trigger') THEN
+		EXECUTE format('CREATE TRIGGER pathman_zone_map_trigger
+						AFTER INSERT OR UPDATE ON %s
+						FOR EACH ROW EXECUTE PROCEDURE
+						@extschema@.pathman_zone_map_trigger_func()',
+					   partition_relid::TEXT);
+	END IF;
+
+	FOREACH col IN ARRAY columns
+	LOOP
+		/* Use column's default ordering, just like the planner does */
+		EXECUTE format('SELECT %1$s::TEXT FROM %2$s WHERE %1$s IS NOT NULL
+						ORDER BY %1$s LIMIT 1',
+					   quote_ident(col), partition_relid::TEXT)
+		INTO v_min;
+
+		EXECUTE format('SELECT %1$s::TEXT FROM %2$s WHERE %1$s IS NOT NULL
+						ORDER BY %1$s DESC LIMIT 1',
+					   quote_ident(col), partition_relid::TEXT)
+		INTO v_max;
+
+		INSERT INTO @extschema@.pathman_zone_maps
+		VALUES (partition_relid, col, true, v_min, v_max)
+		ON CONFLICT (partrel, attname) DO UPDATE
+		SET valid = true, min_value = v_min, max_value = v_max;
+	END LOOP;
+
+	RETURN true;
+END
+$$
+LANGUAGE plpgsql STRICT
+SET DateStyle = 'ISO, YMD'				/* stable text representation */
+SET IntervalStyle = 'postgres'
+SET extra_float_digits = 3;
+
+/*
+ * Recompute zone maps of all partitions of a table.
+ * Returns number of partitions which have been refreshed.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.refresh_zone_maps(
+	parent_relid	REGCLASS,
+	only_stale		BOOLEAN DEFAULT FALSE)
+RETURNS INTEGER AS
+$$
+DECLARE
+	part			REGCLASS;
+	refreshed		INTEGER := 0;
+
+BEGIN
+	PERFORM @extschema@.validate_relname(parent_relid);
+
+	FOR part IN (SELECT inhrelid::REGCLASS FROM pg_catalog.pg_inherits
+				 WHERE inhparent = parent_relid
+				 ORDER BY inhrelid ASC)
+	LOOP
+		IF @extschema@.refresh_partition_zone_map(part, only_stale) THEN
+			refreshed := refreshed + 1;
+		END IF;
+	END LOOP;
+
+	RETURN refreshed;
+END
+$$
+LANGUAGE plpgsql STRICT;
+
+/*
+ * Refresh stale zone maps of a table using ZoneMapsWorker.
+ * NOTE: partitions are refreshed one by one in separate transactions.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.refresh_zone_maps_concurrently(
+	relation		REGCLASS)
+RETURNS VOID AS 'pg_pathman', 'refresh_zone_maps_concurrently'
+LANGUAGE C STRICT;
+
+/*
+ * Marks zone maps spoiled by writes to a partition.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.pathman_zone_map_trigger_func()
+RETURNS TRIGGER AS 'pg_pathman', 'pathman_zone_map_trigger_func'
+LANGUAGE C;
+
+
 /*
  * Show all existing concurrent partitioning tasks.
  */
@@ -307,6 +572,15 @@ CREATE OR REPLACE FUNCTION @extschema@.stop_concurrent_part_task(
 RETURNS BOOL AS 'pg_pathman', 'stop_concurrent_part_task'
 LANGUAGE C STRICT;
 
+/*
+ * Start PremakeWorker for current database (if it's not running yet)
+ * once current transaction commits, so that it sees our changes.
+ * NOTE: worker exits when there are no tables with 'premake' set.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.start_premake_worker()
+RETURNS VOID AS 'pg_pathman', 'start_premake_worker_pl'
+LANGUAGE C STRICT;
+
 
 /*
  * Copy rows to partitions concurrently.
@@ -546,6 +820,12 @@ BEGIN
 
 	/* Cleanup params table too */
 	DELETE FROM @extschema@.pathman_config_params WHERE partrel = ANY(relids);
+
+	/* Remove zone maps of dropped partitions */
+	DELETE FROM @extschema@.pathman_zone_maps AS zm
+	USING pg_event_trigger_dropped_objects() AS events
+	WHERE zm.partrel::oid = events.objid AND
+		  events.classid = pg_class_oid AND events.objsubid = 0;
 END
 $$
 LANGUAGE plpgsql;
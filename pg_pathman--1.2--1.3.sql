@@ -1045,6 +1045,741 @@ LANGUAGE plpgsql;
 
 
 
+/* ------------------------------------------------------------------------
+ * Zone maps
+ * ----------------------------------------------------------------------*/
+ALTER TABLE @extschema@.pathman_config_params
+ADD COLUMN zone_map_columns TEXT[] DEFAULT NULL;
+
+/*
+ * Zone maps (min/max summaries) of partitions
+ *		partrel - partition (regclass, stored as Oid)
+ *		attname - summarized column
+ *		valid - false if summary has never been computed or has been
+ *				spoiled by writes (such partitions are always scanned)
+ *		min_value, max_value - bounds of column's non-NULL values as strings
+ */
+CREATE TABLE IF NOT EXISTS @extschema@.pathman_zone_maps (
+	partrel			REGCLASS NOT NULL,
+	attname			TEXT NOT NULL,
+	valid			BOOLEAN NOT NULL DEFAULT FALSE,
+	min_value		TEXT,
+	max_value		TEXT,
+
+	PRIMARY KEY (partrel, attname)
+);
+
+GRANT SELECT, INSERT, UPDATE, DELETE
+ON @extschema@.pathman_zone_maps
+TO public;
+
+CREATE POLICY deny_modification ON @extschema@.pathman_zone_maps
+FOR ALL USING (check_security_policy(partrel));
+
+CREATE POLICY allow_select ON @extschema@.pathman_zone_maps FOR SELECT USING (true);
+
+ALTER TABLE @extschema@.pathman_zone_maps ENABLE ROW LEVEL SECURITY;
+
+/*
+ * Invalidate relcache of partition (and its parent) every time
+ * someone changes its zone maps.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.pathman_zone_maps_trigger_func()
+RETURNS TRIGGER AS 'pg_pathman', 'pathman_zone_maps_trigger_func'
+LANGUAGE C;
+
+CREATE TRIGGER pathman_zone_maps_trigger
+BEFORE INSERT OR UPDATE OR DELETE ON @extschema@.pathman_zone_maps
+FOR EACH ROW EXECUTE PROCEDURE @extschema@.pathman_zone_maps_trigger_func();
+
+SELECT pg_catalog.pg_extension_config_dump('@extschema@.pathman_zone_maps', '');
+
+/*
+ * Set (or reset with NULL) columns summarized by zone maps
+ */
+CREATE OR REPLACE FUNCTION @extschema@.set_zone_map_columns(
+	relation	REGCLASS,
+	columns		TEXT[])
+RETURNS VOID AS
+$$
+DECLARE
+	col			TEXT;
+
+BEGIN
+	IF NOT EXISTS (SELECT * FROM @extschema@.pathman_config
+				   WHERE partrel = relation) THEN
+		RAISE EXCEPTION 'relation "%" has no partitions', relation;
+	END IF;
+
+	IF coalesce(array_length(columns, 1), 0) > 8 THEN
+		RAISE EXCEPTION 'zone maps support at most 8 columns';
+	END IF;
+
+	/* Check that columns exist */
+	FOREACH col IN ARRAY coalesce(columns, '{}'::TEXT[])
+	LOOP
+		IF NOT EXISTS (SELECT * FROM pg_catalog.pg_attribute
+					   WHERE attrelid = relation AND attname = col AND
+							 attnum > 0 AND NOT attisdropped) THEN
+			RAISE EXCEPTION 'column "%" of relation "%" does not exist',
+							col, relation;
+		END IF;
+	END LOOP;
+
+	IF columns = '{}'::TEXT[] THEN
+		columns := NULL;
+	END IF;
+
+	PERFORM @extschema@.pathman_set_param(relation, 'zone_map_columns', columns);
+
+	/* Remove summaries of columns which are not tracked anymore */
+	DELETE FROM @extschema@.pathman_zone_maps
+	WHERE partrel IN (SELECT inhrelid FROM pg_catalog.pg_inherits
+					  WHERE inhparent = relation) AND
+		  attname != ALL(coalesce(columns, '{}'::TEXT[]));
+
+	/* Drop triggers of partitions */
+	IF columns IS NULL THEN
+		PERFORM @extschema@.refresh_zone_maps(relation);
+	END IF;
+END
+$$
+LANGUAGE plpgsql;
+
+/*
+ * Recompute zone maps of a partition. If 'only_stale' is set, do
+ * nothing unless some of them are missing or have been spoiled.
+ * Returns true if zone maps have been recomputed.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.refresh_partition_zone_map(
+	partition_relid	REGCLASS,
+	only_stale		BOOLEAN DEFAULT FALSE)
+RETURNS BOOLEAN AS
+$$
+DECLARE
+	parent_relid	REGCLASS;
+	columns			TEXT[];
+	col				TEXT;
+	v_min			TEXT;
+	v_max			TEXT;
+
+BEGIN
+	parent_relid := @extschema@.get_parent_of_partition(partition_relid);
+
+	SELECT zone_map_columns FROM @extschema@.pathman_config_params
+	WHERE partrel = parent_relid
+	INTO columns;
+
+	/* Remove summaries of columns which are not tracked anymore */
+	DELETE FROM @extschema@.pathman_zone_maps
+	WHERE partrel = partition_relid AND
+		  attname != ALL(coalesce(columns, '{}'::TEXT[]));
+
+	IF columns IS NULL THEN
+		EXECUTE format('DROP TRIGGER IF EXISTS pathman_zone_map_trigger ON %s',
+					   partition_relid::TEXT);
+		RETURN false;
+	END IF;
+
+	IF only_stale AND
+	   NOT EXISTS (SELECT * FROM unnest(columns) AS c(attname)
+				   WHERE NOT EXISTS (SELECT * FROM @extschema@.pathman_zone_maps AS zm
+									 WHERE zm.partrel = partition_relid AND
+										   zm.attname = c.attname AND
+										   zm.valid)) THEN
+		RETURN false;
+	END IF;
+
+	/* Snapshot must be taken after the lock, see below */
+	IF current_setting('transaction_isolation') != 'read committed' THEN
+		RAISE EXCEPTION 'zone maps can only be refreshed in READ COMMITTED transactions';
+	END IF;
+
+	/* Block writers until we're done */
+	EXECUTE format('LOCK TABLE %s IN SHARE ROW EXCLUSIVE MODE',
+				   partition_relid::TEXT);
+
+	/*
+	 * Track writes which could spoil summaries. BEFORE ROW triggers fire
+	 * in name order and may change the row, so we have to check the final
+	 * one in an AFTER ROW trigger.
+	 */
+	IF NOT EXISTS (SELECT * FROM pg_catalog.pg_trigger
+				   WHERE tgrelid = partition_relid AND
+						 tgname = 'pathman_zone_map_trigger') THEN
+		EXECUTE format('CREATE TRIGGER pathman_zone_map_trigger
+						AFTER INSERT OR UPDATE ON %s
+						FOR EACH ROW EXECUTE PROCEDURE
+						@extschema@.pathman_zone_map_trigger_func()',
+					   partition_relid::TEXT);
+	END IF;
+
+	FOREACH col IN ARRAY columns
+	LOOP
+		/* Use column's default ordering, just like the planner does */
+		EXECUTE format('SELECT %1$s::TEXT FROM %2$s WHERE %1$s IS NOT NULL
+						ORDER BY %1$s LIMIT 1',
+					   quote_ident(col), partition_relid::TEXT)
+		INTO v_min;
+
+		EXECUTE format('SELECT %1$s::TEXT FROM %2$s WHERE %1$s IS NOT NULL
+						ORDER BY %1$s DESC LIMIT 1',
+					   quote_ident(col), partition_relid::TEXT)
+		INTO v_max;
+
+		INSERT INTO @extschema@.pathman_zone_maps
+		VALUES (partition_relid, col, true, v_min, v_max)
+		ON CONFLICT (partrel, attname) DO UPDATE
+		SET valid = true, min_value = v_min, max_value = v_max;
+	END LOOP;
+
+	RETURN true;
+END
+$$
+LANGUAGE plpgsql STRICT
+SET DateStyle = 'ISO, YMD'				/* stable text representation */
+SET IntervalStyle = 'postgres'
+SET extra_float_digits = 3;
+
+/*
+ * Recompute zone maps of all partitions of a table.
+ * Returns number of partitions which have been refreshed.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.refresh_zone_maps(
+	parent_relid	REGCLASS,
+	only_stale		BOOLEAN DEFAULT FALSE)
+RETURNS INTEGER AS
+$$
+DECLARE
+	part			REGCLASS;
+	refreshed		INTEGER := 0;
+
+BEGIN
+	PERFORM @extschema@.validate_relname(parent_relid);
+
+	FOR part IN (SELECT inhrelid::REGCLASS FROM pg_catalog.pg_inherits
+				 WHERE inhparent = parent_relid
+				 ORDER BY inhrelid ASC)
+	LOOP
+		IF @extschema@.refresh_partition_zone_map(part, only_stale) THEN
+			refreshed := refreshed + 1;
+		END IF;
+	END LOOP;
+
+	RETURN refreshed;
+END
+$$
+LANGUAGE plpgsql STRICT;
+
+/*
+ * Refresh stale zone maps of a table using ZoneMapsWorker.
+ * NOTE: partitions are refreshed one by one in separate transactions.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.refresh_zone_maps_concurrently(
+	relation		REGCLASS)
+RETURNS VOID AS 'pg_pathman', 'refresh_zone_maps_concurrently'
+LANGUAGE C STRICT;
+
+/*
+ * Marks zone maps spoiled by writes to a partition.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.pathman_zone_map_trigger_func()
+RETURNS TRIGGER AS 'pg_pathman', 'pathman_zone_map_trigger_func'
+LANGUAGE C;
+
+/*
+ * DDL trigger that removes entry from pathman_config table.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.pathman_ddl_trigger_func()
+RETURNS event_trigger AS
+$$
+DECLARE
+	obj				record;
+	pg_class_oid	oid;
+	relids			regclass[];
+BEGIN
+	pg_class_oid = 'pg_catalog.pg_class'::regclass;
+
+	/* Find relids to remove from config */
+	SELECT array_agg(cfg.partrel) INTO relids
+	FROM pg_event_trigger_dropped_objects() AS events
+	JOIN @extschema@.pathman_config AS cfg ON cfg.partrel::oid = events.objid
+	WHERE events.classid = pg_class_oid AND events.objsubid = 0;
+
+	/* Cleanup pathman_config */
+	DELETE FROM @extschema@.pathman_config WHERE partrel = ANY(relids);
+
+	/* Cleanup params table too */
+	DELETE FROM @extschema@.pathman_config_params WHERE partrel = ANY(relids);
+
+	/* Remove zone maps of dropped partitions */
+	DELETE FROM @extschema@.pathman_zone_maps AS zm
+	USING pg_event_trigger_dropped_objects() AS events
+	WHERE zm.partrel::oid = events.objid AND
+		  events.classid = pg_class_oid AND events.objsubid = 0;
+END
+$$
+LANGUAGE plpgsql;
+
+
+/*
+ * Creates RANGE partitions [bounds[i], bounds[i + 1]) in one go.
+ * NOTE: This function SHOULD NOT take xact_handling lock (BGWs in 9.5).
+ */
+CREATE OR REPLACE FUNCTION @extschema@.create_range_partitions_internal(
+	parent_relid	REGCLASS,
+	bounds			ANYARRAY,
+	partition_names	TEXT[] DEFAULT NULL,
+	tablespaces		TEXT[] DEFAULT NULL)
+RETURNS VOID AS 'pg_pathman', 'create_range_partitions_internal'
+LANGUAGE C
+SET client_min_messages = WARNING;
+
+/*
+ * Generates boundaries of 'p_count' RANGE partitions starting at 'p_start'.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.generate_range_bounds(
+	p_start			ANYELEMENT,
+	p_interval		INTERVAL,
+	p_count			INTEGER)
+RETURNS ANYARRAY AS 'pg_pathman', 'generate_range_bounds_pl'
+LANGUAGE C STRICT;
+
+CREATE OR REPLACE FUNCTION @extschema@.generate_range_bounds(
+	p_start			ANYELEMENT,
+	p_interval		ANYELEMENT,
+	p_count			INTEGER)
+RETURNS ANYARRAY AS 'pg_pathman', 'generate_range_bounds_pl'
+LANGUAGE C STRICT;
+
+/*
+ * Creates RANGE partitions for specified relation based on datetime attribute
+ */
+CREATE OR REPLACE FUNCTION @extschema@.create_range_partitions(
+	parent_relid	REGCLASS,
+	attribute		TEXT,
+	start_value		ANYELEMENT,
+	p_interval		INTERVAL,
+	p_count			INTEGER DEFAULT NULL,
+	partition_data	BOOLEAN DEFAULT TRUE)
+RETURNS INTEGER AS
+$$
+DECLARE
+	v_rows_count		BIGINT;
+	v_atttype			REGTYPE;
+	v_max				start_value%TYPE;
+	v_cur_value			start_value%TYPE := start_value;
+	end_value			start_value%TYPE;
+	i					INTEGER;
+
+BEGIN
+	PERFORM @extschema@.validate_relname(parent_relid);
+
+	IF partition_data = true THEN
+		/* Acquire data modification lock */
+		PERFORM @extschema@.prevent_relation_modification(parent_relid);
+	ELSE
+		/* Acquire lock on parent */
+		PERFORM @extschema@.lock_partitioned_relation(parent_relid);
+	END IF;
+
+	attribute := lower(attribute);
+	PERFORM @extschema@.common_relation_checks(parent_relid, attribute);
+
+	IF p_count < 0 THEN
+		RAISE EXCEPTION '"p_count" must not be less than 0';
+	END IF;
+
+	/* Try to determine partitions count if not set */
+	IF p_count IS NULL THEN
+		EXECUTE format('SELECT count(*), max(%s) FROM %s', attribute, parent_relid)
+		INTO v_rows_count, v_max;
+
+		IF v_rows_count = 0 THEN
+			RAISE EXCEPTION 'cannot determine partitions count for empty table';
+		END IF;
+
+		p_count := 0;
+		WHILE v_cur_value <= v_max
+		LOOP
+			v_cur_value := v_cur_value + p_interval;
+			p_count := p_count + 1;
+		END LOOP;
+	END IF;
+
+	v_atttype := @extschema@.get_base_type(pg_typeof(start_value));
+
+	/*
+	 * In case when user doesn't want to automatically create partitions
+	 * and specifies partition count as 0 then do not check boundaries
+	 */
+	IF p_count != 0 THEN
+		/* compute right bound of partitioning through additions */
+		end_value := start_value;
+		FOR i IN 1..p_count
+		LOOP
+			end_value := end_value + p_interval;
+		END LOOP;
+
+		/* Check boundaries */
+		EXECUTE format('SELECT @extschema@.check_boundaries(''%s'', ''%s'', ''%s'', ''%s''::%s)',
+					   parent_relid,
+					   attribute,
+					   start_value,
+					   end_value,
+					   v_atttype::TEXT);
+	END IF;
+
+	/* Insert new entry to pathman config */
+	INSERT INTO @extschema@.pathman_config (partrel, attname, parttype, range_interval)
+	VALUES (parent_relid, attribute, 2, p_interval::TEXT);
+
+	/* Create sequence for child partitions names */
+	PERFORM @extschema@.create_or_replace_sequence(parent_relid)
+	FROM @extschema@.get_plain_schema_and_relname(parent_relid);
+
+	/* Create partitions */
+	IF p_count != 0 THEN
+		PERFORM @extschema@.create_range_partitions_internal(
+			parent_relid,
+			@extschema@.generate_range_bounds(start_value, p_interval, p_count),
+			NULL,
+			NULL);
+	END IF;
+
+	/* Notify backend about changes */
+	PERFORM @extschema@.on_create_partitions(parent_relid);
+
+	/* Relocate data if asked to */
+	IF partition_data = true THEN
+		PERFORM @extschema@.set_enable_parent(parent_relid, false);
+		PERFORM @extschema@.partition_data(parent_relid);
+	ELSE
+		PERFORM @extschema@.set_enable_parent(parent_relid, true);
+	END IF;
+
+	RETURN p_count;
+END
+$$ LANGUAGE plpgsql;
+
+/*
+ * Creates RANGE partitions for specified relation based on numerical attribute
+ */
+CREATE OR REPLACE FUNCTION @extschema@.create_range_partitions(
+	parent_relid	REGCLASS,
+	attribute		TEXT,
+	start_value		ANYELEMENT,
+	p_interval		ANYELEMENT,
+	p_count			INTEGER DEFAULT NULL,
+	partition_data	BOOLEAN DEFAULT TRUE)
+RETURNS INTEGER AS
+$$
+DECLARE
+	v_rows_count		BIGINT;
+	v_max				start_value%TYPE;
+	v_cur_value			start_value%TYPE := start_value;
+	end_value			start_value%TYPE;
+	i					INTEGER;
+
+BEGIN
+	PERFORM @extschema@.validate_relname(parent_relid);
+
+	IF partition_data = true THEN
+		/* Acquire data modification lock */
+		PERFORM @extschema@.prevent_relation_modification(parent_relid);
+	ELSE
+		/* Acquire lock on parent */
+		PERFORM @extschema@.lock_partitioned_relation(parent_relid);
+	END IF;
+
+	attribute := lower(attribute);
+	PERFORM @extschema@.common_relation_checks(parent_relid, attribute);
+
+	IF p_count < 0 THEN
+		RAISE EXCEPTION 'partitions count must not be less than zero';
+	END IF;
+
+	/* Try to determine partitions count if not set */
+	IF p_count IS NULL THEN
+		EXECUTE format('SELECT count(*), max(%s) FROM %s', attribute, parent_relid)
+		INTO v_rows_count, v_max;
+
+		IF v_rows_count = 0 THEN
+			RAISE EXCEPTION 'cannot determine partitions count for empty table';
+		END IF;
+
+		IF v_max IS NULL THEN
+			RAISE EXCEPTION 'column "%" has NULL values', attribute;
+		END IF;
+
+		p_count := 0;
+		WHILE v_cur_value <= v_max
+		LOOP
+			v_cur_value := v_cur_value + p_interval;
+			p_count := p_count + 1;
+		END LOOP;
+	END IF;
+
+	/*
+	 * In case when user doesn't want to automatically create partitions
+	 * and specifies partition count as 0 then do not check boundaries
+	 */
+	IF p_count != 0 THEN
+		/* compute right bound of partitioning through additions */
+		end_value := start_value;
+		FOR i IN 1..p_count
+		LOOP
+			end_value := end_value + p_interval;
+		END LOOP;
+
+		/* check boundaries */
+		PERFORM @extschema@.check_boundaries(parent_relid,
+											 attribute,
+											 start_value,
+											 end_value);
+	END IF;
+
+	/* Insert new entry to pathman config */
+	INSERT INTO @extschema@.pathman_config (partrel, attname, parttype, range_interval)
+	VALUES (parent_relid, attribute, 2, p_interval::TEXT);
+
+	/* Create sequence for child partitions names */
+	PERFORM @extschema@.create_or_replace_sequence(parent_relid)
+	FROM @extschema@.get_plain_schema_and_relname(parent_relid);
+
+	/* Create partitions */
+	IF p_count != 0 THEN
+		PERFORM @extschema@.create_range_partitions_internal(
+			parent_relid,
+			@extschema@.generate_range_bounds(start_value, p_interval, p_count),
+			NULL,
+			NULL);
+	END IF;
+
+	/* Notify backend about changes */
+	PERFORM @extschema@.on_create_partitions(parent_relid);
+
+	/* Relocate data if asked to */
+	IF partition_data = true THEN
+		PERFORM @extschema@.set_enable_parent(parent_relid, false);
+		PERFORM @extschema@.partition_data(parent_relid);
+	ELSE
+		PERFORM @extschema@.set_enable_parent(parent_relid, true);
+	END IF;
+
+	RETURN p_count;
+END
+$$ LANGUAGE plpgsql;
+
+/*
+ * Creates RANGE partitions for specified range
+ */
+CREATE OR REPLACE FUNCTION @extschema@.create_partitions_from_range(
+	parent_relid	REGCLASS,
+	attribute		TEXT,
+	start_value		ANYELEMENT,
+	end_value		ANYELEMENT,
+	p_interval		ANYELEMENT,
+	partition_data	BOOLEAN DEFAULT TRUE)
+RETURNS INTEGER AS
+$$
+DECLARE
+	part_count		INTEGER := 0;
+	v_cur_value		start_value%TYPE;
+
+BEGIN
+	PERFORM @extschema@.validate_relname(parent_relid);
+
+	IF partition_data = true THEN
+		/* Acquire data modification lock */
+		PERFORM @extschema@.prevent_relation_modification(parent_relid);
+	ELSE
+		/* Acquire lock on parent */
+		PERFORM @extschema@.lock_partitioned_relation(parent_relid);
+	END IF;
+
+	attribute := lower(attribute);
+	PERFORM @extschema@.common_relation_checks(parent_relid, attribute);
+
+	IF p_interval <= 0 THEN
+		RAISE EXCEPTION 'interval must be positive';
+	END IF;
+
+	/* Check boundaries */
+	PERFORM @extschema@.check_boundaries(parent_relid,
+										 attribute,
+										 start_value,
+										 end_value);
+
+	/* Insert new entry to pathman config */
+	INSERT INTO @extschema@.pathman_config (partrel, attname, parttype, range_interval)
+	VALUES (parent_relid, attribute, 2, p_interval::TEXT);
+
+	/* Create sequence for child partitions names */
+	PERFORM @extschema@.create_or_replace_sequence(parent_relid)
+	FROM @extschema@.get_plain_schema_and_relname(parent_relid);
+
+	/* Count partitions */
+	v_cur_value := start_value;
+	WHILE v_cur_value <= end_value
+	LOOP
+		v_cur_value := v_cur_value + p_interval;
+		part_count := part_count + 1;
+	END LOOP;
+
+	/* Create partitions */
+	IF part_count != 0 THEN
+		PERFORM @extschema@.create_range_partitions_internal(
+			parent_relid,
+			@extschema@.generate_range_bounds(start_value, p_interval, part_count),
+			NULL,
+			NULL);
+	END IF;
+
+	/* Notify backend about changes */
+	PERFORM @extschema@.on_create_partitions(parent_relid);
+
+	/* Relocate data if asked to */
+	IF partition_data = true THEN
+		PERFORM @extschema@.set_enable_parent(parent_relid, false);
+		PERFORM @extschema@.partition_data(parent_relid);
+	ELSE
+		PERFORM @extschema@.set_enable_parent(parent_relid, true);
+	END IF;
+
+	RETURN part_count; /* number of created partitions */
+END
+$$ LANGUAGE plpgsql;
+
+/*
+ * Creates RANGE partitions for specified range based on datetime attribute
+ */
+CREATE OR REPLACE FUNCTION @extschema@.create_partitions_from_range(
+	parent_relid	REGCLASS,
+	attribute		TEXT,
+	start_value		ANYELEMENT,
+	end_value		ANYELEMENT,
+	p_interval		INTERVAL,
+	partition_data	BOOLEAN DEFAULT TRUE)
+RETURNS INTEGER AS
+$$
+DECLARE
+	part_count		INTEGER := 0;
+	v_cur_value		start_value%TYPE;
+
+BEGIN
+	PERFORM @extschema@.validate_relname(parent_relid);
+
+	IF partition_data = true THEN
+		/* Acquire data modification lock */
+		PERFORM @extschema@.prevent_relation_modification(parent_relid);
+	ELSE
+		/* Acquire lock on parent */
+		PERFORM @extschema@.lock_partitioned_relation(parent_relid);
+	END IF;
+
+	attribute := lower(attribute);
+	PERFORM @extschema@.common_relation_checks(parent_relid, attribute);
+
+	/* Check boundaries */
+	PERFORM @extschema@.check_boundaries(parent_relid,
+										 attribute,
+										 start_value,
+										 end_value);
+
+	/* Insert new entry to pathman config */
+	INSERT INTO @extschema@.pathman_config (partrel, attname, parttype, range_interval)
+	VALUES (parent_relid, attribute, 2, p_interval::TEXT);
+
+	/* Create sequence for child partitions names */
+	PERFORM @extschema@.create_or_replace_sequence(parent_relid)
+	FROM @extschema@.get_plain_schema_and_relname(parent_relid);
+
+	/* Count partitions */
+	v_cur_value := start_value;
+	WHILE v_cur_value <= end_value
+	LOOP
+		v_cur_value := v_cur_value + p_interval;
+		part_count := part_count + 1;
+	END LOOP;
+
+	/* Create partitions */
+	IF part_count != 0 THEN
+		PERFORM @extschema@.create_range_partitions_internal(
+			parent_relid,
+			@extschema@.generate_range_bounds(start_value, p_interval, part_count),
+			NULL,
+			NULL);
+	END IF;
+
+	/* Notify backend about changes */
+	PERFORM @extschema@.on_create_partitions(parent_relid);
+
+	/* Relocate data if asked to */
+	IF partition_data = true THEN
+		PERFORM @extschema@.set_enable_parent(parent_relid, false);
+		PERFORM @extschema@.partition_data(parent_relid);
+	ELSE
+		PERFORM @extschema@.set_enable_parent(parent_relid, true);
+	END IF;
+
+	RETURN part_count; /* number of created partitions */
+END
+$$ LANGUAGE plpgsql;
+
+
+/* ------------------------------------------------------------------------
+ * Create RANGE partitions ahead of time
+ * ----------------------------------------------------------------------*/
+ALTER TABLE @extschema@.pathman_config_params
+ADD COLUMN premake INTEGER DEFAULT NULL CHECK (premake > 0);
+
+/*
+ * Set (or reset with NULL) number of RANGE partitions
+ * to be created ahead of time by PremakeWorker
+ */
+CREATE OR REPLACE FUNCTION @extschema@.set_premake(
+	relation		REGCLASS,
+	value			INTEGER DEFAULT NULL)
+RETURNS VOID AS
+$$
+BEGIN
+	IF NOT EXISTS (SELECT * FROM @extschema@.pathman_config
+				   WHERE partrel = relation AND parttype = 2) THEN
+		RAISE EXCEPTION 'table "%" is not partitioned by RANGE', relation;
+	END IF;
+
+	PERFORM @extschema@.pathman_set_param(relation, 'premake', value);
+
+	/* Make sure there's a worker serving this database */
+	IF value IS NOT NULL THEN
+		PERFORM @extschema@.start_premake_worker();
+	END IF;
+END
+$$
+LANGUAGE plpgsql;
+
+/*
+ * Start PremakeWorker for current database (if it's not running yet)
+ * once current transaction commits, so that it sees our changes.
+ * NOTE: worker exits when there are no tables with 'premake' set.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.start_premake_worker()
+RETURNS VOID AS 'pg_pathman', 'start_premake_worker_pl'
+LANGUAGE C STRICT;
+
+/*
+ * Creates RANGE partitions ahead of time (used by PremakeWorker).
+ * 'p_count' defaults to 'premake' parameter of a table.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.premake_partitions(
+	parent_relid	REGCLASS,
+	p_count			INTEGER DEFAULT NULL)
+RETURNS REGCLASS AS 'pg_pathman', 'premake_partitions'
+LANGUAGE C
+SET client_min_messages = WARNING;
+
+
 /* ------------------------------------------------------------------------
  * Final words of wisdom
  * ----------------------------------------------------------------------*/
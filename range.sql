@@ -146,20 +146,14 @@ BEGIN
 	PERFORM @extschema@.create_or_replace_sequence(parent_relid)
 	FROM @extschema@.get_plain_schema_and_relname(parent_relid);
 
-	/* Create first partition */
-	FOR i IN 1..p_count
-	LOOP
-		EXECUTE
-			format('SELECT @extschema@.create_single_range_partition($1, $2, $3::%s, tablespace:=$4)',
-				   v_atttype::TEXT)
-		USING
+	/* Create partitions */
+	IF p_count != 0 THEN
+		PERFORM @extschema@.create_range_partitions_internal(
 			parent_relid,
-			start_value,
-			start_value + p_interval,
-			@extschema@.get_tablespace(parent_relid);
-
-		start_value := start_value + p_interval;
-	END LOOP;
+			@extschema@.generate_range_bounds(start_value, p_interval, p_count),
+			NULL,
+			NULL);
+	END IF;
 
 	/* Notify backend about changes */
 	PERFORM @extschema@.on_create_partitions(parent_relid);
@@ -261,17 +255,14 @@ BEGIN
 	PERFORM @extschema@.create_or_replace_sequence(parent_relid)
 	FROM @extschema@.get_plain_schema_and_relname(parent_relid);
 
-	/* create first partition */
-	FOR i IN 1..p_count
-	LOOP
-		PERFORM @extschema@.create_single_range_partition(
+	/* Create partitions */
+	IF p_count != 0 THEN
+		PERFORM @extschema@.create_range_partitions_internal(
 			parent_relid,
-			start_value,
-			start_value + p_interval,
-			tablespace := @extschema@.get_tablespace(parent_relid));
-
-		start_value := start_value + p_interval;
-	END LOOP;
+			@extschema@.generate_range_bounds(start_value, p_interval, p_count),
+			NULL,
+			NULL);
+	END IF;
 
 	/* Notify backend about changes */
 	PERFORM @extschema@.on_create_partitions(parent_relid);
@@ -302,6 +293,7 @@ RETURNS INTEGER AS
 $$
 DECLARE
 	part_count		INTEGER := 0;
+	v_cur_value		start_value%TYPE;
 
 BEGIN
 	PERFORM @extschema@.validate_relname(parent_relid);
@@ -335,18 +327,23 @@ BEGIN
 	PERFORM @extschema@.create_or_replace_sequence(parent_relid)
 	FROM @extschema@.get_plain_schema_and_relname(parent_relid);
 
-	WHILE start_value <= end_value
+	/* Count partitions */
+	v_cur_value := start_value;
+	WHILE v_cur_value <= end_value
 	LOOP
-		PERFORM @extschema@.create_single_range_partition(
-			parent_relid,
-			start_value,
-			start_value + p_interval,
-			tablespace := @extschema@.get_tablespace(parent_relid));
-
-		start_value := start_value + p_interval;
+		v_cur_value := v_cur_value + p_interval;
 		part_count := part_count + 1;
 	END LOOP;
 
+	/* Create partitions */
+	IF part_count != 0 THEN
+		PERFORM @extschema@.create_range_partitions_internal(
+			parent_relid,
+			@extschema@.generate_range_bounds(start_value, p_interval, part_count),
+			NULL,
+			NULL);
+	END IF;
+
 	/* Notify backend about changes */
 	PERFORM @extschema@.on_create_partitions(parent_relid);
 
@@ -376,6 +373,7 @@ RETURNS INTEGER AS
 $$
 DECLARE
 	part_count		INTEGER := 0;
+	v_cur_value		start_value%TYPE;
 
 BEGIN
 	PERFORM @extschema@.validate_relname(parent_relid);
@@ -405,21 +403,23 @@ BEGIN
 	PERFORM @extschema@.create_or_replace_sequence(parent_relid)
 	FROM @extschema@.get_plain_schema_and_relname(parent_relid);
 
-	WHILE start_value <= end_value
+	/* Count partitions */
+	v_cur_value := start_value;
+	WHILE v_cur_value <= end_value
 	LOOP
-		EXECUTE
-			format('SELECT @extschema@.create_single_range_partition($1, $2, $3::%s, tablespace:=$4);',
-				   @extschema@.get_base_type(pg_typeof(start_value))::TEXT)
-		USING
-			parent_relid,
-			start_value,
-			start_value + p_interval,
-			@extschema@.get_tablespace(parent_relid);
-
-		start_value := start_value + p_interval;
+		v_cur_value := v_cur_value + p_interval;
 		part_count := part_count + 1;
 	END LOOP;
 
+	/* Create partitions */
+	IF part_count != 0 THEN
+		PERFORM @extschema@.create_range_partitions_internal(
+			parent_relid,
+			@extschema@.generate_range_bounds(start_value, p_interval, part_count),
+			NULL,
+			NULL);
+	END IF;
+
 	/* Notify backend about changes */
 	PERFORM @extschema@.on_create_partitions(parent_relid);
 
@@ -1116,6 +1116,36 @@ RETURNS REGCLASS AS 'pg_pathman', 'create_single_range_partition_pl'
 LANGUAGE C
 SET client_min_messages = WARNING;
 
+/*
+ * Creates RANGE partitions [bounds[i], bounds[i + 1]) in one go.
+ * NOTE: This function SHOULD NOT take xact_handling lock (BGWs in 9.5).
+ */
+CREATE OR REPLACE FUNCTION @extschema@.create_range_partitions_internal(
+	parent_relid	REGCLASS,
+	bounds			ANYARRAY,
+	partition_names	TEXT[] DEFAULT NULL,
+	tablespaces		TEXT[] DEFAULT NULL)
+RETURNS VOID AS 'pg_pathman', 'create_range_partitions_internal'
+LANGUAGE C
+SET client_min_messages = WARNING;
+
+/*
+ * Generates boundaries of 'p_count' RANGE partitions starting at 'p_start'.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.generate_range_bounds(
+	p_start			ANYELEMENT,
+	p_interval		INTERVAL,
+	p_count			INTEGER)
+RETURNS ANYARRAY AS 'pg_pathman', 'generate_range_bounds_pl'
+LANGUAGE C STRICT;
+
+CREATE OR REPLACE FUNCTION @extschema@.generate_range_bounds(
+	p_start			ANYELEMENT,
+	p_interval		ANYELEMENT,
+	p_count			INTEGER)
+RETURNS ANYARRAY AS 'pg_pathman', 'generate_range_bounds_pl'
+LANGUAGE C STRICT;
+
 /*
  * Construct CHECK constraint condition for a range partition.
  */
@@ -1170,3 +1200,14 @@ CREATE OR REPLACE FUNCTION @extschema@.find_or_create_range_partition(
 	value			ANYELEMENT)
 RETURNS REGCLASS AS 'pg_pathman', 'find_or_create_range_partition'
 LANGUAGE C;
+
+/*
+ * Creates RANGE partitions ahead of time (used by PremakeWorker).
+ * 'p_count' defaults to 'premake' parameter of a table.
+ */
+CREATE OR REPLACE FUNCTION @extschema@.premake_partitions(
+	parent_relid	REGCLASS,
+	p_count			INTEGER DEFAULT NULL)
+RETURNS REGCLASS AS 'pg_pathman', 'premake_partitions'
+LANGUAGE C
+SET client_min_messages = WARNING;
@@ -0,0 +1,32 @@
+setup
+{
+	CREATE EXTENSION pg_pathman;
+	CREATE TABLE range_rel(id int4 NOT NULL);
+	SELECT create_range_partitions('range_rel', 'id', 1, 100, 1);
+}
+
+teardown
+{
+	SELECT drop_partitions('range_rel');
+	DROP TABLE range_rel CASCADE;
+	DROP EXTENSION pg_pathman;
+}
+
+session "s1"
+step "s1b" { BEGIN; }
+step "s1_insert_150" { INSERT INTO range_rel VALUES (150); }
+step "s1r" { ROLLBACK; }
+step "s1c" { COMMIT; }
+
+session "s2"
+step "s2_insert_160" { INSERT INTO range_rel VALUES (160); }
+
+session "s3"
+step "s3_show_waits" { SELECT locktype, mode FROM pg_locks WHERE NOT granted; }
+step "s3_show_partitions" { SELECT p.range_min, p.range_max, (SELECT count(*) FROM range_rel r WHERE r.tableoid = p.partition) AS count FROM pathman_partition_list p WHERE p.parent = 'range_rel'::regclass ORDER BY p.range_min::int4; }
+
+# s2 waits for the partition created by s1 instead of creating another one
+permutation "s1b" "s1_insert_150" "s2_insert_160" "s3_show_waits" "s1c" "s3_show_partitions"
+
+# s2 creates the partition itself if s1 rolls back
+permutation "s1b" "s1_insert_150" "s2_insert_160" "s3_show_waits" "s1r" "s3_show_partitions"
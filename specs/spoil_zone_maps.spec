@@ -0,0 +1,37 @@
+setup
+{
+	CREATE EXTENSION pg_pathman;
+	CREATE TABLE range_rel(id int4 NOT NULL, val int4);
+	INSERT INTO range_rel SELECT i, i * 2 FROM generate_series(1, 200) i;
+	SELECT create_range_partitions('range_rel', 'id', 1, 100);
+	SELECT set_zone_map_columns('range_rel', '{val}');
+	SELECT refresh_zone_maps('range_rel');
+}
+
+teardown
+{
+	SELECT drop_partitions('range_rel');
+	DROP TABLE range_rel CASCADE;
+	DROP EXTENSION pg_pathman;
+}
+
+session "s1"
+step "s1b" { BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step "s1_insert_1000" { INSERT INTO range_rel VALUES (50, 1000); }
+step "s1r" { ROLLBACK; }
+step "s1c" { COMMIT; }
+
+session "s2"
+step "s2b" { BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step "s2_insert_2000" { INSERT INTO range_rel VALUES (60, 2000); }
+step "s2c" { COMMIT; }
+
+session "s3"
+step "s3_show_waits" { SELECT locktype, mode FROM pg_locks WHERE NOT granted; }
+step "s3_show_zone_maps" { SELECT partrel, valid FROM pathman_zone_maps ORDER BY partrel::TEXT; }
+
+# writers spoiling the same zone map neither wait for each other nor fail
+permutation "s1b" "s2b" "s1_insert_1000" "s2_insert_2000" "s3_show_waits" "s1c" "s2c" "s3_show_zone_maps"
+
+# zone map stays spoiled if the writer rolls back
+permutation "s1b" "s1_insert_1000" "s1r" "s3_show_zone_maps"
@@ -54,5 +54,59 @@ DROP TABLE test_bgw.test_4 CASCADE;
 
 
 
+/*
+ * Tests for PremakeWorker
+ */
+
+/* int4, partitions are premade ahead of the last non-empty one */
+CREATE TABLE test_bgw.test_5(val INT4 NOT NULL);
+INSERT INTO test_bgw.test_5 VALUES (1), (6);
+SELECT create_range_partitions('test_bgw.test_5', 'val', 1, 5, 3);
+
+SELECT premake_partitions('test_bgw.test_5');		/* not set, error */
+SELECT premake_partitions('test_bgw.test_5', 0);	/* invalid, error */
+SELECT premake_partitions('test_bgw.test_5', 2);	/* should create 1 partition */
+SELECT premake_partitions('test_bgw.test_5', 2);	/* nothing to create */
+
+SELECT set_auto('test_bgw.test_5', false);			/* keep worker away */
+SELECT set_premake('test_bgw.test_5', 0);			/* invalid, error */
+SELECT set_premake('test_bgw.test_5', 3);
+SELECT partrel, auto, premake FROM pathman_config_params;
+SELECT premake_partitions('test_bgw.test_5');		/* should create 1 partition */
+SELECT * FROM pathman_partition_list ORDER BY partition; /* should contain 5 partitions */
+
+SELECT set_premake('test_bgw.test_5');
+SELECT partrel, auto, premake FROM pathman_config_params;
+
+DROP TABLE test_bgw.test_5 CASCADE;
+
+
+/* int4, partitions are created by PremakeWorker */
+CREATE TABLE test_bgw.test_6(val INT4 NOT NULL);
+INSERT INTO test_bgw.test_6 VALUES (6);
+SELECT create_range_partitions('test_bgw.test_6', 'val', 1, 5, 2);
+SELECT set_premake('test_bgw.test_6', 2);			/* should create 2 partitions */
+
+DO $$
+BEGIN
+	/* Wait for PremakeWorker (up to 60 seconds) */
+	FOR i IN 1..600 LOOP
+		IF (SELECT count(*) FROM pg_catalog.pg_inherits
+			WHERE inhparent = 'test_bgw.test_6'::REGCLASS) = 4 THEN
+			RETURN;
+		END IF;
+
+		PERFORM pg_sleep(0.1);
+	END LOOP;
+
+	RAISE EXCEPTION 'partitions have not been created by PremakeWorker';
+END
+$$;
+SELECT * FROM pathman_partition_list ORDER BY partition; /* should contain 4 partitions */
+
+SELECT set_premake('test_bgw.test_6');
+DROP TABLE test_bgw.test_6 CASCADE;
+
+
 DROP SCHEMA test_bgw CASCADE;
 DROP EXTENSION pg_pathman;
@@ -68,6 +68,10 @@ SELECT append_range_partition('callbacks.abc');
 SELECT prepend_range_partition('callbacks.abc');
 SELECT add_range_partition('callbacks.abc', 501, 602);
 
+/* create several partitions in one go */
+SELECT create_range_partitions_internal('callbacks.abc', '{602, 700, NULL}'::INT4[]);
+SELECT generate_range_bounds('2017-01-31'::DATE, '1 month'::INTERVAL, 3);
+
 SELECT drop_partitions('callbacks.abc');
 
 
@@ -0,0 +1,66 @@
+\set VERBOSITY terse
+
+CREATE EXTENSION pg_pathman;
+CREATE SCHEMA exprs;
+
+
+/*
+ * Test pruning through monotonic functions and casts
+ */
+CREATE TABLE exprs.range_rel(dt TIMESTAMP NOT NULL);
+INSERT INTO exprs.range_rel (dt)
+SELECT g FROM generate_series('2015-01-01', '2015-04-30', '1 day'::interval) AS g;
+SELECT create_range_partitions('exprs.range_rel', 'dt', '2015-01-01'::DATE, '1 month'::INTERVAL);
+
+CREATE TABLE exprs.num_rel(id INT4 NOT NULL);
+INSERT INTO exprs.num_rel SELECT generate_series(1, 300);
+SELECT create_range_partitions('exprs.num_rel', 'id', 1, 100);
+
+/* casts */
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE dt::DATE = '2015-02-15';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.num_rel WHERE id::INT8 = 150;
+
+/* date_trunc() */
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE date_trunc('month', dt) = '2015-03-01';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE '2015-03-15' <= date_trunc('day', dt);
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE date_trunc('day', dt) <= '294276-12-31';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE date_trunc('month', dt)::DATE = '2015-03-01';
+
+/* AT TIME ZONE (only zones with fixed offset) */
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE dt AT TIME ZONE 'UTC' < '2015-01-20 00:00:00+00';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE dt AT TIME ZONE 'America/New_York' < '2015-01-20 00:00:00+00';
+
+SELECT count(*) FROM exprs.range_rel WHERE dt::DATE = '2015-02-15';
+SELECT count(*) FROM exprs.range_rel WHERE date_trunc('month', dt) = '2015-03-01';
+SELECT count(*) FROM exprs.num_rel WHERE id::INT8 BETWEEN 95 AND 105;
+
+
+/* range types */
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE dt <@ tsrange('2015-02-01', '2015-03-01');
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE tsrange('2015-02-15', '2015-03-15', '[]') @> dt;
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE tsrange(dt, dt, '[]') && '[2015-03-10, 2015-03-20)'::tsrange;
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.range_rel WHERE dt <@ 'empty'::tsrange;
+SELECT count(*) FROM exprs.range_rel WHERE tsrange(dt, dt, '[]') <@ '[2015-02-01, 2015-03-01)'::tsrange;
+SELECT count(*) FROM (VALUES ('[2015-02-01, 2015-02-03)'::tsrange),
+							 ('[2015-03-30, 2015-04-02)'::tsrange)) AS v(r)
+JOIN exprs.range_rel ON dt <@ r;
+
+/* LIKE and regular expressions (only "C" collation) */
+CREATE TABLE exprs.text_rel(sku TEXT COLLATE "C" NOT NULL);
+SELECT create_range_partitions('exprs.text_rel', 'sku', 'A'::TEXT, NULL::TEXT, 0);
+SELECT add_range_partition('exprs.text_rel', 'A'::TEXT, 'AB'::TEXT);
+SELECT add_range_partition('exprs.text_rel', 'AB'::TEXT, 'ABM'::TEXT);
+SELECT add_range_partition('exprs.text_rel', 'ABM'::TEXT, 'AC'::TEXT);
+SELECT add_range_partition('exprs.text_rel', 'AC'::TEXT, 'B'::TEXT);
+INSERT INTO exprs.text_rel VALUES ('AA1'), ('AB1'), ('ABC'), ('ABM1'), ('ABX'), ('AC1'), ('AZ');
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.text_rel WHERE sku LIKE 'AB%';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.text_rel WHERE sku LIKE 'ABC';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.text_rel WHERE sku ~ '^ABN';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.text_rel WHERE sku LIKE '%B%';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.text_rel WHERE sku >= 'ABM';
+EXPLAIN (COSTS OFF) SELECT * FROM exprs.text_rel WHERE sku < 'AB' COLLATE "POSIX";
+SELECT count(*) FROM exprs.text_rel WHERE sku LIKE 'AB%';
+
+
+DROP SCHEMA exprs CASCADE;
+DROP EXTENSION pg_pathman CASCADE;
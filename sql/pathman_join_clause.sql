@@ -43,6 +43,107 @@ SELECT m.tableoid::regclass, id1, id2, key, start_key, end_key
     WHERE NOT key <@ int4range(6, end_key);
 
 
+/*
+ * Test partition-wise join of identically partitioned tables
+ */
+
+/* create test tables */
+CREATE TABLE test.hash_a (id INT NOT NULL, val INT);
+CREATE TABLE test.hash_b (id INT NOT NULL, val INT);
+INSERT INTO test.hash_a SELECT g, g FROM generate_series(1, 1000) g;
+INSERT INTO test.hash_b SELECT g, g * 2 FROM generate_series(1, 1000, 2) g;
+SELECT pathman.create_hash_partitions('test.hash_a', 'id', 4);
+SELECT pathman.create_hash_partitions('test.hash_b', 'id', 4);
+
+CREATE TABLE test.range_a (id INT NOT NULL, val INT);
+CREATE TABLE test.range_b (id INT NOT NULL, val INT);
+INSERT INTO test.range_a SELECT g, g FROM generate_series(1, 1000) g;
+INSERT INTO test.range_b SELECT g, g * 2 FROM generate_series(1, 1000, 2) g;
+SELECT pathman.create_range_partitions('test.range_a', 'id', 1, 100);
+SELECT pathman.create_range_partitions('test.range_b', 'id', 1, 100);
+
+ANALYZE test.hash_a;
+ANALYZE test.hash_b;
+ANALYZE test.range_a;
+ANALYZE test.range_b;
+
+/* partitions need statistics of their own */
+DO $$
+DECLARE
+	r RECORD;
+BEGIN
+	FOR r IN SELECT partition FROM pathman.pathman_partition_list
+			 WHERE parent IN ('test.hash_a'::regclass, 'test.hash_b'::regclass,
+							  'test.range_a'::regclass, 'test.range_b'::regclass)
+	LOOP
+		EXECUTE format('ANALYZE %s', r.partition);
+	END LOOP;
+END
+$$;
+
+/* run test queries */
+SET pg_pathman.enable_partitionwise_join = t;
+EXPLAIN (COSTS OFF)
+SELECT count(*) AS total, sum(a.val + b.val) AS sum_val
+    FROM test.hash_a a JOIN test.hash_b b USING(id);
+SELECT count(*) AS total, sum(a.val + b.val) AS sum_val
+    FROM test.hash_a a JOIN test.hash_b b USING(id);
+SELECT count(*) AS total, count(b.id) AS matched, sum(b.val) AS sum_val
+    FROM test.hash_a a LEFT JOIN test.hash_b b ON a.id = b.id;
+EXPLAIN (COSTS OFF)
+SELECT count(*) AS total, sum(a.val + b.val) AS sum_val
+    FROM test.range_a a JOIN test.range_b b USING(id)
+    WHERE a.id < 250;
+SELECT count(*) AS total, sum(a.val + b.val) AS sum_val
+    FROM test.range_a a JOIN test.range_b b USING(id)
+    WHERE a.id < 250;
+SELECT count(*) AS total, count(b.id) AS matched, sum(b.val) AS sum_val
+    FROM test.range_a a LEFT JOIN test.range_b b ON a.id = b.id;
+RESET pg_pathman.enable_partitionwise_join;
+
+
+/*
+ * Test pruning of Hash Join's outer partitions
+ */
+CREATE TABLE test.dim (id INT);
+INSERT INTO test.dim VALUES (5), (150), (420), (NULL), (5000);
+ANALYZE test.dim;
+
+SET pg_pathman.enable_partitionselector = t;
+SET enable_nestloop = f;
+SET enable_mergejoin = f;
+EXPLAIN (COSTS OFF)
+SELECT count(*) AS total, sum(a.val) AS sum_val
+    FROM test.range_a a JOIN test.dim d USING(id);
+DO $$
+DECLARE
+	plan	jsonb;
+	hj		jsonb;
+BEGIN
+	EXECUTE 'EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF, FORMAT JSON)
+			 SELECT count(*) FROM test.range_a a JOIN test.dim d USING(id)'
+	INTO plan;
+
+	/* Aggregate -> Hash Join */
+	hj := plan->0->'Plan'->'Plans'->0;
+
+	RAISE NOTICE 'PartitionSelector: % matched, RuntimeAppend: % selected, % initialized',
+		hj->'Plans'->1->'Plans'->0->'Partitions Matched',
+		hj->'Plans'->0->'Partitions Selected',
+		hj->'Plans'->0->'Partitions Initialized';
+END
+$$;
+SELECT count(*) AS total, sum(a.val) AS sum_val
+    FROM test.range_a a JOIN test.dim d USING(id);
+SELECT count(*) AS total, sum(a.val) AS sum_val
+    FROM test.hash_a a JOIN test.dim d USING(id);
+SELECT count(*) AS total, sum(val) AS sum_val
+    FROM test.range_a WHERE id IN (SELECT id FROM test.dim);
+RESET enable_mergejoin;
+RESET enable_nestloop;
+RESET pg_pathman.enable_partitionselector;
+
+
 DROP SCHEMA test CASCADE;
 DROP EXTENSION pg_pathman CASCADE;
 DROP SCHEMA pathman CASCADE;
@@ -0,0 +1,75 @@
+\set VERBOSITY terse
+
+CREATE SCHEMA pathman;
+CREATE EXTENSION pg_pathman SCHEMA pathman;
+CREATE SCHEMA test;
+
+
+/*
+ * Test partition-wise aggregation
+ */
+
+/* create test tables */
+CREATE TABLE test.hash_a (id INT NOT NULL, val INT);
+INSERT INTO test.hash_a SELECT g, g FROM generate_series(1, 1000) g;
+SELECT pathman.create_hash_partitions('test.hash_a', 'id', 4);
+
+CREATE TABLE test.range_a (id INT NOT NULL, val INT);
+CREATE TABLE test.range_b (id INT NOT NULL, val INT);
+INSERT INTO test.range_a SELECT g, g FROM generate_series(1, 1000) g;
+INSERT INTO test.range_b SELECT g, g * 2 FROM generate_series(1, 1000, 2) g;
+SELECT pathman.create_range_partitions('test.range_a', 'id', 1, 100);
+SELECT pathman.create_range_partitions('test.range_b', 'id', 1, 100);
+
+CREATE TABLE test.events (ts TIMESTAMP NOT NULL, val INT);
+INSERT INTO test.events SELECT g, 1
+    FROM generate_series('2017-01-01'::timestamp, '2017-01-10 23:00', '1 hour') g;
+SELECT pathman.create_range_partitions('test.events', 'ts',
+                                       '2017-01-01'::timestamp, '1 day'::interval);
+
+/* partitions need statistics of their own */
+DO $$
+DECLARE
+	r RECORD;
+BEGIN
+	FOR r IN SELECT partrel FROM pathman.pathman_config
+	LOOP
+		EXECUTE format('ANALYZE %s', r.partrel);
+	END LOOP;
+
+	FOR r IN SELECT partition FROM pathman.pathman_partition_list
+	LOOP
+		EXECUTE format('ANALYZE %s', r.partition);
+	END LOOP;
+END
+$$;
+
+/* run test queries */
+SET pg_pathman.enable_partitionwise_agg = t;
+
+/* GROUP BY partitioned column: each partition is aggregated separately */
+EXPLAIN (COSTS OFF)
+SELECT id, count(*) FROM test.hash_a GROUP BY id;
+SELECT count(*) AS total, sum(cnt) AS sum_cnt
+    FROM (SELECT id, count(*) AS cnt FROM test.hash_a GROUP BY id) t;
+SELECT count(*) AS total, sum(s) AS sum_val
+    FROM (SELECT id, sum(val) AS s FROM test.range_b
+          GROUP BY id HAVING sum(val) > 1000) t;
+
+/* date_trunc() which keeps all bounds of partitions */
+EXPLAIN (COSTS OFF)
+SELECT date_trunc('day', ts), count(*) FROM test.events GROUP BY 1;
+SELECT count(*) AS days, sum(cnt) AS total
+    FROM (SELECT date_trunc('day', ts), count(*) AS cnt
+          FROM test.events GROUP BY 1) t;
+
+/* other aggregates are combined from partial ones */
+SELECT val % 3 AS r, count(*) FROM test.hash_a GROUP BY 1 ORDER BY 1;
+SELECT count(*) AS total, sum(val) AS sum_val, min(val), max(val)
+    FROM test.range_a WHERE id > 150;
+RESET pg_pathman.enable_partitionwise_agg;
+
+
+DROP SCHEMA test CASCADE;
+DROP EXTENSION pg_pathman CASCADE;
+DROP SCHEMA pathman CASCADE;
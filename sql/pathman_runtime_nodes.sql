@@ -229,6 +229,262 @@ set pg_pathman.enable = true
 set enable_hashjoin = off
 set enable_mergejoin = off;
 
+create or replace function test.pathman_test_6() returns text as $$
+declare
+	res record;
+begin
+	select t.id
+	from test.vals v, lateral
+		(select id from test.runtime_test_4 g
+		 where g.id > v.val order by g.id offset 2 limit 1) t
+	where v.val = 998
+	into res; /* ordered scan (ascending) */
+
+	perform test.pathman_equal(res.id::text, '1001', 'id is incorrect (t1)');
+
+
+	select t.id
+	from test.vals v, lateral
+		(select id from test.runtime_test_4 g
+		 where g.id < v.val order by g.id desc offset 2 limit 1) t
+	where v.val = 1003
+	into res; /* ordered scan (descending) */
+
+	perform test.pathman_equal(res.id::text, '1000', 'id is incorrect (t2)');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set pg_pathman.enable = true
+set enable_hashjoin = off
+set enable_mergejoin = off;
+
+create or replace function test.pathman_test_7() returns text as $$
+declare
+	res record;
+	plan jsonb;
+	rma jsonb;
+	num int;
+begin
+	select min(id) as min, max(id) as max
+	from test.runtime_test_4
+	into res; /* whole table */
+
+	perform test.pathman_equal(res.min::text, '1', 'min is incorrect (t1)');
+	perform test.pathman_equal(res.max::text, '10000', 'max is incorrect (t1)');
+
+
+	select min(id) as min, max(id) as max
+	from test.runtime_test_4
+	where val != 'k = 1' and val != 'k = 10000'
+	into res; /* filtered */
+
+	perform test.pathman_equal(res.min::text, '2', 'min is incorrect (t2)');
+	perform test.pathman_equal(res.max::text, '9999', 'max is incorrect (t2)');
+
+
+	execute 'explain (analyze, costs off, timing off, format json)
+			 select * from test.runtime_test_7 order by id limit 3'
+	into plan; /* ordered scan stops at the first partition */
+
+	rma = plan->0->'Plan'->'Plans'->0;
+
+	perform test.pathman_equal((rma->'Custom Plan Provider')::text,
+							   '"RuntimeMergeAppend"',
+							   'wrong plan provider (t3)');
+
+	perform test.pathman_equal((rma->'Partition Scan Order')::text,
+							   '"Ascending"',
+							   'wrong scan order (t3)');
+
+	perform test.pathman_equal((rma->'Partitions Selected')::text,
+							   '10',
+							   'expected 10 partitions selected (t3)');
+
+	/* Other partitions have never been executed (not even initialized) */
+	perform test.pathman_equal((rma->'Partitions Initialized')::text,
+							   '1',
+							   'expected 1 partition initialized (t3)');
+
+	select count(*) from jsonb_array_elements(rma->'Plans') into num;
+	perform test.pathman_equal(num::text, '1', 'expected 1 child plan (t3)');
+
+
+	execute 'explain (analyze, costs off, timing off, format json)
+			 select max(id) from test.runtime_test_7'
+	into plan; /* max() is answered by the last partition */
+
+	rma = plan->0->'Plan'->'Plans'->0->'Plans'->0;
+
+	perform test.pathman_equal((rma->'Custom Plan Provider')::text,
+							   '"RuntimeMergeAppend"',
+							   'wrong plan provider (t4)');
+
+	perform test.pathman_equal((rma->'Partition Scan Order')::text,
+							   '"Descending"',
+							   'wrong scan order (t4)');
+
+	perform test.pathman_equal((rma->'Partitions Initialized')::text,
+							   '1',
+							   'expected 1 partition initialized (t4)');
+
+	perform test.pathman_equal((rma->'Plans'->0->'Plans'->0->'Relation Name')::text,
+							   '"runtime_test_7_10"',
+							   'wrong partition (t4)');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set pg_pathman.enable = true;
+
+create or replace function test.pathman_test_8() returns text as $$
+declare
+	plan jsonb;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_5 where id = (select * from test.run_values limit 1)');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Custom Plan Provider')::text,
+							   '"RuntimeAppend"',
+							   'wrong plan provider');
+
+	/* 90% of rows are stored in the first partition */
+	perform test.pathman_assert((plan->0->'Plan'->'Plan Rows')::text::int >= 10,
+								'row estimate ignores partition sizes');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set pg_pathman.enable = true
+set enable_mergejoin = off
+set enable_hashjoin = off;
+
+create or replace function test.stable_bound() returns int as $$
+begin
+	return 2500;
+end;
+$$ language plpgsql stable;
+
+create or replace function test.pathman_test_9() returns text as $$
+declare
+	plan jsonb;
+	num int;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_4 where id < test.stable_bound()');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Custom Plan Provider')::text,
+							   '"RuntimeAppend"',
+							   'wrong plan provider');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Partitions Pruned')::text,
+							   '7',
+							   'expected 7 partitions pruned at startup');
+
+	select count(*) from jsonb_array_elements_text(plan->0->'Plan'->'Plans') into num;
+	perform test.pathman_equal(num::text, '3', 'expected 3 child plans for custom scan');
+
+	select count(*) from test.runtime_test_4 where id < test.stable_bound() into num;
+	perform test.pathman_equal(num::text, '2499', 'wrong number of rows');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set pg_pathman.enable = true;
+
+create or replace function test.pathman_test_10() returns text as $$
+declare
+	plan jsonb;
+	router jsonb;
+	num int;
+begin
+	plan = test.pathman_test('update test.runtime_test_1 set val = -1 where id = (select * from test.run_values limit 1)');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Node Type')::text,
+							   '"ModifyTable"',
+							   'wrong plan type');
+
+	select p from jsonb_array_elements(plan->0->'Plan'->'Plans') p
+	where p->>'Custom Plan Provider' = 'PartitionRouter' into router;
+
+	perform test.pathman_assert(router is not null, 'PartitionRouter not found');
+
+	perform test.pathman_equal((router->'Plans'->0->'Custom Plan Provider')::text,
+							   '"RuntimeAppend"',
+							   'wrong plan provider');
+
+	select count(*) from jsonb_array_elements(router->'Plans'->0->'Plans') p
+	where p->>'Parent Relationship' != 'InitPlan' into num;
+	perform test.pathman_equal(num::text, '1', 'expected 1 child plan for custom scan');
+
+	perform test.pathman_equal((select p->>'Relation Name'
+								from jsonb_array_elements(router->'Plans'->0->'Plans') p
+								where p->>'Parent Relationship' != 'InitPlan'),
+							   format('runtime_test_1_%s', pathman.get_hash_part_idx(hashint4(1), 6)),
+							   'wrong partition');
+
+	select count(*) from test.runtime_test_1 where val = -1 into num;
+	perform test.pathman_equal(num::text, '1', 'wrong number of updated rows');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set pg_pathman.enable = true;
+
+create or replace function test.pathman_test_11() returns text as $$
+declare
+	plan jsonb;
+	num int;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_4 where id < test.stable_bound() limit 1');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->0->'Custom Plan Provider')::text,
+							   '"RuntimeAppend"',
+							   'wrong plan provider');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->0->'Partitions Selected')::text,
+							   '3',
+							   'expected 3 partitions selected');
+
+	/* LIMIT is satisfied by the first partition */
+	perform test.pathman_equal((plan->0->'Plan'->'Plans'->0->'Partitions Initialized')::text,
+							   '1',
+							   'expected 1 partition initialized');
+
+	select count(*) from jsonb_array_elements_text(plan->0->'Plan'->'Plans'->0->'Plans') into num;
+	perform test.pathman_equal(num::text, '1', 'expected 1 child plan for custom scan');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set pg_pathman.enable = true;
+
+create or replace function test.pathman_test_12() returns text as $$
+declare
+	plan jsonb;
+	num int;
+begin
+	plan = test.pathman_test('select * from test.runtime_test_6 where id = (select 1)');
+
+	perform test.pathman_equal((plan->0->'Plan'->'Custom Plan Provider')::text,
+							   '"RuntimeAppend"',
+							   'wrong plan provider');
+
+	/* Parent is empty, so it shouldn't be scanned */
+	perform test.pathman_equal((plan->0->'Plan'->'Partitions Selected')::text,
+							   '1',
+							   'expected 1 partition selected');
+
+	select count(*) from jsonb_array_elements(plan->0->'Plan'->'Plans') p
+	where p->>'Parent Relationship' != 'InitPlan' into num;
+	perform test.pathman_equal(num::text, '1', 'expected 1 child plan for custom scan');
+
+	select count(*) from test.runtime_test_6 where id = (select 1) into num;
+	perform test.pathman_equal(num::text, '1', 'wrong number of rows');
+
+	return 'ok';
+end;
+$$ language plpgsql
+set pg_pathman.enable = true;
+
 
 
 create table test.run_values as select generate_series(1, 10000) val;
@@ -249,12 +505,49 @@ select pathman.create_hash_partitions('test.runtime_test_3', 'id', 4);
 create index on test.runtime_test_3 (id);
 create index on test.runtime_test_3_0 (id);
 
+create table test.runtime_test_4(val text, id int not null);
+insert into test.runtime_test_4(id, val) select * from generate_series(1, 10000) k, format('k = %s', k);
+create index on test.runtime_test_4 (id);
+select pathman.create_range_partitions('test.runtime_test_4', 'id', 1, 1000);
+
+create table test.runtime_test_5(val text, id int not null);
+insert into test.runtime_test_5(id, val) select k, format('k = %s', k) from generate_series(1, 1000) k, generate_series(1, 9);
+insert into test.runtime_test_5(id, val) select k, format('k = %s', k) from generate_series(1, 9) p, generate_series(p * 1000 + 1, p * 1000 + 100) k;
+select pathman.create_range_partitions('test.runtime_test_5', 'id', 1, 1000);
+do $$
+declare
+	r record;
+begin
+	for r in select partition from pathman.pathman_partition_list
+			 where parent = 'test.runtime_test_5'::regclass
+	loop
+		execute format('analyze %s', r.partition);
+	end loop;
+end
+$$;
+
+
+create table test.runtime_test_7(val text, id int not null);
+insert into test.runtime_test_7(id, val) select * from generate_series(1, 10000) k, format('k = %s', k);
+select pathman.create_range_partitions('test.runtime_test_7', 'id', 1, 1000);
+
+create table test.runtime_test_6(val text, id int not null);
+select pathman.create_range_partitions('test.runtime_test_6', 'id', 1, 1000, 3);
+insert into test.runtime_test_6(id, val) select k, format('k = %s', k) from generate_series(1, 3000) k;
+select pathman.set_enable_parent('test.runtime_test_6', true);
+/* dead tuples of the parent shouldn't make it look non-empty */
+set pg_pathman.enable_partitionfilter = off;
+insert into only test.runtime_test_6(id, val) values (1, 'parent');
+delete from only test.runtime_test_6;
+reset pg_pathman.enable_partitionfilter;
 
 analyze test.run_values;
 analyze test.runtime_test_1;
 analyze test.runtime_test_2;
 analyze test.runtime_test_3;
 analyze test.runtime_test_3_0;
+analyze test.runtime_test_4;
+analyze test.runtime_test_7;
 
 set pg_pathman.enable_runtimeappend = on;
 set pg_pathman.enable_runtimemergeappend = on;
@@ -264,6 +557,34 @@ select test.pathman_test_2(); /* RuntimeAppend (select ... where id = any(subque
 select test.pathman_test_3(); /* RuntimeAppend (a join b on a.id = b.val) */
 select test.pathman_test_4(); /* RuntimeMergeAppend (lateral) */
 select test.pathman_test_5(); /* projection tests for RuntimeXXX nodes */
+select test.pathman_test_6(); /* ordered scan of RANGE partitions */
+select test.pathman_test_7(); /* min() & max() of partitioned column */
+select test.pathman_test_8(); /* row estimate for skewed partitions */
+select test.pathman_test_9(); /* RuntimeAppend (stable functions) */
+select test.pathman_test_10(); /* RuntimeAppend (UPDATE ... where id = (subquery)) */
+select test.pathman_test_11(); /* RuntimeAppend (lazy initialization of children) */
+select test.pathman_test_12(); /* RuntimeAppend (empty parent) */
+
+/* Same with prefetching of the next partition */
+set pg_pathman.runtime_prefetch_depth = 4;
+select test.pathman_test_1();
+select test.pathman_test_3();
+select test.pathman_test_4();
+select test.pathman_test_6();
+select test.pathman_test_7();
+select test.pathman_test_11();
+do $$
+declare
+	num int;
+begin
+	/* a generic plan locks all partitions, so they can be prefetched */
+	for i in 1..10 loop
+		select count(*) from test.runtime_test_4 where id < 2500 + i into num;
+		perform test.pathman_equal(num::text, (2499 + i)::text, 'wrong number of rows');
+	end loop;
+end
+$$;
+reset pg_pathman.runtime_prefetch_depth;
 
 
 DROP SCHEMA test CASCADE;
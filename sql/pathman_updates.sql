@@ -32,6 +32,54 @@ EXPLAIN (COSTS OFF) UPDATE test_updates.test SET b = 0 WHERE val = 101;
 UPDATE test_updates.test SET b = 0 WHERE val = 101 RETURNING *, tableoid::REGCLASS;
 
 
+/* several partitions, tuple descs are the same */
+EXPLAIN (COSTS OFF) UPDATE test_updates.test SET b = 0 WHERE val BETWEEN 5 AND 25;
+
+WITH upd AS (UPDATE test_updates.test SET b = 0 WHERE val BETWEEN 5 AND 25
+			 RETURNING tableoid::REGCLASS AS part)
+SELECT part, count(*) FROM upd GROUP BY part ORDER BY part;
+
+EXPLAIN (COSTS OFF) DELETE FROM test_updates.test WHERE val BETWEEN 35 AND 55;
+DELETE FROM test_updates.test WHERE val BETWEEN 35 AND 55;
+SELECT count(*) FROM test_updates.test WHERE val BETWEEN 31 AND 60;
+
+
+/* several partitions, tuple descs are different */
+EXPLAIN (COSTS OFF) UPDATE test_updates.test SET b = 0 WHERE val > 95;
+
+
+/* DELETE truncates partitions fully covered by WHERE clause */
+SET pg_pathman.enable_truncate_on_delete = t;
+EXPLAIN (COSTS OFF) DELETE FROM test_updates.test WHERE val BETWEEN 61 AND 85;
+DELETE FROM test_updates.test WHERE val BETWEEN 61 AND 85;
+SELECT count(*) FROM test_updates.test WHERE val BETWEEN 61 AND 90;
+SELECT count(*) FROM test_updates.test_7;
+
+/* partitions with triggers are scanned as usual */
+CREATE FUNCTION test_updates.dummy_trig() RETURNS TRIGGER AS $$
+BEGIN RETURN OLD; END
+$$ LANGUAGE plpgsql;
+CREATE TRIGGER test_9_trig BEFORE DELETE ON test_updates.test_9
+FOR EACH ROW EXECUTE PROCEDURE test_updates.dummy_trig();
+EXPLAIN (COSTS OFF) DELETE FROM test_updates.test WHERE val BETWEEN 81 AND 95;
+
+/* RETURNING needs deleted rows */
+EXPLAIN (COSTS OFF) DELETE FROM test_updates.test WHERE val BETWEEN 91 AND 100 RETURNING *;
+
+/* DELETE in a CTE doesn't truncate partitions read by the outer query */
+WITH d AS (DELETE FROM test_updates.test WHERE val BETWEEN 11 AND 30)
+SELECT count(*) FROM test_updates.test WHERE val BETWEEN 11 AND 30;
+SELECT count(*) FROM test_updates.test WHERE val BETWEEN 11 AND 30;
+
+/* EXPLAIN doesn't lock partitions to be truncated in ACCESS EXCLUSIVE mode */
+BEGIN;
+EXPLAIN (COSTS OFF) DELETE FROM test_updates.test WHERE val BETWEEN 91 AND 105;
+SELECT mode FROM pg_locks
+WHERE pid = pg_backend_pid() AND relation = 'test_updates.test_10'::REGCLASS;
+ROLLBACK;
+RESET pg_pathman.enable_truncate_on_delete;
+
+
 
 DROP SCHEMA test_updates CASCADE;
 DROP EXTENSION pg_pathman;
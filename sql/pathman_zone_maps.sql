@@ -0,0 +1,59 @@
+\set VERBOSITY terse
+
+CREATE EXTENSION pg_pathman;
+CREATE SCHEMA zone_maps;
+
+
+/*
+ * Test pruning by zone maps of a column other than partitioning key
+ */
+CREATE TABLE zone_maps.events(id INT4 NOT NULL, val INT4);
+INSERT INTO zone_maps.events SELECT i, i * 2 FROM generate_series(1, 300) i;
+SELECT create_range_partitions('zone_maps.events', 'id', 1, 100);
+
+/* no zone maps yet */
+SELECT set_zone_map_columns('zone_maps.events', '{val}');
+EXPLAIN (COSTS OFF) SELECT * FROM zone_maps.events WHERE val = 300;
+
+/* compute zone maps */
+SELECT refresh_zone_maps('zone_maps.events');
+SELECT * FROM pathman_zone_maps ORDER BY partrel::TEXT;
+EXPLAIN (COSTS OFF) SELECT * FROM zone_maps.events WHERE val = 300;
+EXPLAIN (COSTS OFF) SELECT * FROM zone_maps.events WHERE val > 450;
+EXPLAIN (COSTS OFF) SELECT * FROM zone_maps.events WHERE 100 >= val;
+EXPLAIN (COSTS OFF) SELECT * FROM zone_maps.events WHERE val = 1000;
+
+/* spoil zone map of events_1 */
+INSERT INTO zone_maps.events VALUES (50, 1000);
+SELECT partrel, valid FROM pathman_zone_maps ORDER BY partrel::TEXT;
+EXPLAIN (COSTS OFF) SELECT * FROM zone_maps.events WHERE val = 1000;
+SELECT count(*) FROM zone_maps.events WHERE val = 1000;
+
+/* NULLs don't spoil zone maps */
+INSERT INTO zone_maps.events VALUES (150, NULL);
+SELECT partrel, valid FROM pathman_zone_maps ORDER BY partrel::TEXT;
+
+/* refresh only stale zone maps */
+SELECT refresh_zone_maps('zone_maps.events', true);
+SELECT * FROM pathman_zone_maps ORDER BY partrel::TEXT;
+
+/* our trigger sees rows modified by other BEFORE triggers */
+CREATE FUNCTION zone_maps.shift_val() RETURNS TRIGGER AS $$
+BEGIN
+	NEW.val := NEW.val + 1000;
+	RETURN NEW;
+END
+$$ LANGUAGE plpgsql;
+CREATE TRIGGER zzz_shift_val BEFORE INSERT ON zone_maps.events_2
+FOR EACH ROW EXECUTE PROCEDURE zone_maps.shift_val();
+INSERT INTO zone_maps.events VALUES (150, 300);
+SELECT partrel, valid FROM pathman_zone_maps ORDER BY partrel::TEXT;
+
+/* reset zone maps */
+SELECT set_zone_map_columns('zone_maps.events', NULL);
+SELECT count(*) FROM pathman_zone_maps;
+EXPLAIN (COSTS OFF) SELECT * FROM zone_maps.events WHERE val = 300;
+
+
+DROP SCHEMA zone_maps CASCADE;
+DROP EXTENSION pg_pathman;
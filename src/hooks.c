@@ -11,17 +11,23 @@
 #include "utility_stmt_hooking.h"
 #include "hooks.h"
 #include "init.h"
+#include "partition_agg.h"
 #include "partition_filter.h"
+#include "partition_join.h"
+#include "partition_selector.h"
 #include "pg_compat.h"
 #include "planner_tree_modification.h"
 #include "runtimeappend.h"
 #include "runtime_merge_append.h"
 #include "utils.h"
 #include "xact_handling.h"
+#include "zone_map.h"
 
 #include "access/transam.h"
 #include "catalog/pg_authid.h"
+#include "commands/defrem.h"
 #include "miscadmin.h"
+#include "optimizer/clauses.h"
 #include "optimizer/cost.h"
 #include "optimizer/restrictinfo.h"
 #include "utils/typcache.h"
@@ -31,11 +37,105 @@
 set_join_pathlist_hook_type		set_join_pathlist_next = NULL;
 set_rel_pathlist_hook_type		set_rel_pathlist_hook_next = NULL;
 planner_hook_type				planner_hook_next = NULL;
+#if PG_VERSION_NUM >= 90600
+create_upper_paths_hook_type	create_upper_paths_hook_next = NULL;
+#endif
 post_parse_analyze_hook_type	post_parse_analyze_hook_next = NULL;
 shmem_startup_hook_type			shmem_startup_hook_next = NULL;
 ProcessUtility_hook_type		process_utility_hook_next = NULL;
 
 
+/*
+ * Check if children of 'path' may be scanned one by one in bound order,
+ * i.e. it's sorted by partitioned column of a RANGE-partitioned table.
+ */
+static rma_scan_order
+get_partition_scan_order(const PartRelationInfo *prel, Path *path,
+						 PathKey *pathkeyAsc, PathKey *pathkeyDesc)
+{
+	PathKey *first_pathkey;
+
+	/* Parent's tuples don't belong to any range */
+	if (prel->parttype != PT_RANGE || prel->enable_parent)
+		return RMA_MERGE_CHILDREN;
+
+	/* Path is not sorted at all */
+	if (path->pathkeys == NIL)
+		return RMA_MERGE_CHILDREN;
+
+	first_pathkey = (PathKey *) linitial(path->pathkeys);
+
+	if (pathkeyAsc && first_pathkey == pathkeyAsc)
+		return RMA_ORDERED_ASC;
+
+	if (pathkeyDesc && first_pathkey == pathkeyDesc)
+		return RMA_ORDERED_DESC;
+
+	return RMA_MERGE_CHILDREN;
+}
+
+/*
+ * Check if some of 'clauses' could select partitions only at execution
+ * time, i.e. contain Params or stable functions (e.g. now()).
+ */
+static bool
+clauses_need_runtime_pruning(List *clauses)
+{
+	ListCell *lc;
+
+	foreach (lc, clauses)
+	{
+		Node *clause = (Node *) lfirst(lc);
+
+		if (clause_contains_params(clause))
+			return true;
+
+		/* Stable functions will be evaluated by begin_append_common() */
+		if (contain_mutable_functions(clause) &&
+			!contain_volatile_functions(clause))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * For each MergeAppend sorted by partitioned column, add a RuntimeMergeAppend
+ * which scans partitions in bound order. add_path() keeps the cheaper one.
+ */
+static void
+add_ordered_append_paths(PlannerInfo *root, RelOptInfo *rel,
+						 const PartRelationInfo *prel,
+						 PathKey *pathkeyAsc, PathKey *pathkeyDesc)
+{
+	List	   *ordered_paths = NIL;
+	ListCell   *lc;
+
+	foreach (lc, rel->pathlist)
+	{
+		Path		   *cur_path = (Path *) lfirst(lc);
+		rma_scan_order	scan_order;
+
+		if (!IsA(cur_path, MergeAppendPath))
+			continue;
+
+		scan_order = get_partition_scan_order(prel, cur_path,
+											  pathkeyAsc, pathkeyDesc);
+
+		if (scan_order != RMA_MERGE_CHILDREN)
+			ordered_paths = lappend(ordered_paths,
+									create_runtimemergeappend_path(root,
+																   (AppendPath *) cur_path,
+																   NULL, scan_order,
+																   1.0));
+	}
+
+	/* add_path() might free some cells of 'rel->pathlist' */
+	foreach (lc, ordered_paths)
+		add_path(rel, (Path *) lfirst(lc));
+}
+
+
 /* Take care of joins */
 void
 pathman_join_pathlist_hook(PlannerInfo *root,
@@ -61,10 +161,23 @@ pathman_join_pathlist_hook(PlannerInfo *root,
 		set_join_pathlist_next(root, joinrel, outerrel,
 							   innerrel, jointype, extra);
 
-	/* Check that both pg_pathman & RuntimeAppend nodes are enabled */
-	if (!IsPathmanReady() || !pg_pathman_enable_runtimeappend)
+	if (!IsPathmanReady())
+		return;
+
+	/* Try joining partitions of identically partitioned tables pairwise */
+	if (pg_pathman_enable_partitionwise_join)
+		add_partitionwise_join_path(root, joinrel, outerrel,
+									innerrel, jointype, extra);
+
+	/* Check that RuntimeAppend node is enabled */
+	if (!pg_pathman_enable_runtimeappend)
 		return;
 
+	/* Try pruning outer partitions using keys of Hash Join's build side */
+	if (pg_pathman_enable_partition_selector)
+		add_partition_selector_path(root, joinrel, outerrel,
+									innerrel, jointype, extra);
+
 	if (jointype == JOIN_FULL)
 		return; /* handling full joins is meaningless */
 
@@ -96,13 +209,12 @@ pathman_join_pathlist_hook(PlannerInfo *root,
 	}
 
 	paramsel = 1.0;
+	InitWalkerContext(&context, innerrel->relid,
+					  inner_prel, NULL, false);
 	foreach (lc, joinclauses)
 	{
 		WrapperNode *wrap;
 
-		InitWalkerContext(&context, innerrel->relid,
-						  inner_prel, NULL, false);
-
 		wrap = walk_expr_tree((Expr *) lfirst(lc), &context);
 		paramsel *= wrap->paramsel;
 	}
@@ -206,11 +318,23 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 	if (!IsPathmanReady())
 		return;
 
-	/* This works only for SELECTs or INSERTs on simple relations */
+	/* This works only for simple relations */
 	if (rte->rtekind != RTE_RELATION ||
-		rte->relkind != RELKIND_RELATION ||
-			(root->parse->commandType != CMD_SELECT &&
-			 root->parse->commandType != CMD_INSERT)) /* INSERT INTO ... SELECT ... */
+		rte->relkind != RELKIND_RELATION)
+		return;
+
+	/* UPDATE & DELETE: only result relation pruned by handle_modification_query() */
+	if (root->parse->commandType == CMD_UPDATE ||
+		root->parse->commandType == CMD_DELETE)
+	{
+		if (rti != root->parse->resultRelation ||
+			PARENTHOOD_ALLOWED != get_rel_parenthood_status(root->parse->queryId,
+															rte->relid))
+			return;
+	}
+	/* Otherwise it should be a SELECT or an INSERT INTO ... SELECT ... */
+	else if (root->parse->commandType != CMD_SELECT &&
+			 root->parse->commandType != CMD_INSERT)
 		return;
 
 	/* Skip if this table is not allowed to act as parent (see FROM ONLY) */
@@ -225,10 +349,14 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 		Oid			   *children;				/* selected children oids */
 		List		   *ranges,					/* a list of IndexRanges */
 					   *wrappers,				/* a list of WrapperNodes */
-					   *rel_part_clauses = NIL;	/* clauses with part. column */
+					   *rel_part_clauses = NIL,	/* clauses with part. column */
+					   *truncated = NIL;		/* truncated by DELETE */
 		PathKey		   *pathkeyAsc = NULL,
 					   *pathkeyDesc = NULL;
 		double			paramsel = 1.0;			/* default part selectivity */
+#if PG_VERSION_NUM >= 90600
+		bool			add_partial_paths = false;
+#endif
 		WalkerContext	context;
 		ListCell	   *lc;
 		int				i;
@@ -285,6 +413,21 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 			ranges = irange_list_intersection(ranges, wrap->rangeset);
 		}
 
+		/* Skip partitions whose zone maps don't match restrictions */
+		if (prel->zone_map_ncolumns > 0)
+			ranges = prune_by_zone_map_consts(ranges, prel,
+											  rel->baserestrictinfo, rti);
+
+		/* Skip partitions which will be truncated by PartitionRouter */
+		if (rti == root->parse->resultRelation)
+		{
+			truncated = get_truncated_partitions(root->parse->targetList);
+
+			/* Replan if they get triggers etc */
+			root->glob->relationOids = list_concat(root->glob->relationOids,
+												   list_copy(truncated));
+		}
+
 		/* Get number of selected partitions */
 		len = irange_list_length(ranges);
 		if (prel->enable_parent)
@@ -332,7 +475,12 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 			IndexRange irange = lfirst_irange(lc);
 
 			for (i = irange_lower(irange); i <= irange_upper(irange); i++)
+			{
+				if (truncated && list_member_oid(truncated, children[i]))
+					continue;
+
 				append_child_relation(root, parent_rel, rti, i, children[i], wrappers);
+			}
 		}
 
 		/* Now close parent relation */
@@ -366,9 +514,19 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 		rel_part_clauses = get_partitioned_attr_clauses(rel->baserestrictinfo,
 														prel, rel->relid);
 
-		/* Runtime[Merge]Append is pointless if there are no params in clauses */
-		if (!clause_contains_params((Node *) rel_part_clauses))
+		/* Runtime[Merge]Append is pointless if clauses are known at plan time */
+		if (!clauses_need_runtime_pruning(rel_part_clauses))
+		{
+			/*
+			 * ... unless MergeAppend is sorted by partitioned column.
+			 * In this case we can scan partitions one by one, thus
+			 * avoiding initialization of children we won't need.
+			 */
+			if (pg_pathman_enable_runtime_merge_append)
+				add_ordered_append_paths(root, rel, prel,
+										 pathkeyAsc, pathkeyDesc);
 			return;
+		}
 
 		/* Generate Runtime[Merge]Append paths if needed */
 		foreach (lc, rel->pathlist)
@@ -378,6 +536,7 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 			Path		   *inner_path = NULL;
 			ParamPathInfo  *ppi;
 			List		   *ppi_part_clauses = NIL;
+			rma_scan_order	scan_order;
 
 			/* Fetch ParamPathInfo & try to extract part-related clauses */
 			ppi = get_baserel_parampathinfo(root, rel, inner_required);
@@ -399,7 +558,18 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 			if (!(rel_part_clauses || ppi_part_clauses))
 				continue;
 
-			if (IsA(cur_path, AppendPath) && pg_pathman_enable_runtimeappend)
+			scan_order = get_partition_scan_order(prel, (Path *) cur_path,
+												  pathkeyAsc, pathkeyDesc);
+
+			/* Sorted by partitioned column, no need to merge children */
+			if (scan_order != RMA_MERGE_CHILDREN)
+			{
+				if (pg_pathman_enable_runtime_merge_append)
+					inner_path = create_runtimemergeappend_path(root, cur_path,
+																ppi, scan_order,
+																paramsel);
+			}
+			else if (IsA(cur_path, AppendPath) && pg_pathman_enable_runtimeappend)
 				inner_path = create_runtimeappend_path(root, cur_path,
 													   ppi, paramsel);
 			else if (IsA(cur_path, MergeAppendPath) &&
@@ -412,12 +582,38 @@ pathman_rel_pathlist_hook(PlannerInfo *root,
 								"MergeAppendPath differ");
 
 				inner_path = create_runtimemergeappend_path(root, cur_path,
-															ppi, paramsel);
+															ppi, RMA_MERGE_CHILDREN,
+															paramsel);
 			}
 
 			if (inner_path)
 				add_path(rel, inner_path);
+
+#if PG_VERSION_NUM >= 90600
+			/* Let parallel workers share selected partitions */
+			if (IsA(cur_path, AppendPath) && !inner_required &&
+				scan_order == RMA_MERGE_CHILDREN &&
+				pg_pathman_enable_runtimeappend &&
+				rel->consider_parallel && cur_path->path.parallel_safe)
+			{
+				Path *partial_path;
+
+				partial_path = create_parallel_runtimeappend_path(root, cur_path,
+																  paramsel);
+				if (partial_path)
+				{
+					add_partial_path(rel, partial_path);
+					add_partial_paths = true;
+				}
+			}
+#endif
 		}
+
+#if PG_VERSION_NUM >= 90600
+		/* Consider gathering parallel RuntimeAppend */
+		if (add_partial_paths)
+			generate_gather_paths(root, rel);
+#endif
 	}
 }
 
@@ -496,6 +692,9 @@ pathman_planner_hook(Query *parse, int cursorOptions, ParamListInfo boundParams)
 			/* Add PartitionFilter node for INSERT queries */
 			ExecuteForPlanTree(result, add_partition_filters);
 
+			/* Add PartitionRouter node for UPDATE & DELETE queries */
+			ExecuteForPlanTree(result, add_partition_routers);
+
 			/* Decrement parenthood_statuses refcount */
 			decr_refcount_parenthood_statuses();
 
@@ -521,6 +720,28 @@ pathman_planner_hook(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	return result;
 }
 
+#if PG_VERSION_NUM >= 90600
+/*
+ * Upper paths hook. Adds partition-wise aggregation paths.
+ */
+void
+pathman_create_upper_paths_hook(PlannerInfo *root,
+								UpperRelationKind stage,
+								RelOptInfo *input_rel,
+								RelOptInfo *output_rel)
+{
+	/* Invoke original hook if needed */
+	if (create_upper_paths_hook_next)
+		create_upper_paths_hook_next(root, stage, input_rel, output_rel);
+
+	if (!IsPathmanReady())
+		return;
+
+	if (stage == UPPERREL_GROUP_AGG && pg_pathman_enable_partitionwise_agg)
+		add_partitionwise_agg_paths(root, input_rel, output_rel);
+}
+#endif
+
 /*
  * Post parse analysis hook. It makes sure the config is loaded before executing
  * any statement, including utility commands
@@ -683,6 +904,43 @@ pathman_relcache_hook(Datum arg, Oid relid)
 	}
 }
 
+/* Check if EXPLAIN is going to execute the statement */
+static bool
+explain_stmt_has_analyze(ExplainStmt *stmt)
+{
+	ListCell *lc;
+
+	foreach (lc, stmt->options)
+	{
+		DefElem *opt = (DefElem *) lfirst(lc);
+
+		if (strcmp(opt->defname, "analyze") == 0)
+			return defGetBoolean(opt);
+	}
+
+	return false;
+}
+
+static void
+call_process_utility_next(Node *parsetree,
+						  const char *queryString,
+						  ProcessUtilityContext context,
+						  ParamListInfo params,
+						  DestReceiver *dest,
+						  char *completionTag)
+{
+	/* Call hooks set by other extensions if needed */
+	if (process_utility_hook_next)
+		process_utility_hook_next(parsetree, queryString,
+								  context, params,
+								  dest, completionTag);
+	/* Else call internal implementation */
+	else
+		standard_ProcessUtility(parsetree, queryString,
+								context, params,
+								dest, completionTag);
+}
+
 /*
  * Utility function invoker hook.
  */
@@ -722,14 +980,32 @@ pathman_process_utility_hook(Node *parsetree,
 									(const RenameStmt *) parsetree);
 	}
 
-	/* Call hooks set by other extensions if needed */
-	if (process_utility_hook_next)
-		process_utility_hook_next(parsetree, queryString,
+	/* Plans of EXPLAIN (without ANALYZE) won't be executed */
+	if (IsA(parsetree, ExplainStmt) &&
+		!explain_stmt_has_analyze((ExplainStmt *) parsetree))
+	{
+		bool	save_explain_only = pathman_explain_only;
+
+		pathman_explain_only = true;
+
+		PG_TRY();
+		{
+			call_process_utility_next(parsetree, queryString,
+									  context, params,
+									  dest, completionTag);
+		}
+		PG_CATCH();
+		{
+			pathman_explain_only = save_explain_only;
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+
+		pathman_explain_only = save_explain_only;
+	}
+	else
+		call_process_utility_next(parsetree, queryString,
 								  context, params,
 								  dest, completionTag);
-	/* Else call internal implementation */
-	else
-		standard_ProcessUtility(parsetree, queryString,
-								context, params,
-								dest, completionTag);
 }
+
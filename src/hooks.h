@@ -23,6 +23,9 @@
 extern set_join_pathlist_hook_type		set_join_pathlist_next;
 extern set_rel_pathlist_hook_type		set_rel_pathlist_hook_next;
 extern planner_hook_type				planner_hook_next;
+#if PG_VERSION_NUM >= 90600
+extern create_upper_paths_hook_type		create_upper_paths_hook_next;
+#endif
 extern post_parse_analyze_hook_type		post_parse_analyze_hook_next;
 extern shmem_startup_hook_type			shmem_startup_hook_next;
 extern ProcessUtility_hook_type			process_utility_hook_next;
@@ -46,6 +49,13 @@ PlannedStmt * pathman_planner_hook(Query *parse,
 								   int cursorOptions,
 								   ParamListInfo boundParams);
 
+#if PG_VERSION_NUM >= 90600
+void pathman_create_upper_paths_hook(PlannerInfo *root,
+									 UpperRelationKind stage,
+									 RelOptInfo *input_rel,
+									 RelOptInfo *output_rel);
+#endif
+
 void pathman_post_parse_analysis_hook(ParseState *pstate,
 									  Query *query);
 
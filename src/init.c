@@ -13,6 +13,7 @@
 
 #include "hooks.h"
 #include "init.h"
+#include "partition_flight.h"
 #include "pathman.h"
 #include "pathman_workers.h"
 #include "relation_info.h"
@@ -260,6 +261,8 @@ Size
 estimate_pathman_shmem_size(void)
 {
 	return estimate_concurrent_part_task_slots_size() +
+		   estimate_spawn_partitions_queue_size() +
+		   estimate_partition_flights_size() +
 		   MAXALIGN(sizeof(PathmanState));
 }
 
@@ -284,6 +287,11 @@ init_pathman_relation_oids(void)
 	if (pathman_config_params_relid == InvalidOid)
 		return false;
 
+	/* Cache PATHMAN_ZONE_MAPS relation's Oid */
+	pathman_zone_maps_relid = get_relname_relid(PATHMAN_ZONE_MAPS, schema);
+	if (pathman_zone_maps_relid == InvalidOid)
+		return false;
+
 	/* NOTE: add more relations to be cached right here ^^^ */
 
 	/* Everything is fine, proceed */
@@ -298,6 +306,7 @@ fini_pathman_relation_oids(void)
 {
 	pathman_config_relid = InvalidOid;
 	pathman_config_params_relid = InvalidOid;
+	pathman_zone_maps_relid = InvalidOid;
 
 	/* NOTE: add more relations to be forgotten right here ^^^ */
 }
@@ -383,6 +392,12 @@ init_shmem_config(void)
 
 	/* Allocate some space for concurrent part slots */
 	init_concurrent_part_task_slots();
+
+	/* Allocate queue of SpawnPartitionsWorkers */
+	init_spawn_partitions_queue();
+
+	/* Allocate registry of partitions being created */
+	init_partition_flights();
 }
 
 /*
@@ -809,10 +824,18 @@ read_pathman_params(Oid relid, Datum *values, bool *isnull)
 	/* There should be just 1 row */
 	if ((htup = heap_getnext(scan, ForwardScanDirection)) != NULL)
 	{
+		TupleDesc	tupdesc = RelationGetDescr(rel);
+		int			i;
+
 		/* Extract data if necessary */
-		heap_deform_tuple(htup, RelationGetDescr(rel), values, isnull);
+		heap_deform_tuple(htup, tupdesc, values, isnull);
 		row_found = true;
 
+		/* Copy by-reference values (e.g. 'zone_map_columns'), buffer will be released */
+		for (i = 0; i < tupdesc->natts; i++)
+			if (!isnull[i] && !tupdesc->attrs[i]->attbyval)
+				values[i] = datumCopy(values[i], false, tupdesc->attrs[i]->attlen);
+
 		/* Perform checks for non-NULL columns */
 		Assert(!isnull[Anum_pathman_config_params_partrel - 1]);
 		Assert(!isnull[Anum_pathman_config_params_enable_parent - 1]);
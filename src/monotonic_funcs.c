@@ -0,0 +1,515 @@
+/* ------------------------------------------------------------------------
+ *
+ * monotonic_funcs.c
+ *		Registry of order-preserving functions and casts which allow
+ *		to prune partitions using predicates on F(partitioned column)
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "monotonic_funcs.h"
+
+#include "nodes/nodeFuncs.h"
+#include "parser/scansup.h"
+#include "pgtime.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/fmgroids.h"
+#include "utils/hsearch.h"
+#include "utils/timestamp.h"
+
+
+#define MONOTONIC_FUNCS_SIZE	32
+
+/* PostgreSQL 9.5 doesn't define it */
+#ifndef TIMESTAMP_END_JULIAN
+#define TIMESTAMP_END_JULIAN	(109203528)		/* == date2j(294277, 1, 1) */
+#endif
+
+/* Fixed offsets of time zones never exceed a week */
+#define MAX_ZONE_OFFSET_DAYS	7
+
+
+static HTAB *monotonic_funcs = NULL;
+
+
+static void init_monotonic_funcs(void);
+
+static bool get_const_arg(const FuncExpr *expr, int argno, Datum *value);
+static bool timezone_is_fixed(text *zone);
+static bool get_date_trunc_interval(text *units, Interval *result);
+static bool timestamp_can_shift(Timestamp ts, int days);
+
+static bool int48_bound(const FuncExpr *expr, bool is_upper,
+						Datum value, Datum *bound, bool *strict);
+static bool int28_bound(const FuncExpr *expr, bool is_upper,
+						Datum value, Datum *bound, bool *strict);
+static bool i2toi4_bound(const FuncExpr *expr, bool is_upper,
+						 Datum value, Datum *bound, bool *strict);
+static bool timestamp_date_bound(const FuncExpr *expr, bool is_upper,
+								 Datum value, Datum *bound, bool *strict);
+static bool date_timestamp_bound(const FuncExpr *expr, bool is_upper,
+								 Datum value, Datum *bound, bool *strict);
+static bool timestamp_trunc_bound(const FuncExpr *expr, bool is_upper,
+								  Datum value, Datum *bound, bool *strict);
+static bool timestamptz_zone_bound(const FuncExpr *expr, bool is_upper,
+								   Datum value, Datum *bound, bool *strict);
+static bool timestamp_zone_bound(const FuncExpr *expr, bool is_upper,
+								 Datum value, Datum *bound, bool *strict);
+
+
+/*
+ * Register a function which doesn't change the order of its key argument,
+ * i.e. k1 <= k2 implies F(k1) <= F(k2). Stable functions should not be
+ * registered, since plans would depend on session settings.
+ */
+void
+register_monotonic_func(Oid funcid,
+						int key_arg,
+						monotonic_bound_func bound_func)
+{
+	MonotonicFunc  *entry;
+	bool			found;
+
+	if (!monotonic_funcs)
+		init_monotonic_funcs();
+
+	entry = (MonotonicFunc *) hash_search(monotonic_funcs,
+										  (const void *) &funcid,
+										  HASH_ENTER, &found);
+
+	entry->key_arg = key_arg;
+	entry->bound_func = bound_func;
+}
+
+/*
+ * Return MonotonicFunc for 'funcid' or NULL.
+ */
+const MonotonicFunc *
+find_monotonic_func(Oid funcid)
+{
+	if (!monotonic_funcs)
+		init_monotonic_funcs();
+
+	return (const MonotonicFunc *) hash_search(monotonic_funcs,
+											   (const void *) &funcid,
+											   HASH_FIND, NULL);
+}
+
+/*
+ * Strip a chain of registered functions, e.g. date_trunc('day', KEY::date),
+ * and return the innermost expression or NULL if 'expr' is not a chain.
+ */
+Node *
+monotonic_expr_get_key(Node *expr)
+{
+	bool	found_func = false;
+
+	for (;;)
+	{
+		const MonotonicFunc	   *mfunc;
+		FuncExpr			   *func;
+
+		if (IsA(expr, RelabelType))
+		{
+			expr = (Node *) ((RelabelType *) expr)->arg;
+			continue;
+		}
+
+		if (!IsA(expr, FuncExpr))
+			break;
+
+		func = (FuncExpr *) expr;
+		mfunc = find_monotonic_func(func->funcid);
+
+		if (!mfunc || func->funcretset ||
+			list_length(func->args) <= mfunc->key_arg)
+			return NULL;
+
+		expr = (Node *) list_nth(func->args, mfunc->key_arg);
+		found_func = true;
+	}
+
+	return found_func ? expr : NULL;
+}
+
+/*
+ * Given F(KEY) >= value (or F(KEY) <= value if 'is_upper' is set),
+ * compute the bound of KEY. See monotonic_bound_func for details.
+ */
+bool
+monotonic_expr_get_key_bound(Node *expr,
+							 bool is_upper,
+							 Datum value,
+							 Datum *bound,
+							 bool *strict)
+{
+	*strict = false;
+
+	for (;;)
+	{
+		const MonotonicFunc	   *mfunc;
+		FuncExpr			   *func;
+
+		if (IsA(expr, RelabelType))
+		{
+			expr = (Node *) ((RelabelType *) expr)->arg;
+			continue;
+		}
+
+		if (!IsA(expr, FuncExpr))
+			break;
+
+		func = (FuncExpr *) expr;
+		mfunc = find_monotonic_func(func->funcid);
+		Assert(mfunc);
+
+		/*
+		 * Strictness only matters for the innermost function,
+		 * non-strict bounds are always safe for the outer ones.
+		 */
+		if (!mfunc->bound_func(func, is_upper, value, &value, strict))
+			return false;
+
+		expr = (Node *) list_nth(func->args, mfunc->key_arg);
+	}
+
+	*bound = value;
+	return true;
+}
+
+
+/*
+ * Create registry and fill it with built-in functions.
+ */
+static void
+init_monotonic_funcs(void)
+{
+	HASHCTL ctl;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(MonotonicFunc);
+
+	monotonic_funcs = hash_create("pg_pathman's monotonic functions",
+								  MONOTONIC_FUNCS_SIZE, &ctl,
+								  HASH_ELEM | HASH_BLOBS);
+
+	/* Integer widening */
+	register_monotonic_func(F_INT48, 0, int48_bound);
+	register_monotonic_func(F_INT28, 0, int28_bound);
+	register_monotonic_func(F_I2TOI4, 0, i2toi4_bound);
+
+	/* Date & timestamp casts */
+	register_monotonic_func(F_TIMESTAMP_DATE, 0, timestamp_date_bound);
+	register_monotonic_func(F_DATE_TIMESTAMP, 0, date_timestamp_bound);
+
+	/* date_trunc(text, timestamp) */
+	register_monotonic_func(F_TIMESTAMP_TRUNC, 1, timestamp_trunc_bound);
+
+	/* KEY AT TIME ZONE 'zone' */
+	register_monotonic_func(F_TIMESTAMPTZ_ZONE, 1, timestamptz_zone_bound);
+	register_monotonic_func(F_TIMESTAMP_ZONE, 1, timestamp_zone_bound);
+}
+
+/*
+ * Fetch value of a non-NULL Const argument.
+ */
+static bool
+get_const_arg(const FuncExpr *expr, int argno, Datum *value)
+{
+	Node *arg = (Node *) list_nth(expr->args, argno);
+
+	if (!IsA(arg, Const) || ((Const *) arg)->constisnull)
+		return false;
+
+	*value = ((Const *) arg)->constvalue;
+	return true;
+}
+
+/*
+ * Local time is monotonic only if zone has a fixed UTC offset
+ * (no DST etc). Zone lookup mimics timestamp_zone().
+ */
+static bool
+timezone_is_fixed(text *zone)
+{
+	char		tzname[TZ_STRLEN_MAX + 1];
+	char	   *lowzone;
+	int			type,
+				val;
+	pg_tz	   *tzp;
+	long int	gmtoff;
+
+	text_to_cstring_buffer(zone, tzname, sizeof(tzname));
+
+	lowzone = downcase_truncate_identifier(tzname, strlen(tzname), false);
+	type = DecodeTimezoneAbbrev(0, lowzone, &val, &tzp);
+
+	/* Plain abbreviations have fixed offsets, dynamic ones don't */
+	if (type == TZ || type == DTZ)
+		return true;
+	else if (type == DYNTZ)
+		return false;
+
+	tzp = pg_tzset(tzname);
+
+	return tzp && pg_get_timezone_offset(tzp, &gmtoff);
+}
+
+/*
+ * Convert units of date_trunc() into an interval.
+ */
+static bool
+get_date_trunc_interval(text *units, Interval *result)
+{
+	char   *lowunits;
+	int		type,
+			val;
+
+	lowunits = downcase_truncate_identifier(VARDATA_ANY(units),
+											VARSIZE_ANY_EXHDR(units),
+											false);
+
+	type = DecodeUnits(0, lowunits, &val);
+	if (type != UNITS)
+		return false;
+
+	memset(result, 0, sizeof(Interval));
+
+	switch (val)
+	{
+		case DTK_MICROSEC:
+		case DTK_MILLISEC:
+		case DTK_SECOND:
+		case DTK_MINUTE:
+		case DTK_HOUR:
+		case DTK_DAY:
+			/* Don't bother with time units, a day is enough */
+			result->day = 1;
+			break;
+
+		case DTK_WEEK:
+			result->day = 7;
+			break;
+
+		case DTK_MONTH:
+			result->month = 1;
+			break;
+
+		case DTK_QUARTER:
+			result->month = 3;
+			break;
+
+		case DTK_YEAR:
+			result->month = MONTHS_PER_YEAR;
+			break;
+
+		case DTK_DECADE:
+			result->month = MONTHS_PER_YEAR * 10;
+			break;
+
+		case DTK_CENTURY:
+			result->month = MONTHS_PER_YEAR * 100;
+			break;
+
+		case DTK_MILLENNIUM:
+			result->month = MONTHS_PER_YEAR * 1000;
+			break;
+
+		default:
+			return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * Integer widening: KEY::int8 etc. Bound is just a value clamped
+ * to the range of the narrower type.
+ */
+
+static bool
+int48_bound(const FuncExpr *expr, bool is_upper,
+			Datum value, Datum *bound, bool *strict)
+{
+	int64 v = DatumGetInt64(value);
+
+	*bound = Int32GetDatum((int32) Min(Max(v, PG_INT32_MIN), PG_INT32_MAX));
+	*strict = false;
+	return true;
+}
+
+static bool
+int28_bound(const FuncExpr *expr, bool is_upper,
+			Datum value, Datum *bound, bool *strict)
+{
+	int64 v = DatumGetInt64(value);
+
+	*bound = Int16GetDatum((int16) Min(Max(v, PG_INT16_MIN), PG_INT16_MAX));
+	*strict = false;
+	return true;
+}
+
+static bool
+i2toi4_bound(const FuncExpr *expr, bool is_upper,
+			 Datum value, Datum *bound, bool *strict)
+{
+	int32 v = DatumGetInt32(value);
+
+	*bound = Int16GetDatum((int16) Min(Max(v, PG_INT16_MIN), PG_INT16_MAX));
+	*strict = false;
+	return true;
+}
+
+/*
+ * Check that 'ts' might be moved 'days' back and forth
+ * without leaving the range of valid timestamps.
+ */
+static bool
+timestamp_can_shift(Timestamp ts, int days)
+{
+	DateADT d;
+
+	if (TIMESTAMP_NOT_FINITE(ts))
+		return true;
+
+	d = DatumGetDateADT(DirectFunctionCall1(timestamp_date,
+											TimestampGetDatum(ts)));
+
+	return d - days >= (DATETIME_MIN_JULIAN - POSTGRES_EPOCH_JDATE) &&
+		   d + days < (TIMESTAMP_END_JULIAN - POSTGRES_EPOCH_JDATE);
+}
+
+/*
+ * KEY::date, KEY is timestamp:
+ *		KEY::date >= d  =>  KEY >= d 00:00
+ *		KEY::date <= d  =>  KEY < (d + 1) 00:00
+ */
+static bool
+timestamp_date_bound(const FuncExpr *expr, bool is_upper,
+					 Datum value, Datum *bound, bool *strict)
+{
+	DateADT d = DatumGetDateADT(value);
+
+	if (!DATE_NOT_FINITE(d))
+	{
+		/* Make sure date can be converted to timestamp */
+		if (d < (DATETIME_MIN_JULIAN - POSTGRES_EPOCH_JDATE) ||
+			d >= (TIMESTAMP_END_JULIAN - POSTGRES_EPOCH_JDATE) - 1)
+			return false;
+
+		if (is_upper)
+			d++;
+	}
+
+	*bound = DirectFunctionCall1(date_timestamp, DateADTGetDatum(d));
+	*strict = is_upper && !DATE_NOT_FINITE(d);
+	return true;
+}
+
+/*
+ * KEY::timestamp, KEY is date:
+ *		KEY::timestamp >= ts  =>  KEY >= ts::date
+ *		KEY::timestamp <= ts  =>  KEY <= ts::date
+ */
+static bool
+date_timestamp_bound(const FuncExpr *expr, bool is_upper,
+					 Datum value, Datum *bound, bool *strict)
+{
+	*bound = DirectFunctionCall1(timestamp_date, value);
+	*strict = false;
+	return true;
+}
+
+/*
+ * date_trunc(units, KEY), KEY is timestamp:
+ *		date_trunc(units, KEY) >= ts  =>  KEY >= ts
+ *		date_trunc(units, KEY) <= ts  =>  KEY < date_trunc(units, ts) + units
+ */
+static bool
+timestamp_trunc_bound(const FuncExpr *expr, bool is_upper,
+					  Datum value, Datum *bound, bool *strict)
+{
+	Datum		units;
+	Interval	step;
+
+	*strict = false;
+
+	if (!is_upper)
+	{
+		*bound = value;
+		return true;
+	}
+
+	if (!get_const_arg(expr, 0, &units) ||
+		!get_date_trunc_interval(DatumGetTextPP(units), &step))
+		return false;
+
+	/* Infinite timestamps stay as they are */
+	if (TIMESTAMP_NOT_FINITE(DatumGetTimestamp(value)))
+	{
+		*bound = value;
+		return true;
+	}
+
+	/* Don't prune if truncated value + units is out of range */
+	if (!timestamp_can_shift(DatumGetTimestamp(value),
+							 step.month * 31 + step.day + 1))
+		return false;
+
+	value = DirectFunctionCall2(timestamp_trunc, units, value);
+	*bound = DirectFunctionCall2(timestamp_pl_interval, value,
+								 IntervalPGetDatum(&step));
+	*strict = true;
+	return true;
+}
+
+/*
+ * KEY AT TIME ZONE zone, KEY is timestamptz. Bound is
+ * a local time converted back, if zone has fixed offset.
+ */
+static bool
+timestamptz_zone_bound(const FuncExpr *expr, bool is_upper,
+					   Datum value, Datum *bound, bool *strict)
+{
+	Datum zone;
+
+	if (!get_const_arg(expr, 0, &zone) ||
+		!timezone_is_fixed(DatumGetTextPP(zone)))
+		return false;
+
+	/* Don't prune if shifted value might be out of range */
+	if (!timestamp_can_shift(DatumGetTimestamp(value), MAX_ZONE_OFFSET_DAYS))
+		return false;
+
+	*bound = DirectFunctionCall2(timestamp_zone, zone, value);
+	*strict = false;
+	return true;
+}
+
+/*
+ * KEY AT TIME ZONE zone, KEY is timestamp. Same as above.
+ */
+static bool
+timestamp_zone_bound(const FuncExpr *expr, bool is_upper,
+					 Datum value, Datum *bound, bool *strict)
+{
+	Datum zone;
+
+	if (!get_const_arg(expr, 0, &zone) ||
+		!timezone_is_fixed(DatumGetTextPP(zone)))
+		return false;
+
+	/* Don't prune if shifted value might be out of range */
+	if (!timestamp_can_shift(DatumGetTimestamp(value), MAX_ZONE_OFFSET_DAYS))
+		return false;
+
+	*bound = DirectFunctionCall2(timestamptz_zone, zone, value);
+	*strict = false;
+	return true;
+}
@@ -0,0 +1,59 @@
+/* ------------------------------------------------------------------------
+ *
+ * monotonic_funcs.h
+ *		Registry of order-preserving functions and casts which allow
+ *		to prune partitions using predicates on F(partitioned column)
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef MONOTONIC_FUNCS_H
+#define MONOTONIC_FUNCS_H
+
+
+#include "postgres.h"
+#include "nodes/primnodes.h"
+
+
+/*
+ * Compute a bound of function's key argument.
+ *
+ * 'value' has the function's result type, 'bound' has the type of its
+ * key argument. If 'is_upper' is false, the function should guarantee
+ * that F(k) >= value implies k >= bound (k > bound if '*strict' is set),
+ * otherwise that F(k) <= value implies k <= bound (k < bound if strict).
+ *
+ * Returns false if no such bound could be computed.
+ */
+typedef bool (*monotonic_bound_func)(const FuncExpr *expr,
+									 bool is_upper,
+									 Datum value,
+									 Datum *bound,
+									 bool *strict);
+
+typedef struct
+{
+	Oid						funcid;		/* key */
+	int						key_arg;	/* index of key argument */
+	monotonic_bound_func	bound_func;	/* see above */
+} MonotonicFunc;
+
+
+void register_monotonic_func(Oid funcid,
+							 int key_arg,
+							 monotonic_bound_func bound_func);
+
+const MonotonicFunc *find_monotonic_func(Oid funcid);
+
+Node *monotonic_expr_get_key(Node *expr);
+
+bool monotonic_expr_get_key_bound(Node *expr,
+								  bool is_upper,
+								  Datum value,
+								  Datum *bound,
+								  bool *strict);
+
+
+#endif /* MONOTONIC_FUNCS_H */
@@ -12,9 +12,14 @@
 #include "runtimeappend.h"
 #include "utils.h"
 
+#include "access/heapam.h"
 #include "access/sysattr.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
 #include "optimizer/restrictinfo.h"
 #include "optimizer/var.h"
+#include "storage/bufmgr.h"
+#include "storage/lmgr.h"
 #include "utils/memutils.h"
 
 
@@ -23,6 +28,9 @@
 #define ALLOC_EXP			2
 
 
+static void select_append_plans(RuntimeAppendState *scan_state);
+
+
 /* Compare plans by 'original_order' */
 static int
 cmp_child_scan_common_by_orig_order(const void *ap,
@@ -39,6 +47,29 @@ cmp_child_scan_common_by_orig_order(const void *ap,
 		return 0;
 }
 
+/* Initialize PlanState of a child which hasn't been used yet */
+static PlanState *
+init_child_plan_state(RuntimeAppendState *scan_state,
+					  ChildScanCommon child,
+					  EState *estate)
+{
+	PlanState *ps;
+
+	Assert(child->content_type == CHILD_PLAN); /* no paths allowed */
+
+	ps = ExecInitNode(child->content.plan, estate, 0);
+	child->content.plan_state = ps;
+	child->content_type = CHILD_PLAN_STATE; /* update content type */
+	child->rescan_pending = false;
+
+	scan_state->nplans_initialized++;
+
+	/* Explain and clear_plan_states rely on this list */
+	scan_state->css.custom_ps = lappend(scan_state->css.custom_ps, ps);
+
+	return ps;
+}
+
 static void
 transform_plans_into_states(RuntimeAppendState *scan_state,
 							ChildScanCommon *selected_plans, int n,
@@ -54,14 +85,11 @@ transform_plans_into_states(RuntimeAppendState *scan_state,
 		/* Create new node since this plan hasn't been used yet */
 		if (child->content_type != CHILD_PLAN_STATE)
 		{
-			Assert(child->content_type == CHILD_PLAN); /* no paths allowed */
+			/* It will be created by get_child_plan_state() */
+			if (scan_state->lazy_init)
+				continue;
 
-			ps = ExecInitNode(child->content.plan, estate, 0);
-			child->content.plan_state = ps;
-			child->content_type = CHILD_PLAN_STATE; /* update content type */
-
-			/* Explain and clear_plan_states rely on this list */
-			scan_state->css.custom_ps = lappend(scan_state->css.custom_ps, ps);
+			ps = init_child_plan_state(scan_state, child, estate);
 		}
 		else
 			ps = child->content.plan_state;
@@ -73,43 +101,327 @@ transform_plans_into_states(RuntimeAppendState *scan_state,
 		/*
 		 * We should ReScan this node manually since
 		 * ExecProcNode won't do this for us in this case.
+		 * In lazy mode this is postponed till the child is reached,
+		 * since it might be never scanned (e.g. because of LIMIT).
 		 */
-		if (bms_is_empty(ps->chgParam))
+		if (scan_state->lazy_init)
+			child->rescan_pending = true;
+		else if (bms_is_empty(ps->chgParam))
 			ExecReScan(ps);
 
 		child->content.plan_state = ps;
 	}
 }
 
-static ChildScanCommon *
-select_required_plans(HTAB *children_table, Oid *parts, int nparts, int *nres)
+/*
+ * Make children accessible by their indices in PrelGetChildrenArray(),
+ * so that rangesets could be transformed into plans without hashing.
+ */
+static void
+index_children(RuntimeAppendState *scan_state, const PartRelationInfo *prel)
 {
-	uint32				allocated = INITIAL_ALLOC_NUM,
-						used = 0;
-	ChildScanCommon	   *result;
-	int					i;
+	Oid		   *children = PrelGetChildrenArray(prel);
+	Oid			parent_relid = PrelParentRelid(prel);
+	uint32		nchildren = PrelChildrenCount(prel),
+				i;
 
-	result = (ChildScanCommon *) palloc(allocated * sizeof(ChildScanCommon));
+	scan_state->nchildren_by_idx = nchildren;
+	scan_state->children_oids = (Oid *) palloc(Max(nchildren, 1) * sizeof(Oid));
+	scan_state->children_by_idx = (ChildScanCommon *)
+			palloc(Max(nchildren, 1) * sizeof(ChildScanCommon));
 
-	for (i = 0; i < nparts; i++)
+	for (i = 0; i < nchildren; i++)
 	{
-		ChildScanCommon child = hash_search(children_table,
-											(const void *) &parts[i],
-											HASH_FIND, NULL);
-		if (!child)
-			continue; /* no plan for this partition */
+		scan_state->children_oids[i] = children[i];
+		scan_state->children_by_idx[i] = hash_search(scan_state->children_table,
+													 (const void *) &children[i],
+													 HASH_FIND, NULL);
+	}
+
+	scan_state->parent_child = hash_search(scan_state->children_table,
+										   (const void *) &parent_relid,
+										   HASH_FIND, NULL);
+}
+
+/*
+ * Parent table (see enable_parent) is usually empty once its rows have been
+ * moved to partitions, e.g. by partition_table_concurrently(). Its heap keeps
+ * dead tuples until VACUUM, so we look for the first tuple visible to our
+ * snapshot. This scans the parent at most once per execution, while
+ * RuntimeAppend might have to scan it on each rescan.
+ */
+static bool
+parent_is_empty(Oid relid, Snapshot snapshot)
+{
+	Relation		rel;
+	HeapScanDesc	scan;
+	bool			result = true;
 
-		if (allocated <= used)
+	rel = heap_open(relid, AccessShareLock);
+
+	/* Rows can't reside beyond the current end of the relation */
+	if (RelationGetNumberOfBlocks(rel) > 0)
+	{
+		scan = heap_beginscan(rel, snapshot, 0, NULL);
+		result = (heap_getnext(scan, ForwardScanDirection) == NULL);
+		heap_endscan(scan);
+	}
+
+	heap_close(rel, NoLock);
+
+	return result;
+}
+
+/* Put plans of partitions contained in 'ranges' into 'cur_plans' */
+static void
+select_plans_by_ranges(RuntimeAppendState *scan_state,
+					   const PartRelationInfo *prel,
+					   List *ranges)
+{
+	Oid		   *children = PrelGetChildrenArray(prel);
+	int			nplans = irange_list_length(ranges) + 1,
+				used = 0;
+	ListCell   *lc;
+
+	/* Make sure that 'cur_plans' is big enough */
+	if (scan_state->cur_plans_allocated < nplans)
+	{
+		if (scan_state->cur_plans)
+			pfree(scan_state->cur_plans); /* shallow free since cur_plans
+										   * belong to children_table  */
+
+		scan_state->cur_plans_allocated = Max(nplans, INITIAL_ALLOC_NUM);
+		scan_state->cur_plans = (ChildScanCommon *)
+				MemoryContextAlloc(scan_state->css.ss.ps.state->es_query_cxt,
+								   scan_state->cur_plans_allocated *
+										sizeof(ChildScanCommon));
+	}
+
+	/* If required, add parent to result */
+	if (scan_state->enable_parent && scan_state->parent_child)
+		scan_state->cur_plans[used++] = scan_state->parent_child;
+
+	foreach (lc, ranges)
+	{
+		uint32	i;
+		uint32	a = irange_lower(lfirst_irange(lc)),
+				b = irange_upper(lfirst_irange(lc));
+
+		for (i = a; i <= b; i++)
 		{
-			allocated = allocated * ALLOC_EXP + 1;
-			result = repalloc(result, allocated * sizeof(ChildScanCommon));
+			ChildScanCommon child;
+
+			Assert(i < PrelChildrenCount(prel));
+
+			/* Partitions might have changed since begin_append_common() */
+			if (i < scan_state->nchildren_by_idx &&
+				scan_state->children_oids[i] == children[i])
+				child = scan_state->children_by_idx[i];
+			else
+				child = hash_search(scan_state->children_table,
+									(const void *) &children[i],
+									HASH_FIND, NULL);
+
+			if (!child)
+				continue; /* no plan for this partition */
+
+			scan_state->cur_plans[used++] = child;
 		}
+	}
 
-		result[used++] = child;
+	scan_state->ncur_plans = used;
+}
+
+/* Compare Oids (for qsort() and bsearch()) */
+static int
+cmp_oids(const void *p1, const void *p2)
+{
+	Oid		v1 = *((const Oid *) p1);
+	Oid		v2 = *((const Oid *) p2);
+
+	if (v1 < v2)
+		return -1;
+	if (v1 > v2)
+		return 1;
+	return 0;
+}
+
+/* Does 'node' reference PARAM_EXEC params (e.g. outer Vars of NestLoop)? */
+static bool
+contain_exec_params_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, Param))
+		return ((Param *) node)->paramkind == PARAM_EXEC;
+
+	return expression_tree_walker(node, contain_exec_params_walker, context);
+}
+
+/*
+ * Select partitions using clauses which don't reference PARAM_EXEC params,
+ * i.e. consist of constants, external params and stable functions (now()),
+ * and remove other children from 'children_table', so that they will never
+ * be initialized. If all clauses are like this, partitions won't change
+ * between rescans.
+ */
+static void
+prune_children_at_startup(RuntimeAppendState *scan_state)
+{
+	ExprContext			   *econtext = scan_state->css.ss.ps.ps_ExprContext;
+	const PartRelationInfo *prel;
+	List				   *ranges;
+	ListCell			   *lc;
+	WalkerContext			wcxt;
+	Oid					   *parts;
+	int						nparts;
+	bool					clauses_used = false;
+	HASH_SEQ_STATUS			seqstat;
+	ChildScanCommon			child;
+
+	scan_state->static_selection = true;
+	scan_state->nplans_pruned = -1;
+
+	prel = get_pathman_relation_info(scan_state->relid);
+	Assert(prel);
+
+	/* First we select all available partitions... */
+	ranges = list_make1_irange(make_irange(0, PrelLastChild(prel), IR_COMPLETE));
+
+	InitWalkerContext(&wcxt, INDEX_VAR, prel, econtext, false);
+	foreach (lc, scan_state->custom_exprs)
+	{
+		Node		*clause = (Node *) lfirst(lc);
+		WrapperNode *wn;
+
+		/* Values of PARAM_EXEC params are not known yet */
+		if (contain_exec_params_walker(clause, NULL))
+		{
+			scan_state->static_selection = false;
+			continue;
+		}
+
+		/* ... then we cut off irrelevant ones using the provided clauses */
+		wn = walk_expr_tree((Expr *) clause, &wcxt);
+		ranges = irange_list_intersection(ranges, wn->rangeset);
+		clauses_used = true;
 	}
 
-	*nres = used;
-	return result;
+	/* Nothing to prune yet */
+	if (!clauses_used)
+		return;
+
+	/* Get sorted Oids of the required partitions */
+	parts = get_partition_oids(ranges, &nparts, prel, scan_state->enable_parent);
+	qsort(parts, nparts, sizeof(Oid), cmp_oids);
+
+	/* Remove children which can't be selected by any ReScan */
+	scan_state->nplans_pruned = 0;
+	hash_seq_init(&seqstat, scan_state->children_table);
+	while ((child = (ChildScanCommon) hash_seq_search(&seqstat)) != NULL)
+	{
+		Oid		relid = child->relid;
+
+		if (!bsearch(&relid, parts, nparts, sizeof(Oid), cmp_oids))
+		{
+			/* It's safe to remove the element just returned */
+			hash_search(scan_state->children_table,
+						(const void *) &relid,
+						HASH_REMOVE, NULL);
+
+			scan_state->nplans_pruned++;
+		}
+	}
+
+	pfree(parts);
+}
+
+/*
+ * Prepare values of zone map clauses and load summaries
+ * visible to the query. Clauses might become useless if
+ * columns or operators have changed since planning.
+ */
+static void
+init_zone_map_pruning(RuntimeAppendState *scan_state,
+					  const PartRelationInfo *prel,
+					  EState *estate)
+{
+	ListCell   *lc_attnum,
+			   *lc_opno,
+			   *lc_collid,
+			   *lc_varonleft,
+			   *lc_expr;
+
+	scan_state->nzone_map_quals = 0;
+
+	if (scan_state->zone_map_exprs == NIL || prel->zone_map_ncolumns == 0)
+		return;
+
+	scan_state->zone_map_quals =
+			palloc(list_length(scan_state->zone_map_exprs) * sizeof(ZoneMapQual));
+
+	lc_attnum		= list_head(linitial(scan_state->zone_map_info));
+	lc_opno			= list_head(lsecond(scan_state->zone_map_info));
+	lc_collid		= list_head(lthird(scan_state->zone_map_info));
+	lc_varonleft	= list_head(lfourth(scan_state->zone_map_info));
+
+	foreach (lc_expr, scan_state->zone_map_exprs)
+	{
+		ZoneMapClause	clause;
+		ZoneMapQual	   *qual = &scan_state->zone_map_quals[scan_state->nzone_map_quals];
+
+		clause.attnum		= (AttrNumber) lfirst_int(lc_attnum);
+		clause.opno			= lfirst_oid(lc_opno);
+		clause.inputcollid	= lfirst_oid(lc_collid);
+		clause.varonleft	= (bool) lfirst_int(lc_varonleft);
+		clause.value		= (Expr *) lfirst(lc_expr);
+
+		lc_attnum		= lnext(lc_attnum);
+		lc_opno			= lnext(lc_opno);
+		lc_collid		= lnext(lc_collid);
+		lc_varonleft	= lnext(lc_varonleft);
+
+		if (!init_zone_map_qual(qual, &clause, prel))
+			continue;
+
+		scan_state->zone_map_states =
+				lappend(scan_state->zone_map_states,
+						ExecInitExpr(clause.value, &scan_state->css.ss.ps));
+		scan_state->nzone_map_quals++;
+
+		/* Values of PARAM_EXEC params change between rescans */
+		if (contain_exec_params_walker((Node *) clause.value, NULL))
+			scan_state->static_selection = false;
+	}
+
+	if (scan_state->nzone_map_quals > 0)
+		scan_state->zone_map = load_zone_map(prel, estate->es_snapshot);
+}
+
+/* Evaluate values of zone map clauses and prune 'ranges' using them */
+static List *
+prune_by_zone_map_exprs(RuntimeAppendState *scan_state,
+						const PartRelationInfo *prel,
+						List *ranges,
+						ExprContext *econtext)
+{
+	int			nquals = scan_state->nzone_map_quals;
+	Datum	   *values = palloc(nquals * sizeof(Datum));
+	bool	   *isnull = palloc(nquals * sizeof(bool));
+	ListCell   *lc;
+	int			i = 0;
+
+	foreach (lc, scan_state->zone_map_states)
+	{
+		values[i] = ExecEvalExpr((ExprState *) lfirst(lc), econtext,
+								 &isnull[i], NULL);
+		i++;
+	}
+
+	return prune_by_zone_map(ranges, prel, scan_state->zone_map,
+							 scan_state->zone_map_quals,
+							 values, isnull, nquals);
 }
 
 /* Replace Vars' varnos with the value provided by 'parent' */
@@ -176,12 +488,18 @@ append_part_attr_to_tlist(List *tlist, Index relno, const PartRelationInfo *prel
 
 static void
 pack_runtimeappend_private(CustomScan *cscan, RuntimeAppendPath *path,
-						   bool enable_parent)
+						   bool enable_parent, List *zone_map_clauses)
 {
 	ChildScanCommon    *children = path->children;
 	int					nchildren = path->nchildren;
 	List			   *custom_private = NIL,
-					   *custom_oids = NIL;
+					   *runtimeappend_private,
+					   *custom_oids = NIL,
+					   *zm_attnums = NIL,
+					   *zm_opnos = NIL,
+					   *zm_collids = NIL,
+					   *zm_varonleft = NIL;
+	ListCell		   *lc;
 	int					i;
 
 	for (i = 0; i < nchildren; i++)
@@ -191,11 +509,28 @@ pack_runtimeappend_private(CustomScan *cscan, RuntimeAppendPath *path,
 		pfree(children[i]);
 	}
 
-	/* Save parent & partition Oids and a flag as first element of 'custom_private' */
-	custom_private = lappend(custom_private,
-							 list_make3(list_make1_oid(path->relid),
-										custom_oids, /* list of Oids */
-										list_make1_int(enable_parent)));
+	foreach (lc, zone_map_clauses)
+	{
+		ZoneMapClause *clause = (ZoneMapClause *) lfirst(lc);
+
+		zm_attnums = lappend_int(zm_attnums, clause->attnum);
+		zm_opnos = lappend_oid(zm_opnos, clause->opno);
+		zm_collids = lappend_oid(zm_collids, clause->inputcollid);
+		zm_varonleft = lappend_int(zm_varonleft, clause->varonleft);
+	}
+
+	/* Save parent & partition Oids, flag and param as first element of 'custom_private' */
+	runtimeappend_private = list_make4(list_make1_oid(path->relid),
+									   custom_oids, /* list of Oids */
+									   list_make1_int(enable_parent),
+									   list_make1_int(path->join_filter_param));
+
+	/* ... followed by clauses whose values are stored in 'custom_exprs' */
+	runtimeappend_private = lappend(runtimeappend_private,
+									list_make4(zm_attnums, zm_opnos,
+											   zm_collids, zm_varonleft));
+
+	custom_private = lappend(custom_private, runtimeappend_private);
 
 	/* Store freshly built 'custom_private' */
 	cscan->custom_private = custom_private;
@@ -248,6 +583,8 @@ unpack_runtimeappend_private(RuntimeAppendState *scan_state, CustomScan *cscan)
 	scan_state->children_table = children_table;
 	scan_state->relid = linitial_oid(linitial(runtimeappend_private));
 	scan_state->enable_parent = (bool) linitial_int(lthird(runtimeappend_private));
+	scan_state->join_filter_param = linitial_int(lfourth(runtimeappend_private));
+	scan_state->zone_map_info = (List *) list_nth(runtimeappend_private, 4);
 }
 
 /*
@@ -359,6 +696,9 @@ create_append_path_common(PlannerInfo *root,
 	Assert(inner_entry->relid != 0);
 	result->relid = inner_entry->relid;
 
+	/* No PartitionSelector by default */
+	result->join_filter_param = -1;
+
 	result->nchildren = list_length(inner_append->subpaths);
 	result->children = (ChildScanCommon *)
 			palloc(result->nchildren * sizeof(ChildScanCommon));
@@ -401,6 +741,7 @@ create_append_plan_common(PlannerInfo *root, RelOptInfo *rel,
 	RuntimeAppendPath	   *rpath = (RuntimeAppendPath *) best_path;
 	const PartRelationInfo *prel;
 	CustomScan			   *cscan;
+	List				   *zone_map_clauses = NIL;
 
 	prel = get_pathman_relation_info(rpath->relid);
 	Assert(prel);
@@ -445,8 +786,27 @@ create_append_plan_common(PlannerInfo *root, RelOptInfo *rel,
 	cscan->custom_plans = custom_plans;
 	cscan->methods = scan_methods;
 
+	/* Values of zone map clauses follow partitioned column's clauses */
+	if (prel->zone_map_ncolumns > 0)
+	{
+		ListCell   *lc;
+
+		foreach (lc, extract_zone_map_clauses(clauses, prel, rel->relid, false))
+		{
+			ZoneMapClause *clause = (ZoneMapClause *) lfirst(lc);
+
+			/* Planner has already used constants */
+			if (IsA(clause->value, Const))
+				continue;
+
+			zone_map_clauses = lappend(zone_map_clauses, clause);
+			cscan->custom_exprs = lappend(cscan->custom_exprs, clause->value);
+		}
+	}
+
 	/* Cache 'prel->enable_parent' as well */
-	pack_runtimeappend_private(cscan, rpath, prel->enable_parent);
+	pack_runtimeappend_private(cscan, rpath, prel->enable_parent,
+							   zone_map_clauses);
 
 	return &cscan->scan.plan;
 }
@@ -457,19 +817,28 @@ create_append_scan_state_common(CustomScan *node,
 								uint32 size)
 {
 	RuntimeAppendState *scan_state;
+	int					nclauses,
+						nzone_map_exprs;
 
 	scan_state = (RuntimeAppendState *) palloc0(size);
 	NodeSetTag(scan_state, T_CustomScanState);
 
 	scan_state->css.flags = node->flags;
 	scan_state->css.methods = exec_methods;
-	scan_state->custom_exprs = node->custom_exprs;
-
 	unpack_runtimeappend_private(scan_state, node);
 
+	/* Split 'custom_exprs' into clauses and values of zone map clauses */
+	nzone_map_exprs = list_length(linitial(scan_state->zone_map_info));
+	nclauses = list_length(node->custom_exprs) - nzone_map_exprs;
+
+	scan_state->custom_exprs = list_truncate(list_copy(node->custom_exprs),
+											 nclauses);
+	scan_state->zone_map_exprs = list_copy_tail(node->custom_exprs, nclauses);
+
 	scan_state->cur_plans = NULL;
 	scan_state->ncur_plans = 0;
 	scan_state->running_idx = 0;
+	scan_state->prefetched_idx = -1;
 
 	return (Node *) scan_state;
 }
@@ -477,13 +846,45 @@ create_append_scan_state_common(CustomScan *node,
 void
 begin_append_common(CustomScanState *node, EState *estate, int eflags)
 {
-	RuntimeAppendState *scan_state = (RuntimeAppendState *) node;
+	RuntimeAppendState	   *scan_state = (RuntimeAppendState *) node;
+	const PartRelationInfo *prel;
 
 	scan_state->custom_expr_states =
 		(List *) ExecInitExpr((Expr *) scan_state->custom_exprs,
 							  (PlanState *) scan_state);
 
 	node->ss.ps.ps_TupFromTlist = false;
+
+	/* Evaluate stable clauses once and get rid of useless children */
+	prune_children_at_startup(scan_state);
+
+	prel = get_pathman_relation_info(scan_state->relid);
+	Assert(prel);
+
+	/* Prepare clauses to be checked against zone maps */
+	init_zone_map_pruning(scan_state, prel, estate);
+
+	/* Clauses will be evaluated on each rescan, prepare them */
+	if (!scan_state->static_selection)
+		scan_state->prune_prog = compile_prune_program(scan_state->custom_exprs,
+													   prel, INDEX_VAR,
+													   &node->ss.ps);
+
+	index_children(scan_state, prel);
+
+	/*
+	 * Don't bother scanning parent if it's empty. Processes of a parallel
+	 * scan must select the same plans, so they can't decide on their own.
+	 */
+	if (scan_state->parent_child &&
+		!(eflags & EXEC_FLAG_EXPLAIN_ONLY) &&
+#if PG_VERSION_NUM >= 90600
+		!node->ss.ps.plan->parallel_aware &&
+#endif
+		parent_is_empty(scan_state->relid, estate->es_snapshot))
+	{
+		scan_state->parent_child = NULL;
+	}
 }
 
 TupleTableSlot *
@@ -494,7 +895,13 @@ exec_append_common(CustomScanState *node,
 
 	/* ReScan if no plans are selected */
 	if (scan_state->ncur_plans == 0)
-		ExecReScan(&node->ss.ps);
+	{
+		/* PartitionSelector is done by now (see rescan_append_common()) */
+		if (scan_state->join_filter_param >= 0)
+			select_append_plans(scan_state);
+		else
+			ExecReScan(&node->ss.ps);
+	}
 
 	for (;;)
 	{
@@ -543,42 +950,94 @@ end_append_common(CustomScanState *node)
 void
 rescan_append_common(CustomScanState *node)
 {
-	RuntimeAppendState	   *scan_state = (RuntimeAppendState *) node;
-	ExprContext			   *econtext = node->ss.ps.ps_ExprContext;
+	RuntimeAppendState *scan_state = (RuntimeAppendState *) node;
+
+	/*
+	 * Partitions selected by PartitionSelector are unknown until
+	 * Hash is built, so we postpone selection till the first tuple.
+	 */
+	if (scan_state->join_filter_param >= 0)
+	{
+		scan_state->ncur_plans = 0;
+		scan_state->running_idx = 0;
+		scan_state->prefetched_idx = -1;
+
+		return;
+	}
+
+	select_append_plans(scan_state);
+}
+
+/* Select partitions for the next run and prepare their plan states */
+static void
+select_append_plans(RuntimeAppendState *scan_state)
+{
+	ExprContext			   *econtext = scan_state->css.ss.ps.ps_ExprContext;
 	const PartRelationInfo *prel;
 	List				   *ranges;
 	ListCell			   *lc;
 	WalkerContext			wcxt;
-	Oid					   *parts;
-	int						nparts;
+	MemoryContext			old_mcxt;
+
+	/* Partitions can't change between rescans, just restart them */
+	if (scan_state->static_selection &&
+		scan_state->join_filter_param < 0 &&
+		scan_state->cur_plans)
+		goto rescan_plans;
 
 	prel = get_pathman_relation_info(scan_state->relid);
 	Assert(prel);
 
+	/* This is executed for every outer row of NestLoop, so don't leak memory */
+	ResetExprContext(econtext);
+	old_mcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
 	/* First we select all available partitions... */
 	ranges = list_make1_irange(make_irange(0, PrelLastChild(prel), IR_COMPLETE));
 
-	InitWalkerContext(&wcxt, INDEX_VAR, prel, econtext, false);
-	foreach (lc, scan_state->custom_exprs)
+	/* ... then we cut off irrelevant ones using the provided clauses */
+	if (scan_state->prune_prog &&
+		prune_program_is_valid(scan_state->prune_prog, prel))
 	{
-		WrapperNode *wn;
+		ranges = run_prune_program(scan_state->prune_prog, prel, econtext);
+	}
+	/* Children have already been pruned by begin_append_common() */
+	else if (!scan_state->static_selection)
+	{
+		InitWalkerContext(&wcxt, INDEX_VAR, prel, econtext, false);
+		foreach (lc, scan_state->custom_exprs)
+		{
+			WrapperNode *wn;
 
-		/* ... then we cut off irrelevant ones using the provided clauses */
-		wn = walk_expr_tree((Expr *) lfirst(lc), &wcxt);
-		ranges = irange_list_intersection(ranges, wn->rangeset);
+			wn = walk_expr_tree((Expr *) lfirst(lc), &wcxt);
+			ranges = irange_list_intersection(ranges, wn->rangeset);
+		}
 	}
 
-	/* Get Oids of the required partitions */
-	parts = get_partition_oids(ranges, &nparts, prel, scan_state->enable_parent);
+	/* Leave only partitions which may contain build side's join keys */
+	if (scan_state->join_filter_param >= 0)
+	{
+		ParamExecData *prm;
 
-	/* Select new plans for this run using 'parts' */
-	if (scan_state->cur_plans)
-		pfree(scan_state->cur_plans); /* shallow free since cur_plans
-									   * belong to children_table  */
-	scan_state->cur_plans = select_required_plans(scan_state->children_table,
-												  parts, nparts,
-												  &scan_state->ncur_plans);
-	pfree(parts);
+		prm = &econtext->ecxt_param_exec_vals[scan_state->join_filter_param];
+
+		/* Scan all partitions if Hash hasn't been built yet */
+		if (!prm->isnull)
+			ranges = irange_list_intersection(ranges,
+											  (List *) DatumGetPointer(prm->value));
+	}
+
+	/* Skip partitions whose zone maps don't match */
+	if (scan_state->nzone_map_quals > 0)
+		ranges = prune_by_zone_map_exprs(scan_state, prel, ranges, econtext);
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	/* Select new plans for this run using 'ranges' */
+	select_plans_by_ranges(scan_state, prel, ranges);
+
+rescan_plans:
+	scan_state->nplans_selected += scan_state->ncur_plans;
 
 	/* Transform selected plans into executable plan states */
 	transform_plans_into_states(scan_state,
@@ -587,11 +1046,126 @@ rescan_append_common(CustomScanState *node)
 								scan_state->css.ss.ps.state);
 
 	scan_state->running_idx = 0;
+	scan_state->prefetched_idx = -1;
+}
+
+/*
+ * Get PlanState of a selected child (create it if needed).
+ *
+ * NOTE: freshly created PlanStates don't have to be ReScanned.
+ */
+PlanState *
+get_child_plan_state(CustomScanState *node, ChildScanCommon child)
+{
+	RuntimeAppendState *scan_state = (RuntimeAppendState *) node;
+
+	if (child->content_type == CHILD_PLAN_STATE)
+	{
+		PlanState *ps = child->content.plan_state;
+
+		/* Perform ReScan postponed by transform_plans_into_states() */
+		if (child->rescan_pending)
+		{
+			if (bms_is_empty(ps->chgParam))
+				ExecReScan(ps);
+
+			child->rescan_pending = false;
+		}
+
+		return ps;
+	}
+
+	return init_child_plan_state(scan_state, child, node->ss.ps.state);
+}
+
+/*
+ * Issue prefetch requests for the first heap blocks of 'relid'.
+ *
+ * We don't want to lock a partition just to prefetch it, so only relations
+ * which are already locked by this backend (e.g. by AcquireExecutorLocks()
+ * for a generic plan) are prefetched.
+ */
+static void
+prefetch_relation(Oid relid, int nblocks)
+{
+	LOCKTAG				tag;
+	LockAcquireResult	res;
+	Relation			rel;
+	BlockNumber			blkno,
+						relblocks;
+
+	/* Check if we hold the lock without waiting for it */
+	SET_LOCKTAG_RELATION(tag, MyDatabaseId, relid);
+	res = LockAcquire(&tag, AccessShareLock, false, true);
+	if (res == LOCKACQUIRE_NOT_AVAIL)
+		return;
+
+	/* Give it back at once (we've either taken it or bumped its count) */
+	LockRelease(&tag, AccessShareLock, false);
+	if (res != LOCKACQUIRE_ALREADY_HELD)
+		return;
+
+	rel = try_relation_open(relid, NoLock);
+	if (!rel)
+		return; /* relation has been dropped */
+
+	relblocks = RelationGetNumberOfBlocks(rel);
+	for (blkno = 0; blkno < relblocks && blkno < (BlockNumber) nblocks; blkno++)
+		PrefetchBuffer(rel, MAIN_FORKNUM, blkno);
+
+	relation_close(rel, NoLock);
+}
+
+/*
+ * Prefetch first heap blocks of the idx-th selected child if it's
+ * a SeqScan, so that its scan won't start with an I/O stall. Index
+ * scans read the index first, so there's nothing sensible to warm up.
+ * Does nothing unless pg_pathman.runtime_prefetch_depth is set.
+ */
+void
+prefetch_append_child(CustomScanState *node, int idx)
+{
+	RuntimeAppendState *scan_state = (RuntimeAppendState *) node;
+	ChildScanCommon		child;
+	Plan			   *plan;
+	int					depth = pg_pathman_runtime_prefetch_depth;
+
+	if (depth <= 0 || idx < 0 || idx >= scan_state->ncur_plans)
+		return;
+
+	/* Each child is prefetched once per run */
+	if (idx == scan_state->prefetched_idx)
+		return;
+	scan_state->prefetched_idx = idx;
+
+	child = scan_state->cur_plans[idx];
+	plan = (child->content_type == CHILD_PLAN_STATE) ?
+				child->content.plan_state->plan :
+				child->content.plan;
+
+	if (IsA(plan, SeqScan))
+		prefetch_relation(child->relid, depth);
 }
 
 void
 explain_append_common(CustomScanState *node, HTAB *children_table, ExplainState *es)
 {
+	RuntimeAppendState *scan_state = (RuntimeAppendState *) node;
+
+	/* Show how many children have been pruned by begin_append_common() */
+	if (scan_state->nplans_pruned >= 0)
+		ExplainPropertyInteger("Partitions Pruned",
+							   scan_state->nplans_pruned, es);
+
+	/* Show how many of selected children have actually been initialized */
+	if (es->analyze)
+	{
+		ExplainPropertyLong("Partitions Selected",
+							scan_state->nplans_selected, es);
+		ExplainPropertyLong("Partitions Initialized",
+							scan_state->nplans_initialized, es);
+	}
+
 	/* Construct excess PlanStates */
 	if (!es->analyze)
 	{
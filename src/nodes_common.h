@@ -47,6 +47,7 @@ typedef struct
 	}			content;
 
 	int			original_order;		/* for sorting in EXPLAIN */
+	bool		rescan_pending;		/* ReScan is postponed till first use */
 } ChildScanCommonData;
 
 typedef ChildScanCommonData *ChildScanCommon;
@@ -97,6 +98,11 @@ void end_append_common(CustomScanState *node);
 
 void rescan_append_common(CustomScanState *node);
 
+PlanState * get_child_plan_state(CustomScanState *node,
+								 ChildScanCommon child);
+
+void prefetch_append_child(CustomScanState *node, int idx);
+
 void explain_append_common(CustomScanState *node,
 						   HTAB *children_table,
 						   ExplainState *es);
@@ -0,0 +1,543 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_agg.c
+ *		Partition-wise aggregation of partitioned tables
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * Portions Copyright (c) 1996-2016, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "partition_agg.h"
+#include "pg_compat.h"
+#include "relation_info.h"
+#include "utils.h"
+
+#include "catalog/pg_type.h"
+#include "optimizer/clauses.h"
+#include "optimizer/cost.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/prep.h"
+#include "optimizer/tlist.h"
+#include "optimizer/var.h"
+#include "utils/fmgroids.h"
+#include "utils/guc.h"
+#include "utils/selfuncs.h"
+
+
+bool				pg_pathman_enable_partitionwise_agg = false;
+
+
+#if PG_VERSION_NUM >= 90600
+
+static bool group_clause_matches_partitioning(const PartRelationInfo *prel,
+											  List *group_exprs,
+											  Index varno);
+
+static bool is_bounds_preserving_trunc(Node *node, Index varno,
+									   const PartRelationInfo *prel);
+
+static bool trunc_keeps_bound(Datum unit, const Bound *bound,
+							  FmgrInfo *cmp_func);
+
+static List *create_partition_agg_paths(PlannerInfo *root,
+										RelOptInfo *input_rel,
+										RelOptInfo *grouped_rel,
+										PathTarget *target,
+										PathTarget *input_target,
+										AggSplit aggsplit,
+										List *having_qual,
+										const AggClauseCosts *agg_costs,
+										List *group_exprs);
+
+static Path *create_agg_path_for_input(PlannerInfo *root,
+									   RelOptInfo *grouped_rel,
+									   Path *subpath,
+									   PathTarget *target,
+									   AggSplit aggsplit,
+									   List *having_qual,
+									   const AggClauseCosts *agg_costs,
+									   double num_groups);
+
+static PathTarget *translate_pathtarget(PlannerInfo *root,
+										PathTarget *target,
+										AppendRelInfo *appinfo);
+
+static PathTarget *make_partial_grouping_target(PlannerInfo *root,
+												PathTarget *grouping_target);
+
+#endif /* PG_VERSION_NUM >= 90600 */
+
+
+void
+init_partition_agg_static_data(void)
+{
+	DefineCustomBoolVariable("pg_pathman.enable_partitionwise_agg",
+							 "Enables partition-wise aggregation of partitioned tables.",
+							 NULL,
+							 &pg_pathman_enable_partitionwise_agg,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+}
+
+
+#if PG_VERSION_NUM >= 90600
+
+/*
+ * Aggregate partitions of 'input_rel' one by one.
+ *
+ * If each group is contained in a single partition (GROUP BY includes
+ * partitioned column), we produce an Append of per-partition Aggs.
+ * Otherwise partial aggregates of partitions are combined by a final Agg.
+ */
+void
+add_partitionwise_agg_paths(PlannerInfo *root,
+							RelOptInfo *input_rel,
+							RelOptInfo *grouped_rel)
+{
+	Query				   *parse = root->parse;
+	PathTarget			   *target = root->upper_targets[UPPERREL_GROUP_AGG],
+						   *input_target;
+	const PartRelationInfo *prel;
+	RangeTblEntry		   *rte;
+	List				   *group_exprs,
+						   *subpaths;
+	AggClauseCosts			agg_costs;
+	Path				   *path;
+
+	/* We only handle aggregation of a single partitioned table */
+	if (input_rel->reloptkind != RELOPT_BASEREL || parse->groupingSets)
+		return;
+
+	if (!parse->groupClause && !parse->hasAggs)
+		return;
+
+	if (!target || !input_rel->cheapest_total_path || IS_DUMMY_REL(input_rel))
+		return;
+
+	rte = root->simple_rte_array[input_rel->relid];
+	if (!rte->inh || !(prel = get_pathman_relation_info(rte->relid)))
+		return;
+
+	/* Target list which is fed to aggregation (with sortgrouprefs) */
+	input_target = input_rel->cheapest_total_path->pathtarget;
+
+	group_exprs = get_sortgrouplist_exprs(parse->groupClause,
+										  parse->targetList);
+
+	MemSet(&agg_costs, 0, sizeof(AggClauseCosts));
+	if (parse->hasAggs)
+	{
+		get_agg_clause_costs(root, (Node *) target->exprs,
+							 AGGSPLIT_SIMPLE, &agg_costs);
+		get_agg_clause_costs(root, parse->havingQual,
+							 AGGSPLIT_SIMPLE, &agg_costs);
+	}
+
+	/* Each group lives entirely in a single partition */
+	if (group_clause_matches_partitioning(prel, group_exprs, input_rel->relid))
+	{
+		subpaths = create_partition_agg_paths(root, input_rel, grouped_rel,
+											  target, input_target,
+											  AGGSPLIT_SIMPLE,
+											  (List *) parse->havingQual,
+											  &agg_costs, group_exprs);
+		if (subpaths == NIL)
+			return;
+
+		path = (Path *) create_append_path_compat(grouped_rel, subpaths,
+												  NULL, 0);
+		path->pathtarget = target;
+
+		add_path(grouped_rel, path);
+	}
+
+	/* Otherwise combine partial aggregates of partitions */
+	else if (!agg_costs.hasNonPartial && !agg_costs.hasNonSerial)
+	{
+		PathTarget	   *partial_target;
+		AggClauseCosts	agg_partial_costs,
+						agg_final_costs;
+		double			num_groups = 1;
+
+		partial_target = make_partial_grouping_target(root, target);
+
+		MemSet(&agg_partial_costs, 0, sizeof(AggClauseCosts));
+		MemSet(&agg_final_costs, 0, sizeof(AggClauseCosts));
+		if (parse->hasAggs)
+		{
+			get_agg_clause_costs(root, (Node *) partial_target->exprs,
+								 AGGSPLIT_INITIAL_SERIAL,
+								 &agg_partial_costs);
+			get_agg_clause_costs(root, (Node *) target->exprs,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 &agg_final_costs);
+			get_agg_clause_costs(root, parse->havingQual,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 &agg_final_costs);
+		}
+
+		/* HAVING is checked by the final Agg */
+		subpaths = create_partition_agg_paths(root, input_rel, grouped_rel,
+											  partial_target, input_target,
+											  AGGSPLIT_INITIAL_SERIAL, NIL,
+											  &agg_partial_costs, group_exprs);
+		if (subpaths == NIL)
+			return;
+
+		path = (Path *) create_append_path_compat(grouped_rel, subpaths,
+												  NULL, 0);
+		path->pathtarget = partial_target;
+
+		if (parse->groupClause)
+			num_groups = estimate_num_groups(root, group_exprs,
+											 input_rel->cheapest_total_path->rows,
+											 NULL);
+
+		/* Append is not sorted, so GROUP BY may need an explicit Sort */
+		if (parse->groupClause &&
+			!(enable_hashagg && grouping_is_hashable(parse->groupClause)))
+		{
+			if (!grouping_is_sortable(parse->groupClause))
+				return;
+
+			path = (Path *) create_sort_path(root, grouped_rel, path,
+											 root->group_pathkeys, -1.0);
+		}
+
+		path = create_agg_path_for_input(root, grouped_rel, path, target,
+										 AGGSPLIT_FINAL_DESERIAL,
+										 (List *) parse->havingQual,
+										 &agg_final_costs, num_groups);
+		if (path)
+			add_path(grouped_rel, path);
+	}
+}
+
+
+/*
+ * Check that rows of any group belong to a single partition.
+ */
+static bool
+group_clause_matches_partitioning(const PartRelationInfo *prel,
+								  List *group_exprs,
+								  Index varno)
+{
+	ListCell *lc;
+
+	/* Parent's tuples don't belong to any partition */
+	if (prel->enable_parent)
+		return false;
+
+	foreach (lc, group_exprs)
+	{
+		Node *expr = (Node *) lfirst(lc);
+
+		if (is_partitioned_column(expr, varno, prel))
+			return true;
+
+		if (prel->parttype == PT_RANGE &&
+			is_bounds_preserving_trunc(expr, varno, prel))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Check if 'node' is date_trunc(const, partitioned column) which
+ * doesn't move any RANGE bound, e.g. 'day' for daily partitions.
+ * Since date_trunc(x) <= x, a group can't cross such a bound.
+ */
+static bool
+is_bounds_preserving_trunc(Node *node, Index varno,
+						   const PartRelationInfo *prel)
+{
+	FuncExpr   *expr = (FuncExpr *) node;
+	Const	   *unit;
+	RangeEntry *ranges;
+	FmgrInfo	cmp_func;
+	uint32		i;
+
+	if (!IsA(expr, FuncExpr) || expr->funcid != F_TIMESTAMP_TRUNC)
+		return false;
+
+	unit = (Const *) linitial(expr->args);
+	if (!IsA(unit, Const) || unit->constisnull)
+		return false;
+
+	if (!is_partitioned_column((Node *) lsecond(expr->args), varno, prel))
+		return false;
+
+	/* date_trunc() returns the same type */
+	if (prel->atttype != TIMESTAMPOID)
+		return false;
+
+	ranges = PrelGetRangesArray(prel);
+	fmgr_info(prel->cmp_proc, &cmp_func);
+
+	for (i = 0; i < PrelChildrenCount(prel); i++)
+	{
+		if (!trunc_keeps_bound(unit->constvalue, &ranges[i].min, &cmp_func) ||
+			!trunc_keeps_bound(unit->constvalue, &ranges[i].max, &cmp_func))
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+trunc_keeps_bound(Datum unit, const Bound *bound, FmgrInfo *cmp_func)
+{
+	Datum truncated;
+
+	if (IsInfinite(bound))
+		return true;
+
+	truncated = OidFunctionCall2(F_TIMESTAMP_TRUNC, unit, BoundGetValue(bound));
+
+	return DatumGetInt32(FunctionCall2(cmp_func, truncated,
+									   BoundGetValue(bound))) == 0;
+}
+
+/*
+ * Build an aggregation path for each non-excluded partition of 'input_rel'.
+ * Returns NIL if at least one partition can't be handled.
+ */
+static List *
+create_partition_agg_paths(PlannerInfo *root,
+						   RelOptInfo *input_rel,
+						   RelOptInfo *grouped_rel,
+						   PathTarget *target,
+						   PathTarget *input_target,
+						   AggSplit aggsplit,
+						   List *having_qual,
+						   const AggClauseCosts *agg_costs,
+						   List *group_exprs)
+{
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	foreach (lc, root->append_rel_list)
+	{
+		AppendRelInfo  *appinfo = (AppendRelInfo *) lfirst(lc);
+		RelOptInfo	   *child_rel;
+		Path		   *subpath,
+					   *agg_path;
+		List		   *child_group_exprs;
+		double			num_groups = 1;
+
+		if (appinfo->parent_relid != input_rel->relid)
+			continue;
+
+		child_rel = find_base_rel(root, appinfo->child_relid);
+
+		/* Skip partitions excluded by constraints */
+		if (IS_DUMMY_REL(child_rel))
+			continue;
+
+		subpath = child_rel->cheapest_total_path;
+		if (!subpath || PATH_REQ_OUTER(subpath))
+			return NIL;
+
+		/* Compute (and label) grouping columns of this partition */
+		subpath = (Path *) create_projection_path(root, child_rel, subpath,
+												  translate_pathtarget(root,
+																	   input_target,
+																	   appinfo));
+
+		if (group_exprs)
+		{
+			child_group_exprs = (List *) adjust_appendrel_attrs(root,
+																(Node *) group_exprs,
+																appinfo);
+			num_groups = estimate_num_groups(root, child_group_exprs,
+											 subpath->rows, NULL);
+		}
+
+		agg_path = create_agg_path_for_input(root, grouped_rel, subpath,
+											 translate_pathtarget(root,
+																  target,
+																  appinfo),
+											 aggsplit,
+											 (List *) adjust_appendrel_attrs(root,
+																			 (Node *) having_qual,
+																			 appinfo),
+											 agg_costs, num_groups);
+		if (!agg_path)
+			return NIL;
+
+		result = lappend(result, agg_path);
+	}
+
+	return result;
+}
+
+/*
+ * Pick aggregation strategy for 'subpath'.
+ *
+ * NOTE: we don't add Sorts below partitions' Aggs, since there's
+ * no way to sort them by parent's pathkeys in 9.6.
+ */
+static Path *
+create_agg_path_for_input(PlannerInfo *root,
+						  RelOptInfo *grouped_rel,
+						  Path *subpath,
+						  PathTarget *target,
+						  AggSplit aggsplit,
+						  List *having_qual,
+						  const AggClauseCosts *agg_costs,
+						  double num_groups)
+{
+	Query	   *parse = root->parse;
+	AggStrategy	strategy;
+
+	if (!parse->groupClause)
+		strategy = AGG_PLAIN;
+
+	else if (pathkeys_contained_in(root->group_pathkeys, subpath->pathkeys))
+		strategy = AGG_SORTED;
+
+	else if (enable_hashagg && grouping_is_hashable(parse->groupClause))
+		strategy = AGG_HASHED;
+
+	else return NULL;
+
+	return (Path *) create_agg_path(root, grouped_rel, subpath, target,
+									strategy, aggsplit,
+									parse->groupClause, having_qual,
+									agg_costs, num_groups);
+}
+
+/* Copy 'target' replacing parent's Vars with those of partition */
+static PathTarget *
+translate_pathtarget(PlannerInfo *root,
+					 PathTarget *target,
+					 AppendRelInfo *appinfo)
+{
+	PathTarget *result = copy_pathtarget(target);
+
+	result->exprs = (List *) adjust_appendrel_attrs(root,
+													(Node *) target->exprs,
+													appinfo);
+
+	return result;
+}
+
+/*
+ * make_partial_grouping_target
+ *	  Generate appropriate PathTarget for output of partial aggregate
+ *	  (or partial grouping, if there are no aggregates) nodes.
+ *
+ * NOTE: this function is a copy of static make_partial_grouping_target()
+ * from planner.c (with mark_partial_aggref() inlined).
+ */
+static PathTarget *
+make_partial_grouping_target(PlannerInfo *root, PathTarget *grouping_target)
+{
+	Query	   *parse = root->parse;
+	PathTarget *partial_target;
+	List	   *non_group_cols;
+	List	   *non_group_exprs;
+	int			i;
+	ListCell   *lc;
+
+	partial_target = create_empty_pathtarget();
+	non_group_cols = NIL;
+
+	i = 0;
+	foreach(lc, grouping_target->exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+		Index		sgref = get_pathtarget_sortgroupref(grouping_target, i);
+
+		if (sgref && parse->groupClause &&
+			get_sortgroupref_clause_noerr(sgref, parse->groupClause) != NULL)
+		{
+			/*
+			 * It's a grouping column, so add it to the partial_target as-is.
+			 * (This allows the upper agg step to repeat the grouping calcs.)
+			 */
+			add_column_to_pathtarget(partial_target, expr, sgref);
+		}
+		else
+		{
+			/*
+			 * Non-grouping column, so just remember the expression for later
+			 * call to pull_var_clause.
+			 */
+			non_group_cols = lappend(non_group_cols, expr);
+		}
+
+		i++;
+	}
+
+	/*
+	 * If there's a HAVING clause, we'll need the Vars/Aggrefs it uses, too.
+	 */
+	if (parse->havingQual)
+		non_group_cols = lappend(non_group_cols, parse->havingQual);
+
+	/*
+	 * Pull out all the Vars, PlaceHolderVars, and Aggrefs mentioned in
+	 * non-group cols (plus HAVING), and add them to the partial_target if not
+	 * already present.  (An expression used directly as a GROUP BY item will
+	 * be present already.)  Note this includes Vars used in resjunk items, so
+	 * we are covering the needs of ORDER BY and window specifications.
+	 */
+	non_group_exprs = pull_var_clause((Node *) non_group_cols,
+									  PVC_INCLUDE_AGGREGATES |
+									  PVC_RECURSE_WINDOWFUNCS |
+									  PVC_INCLUDE_PLACEHOLDERS);
+
+	add_new_columns_to_pathtarget(partial_target, non_group_exprs);
+
+	/*
+	 * Adjust Aggrefs to put them in partial mode.  At this point all Aggrefs
+	 * are at the top level of the target list, so we can just scan the list
+	 * rather than recursing through the expression trees.
+	 */
+	foreach(lc, partial_target->exprs)
+	{
+		Aggref	   *aggref = (Aggref *) lfirst(lc);
+
+		if (IsA(aggref, Aggref))
+		{
+			Aggref	   *newaggref;
+
+			/*
+			 * We shouldn't need to copy the substructure of the Aggref node,
+			 * but flat-copy the node itself to avoid damaging other trees.
+			 */
+			newaggref = makeNode(Aggref);
+			memcpy(newaggref, aggref, sizeof(Aggref));
+
+			/* For now, assume serialization is required */
+			newaggref->aggsplit = AGGSPLIT_INITIAL_SERIAL;
+
+			/* Partial aggregate produces transition state */
+			if (newaggref->aggtranstype == INTERNALOID)
+				newaggref->aggtype = BYTEAOID;
+			else
+				newaggref->aggtype = newaggref->aggtranstype;
+
+			lfirst(lc) = newaggref;
+		}
+	}
+
+	/* clean up cruft */
+	list_free(non_group_exprs);
+	list_free(non_group_cols);
+
+	/* XXX this causes some redundant cost calculation ... */
+	return set_pathtarget_cost_width(root, partial_target);
+}
+
+#endif /* PG_VERSION_NUM >= 90600 */
@@ -0,0 +1,31 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_agg.h
+ *		Partition-wise aggregation of partitioned tables
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PARTITION_AGG_H
+#define PARTITION_AGG_H
+
+
+#include "postgres.h"
+#include "optimizer/paths.h"
+
+
+extern bool pg_pathman_enable_partitionwise_agg;
+
+
+void init_partition_agg_static_data(void);
+
+#if PG_VERSION_NUM >= 90600
+void add_partitionwise_agg_paths(PlannerInfo *root,
+								 RelOptInfo *input_rel,
+								 RelOptInfo *grouped_rel);
+#endif
+
+
+#endif /* PARTITION_AGG_H */
@@ -11,6 +11,7 @@
 #include "init.h"
 #include "partition_creation.h"
 #include "partition_filter.h"
+#include "partition_flight.h"
 #include "pathman.h"
 #include "pathman_workers.h"
 #include "xact_handling.h"
@@ -21,6 +22,7 @@
 #include "access/xact.h"
 #include "catalog/heap.h"
 #include "catalog/pg_authid.h"
+#include "catalog/pg_class.h"
 #include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
 #include "catalog/toasting.h"
@@ -32,14 +34,17 @@
 #include "parser/parse_func.h"
 #include "parser/parse_relation.h"
 #include "parser/parse_utilcmd.h"
+#include "storage/bufmgr.h"
 #include "tcop/utility.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/fmgroids.h"
+#include "utils/inval.h"
 #include "utils/jsonb.h"
 #include "utils/snapmgr.h"
 #include "utils/lsyscache.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
 #include "utils/typcache.h"
 
 
@@ -47,19 +52,22 @@ static Oid spawn_partitions_val(Oid parent_relid,
 								const Bound *range_bound_min,
 								const Bound *range_bound_max,
 								Oid range_bound_type,
+								FmgrInfo *cmp_value_bound,
 								Datum interval_binary,
 								Oid interval_type,
 								Datum value,
 								Oid value_type);
 
-static void create_single_partition_common(Oid partition_relid,
-										   Constraint *check_constraint,
-										   init_callback_params *callback_params);
+static Oid *create_partition_tables(Oid parent_relid,
+									RangeVar **partition_rvs,
+									char **tablespaces,
+									int nparts,
+									char **partitioned_column);
 
-static Oid create_single_partition_internal(Oid parent_relid,
-											RangeVar *partition_rv,
-											char *tablespace,
-											char **partitioned_column);
+static void add_check_constraint(Oid partition_relid,
+								 Constraint *check_constraint);
+
+static void finish_partitions_creation(Oid parent_relid);
 
 static char *choose_range_partition_name(Oid parent_relid, Oid parent_nsp);
 static char *choose_hash_partition_name(Oid parent_relid, uint32 part_idx);
@@ -67,8 +75,12 @@ static char *choose_hash_partition_name(Oid parent_relid, uint32 part_idx);
 static ObjectAddress create_table_using_stmt(CreateStmt *create_stmt,
 											 Oid relowner);
 
-static void copy_foreign_keys(Oid parent_relid, Oid partition_oid);
-static void postprocess_child_table_and_atts(Oid parent_relid, Oid partition_relid);
+static void copy_foreign_keys(Oid parent_relid,
+							  Oid *partition_relids,
+							  int nparts);
+static void postprocess_child_table_and_atts(Oid parent_relid,
+											 Oid *partition_relids,
+											 int nparts);
 
 static Oid text_to_regprocedure(text *proname_args);
 
@@ -95,124 +107,214 @@ create_single_range_partition_internal(Oid parent_relid,
 									   RangeVar *partition_rv,
 									   char *tablespace)
 {
-	Oid						partition_relid;
-	Constraint			   *check_constr;
+	return create_range_partitions_bulk(parent_relid,
+										start_value, end_value,
+										value_type,
+										&partition_rv,
+										&tablespace,
+										1, NULL);
+}
+
+/*
+ * Create 'nparts' RANGE partitions [start_values[i], end_values[i]).
+ *
+ * Unlike a series of create_single_range_partition_internal() calls,
+ * this function locks the parent, checks privileges, copies FKs and ACLs
+ * and invalidates pg_pathman's cache only once for the whole batch.
+ *
+ * Both 'partition_rvs' and 'tablespaces' may be NULL (as well as any
+ * of their elements), in which case defaults are used. Oids of new
+ * partitions are stored to 'partition_relids' if it's not NULL.
+ *
+ * Returns Oid of the last partition.
+ */
+Oid
+create_range_partitions_bulk(Oid parent_relid,
+							 const Bound *start_values,
+							 const Bound *end_values,
+							 Oid value_type,
+							 RangeVar **partition_rvs,
+							 char **tablespaces,
+							 int nparts,
+							 Oid *partition_relids) /* to be set */
+{
+	Oid					   *new_relids;
+	RangeVar			  **rvs;
 	char				   *partitioned_column;
 	init_callback_params	callback_params;
+	Oid						callback = DEFAULT_INIT_CALLBACK;
+	bool					callback_is_cached = false;
+	Oid						parent_nsp = get_rel_namespace(parent_relid);
+	char				   *parent_nsp_name = get_namespace_name(parent_nsp);
+	int						i;
+
+	Assert(nparts > 0);
+
+	/* Generate names if asked to */
+	rvs = palloc(nparts * sizeof(RangeVar *));
+	for (i = 0; i < nparts; i++)
+	{
+		if (partition_rvs && partition_rvs[i])
+			rvs[i] = partition_rvs[i];
+		else
+			rvs[i] = makeRangeVar(parent_nsp_name,
+								  choose_range_partition_name(parent_relid,
+															  parent_nsp),
+								  -1);
+	}
+
+	/* Create partitions & get 'partitioned_column' */
+	new_relids = create_partition_tables(parent_relid, rvs, tablespaces,
+										 nparts, &partitioned_column);
+
+	/* Build and add check constraints for RANGE partitions */
+	for (i = 0; i < nparts; i++)
+	{
+		Constraint *check_constr;
 
-	/* Generate a name if asked to */
-	if (!partition_rv)
+		check_constr = build_range_check_constraint(new_relids[i],
+													partitioned_column,
+													&start_values[i],
+													&end_values[i],
+													value_type);
+
+		add_check_constraint(new_relids[i], check_constr);
+	}
+
+	/* Make constraints visible */
+	CommandCounterIncrement();
+
+	/* Execute init_callback for each partition */
+	for (i = 0; i < nparts; i++)
 	{
-		Oid		parent_nsp = get_rel_namespace(parent_relid);
-		char   *parent_nsp_name = get_namespace_name(parent_nsp);
-		char   *partition_name;
+		/* Cook args for init_callback */
+		MakeInitCallbackRangeParams(&callback_params,
+									callback,
+									parent_relid, new_relids[i],
+									start_values[i], end_values[i],
+									value_type);
+
+		/* Don't look the callback up more than once */
+		callback_params.callback_is_cached = callback_is_cached;
 
-		partition_name = choose_range_partition_name(parent_relid, parent_nsp);
+		invoke_part_callback(&callback_params);
 
-		partition_rv = makeRangeVar(parent_nsp_name, partition_name, -1);
+		callback = callback_params.callback;
+		callback_is_cached = callback_params.callback_is_cached;
 	}
 
-	/* Create a partition & get 'partitioned_column' */
-	partition_relid = create_single_partition_internal(parent_relid,
-													   partition_rv,
-													   tablespace,
-													   &partitioned_column);
-
-	/* Build check constraint for RANGE partition */
-	check_constr = build_range_check_constraint(partition_relid,
-												partitioned_column,
-												start_value,
-												end_value,
-												value_type);
-
-	/* Cook args for init_callback */
-	MakeInitCallbackRangeParams(&callback_params,
-								DEFAULT_INIT_CALLBACK,
-								parent_relid, partition_relid,
-								*start_value, *end_value, value_type);
-
-	/* Add constraint & execute init_callback */
-	create_single_partition_common(partition_relid,
-								   check_constr,
-								   &callback_params);
-
-	/* Return the Oid */
-	return partition_relid;
+	/* Notify backends & make possible changes visible */
+	finish_partitions_creation(parent_relid);
+
+	if (partition_relids)
+		memcpy(partition_relids, new_relids, nparts * sizeof(Oid));
+
+	/* Return the Oid of the last partition */
+	return new_relids[nparts - 1];
 }
 
-/* Create one HASH partition */
-Oid
-create_single_hash_partition_internal(Oid parent_relid,
-									  uint32 part_idx,
-									  uint32 part_count,
-									  Oid value_type,
-									  RangeVar *partition_rv,
-									  char *tablespace)
+/*
+ * Create all 'part_count' HASH partitions at once.
+ *
+ * Both 'partition_rvs' and 'tablespaces' may be NULL (as well as any
+ * of their elements), in which case defaults are used.
+ */
+void
+create_hash_partitions_bulk(Oid parent_relid,
+							uint32 part_count,
+							Oid value_type,
+							RangeVar **partition_rvs,
+							char **tablespaces)
 {
-	Oid						partition_relid;
-	Constraint			   *check_constr;
+	Oid					   *new_relids;
+	RangeVar			  **rvs;
 	char				   *partitioned_column;
 	init_callback_params	callback_params;
+	Oid						callback = DEFAULT_INIT_CALLBACK;
+	bool					callback_is_cached = false;
+	char				   *parent_nsp_name;
+	uint32					i;
+
+	Assert(part_count > 0);
 
-	/* Generate a name if asked to */
-	if (!partition_rv)
+	parent_nsp_name = get_namespace_name(get_rel_namespace(parent_relid));
+
+	/* Generate names if asked to */
+	rvs = palloc(part_count * sizeof(RangeVar *));
+	for (i = 0; i < part_count; i++)
 	{
-		Oid		parent_nsp = get_rel_namespace(parent_relid);
-		char   *parent_nsp_name = get_namespace_name(parent_nsp);
-		char   *partition_name;
+		if (partition_rvs && partition_rvs[i])
+			rvs[i] = partition_rvs[i];
+		else
+			rvs[i] = makeRangeVar(parent_nsp_name,
+								  choose_hash_partition_name(parent_relid, i),
+								  -1);
+	}
+
+	/* Create partitions & get 'partitioned_column' */
+	new_relids = create_partition_tables(parent_relid, rvs, tablespaces,
+										 part_count, &partitioned_column);
+
+	/* Build and add check constraints for HASH partitions */
+	for (i = 0; i < part_count; i++)
+	{
+		Constraint *check_constr;
+
+		check_constr = build_hash_check_constraint(new_relids[i],
+												   partitioned_column,
+												   i,
+												   part_count,
+												   value_type);
+
+		add_check_constraint(new_relids[i], check_constr);
+	}
+
+	/* Make constraints visible */
+	CommandCounterIncrement();
+
+	/* Execute init_callback for each partition */
+	for (i = 0; i < part_count; i++)
+	{
+		/* Cook args for init_callback */
+		MakeInitCallbackHashParams(&callback_params,
+								   callback,
+								   parent_relid, new_relids[i]);
+
+		/* Don't look the callback up more than once */
+		callback_params.callback_is_cached = callback_is_cached;
 
-		partition_name = choose_hash_partition_name(parent_relid, part_idx);
+		invoke_part_callback(&callback_params);
 
-		partition_rv = makeRangeVar(parent_nsp_name, partition_name, -1);
+		callback = callback_params.callback;
+		callback_is_cached = callback_params.callback_is_cached;
 	}
 
-	/* Create a partition & get 'partitioned_column' */
-	partition_relid = create_single_partition_internal(parent_relid,
-													   partition_rv,
-													   tablespace,
-													   &partitioned_column);
-
-	/* Build check constraint for HASH partition */
-	check_constr = build_hash_check_constraint(partition_relid,
-											   partitioned_column,
-											   part_idx,
-											   part_count,
-											   value_type);
-
-	/* Cook args for init_callback */
-	MakeInitCallbackHashParams(&callback_params,
-							   DEFAULT_INIT_CALLBACK,
-							   parent_relid, partition_relid);
-
-	/* Add constraint & execute init_callback */
-	create_single_partition_common(partition_relid,
-								   check_constr,
-								   &callback_params);
-
-	/* Return the Oid */
-	return partition_relid;
+	/* Notify backends & make possible changes visible */
+	finish_partitions_creation(parent_relid);
 }
 
-/* Add constraint & execute init_callback */
-void
-create_single_partition_common(Oid partition_relid,
-							   Constraint *check_constraint,
-							   init_callback_params *callback_params)
+/* Add a CHECK constraint to a new partition */
+static void
+add_check_constraint(Oid partition_relid, Constraint *check_constraint)
 {
 	Relation child_relation;
 
-	/* Open the relation and add new check constraint & fkeys */
+	/* Open the relation and add new check constraint */
 	child_relation = heap_open(partition_relid, AccessExclusiveLock);
 	AddRelationNewConstraints(child_relation, NIL,
 							  list_make1(check_constraint),
 							  false, true, true);
 	heap_close(child_relation, NoLock);
+}
 
-	/* Make constraint visible */
-	CommandCounterIncrement();
-
-	/* Finally invoke 'init_callback' */
-	invoke_part_callback(callback_params);
+/*
+ * Emit a single invalidation event for the parent, so that all
+ * backends (including this one) refresh its PartRelationInfo.
+ */
+static void
+finish_partitions_creation(Oid parent_relid)
+{
+	CacheInvalidateRelcacheByRelid(parent_relid);
 
 	/* Make possible changes visible */
 	CommandCounterIncrement();
@@ -234,7 +336,8 @@ create_partitions_for_value(Oid relid, Datum value, Oid value_type)
 	{
 		/* Take default values */
 		bool	spawn_using_bgw	= DEFAULT_SPAWN_USING_BGW,
-				enable_auto		= DEFAULT_AUTO;
+				enable_auto		= DEFAULT_AUTO,
+				premake			= false;
 
 		/* Values to be extracted from PATHMAN_CONFIG_PARAMS */
 		Datum	values[Natts_pathman_config_params];
@@ -245,19 +348,28 @@ create_partitions_for_value(Oid relid, Datum value, Oid value_type)
 		{
 			enable_auto = values[Anum_pathman_config_params_auto - 1];
 			spawn_using_bgw = values[Anum_pathman_config_params_spawn_using_bgw - 1];
+			premake = !isnull[Anum_pathman_config_params_premake - 1];
 		}
 
 		/* Emit ERROR if automatic partition creation is disabled */
 		if (!enable_auto || !IsAutoPartitionEnabled())
 			elog(ERROR, ERR_PART_ATTR_NO_PART, datum_to_cstring(value, value_type));
 
+		/* Some other transaction might be creating this partition already */
+		last_partition = wait_for_partition_flight(relid, value, value_type);
+
+		if (last_partition != InvalidOid)
+		{
+			elog(DEBUG2, "create_partitions(): used partition of another xact [%u]",
+				 MyProcPid);
+		}
 		/*
 		 * If table has been partitioned in some previous xact AND
 		 * we don't hold any conflicting locks, run BGWorker.
 		 */
-		if (spawn_using_bgw &&
-			xact_object_is_visible(rel_xmin) &&
-			!xact_bgw_conflicting_lock_exists(relid))
+		else if (spawn_using_bgw &&
+				 xact_object_is_visible(rel_xmin) &&
+				 !xact_bgw_conflicting_lock_exists(relid))
 		{
 			elog(DEBUG2, "create_partitions(): chose BGWorker [%u]", MyProcPid);
 			last_partition = create_partitions_for_value_bg_worker(relid,
@@ -273,6 +385,10 @@ create_partitions_for_value(Oid relid, Datum value, Oid value_type)
 																  value_type,
 																  false); /* backend */
 		}
+
+		/* PremakeWorker should have done this, make sure it's running */
+		if (premake)
+			start_premake_worker(false);
 	}
 	else
 		elog(ERROR, "relation \"%s\" is not partitioned by pg_pathman",
@@ -365,6 +481,7 @@ create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type,
 				Oid			interval_type = InvalidOid;
 				Datum		interval_binary, /* assigned 'width' of one partition */
 							interval_text;
+				FmgrInfo	cmp_value_bound;
 
 				/* Copy datums in order to protect them from cache invalidation */
 				bound_min = CopyBound(&ranges[0].min,
@@ -375,6 +492,9 @@ create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type,
 									  prel->attbyval,
 									  prel->attlen);
 
+				/* Compare 'value' to bounds just like partitions are sorted */
+				fill_prel_cmp_fmgr_info(&cmp_value_bound, base_value_type, prel);
+
 				/* Check if interval is set */
 				if (isnull[Anum_pathman_config_range_interval - 1])
 				{
@@ -394,6 +514,7 @@ create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type,
 				/* At last, spawn partitions to store the value */
 				partid = spawn_partitions_val(PrelParentRelid(prel),
 											  &bound_min, &bound_max, base_bound_type,
+											  &cmp_value_bound,
 											  interval_binary, interval_type,
 											  value, base_value_type);
 			}
@@ -431,6 +552,127 @@ create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type,
 	return partid;
 }
 
+/*
+ * Make sure that 'premake' partitions exist ahead of the current one, i.e.
+ * the one storing now() (for date types) or the last non-empty partition.
+ *
+ * Returns Oid of the last created partition or InvalidOid.
+ */
+Oid
+premake_range_partitions(Oid relid, int premake)
+{
+	const PartRelationInfo *prel;
+	Datum					values[Natts_pathman_config];
+	bool					isnull[Natts_pathman_config];
+	RangeEntry			   *ranges;
+	Oid						bound_type,
+							interval_type,
+							plus_op_func,
+							plus_op_ret_type;
+	Datum					interval_binary,
+							target;
+	Bound					target_bound,
+							last_bound;
+	FmgrInfo				plus_op_finfo,
+							cmp_func;
+	int						i;
+
+	if (premake < 1)
+		elog(ERROR, "'premake' must be greater than zero");
+
+	/* Get both PartRelationInfo & PATHMAN_CONFIG contents for this relation */
+	if (!pathman_config_contains_relation(relid, values, isnull, NULL))
+		elog(ERROR, "relation \"%s\" is not partitioned by pg_pathman",
+			 get_rel_name_or_relid(relid));
+
+	prel = get_pathman_relation_info(relid);
+	shout_if_prel_is_invalid(relid, prel, PT_RANGE);
+
+	/* Check if interval is set */
+	if (isnull[Anum_pathman_config_range_interval - 1])
+		elog(ERROR, "cannot premake partitions of relation \"%s\" without interval",
+			 get_rel_name_or_relid(relid));
+
+	/* There's nothing to start with */
+	if (PrelChildrenCount(prel) == 0)
+		return InvalidOid;
+
+	ranges = PrelGetRangesArray(prel);
+	bound_type = getBaseType(prel->atttype);
+	fill_prel_cmp_fmgr_info(&cmp_func, bound_type, prel);
+
+	/* Last partition covers everything, nothing to do */
+	if (IsInfinite(&ranges[PrelLastChild(prel)].max))
+		return InvalidOid;
+
+	/* Copy datum in order to protect it from cache invalidation */
+	last_bound = CopyBound(&ranges[PrelLastChild(prel)].max,
+						   prel->attbyval,
+						   prel->attlen);
+
+	/* Date types are premade relative to now() */
+	if (is_date_type_internal(bound_type))
+	{
+		target = perform_type_cast(TimestampTzGetDatum(GetCurrentTimestamp()),
+								   TIMESTAMPTZOID, bound_type, NULL);
+	}
+	/* Other types are premade relative to the last non-empty partition */
+	else
+	{
+		for (i = PrelLastChild(prel); i > 0; i--)
+		{
+			Relation	child_rel;
+			BlockNumber	nblocks;
+
+			child_rel = heap_open(ranges[i].child_oid, AccessShareLock);
+			nblocks = RelationGetNumberOfBlocks(child_rel);
+			heap_close(child_rel, AccessShareLock);
+
+			if (nblocks > 0)
+				break;
+		}
+
+		if (IsInfinite(&ranges[i].min))
+			return InvalidOid;
+
+		target = datumCopy(BoundGetValue(&ranges[i].min),
+						   prel->attbyval,
+						   prel->attlen);
+	}
+
+	/* Convert interval from TEXT to binary form */
+	interval_binary = extract_binary_interval_from_text(values[Anum_pathman_config_range_interval - 1],
+														bound_type,
+														&interval_type);
+
+	/* Fetch operator's underlying function and ret type */
+	extract_op_func_and_ret_type("+", bound_type, interval_type,
+								 &plus_op_func, &plus_op_ret_type);
+	fmgr_info(plus_op_func, &plus_op_finfo);
+
+	/* Move target 'premake' intervals ahead */
+	for (i = 0; i < premake; i++)
+	{
+		target = FunctionCall2(&plus_op_finfo, target, interval_binary);
+
+		/* Cast result back to bound's type (e.g. date + interval = timestamp) */
+		if (plus_op_ret_type != bound_type)
+			target = perform_type_cast(target, plus_op_ret_type, bound_type, NULL);
+	}
+
+	/* Partition for 'target' already exists */
+	target_bound = MakeBound(target);
+	if (cmp_bounds(&cmp_func, &target_bound, &last_bound) < 0)
+		return InvalidOid;
+
+	elog(DEBUG2, "premaking partitions of relation %u up to '%s' [%u]",
+		 relid, datum_to_cstring(target, bound_type), MyProcPid);
+
+	/* Spawn all missing partitions at once */
+	return create_partitions_for_value_internal(relid, target, bound_type,
+												false); /* backend */
+}
+
 /*
  * Append\prepend partitions if there's no partition to store 'value'.
  *
@@ -444,6 +686,7 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 					 const Bound *range_bound_min,	/* parent's MIN boundary */
 					 const Bound *range_bound_max,	/* parent's MAX boundary */
 					 Oid range_bound_type,			/* type of boundary's value */
+					 FmgrInfo *cmp_value_bound,		/* cmp(value, bound) of prel */
 					 Datum interval_binary,			/* interval in binary form */
 					 Oid interval_type,				/* INTERVALOID or prel->atttype */
 					 Datum value,					/* value to be INSERTed */
@@ -462,10 +705,15 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 
 	Bound		value_bound = MakeBound(value);
 
-	Oid			last_partition = InvalidOid;
+	Bound	   *start_bounds,				/* boundaries of new partitions */
+			   *end_bounds;
+	Oid		   *partition_relids;
+	int		   *flights;					/* see launch_partition_flights() */
+	int			nparts = 0,
+				nparts_allocated = 8;
 
 
-	fill_type_cmp_fmgr_info(&cmp_value_bound_finfo, value_type, range_bound_type);
+	fmgr_info_copy(&cmp_value_bound_finfo, cmp_value_bound, CurrentMemoryContext);
 
 	/* Is it possible to append\prepend a partition? */
 	if (IsInfinite(range_bound_min) && IsInfinite(range_bound_max))
@@ -511,7 +759,7 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 		/* Update 'range_bound_type' */
 		range_bound_type = move_bound_op_ret_type;
 
-		/* Fetch new comparison function */
+		/* Fetch new comparison function (bounds aren't of prel's type now) */
 		fill_type_cmp_fmgr_info(&cmp_value_bound_finfo,
 								value_type,
 								range_bound_type);
@@ -531,13 +779,14 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 	/* Get operator's underlying function */
 	fmgr_info(move_bound_op_func, &move_bound_finfo);
 
+	start_bounds = palloc(nparts_allocated * sizeof(Bound));
+	end_bounds = palloc(nparts_allocated * sizeof(Bound));
+
 	/* Execute comparison function cmp(value, cur_leading_bound) */
 	while (should_append ?
 				check_ge(&cmp_value_bound_finfo, value, cur_leading_bound) :
 				check_lt(&cmp_value_bound_finfo, value, cur_leading_bound))
 	{
-		Bound bounds[2];
-
 		/* Assign the 'following' boundary to current 'leading' value */
 		cur_following_bound = cur_leading_bound;
 
@@ -546,13 +795,21 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 										  cur_leading_bound,
 										  interval_binary);
 
-		bounds[0] = MakeBound(should_append ? cur_following_bound : cur_leading_bound);
-		bounds[1] = MakeBound(should_append ? cur_leading_bound : cur_following_bound);
+		/* Grow arrays of boundaries if needed */
+		if (nparts >= nparts_allocated)
+		{
+			nparts_allocated *= 2;
+			start_bounds = repalloc(start_bounds, nparts_allocated * sizeof(Bound));
+			end_bounds = repalloc(end_bounds, nparts_allocated * sizeof(Bound));
+		}
 
-		last_partition = create_single_range_partition_internal(parent_relid,
-																&bounds[0], &bounds[1],
-																range_bound_type,
-																NULL, NULL);
+		start_bounds[nparts] = MakeBound(should_append ?
+											cur_following_bound :
+											cur_leading_bound);
+		end_bounds[nparts] = MakeBound(should_append ?
+											cur_leading_bound :
+											cur_following_bound);
+		nparts++;
 
 #ifdef USE_ASSERT_CHECKING
 		elog(DEBUG2, "%s partition with following='%s' & leading='%s' [%u]",
@@ -563,7 +820,29 @@ spawn_partitions_val(Oid parent_relid,				/* parent's Oid */
 #endif
 	}
 
-	return last_partition;
+	/* Shouldn't happen, we've already checked 'value' */
+	if (nparts == 0)
+		return InvalidOid;
+
+	/* Let concurrent backends wait for us instead of the lock */
+	flights = launch_partition_flights(parent_relid,
+									   start_bounds, end_bounds,
+									   range_bound_type,
+									   nparts);
+
+	partition_relids = palloc(nparts * sizeof(Oid));
+
+	/* Create all partitions at once, the last one will store 'value' */
+	create_range_partitions_bulk(parent_relid,
+								 start_bounds, end_bounds,
+								 range_bound_type,
+								 NULL, NULL,
+								 nparts, partition_relids);
+
+	/* Waiters will get these Oids when we commit */
+	set_partition_flights_result(flights, partition_relids, nparts);
+
+	return partition_relids[nparts - 1];
 }
 
 /* Choose a good name for a RANGE partition */
@@ -634,20 +913,27 @@ choose_hash_partition_name(Oid parent_relid, uint32 part_idx)
 	return psprintf("%s_%u", get_rel_name(parent_relid), part_idx);
 }
 
-/* Create a partition-like table (no constraints yet) */
-static Oid
-create_single_partition_internal(Oid parent_relid,
-								 RangeVar *partition_rv,
-								 char *tablespace,
-								 char **partitioned_column) /* to be set */
+/*
+ * Create 'nparts' partition-like tables (no constraints yet).
+ *
+ * Returns palloc'ed array of their Oids.
+ */
+static Oid *
+create_partition_tables(Oid parent_relid,
+						RangeVar **partition_rvs,
+						char **tablespaces, /* might be NULL */
+						int nparts,
+						char **partitioned_column) /* to be set */
 {
-	/* Value to be returned */
-	Oid					partition_relid = InvalidOid; /* safety */
+	/* Values to be returned */
+	Oid				   *partition_relids;
 
-	/* Parent's namespace and name */
+	/* Parent's namespace, name and owner */
 	Oid					parent_nsp;
 	char			   *parent_name,
-					   *parent_nsp_name;
+					   *parent_nsp_name,
+					   *parent_tablespace = NULL;
+	Oid					child_relowner;
 
 	/* Values extracted from PATHMAN_CONFIG */
 	Datum				config_values[Natts_pathman_config];
@@ -656,9 +942,7 @@ create_single_partition_internal(Oid parent_relid,
 	/* Elements of the "CREATE TABLE" query tree */
 	RangeVar		   *parent_rv;
 	TableLikeClause		like_clause;
-	CreateStmt			create_stmt;
-	List			   *create_stmts;
-	ListCell		   *lc;
+	int					i;
 
 	/* Current user and security context */
 	Oid					save_userid;
@@ -676,11 +960,14 @@ create_single_partition_internal(Oid parent_relid,
 		elog(ERROR, "table \"%s\" is not partitioned",
 			 get_rel_name_or_relid(parent_relid));
 
-	/* Cache parent's namespace and name */
+	/* Cache parent's namespace, name and owner */
 	parent_name = get_rel_name(parent_relid);
 	parent_nsp = get_rel_namespace(parent_relid);
 	parent_nsp_name = get_namespace_name(parent_nsp);
 
+	/* Partitions should have the same owner as the parent */
+	child_relowner = get_rel_owner(parent_relid);
+
 	/* Fetch partitioned column's name */
 	if (partitioned_column)
 	{
@@ -693,12 +980,6 @@ create_single_partition_internal(Oid parent_relid,
 	/* Make up parent's RangeVar */
 	parent_rv = makeRangeVar(parent_nsp_name, parent_name, -1);
 
-	Assert(partition_rv);
-
-	/* If no 'tablespace' is provided, get parent's tablespace */
-	if (!tablespace)
-		tablespace = get_tablespace_name(get_rel_tablespace(parent_relid));
-
 	/* Initialize TableLikeClause structure */
 	NodeSetTag(&like_clause, T_TableLikeClause);
 	like_clause.relation		= copyObject(parent_rv);
@@ -706,22 +987,6 @@ create_single_partition_internal(Oid parent_relid,
 								  CREATE_TABLE_LIKE_INDEXES |
 								  CREATE_TABLE_LIKE_STORAGE;
 
-	/* Initialize CreateStmt structure */
-	NodeSetTag(&create_stmt, T_CreateStmt);
-	create_stmt.relation		= copyObject(partition_rv);
-	create_stmt.tableElts		= list_make1(copyObject(&like_clause));
-	create_stmt.inhRelations	= list_make1(copyObject(parent_rv));
-	create_stmt.ofTypename		= NULL;
-	create_stmt.constraints		= NIL;
-	create_stmt.options			= NIL;
-	create_stmt.oncommit		= ONCOMMIT_NOOP;
-	create_stmt.tablespacename	= tablespace;
-	create_stmt.if_not_exists	= false;
-
-#if defined(PGPRO_EE) && PG_VERSION_NUM >= 90600
-	create_stmt.partition_info	= NULL;
-#endif
-
 	/* Do we have to escalate privileges? */
 	if (need_priv_escalation)
 	{
@@ -743,65 +1008,100 @@ create_single_partition_internal(Oid parent_relid,
 							   save_sec_context | SECURITY_LOCAL_USERID_CHANGE);
 	}
 
-	/* Generate columns using the parent table */
-	create_stmts = transformCreateStmt(&create_stmt, NULL);
+	partition_relids = palloc(nparts * sizeof(Oid));
 
-	/* Create the partition and all required relations */
-	foreach (lc, create_stmts)
+	for (i = 0; i < nparts; i++)
 	{
-		Node *cur_stmt;
+		CreateStmt			create_stmt;
+		List			   *create_stmts;
+		ListCell		   *lc;
+		char			   *tablespace = tablespaces ? tablespaces[i] : NULL;
 
-		/* Fetch current CreateStmt */
-		cur_stmt = (Node *) lfirst(lc);
+		Assert(partition_rvs[i]);
 
-		if (IsA(cur_stmt, CreateStmt))
+		/* If no 'tablespace' is provided, get parent's tablespace */
+		if (!tablespace)
 		{
-			Oid child_relowner;
+			if (!parent_tablespace)
+				parent_tablespace = get_tablespace_name(get_rel_tablespace(parent_relid));
 
-			/* Partition should have the same owner as the parent */
-			child_relowner = get_rel_owner(parent_relid);
+			tablespace = parent_tablespace;
+		}
 
-			/* Create a partition and save its Oid */
-			partition_relid = create_table_using_stmt((CreateStmt *) cur_stmt,
-													  child_relowner).objectId;
+		/* Initialize CreateStmt structure */
+		NodeSetTag(&create_stmt, T_CreateStmt);
+		create_stmt.relation		= copyObject(partition_rvs[i]);
+		create_stmt.tableElts		= list_make1(copyObject(&like_clause));
+		create_stmt.inhRelations	= list_make1(copyObject(parent_rv));
+		create_stmt.ofTypename		= NULL;
+		create_stmt.constraints		= NIL;
+		create_stmt.options			= NIL;
+		create_stmt.oncommit		= ONCOMMIT_NOOP;
+		create_stmt.tablespacename	= tablespace;
+		create_stmt.if_not_exists	= false;
 
-			/* Copy FOREIGN KEYS of the parent table */
-			copy_foreign_keys(parent_relid, partition_relid);
+#if defined(PGPRO_EE) && PG_VERSION_NUM >= 90600
+		create_stmt.partition_info	= NULL;
+#endif
 
-			/* Make changes visible */
-			CommandCounterIncrement();
+		/* Generate columns using the parent table */
+		create_stmts = transformCreateStmt(&create_stmt, NULL);
 
-			/* Copy ACL privileges of the parent table and set "attislocal" */
-			postprocess_child_table_and_atts(parent_relid, partition_relid);
-		}
-		else if (IsA(cur_stmt, CreateForeignTableStmt))
-		{
-			elog(ERROR, "FDW partition creation is not implemented yet");
-		}
-		else
+		/* Create the partition and all required relations */
+		foreach (lc, create_stmts)
 		{
-			/*
-			 * Recurse for anything else.  Note the recursive
-			 * call will stash the objects so created into our
-			 * event trigger context.
-			 */
-			ProcessUtility(cur_stmt,
-						   "we have to provide a query string",
-						   PROCESS_UTILITY_SUBCOMMAND,
-						   NULL,
-						   None_Receiver,
-						   NULL);
-		}
+			Node *cur_stmt;
+
+			/* Fetch current CreateStmt */
+			cur_stmt = (Node *) lfirst(lc);
 
-		/* Update config one more time */
-		CommandCounterIncrement();
+			if (IsA(cur_stmt, CreateStmt))
+			{
+				/* Create a partition and save its Oid */
+				partition_relids[i] = create_table_using_stmt((CreateStmt *) cur_stmt,
+															  child_relowner).objectId;
+			}
+			else if (IsA(cur_stmt, CreateForeignTableStmt))
+			{
+				elog(ERROR, "FDW partition creation is not implemented yet");
+			}
+			else
+			{
+				/*
+				 * Recurse for anything else.  Note the recursive
+				 * call will stash the objects so created into our
+				 * event trigger context.
+				 */
+				ProcessUtility(cur_stmt,
+							   "we have to provide a query string",
+							   PROCESS_UTILITY_SUBCOMMAND,
+							   NULL,
+							   None_Receiver,
+							   NULL);
+			}
+
+			/* Update config one more time */
+			CommandCounterIncrement();
+		}
 	}
 
+	/* Copy FOREIGN KEYS of the parent table */
+	copy_foreign_keys(parent_relid, partition_relids, nparts);
+
+	/* Make changes visible */
+	CommandCounterIncrement();
+
+	/* Copy ACL privileges of the parent table and set "attislocal" */
+	postprocess_child_table_and_atts(parent_relid, partition_relids, nparts);
+
+	/* Make changes visible */
+	CommandCounterIncrement();
+
 	/* Restore user's privileges */
 	if (need_priv_escalation)
 		SetUserIdAndSecContext(save_userid, save_sec_context);
 
-	return partition_relid;
+	return partition_relids;
 }
 
 /* Create a new table using cooked CreateStmt */
@@ -854,7 +1154,9 @@ create_table_using_stmt(CreateStmt *create_stmt, Oid relowner)
 
 /* Copy ACL privileges of parent table and set "attislocal" = true */
 static void
-postprocess_child_table_and_atts(Oid parent_relid, Oid partition_relid)
+postprocess_child_table_and_atts(Oid parent_relid,
+								 Oid *partition_relids,
+								 int nparts)
 {
 	Relation		pg_class_rel,
 					pg_attribute_rel;
@@ -870,6 +1172,7 @@ postprocess_child_table_and_atts(Oid parent_relid, Oid partition_relid)
 	bool			acl_null;
 
 	Snapshot		snapshot;
+	int				i;
 
 	pg_class_rel = heap_open(RelationRelationId, RowExclusiveLock);
 	pg_attribute_rel = heap_open(AttributeRelationId, RowExclusiveLock);
@@ -900,42 +1203,45 @@ postprocess_child_table_and_atts(Oid parent_relid, Oid partition_relid)
 	/* Release 'htup' */
 	ReleaseSysCache(htup);
 
-	/* Search for 'partition_relid' */
-	ScanKeyInit(&skey[0],
-				ObjectIdAttributeNumber,
-				BTEqualStrategyNumber, F_OIDEQ,
-				ObjectIdGetDatum(partition_relid));
-
-	scan = systable_beginscan(pg_class_rel, ClassOidIndexId,
-							  true, snapshot, 1, skey);
-
-	/* There should be exactly one tuple (our child) */
-	if (HeapTupleIsValid(htup = systable_getnext(scan)))
+	/* Update children's ACLs one by one */
+	for (i = 0; i < nparts; i++)
 	{
-		ItemPointerData		iptr;
-		Datum				values[Natts_pg_class] = { (Datum) 0 };
-		bool				nulls[Natts_pg_class] = { false };
-		bool				replaces[Natts_pg_class] = { false };
+		/* Search for current partition */
+		ScanKeyInit(&skey[0],
+					ObjectIdAttributeNumber,
+					BTEqualStrategyNumber, F_OIDEQ,
+					ObjectIdGetDatum(partition_relids[i]));
+
+		scan = systable_beginscan(pg_class_rel, ClassOidIndexId,
+								  true, snapshot, 1, skey);
 
-		/* Copy ItemPointer of this tuple */
-		iptr = htup->t_self;
+		/* There should be exactly one tuple (our child) */
+		if (HeapTupleIsValid(htup = systable_getnext(scan)))
+		{
+			ItemPointerData		iptr;
+			Datum				values[Natts_pg_class] = { (Datum) 0 };
+			bool				nulls[Natts_pg_class] = { false };
+			bool				replaces[Natts_pg_class] = { false };
 
-		values[Anum_pg_class_relacl - 1] = acl_datum;	/* ACL array */
-		nulls[Anum_pg_class_relacl - 1] = acl_null;		/* do we have ACL? */
-		replaces[Anum_pg_class_relacl - 1] = true;
+			/* Copy ItemPointer of this tuple */
+			iptr = htup->t_self;
 
-		/* Build new tuple with parent's ACL */
-		htup = heap_modify_tuple(htup, pg_class_desc, values, nulls, replaces);
+			values[Anum_pg_class_relacl - 1] = acl_datum;	/* ACL array */
+			nulls[Anum_pg_class_relacl - 1] = acl_null;		/* do we have ACL? */
+			replaces[Anum_pg_class_relacl - 1] = true;
 
-		/* Update child's tuple */
-		simple_heap_update(pg_class_rel, &iptr, htup);
+			/* Build new tuple with parent's ACL */
+			htup = heap_modify_tuple(htup, pg_class_desc, values, nulls, replaces);
 
-		/* Don't forget to update indexes */
-		CatalogUpdateIndexes(pg_class_rel, htup);
-	}
+			/* Update child's tuple */
+			simple_heap_update(pg_class_rel, &iptr, htup);
 
-	systable_endscan(scan);
+			/* Don't forget to update indexes */
+			CatalogUpdateIndexes(pg_class_rel, htup);
+		}
 
+		systable_endscan(scan);
+	}
 
 	/* Search for 'parent_relid's columns */
 	ScanKeyInit(&skey[0],
@@ -984,55 +1290,59 @@ postprocess_child_table_and_atts(Oid parent_relid, Oid partition_relid)
 												pg_attribute_desc, &cur_attnum_null));
 		Assert(cur_attnum_null == false); /* must not be NULL! */
 
-		/* Search for 'partition_relid' */
-		ScanKeyInit(&subskey[0],
-					Anum_pg_attribute_attrelid,
-					BTEqualStrategyNumber, F_OIDEQ,
-					ObjectIdGetDatum(partition_relid));
-
-		/* Search for 'partition_relid's columns */
-		ScanKeyInit(&subskey[1],
-					Anum_pg_attribute_attnum,
-					BTEqualStrategyNumber, F_INT2EQ,
-					Int16GetDatum(cur_attnum));
-
-		subscan = systable_beginscan(pg_attribute_rel,
-									 AttributeRelidNumIndexId,
-									 true, snapshot, 2, subskey);
-
-		/* There should be exactly one tuple (our child's column) */
-		if (HeapTupleIsValid(subhtup = systable_getnext(subscan)))
+		/* Update this column in each partition */
+		for (i = 0; i < nparts; i++)
 		{
-			ItemPointerData		iptr;
-			Datum				values[Natts_pg_attribute] = { (Datum) 0 };
-			bool				nulls[Natts_pg_attribute] = { false };
-			bool				replaces[Natts_pg_attribute] = { false };
+			/* Search for current partition */
+			ScanKeyInit(&subskey[0],
+						Anum_pg_attribute_attrelid,
+						BTEqualStrategyNumber, F_OIDEQ,
+						ObjectIdGetDatum(partition_relids[i]));
+
+			/* Search for its column */
+			ScanKeyInit(&subskey[1],
+						Anum_pg_attribute_attnum,
+						BTEqualStrategyNumber, F_INT2EQ,
+						Int16GetDatum(cur_attnum));
+
+			subscan = systable_beginscan(pg_attribute_rel,
+										 AttributeRelidNumIndexId,
+										 true, snapshot, 2, subskey);
+
+			/* There should be exactly one tuple (our child's column) */
+			if (HeapTupleIsValid(subhtup = systable_getnext(subscan)))
+			{
+				ItemPointerData		iptr;
+				Datum				values[Natts_pg_attribute] = { (Datum) 0 };
+				bool				nulls[Natts_pg_attribute] = { false };
+				bool				replaces[Natts_pg_attribute] = { false };
 
-			/* Copy ItemPointer of this tuple */
-			iptr = subhtup->t_self;
+				/* Copy ItemPointer of this tuple */
+				iptr = subhtup->t_self;
 
-			/* Change ACL of this column */
-			values[Anum_pg_attribute_attacl - 1] = acl_datum;	/* ACL array */
-			nulls[Anum_pg_attribute_attacl - 1] = acl_null;		/* do we have ACL? */
-			replaces[Anum_pg_attribute_attacl - 1] = true;
+				/* Change ACL of this column */
+				values[Anum_pg_attribute_attacl - 1] = acl_datum;	/* ACL array */
+				nulls[Anum_pg_attribute_attacl - 1] = acl_null;		/* do we have ACL? */
+				replaces[Anum_pg_attribute_attacl - 1] = true;
 
-			/* Change 'attislocal' for DROP COLUMN */
-			values[Anum_pg_attribute_attislocal - 1] = false;	/* should not be local */
-			nulls[Anum_pg_attribute_attislocal - 1] = false;	/* NOT NULL */
-			replaces[Anum_pg_attribute_attislocal - 1] = true;
+				/* Change 'attislocal' for DROP COLUMN */
+				values[Anum_pg_attribute_attislocal - 1] = false;	/* should not be local */
+				nulls[Anum_pg_attribute_attislocal - 1] = false;	/* NOT NULL */
+				replaces[Anum_pg_attribute_attislocal - 1] = true;
 
-			/* Build new tuple with parent's ACL */
-			subhtup = heap_modify_tuple(subhtup, pg_attribute_desc,
-										values, nulls, replaces);
+				/* Build new tuple with parent's ACL */
+				subhtup = heap_modify_tuple(subhtup, pg_attribute_desc,
+											values, nulls, replaces);
 
-			/* Update child's tuple */
-			simple_heap_update(pg_attribute_rel, &iptr, subhtup);
+				/* Update child's tuple */
+				simple_heap_update(pg_attribute_rel, &iptr, subhtup);
 
-			/* Don't forget to update indexes */
-			CatalogUpdateIndexes(pg_attribute_rel, subhtup);
-		}
+				/* Don't forget to update indexes */
+				CatalogUpdateIndexes(pg_attribute_rel, subhtup);
+			}
 
-		systable_endscan(subscan);
+			systable_endscan(subscan);
+		}
 	}
 
 	systable_endscan(scan);
@@ -1046,13 +1356,27 @@ postprocess_child_table_and_atts(Oid parent_relid, Oid partition_relid)
 
 /* Copy foreign keys of parent table */
 static void
-copy_foreign_keys(Oid parent_relid, Oid partition_oid)
+copy_foreign_keys(Oid parent_relid, Oid *partition_relids, int nparts)
 {
 	Oid						copy_fkeys_proc_args[] = { REGCLASSOID, REGCLASSOID };
 	List				   *copy_fkeys_proc_name;
 	FmgrInfo				copy_fkeys_proc_flinfo;
 	FunctionCallInfoData	copy_fkeys_proc_fcinfo;
 	char					*pathman_schema;
+	HeapTuple				htup;
+	bool					parent_has_triggers;
+	int						i;
+
+	htup = SearchSysCache1(RELOID, ObjectIdGetDatum(parent_relid));
+	if (!HeapTupleIsValid(htup))
+		elog(ERROR, "cache lookup failed for relation %u", parent_relid);
+
+	parent_has_triggers = ((Form_pg_class) GETSTRUCT(htup))->relhastriggers;
+	ReleaseSysCache(htup);
+
+	/* Each FOREIGN KEY has RI triggers, so there's nothing to copy */
+	if (!parent_has_triggers)
+		return;
 
 	/* Fetch pg_pathman's schema */
 	pathman_schema = get_namespace_name(get_pathman_schema());
@@ -1066,15 +1390,18 @@ copy_foreign_keys(Oid parent_relid, Oid partition_oid)
 							 copy_fkeys_proc_args, false),
 			  &copy_fkeys_proc_flinfo);
 
-	InitFunctionCallInfoData(copy_fkeys_proc_fcinfo, &copy_fkeys_proc_flinfo,
-							 2, InvalidOid, NULL, NULL);
-	copy_fkeys_proc_fcinfo.arg[0] = ObjectIdGetDatum(parent_relid);
-	copy_fkeys_proc_fcinfo.argnull[0] = false;
-	copy_fkeys_proc_fcinfo.arg[1] = ObjectIdGetDatum(partition_oid);
-	copy_fkeys_proc_fcinfo.argnull[1] = false;
-
-	/* Invoke the callback */
-	FunctionCallInvoke(&copy_fkeys_proc_fcinfo);
+	for (i = 0; i < nparts; i++)
+	{
+		InitFunctionCallInfoData(copy_fkeys_proc_fcinfo, &copy_fkeys_proc_flinfo,
+								 2, InvalidOid, NULL, NULL);
+		copy_fkeys_proc_fcinfo.arg[0] = ObjectIdGetDatum(parent_relid);
+		copy_fkeys_proc_fcinfo.argnull[0] = false;
+		copy_fkeys_proc_fcinfo.arg[1] = ObjectIdGetDatum(partition_relids[i]);
+		copy_fkeys_proc_fcinfo.argnull[1] = false;
+
+		/* Invoke the callback */
+		FunctionCallInvoke(&copy_fkeys_proc_fcinfo);
+	}
 }
 
 
@@ -1223,9 +1550,7 @@ check_range_available(Oid parent_relid,
 	shout_if_prel_is_invalid(parent_relid, prel, PT_RANGE);
 
 	/* Fetch comparison function */
-	fill_type_cmp_fmgr_info(&cmp_func,
-							getBaseType(value_type),
-							getBaseType(prel->atttype));
+	fill_prel_cmp_fmgr_info(&cmp_func, value_type, prel);
 
 	ranges = PrelGetRangesArray(prel);
 	for (i = 0; i < PrelChildrenCount(prel); i++)
@@ -27,6 +27,9 @@ Oid create_partitions_for_value(Oid relid, Datum value, Oid value_type);
 Oid create_partitions_for_value_internal(Oid relid, Datum value, Oid value_type,
 										 bool is_background_worker);
 
+/* Create RANGE partitions ahead of time */
+Oid premake_range_partitions(Oid relid, int premake);
+
 
 /* Create one RANGE partition */
 Oid create_single_range_partition_internal(Oid parent_relid,
@@ -36,13 +39,22 @@ Oid create_single_range_partition_internal(Oid parent_relid,
 										   RangeVar *partition_rv,
 										   char *tablespace);
 
-/* Create one HASH partition */
-Oid create_single_hash_partition_internal(Oid parent_relid,
-										  uint32 part_idx,
-										  uint32 part_count,
-										  Oid value_type,
-										  RangeVar *partition_rv,
-										  char *tablespace);
+/* Create several RANGE partitions at once */
+Oid create_range_partitions_bulk(Oid parent_relid,
+								 const Bound *start_values,
+								 const Bound *end_values,
+								 Oid value_type,
+								 RangeVar **partition_rvs,
+								 char **tablespaces,
+								 int nparts,
+								 Oid *partition_relids);
+
+/* Create all HASH partitions at once */
+void create_hash_partitions_bulk(Oid parent_relid,
+								 uint32 part_count,
+								 Oid value_type,
+								 RangeVar **partition_rvs,
+								 char **tablespaces);
 
 
 /* RANGE constraints */
@@ -0,0 +1,462 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_flight.c
+ *		Shared registry of RANGE partitions which are being created
+ *		right now, used to avoid concurrent creation of the same ones
+ *
+ * When lots of backends need a missing partition at the same moment
+ * (e.g. a new day has begun), the first one to take the lock on the
+ * parent registers the ranges it is going to create ("flights").
+ * Others find a matching flight and sleep on the creator's transaction
+ * instead of locking the parent and looking for partitions again.
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "partition_flight.h"
+#include "pathman.h"
+#include "pathman_workers.h"
+#include "utils.h"
+
+#include "access/xact.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lmgr.h"
+#include "storage/shmem.h"
+#include "utils/datum.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+
+
+/* Flight owned by current backend */
+typedef struct
+{
+	int					idx;	/* index in 'flight_registry' */
+	SubTransactionId	subid;	/* subtransaction which has launched it */
+} OwnedFlight;
+
+
+static PartitionFlightRegistry *flight_registry = NULL;
+
+/* Flights launched by this backend which have not landed yet */
+static OwnedFlight	owned_flights[PART_FLIGHT_SLOTS];
+static int			owned_flights_count = 0;
+
+static bool			flight_callbacks_registered = false;
+
+
+static void free_partition_flight(PartitionFlight *flight);
+static void land_owned_flights(PartitionFlightStatus status,
+							   SubTransactionId min_subid);
+static Oid unpin_partition_flight(int idx);
+static void unpin_partition_flight_callback(int code, Datum arg);
+
+static void partition_flights_xact_callback(XactEvent event, void *arg);
+static void partition_flights_subxact_callback(SubXactEvent event,
+											   SubTransactionId mySubid,
+											   SubTransactionId parentSubid,
+											   void *arg);
+
+
+/*
+ * Estimate amount of shmem needed for the registry of flights.
+ */
+Size
+estimate_partition_flights_size(void)
+{
+	return sizeof(PartitionFlightRegistry);
+}
+
+/*
+ * Initialize shared memory needed for the registry of flights.
+ */
+void
+init_partition_flights(void)
+{
+	bool	found;
+	Size	size = estimate_partition_flights_size();
+
+	flight_registry = (PartitionFlightRegistry *)
+			ShmemInitStruct("pg_pathman's PartitionFlightRegistry", size, &found);
+
+	/* Initialize 'flight_registry' if needed */
+	if (!found)
+	{
+		memset(flight_registry, 0, size);
+		SpinLockInit(&flight_registry->mutex);
+	}
+}
+
+
+/*
+ * --------------------
+ *  Creator's routines
+ * --------------------
+ */
+
+/*
+ * Register 'nparts' partitions which are about to be created by current
+ * transaction. Caller should hold a lock on the parent.
+ *
+ * Returns indices of flights (-1 if there was no free slot for a partition).
+ */
+int *
+launch_partition_flights(Oid parent_relid,
+						 const Bound *start_bounds,
+						 const Bound *end_bounds,
+						 Oid bound_type,
+						 int nparts)
+{
+	int				   *flights = palloc(nparts * sizeof(int));
+	TransactionId		xid = GetCurrentTransactionId();
+	SubTransactionId	subid = GetCurrentSubTransactionId();
+	int16				typlen;
+	bool				typbyval;
+	int					slot = 0,
+						i;
+
+	/* We have to know when current transaction ends */
+	if (!flight_callbacks_registered)
+	{
+		RegisterXactCallback(partition_flights_xact_callback, NULL);
+		RegisterSubXactCallback(partition_flights_subxact_callback, NULL);
+
+		flight_callbacks_registered = true;
+	}
+
+	get_typlenbyval(bound_type, &typlen, &typbyval);
+
+	for (i = 0; i < nparts; i++)
+	{
+		Datum	min,
+				max;
+		Size	min_size,
+				max_size;
+
+		flights[i] = -1;
+
+		/* Spawned partitions are always finite, but let's be careful */
+		if (IsInfinite(&start_bounds[i]) || IsInfinite(&end_bounds[i]))
+			continue;
+
+		min = BoundGetValue(&start_bounds[i]);
+		max = BoundGetValue(&end_bounds[i]);
+
+		min_size = datumGetSize(min, typbyval, typlen);
+		max_size = datumGetSize(max, typbyval, typlen);
+
+		/* Waiters won't be able to see this range */
+		if (min_size > PART_FLIGHT_BOUND_SIZE ||
+			max_size > PART_FLIGHT_BOUND_SIZE)
+			continue;
+
+		SpinLockAcquire(&flight_registry->mutex);
+
+		for (; slot < PART_FLIGHT_SLOTS; slot++)
+		{
+			PartitionFlight *flight = &flight_registry->flights[slot];
+
+			if (flight->status != PF_FREE)
+				continue;
+
+			flight->status		= PF_IN_FLIGHT;
+			flight->nwaiters	= 0;
+			flight->creator_xid	= xid;
+			flight->dbid		= MyDatabaseId;
+			flight->parent		= parent_relid;
+			flight->partition	= InvalidOid;
+			flight->bound_type	= bound_type;
+			flight->bound_byval	= typbyval;
+			flight->min_size	= min_size;
+			flight->max_size	= max_size;
+
+			PackDatumToByteArray((void *) flight->min, min, min_size, typbyval);
+			PackDatumToByteArray((void *) flight->max, max, max_size, typbyval);
+
+			flights[i] = slot;
+			break;
+		}
+
+		SpinLockRelease(&flight_registry->mutex);
+
+		/* No free slots left, others will have to take the lock */
+		if (flights[i] < 0)
+			break;
+
+		owned_flights[owned_flights_count].idx = flights[i];
+		owned_flights[owned_flights_count].subid = subid;
+		owned_flights_count++;
+	}
+
+	return flights;
+}
+
+/*
+ * Save Oids of partitions created by launch_partition_flights()' caller.
+ */
+void
+set_partition_flights_result(const int *flights,
+							 const Oid *partition_relids,
+							 int nparts)
+{
+	int i;
+
+	SpinLockAcquire(&flight_registry->mutex);
+
+	for (i = 0; i < nparts; i++)
+	{
+		if (flights[i] < 0)
+			continue;
+
+		Assert(flight_registry->flights[flights[i]].status == PF_IN_FLIGHT);
+		flight_registry->flights[flights[i]].partition = partition_relids[i];
+	}
+
+	SpinLockRelease(&flight_registry->mutex);
+}
+
+/* Mark slot as unused. Caller should hold the mutex */
+static void
+free_partition_flight(PartitionFlight *flight)
+{
+	flight->status = PF_FREE;
+	flight->generation++;
+}
+
+/*
+ * Finish owned flights launched by subtransactions >= 'min_subid'.
+ * Flights which nobody waits for are freed immediately.
+ */
+static void
+land_owned_flights(PartitionFlightStatus status, SubTransactionId min_subid)
+{
+	int i = 0;
+
+	SpinLockAcquire(&flight_registry->mutex);
+
+	while (i < owned_flights_count)
+	{
+		PartitionFlight *flight;
+
+		if (owned_flights[i].subid < min_subid)
+		{
+			i++;
+			continue;
+		}
+
+		flight = &flight_registry->flights[owned_flights[i].idx];
+		Assert(flight->status == PF_IN_FLIGHT);
+
+		if (flight->nwaiters > 0)
+			flight->status = status;
+		else
+			free_partition_flight(flight);
+
+		/* Forget this flight */
+		owned_flights[i] = owned_flights[--owned_flights_count];
+	}
+
+	SpinLockRelease(&flight_registry->mutex);
+}
+
+/*
+ * Land owned flights before transaction's locks are released,
+ * so that waiters always see the final status.
+ */
+static void
+partition_flights_xact_callback(XactEvent event, void *arg)
+{
+	if (owned_flights_count == 0)
+		return;
+
+	switch (event)
+	{
+		case XACT_EVENT_COMMIT:
+			land_owned_flights(PF_LANDED, InvalidSubTransactionId);
+			break;
+
+		/* Partitions of a prepared xact are not available yet */
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PREPARE:
+			land_owned_flights(PF_CRASHED, InvalidSubTransactionId);
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Partitions created by an aborted subtransaction are gone.
+ */
+static void
+partition_flights_subxact_callback(SubXactEvent event,
+								   SubTransactionId mySubid,
+								   SubTransactionId parentSubid,
+								   void *arg)
+{
+	if (owned_flights_count == 0)
+		return;
+
+	if (event == SUBXACT_EVENT_ABORT_SUB)
+		land_owned_flights(PF_CRASHED, mySubid);
+}
+
+
+/*
+ * -------------------
+ *  Waiter's routines
+ * -------------------
+ */
+
+/*
+ * Wait for some other transaction creating a partition for 'value'.
+ *
+ * Returns Oid of the partition if it has been committed, InvalidOid if
+ * there was no such transaction or it has failed.
+ */
+Oid
+wait_for_partition_flight(Oid parent_relid, Datum value, Oid value_type)
+{
+	const PartRelationInfo *prel;
+	FmgrInfo	cmp_finfo;
+	Oid			cmp_bound_type = InvalidOid,
+				cmp_collid;
+	Oid			partid = InvalidOid;
+	int			i;
+
+	/* Caller will check the parent once again under lock */
+	prel = get_pathman_relation_info(parent_relid);
+	if (!prel)
+		return InvalidOid;
+
+	/* Copy it, since 'prel' might be gone once we start waiting */
+	cmp_collid = prel->attcollid;
+
+	value_type = getBaseType(value_type);
+
+	for (i = 0; i < PART_FLIGHT_SLOTS; i++)
+	{
+		PartitionFlight	   *slot = &flight_registry->flights[i],
+							flight;
+		Datum				min,
+							max;
+		bool				suitable;
+
+		/* Copy flight if it belongs to our parent */
+		SpinLockAcquire(&flight_registry->mutex);
+
+		suitable = (slot->status == PF_IN_FLIGHT || slot->status == PF_LANDED) &&
+				   slot->dbid == MyDatabaseId &&
+				   slot->parent == parent_relid;
+
+		if (suitable)
+			memcpy(&flight, slot, sizeof(PartitionFlight));
+
+		SpinLockRelease(&flight_registry->mutex);
+
+		/* We'd wait for ourselves forever */
+		if (!suitable || TransactionIdIsCurrentTransactionId(flight.creator_xid))
+			continue;
+
+		/* Compare bounds just like partitions are sorted (with column's collation) */
+		if (cmp_bound_type != flight.bound_type)
+		{
+			fill_type_cmp_fmgr_info(&cmp_finfo, value_type, flight.bound_type);
+			fmgr_info(get_collation_free_cmp_proc(cmp_finfo.fn_oid, cmp_collid),
+					  &cmp_finfo);
+			cmp_bound_type = flight.bound_type;
+		}
+
+		UnpackDatumFromByteArray(&min, flight.min_size, flight.bound_byval,
+								 (const void *) flight.min);
+		UnpackDatumFromByteArray(&max, flight.max_size, flight.bound_byval,
+								 (const void *) flight.max);
+
+		/* Is 'value' within [min, max)? */
+		if (check_lt(&cmp_finfo, value, min) ||
+			check_ge(&cmp_finfo, value, max))
+			continue;
+
+		/* Pin flight unless it has been freed in the meantime */
+		SpinLockAcquire(&flight_registry->mutex);
+
+		suitable = slot->generation == flight.generation &&
+				   (slot->status == PF_IN_FLIGHT || slot->status == PF_LANDED);
+
+		if (suitable)
+			slot->nwaiters++;
+
+		SpinLockRelease(&flight_registry->mutex);
+
+		if (!suitable)
+			break;
+
+		elog(DEBUG2, "waiting for transaction %u to create partition of \"%s\" [%u]",
+			 flight.creator_xid, get_rel_name_or_relid(parent_relid), MyProcPid);
+
+		/*
+		 * Sleep until creator's transaction ends. This is a plain lock
+		 * wait, thus deadlocks will be detected as usual.
+		 */
+		PG_ENSURE_ERROR_CLEANUP(unpin_partition_flight_callback,
+								Int32GetDatum(i));
+		{
+			XactLockTableWait(flight.creator_xid, NULL, NULL, XLTW_None);
+		}
+		PG_END_ENSURE_ERROR_CLEANUP(unpin_partition_flight_callback,
+									Int32GetDatum(i));
+
+		partid = unpin_partition_flight(i);
+
+		/* Only one flight could contain 'value' */
+		break;
+	}
+
+	/* Make sure that the partition has not been dropped since then */
+	if (OidIsValid(partid))
+	{
+		AcceptInvalidationMessages();
+
+		if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(partid)))
+			partid = InvalidOid;
+	}
+
+	return partid;
+}
+
+/*
+ * Unpin flight and fetch its result.
+ * The last waiter frees flights which have already landed.
+ */
+static Oid
+unpin_partition_flight(int idx)
+{
+	PartitionFlight	   *flight = &flight_registry->flights[idx];
+	Oid					partid = InvalidOid;
+
+	SpinLockAcquire(&flight_registry->mutex);
+
+	Assert(flight->nwaiters > 0);
+	flight->nwaiters--;
+
+	if (flight->status == PF_LANDED)
+		partid = flight->partition;
+
+	if (flight->status != PF_IN_FLIGHT && flight->nwaiters == 0)
+		free_partition_flight(flight);
+
+	SpinLockRelease(&flight_registry->mutex);
+
+	return partid;
+}
+
+/* Unpin flight if waiter has been interrupted */
+static void
+unpin_partition_flight_callback(int code, Datum arg)
+{
+	(void) unpin_partition_flight(DatumGetInt32(arg));
+}
@@ -0,0 +1,84 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_flight.h
+ *		Shared registry of RANGE partitions which are being created
+ *		right now, used to avoid concurrent creation of the same ones
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PARTITION_FLIGHT_H
+#define PARTITION_FLIGHT_H
+
+
+#include "relation_info.h"
+
+#include "postgres.h"
+#include "storage/spin.h"
+
+
+/* Number of partitions which might be in flight at the same time */
+#define PART_FLIGHT_SLOTS			64
+
+/* Max size of a bound stored in flight (larger ones are not registered) */
+#define PART_FLIGHT_BOUND_SIZE		64
+
+
+typedef enum
+{
+	PF_FREE = 0,	/* slot is empty */
+	PF_IN_FLIGHT,	/* partition is being created by 'creator_xid' */
+	PF_LANDED,		/* 'partition' has been committed */
+	PF_CRASHED		/* creator has rolled back */
+} PartitionFlightStatus;
+
+/*
+ * A RANGE partition [min, max) of 'parent' which is being created by
+ * some transaction. Other backends which need the same partition wait
+ * for this transaction instead of locking the parent and creating it.
+ */
+typedef struct
+{
+	PartitionFlightStatus	status;
+	uint32					generation;		/* changes every time slot is freed */
+	int						nwaiters;		/* backends sleeping on this flight */
+
+	TransactionId			creator_xid;	/* (sub)xact creating 'partition' */
+	Oid						dbid;			/* database of 'parent' */
+	Oid						parent;			/* partitioned table */
+	Oid						partition;		/* InvalidOid until it's created */
+
+	Oid						bound_type;		/* type of 'min' and 'max' */
+	bool					bound_byval;
+	Size					min_size,
+							max_size;
+	uint8					min[PART_FLIGHT_BOUND_SIZE],
+							max[PART_FLIGHT_BOUND_SIZE];
+} PartitionFlight;
+
+typedef struct
+{
+	slock_t					mutex;			/* protects all flights */
+	PartitionFlight			flights[PART_FLIGHT_SLOTS];
+} PartitionFlightRegistry;
+
+
+Size estimate_partition_flights_size(void);
+void init_partition_flights(void);
+
+int *launch_partition_flights(Oid parent_relid,
+							  const Bound *start_bounds,
+							  const Bound *end_bounds,
+							  Oid bound_type,
+							  int nparts);
+
+void set_partition_flights_result(const int *flights,
+								  const Oid *partition_relids,
+								  int nparts);
+
+Oid wait_for_partition_flight(Oid parent_relid, Datum value, Oid value_type);
+
+
+#endif /* PARTITION_FLIGHT_H */
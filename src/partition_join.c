@@ -0,0 +1,478 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_join.c
+ *		Partition-wise join of identically partitioned tables
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "partition_join.h"
+#include "pg_compat.h"
+#include "relation_info.h"
+#include "utils.h"
+
+#include "nodes/nodeFuncs.h"
+#include "optimizer/cost.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/prep.h"
+#include "optimizer/tlist.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/typcache.h"
+
+
+bool				pg_pathman_enable_partitionwise_join = false;
+
+
+/*
+ * Planner's view of a single partition (see append_child_relation()).
+ */
+typedef struct
+{
+	Oid				child_oid;		/* key */
+	RelOptInfo	   *child_rel;
+	AppendRelInfo  *appinfo;
+} PartitionRelEntry;
+
+
+static const PartRelationInfo *get_joined_prel(PlannerInfo *root,
+											   RelOptInfo *rel);
+
+static bool partitioning_schemes_match(const PartRelationInfo *prel1,
+									   const PartRelationInfo *prel2);
+
+static bool bounds_are_equal(FmgrInfo *cmp_func,
+							 const Bound *b1,
+							 const Bound *b2);
+
+static bool have_partitioned_column_equijoin(List *restrictlist,
+											 RelOptInfo *outerrel,
+											 const PartRelationInfo *outer_prel,
+											 RelOptInfo *innerrel,
+											 const PartRelationInfo *inner_prel);
+
+static bool rel_target_is_plain(RelOptInfo *rel);
+
+static HTAB *build_partition_rels_table(PlannerInfo *root, RelOptInfo *rel);
+
+static Path *create_partition_pair_path(PlannerInfo *root,
+										RelOptInfo *joinrel,
+										PartitionRelEntry *outer_part,
+										PartitionRelEntry *inner_part,
+										JoinType jointype,
+										JoinPathExtraData *extra);
+
+
+void
+init_partition_join_static_data(void)
+{
+	DefineCustomBoolVariable("pg_pathman.enable_partitionwise_join",
+							 "Enables partition-wise join of identically partitioned tables.",
+							 NULL,
+							 &pg_pathman_enable_partitionwise_join,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+}
+
+
+/*
+ * Join matching partitions of two identically partitioned tables
+ * pairwise and add an Append of these joins to 'joinrel'.
+ *
+ * Each pair is joined using a HashJoin, so hash tables are built
+ * for a single partition instead of the whole inner table.
+ */
+void
+add_partitionwise_join_path(PlannerInfo *root,
+							RelOptInfo *joinrel,
+							RelOptInfo *outerrel,
+							RelOptInfo *innerrel,
+							JoinType jointype,
+							JoinPathExtraData *extra)
+{
+	const PartRelationInfo *outer_prel,
+						   *inner_prel;
+	HTAB				   *outer_parts,
+						   *inner_parts;
+	Oid					   *outer_children,
+						   *inner_children;
+	List				   *subpaths = NIL;
+	bool					give_up = false;
+	uint32					i;
+
+	/* Outer tuples w/o a matching partition would be lost otherwise */
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT)
+		return;
+
+	/* Both sides should be tables partitioned by pg_pathman */
+	if (!(outer_prel = get_joined_prel(root, outerrel)) ||
+		!(inner_prel = get_joined_prel(root, innerrel)))
+		return;
+
+	if (!partitioning_schemes_match(outer_prel, inner_prel))
+		return;
+
+	/* Tuples of a pair of partitions should match only each other */
+	if (!have_partitioned_column_equijoin(extra->restrictlist,
+										  outerrel, outer_prel,
+										  innerrel, inner_prel))
+		return;
+
+	/* We don't know how to translate PlaceHolderVars */
+	if (!rel_target_is_plain(joinrel))
+		return;
+
+	outer_parts = build_partition_rels_table(root, outerrel);
+	inner_parts = build_partition_rels_table(root, innerrel);
+
+	outer_children = PrelGetChildrenArray(outer_prel);
+	inner_children = PrelGetChildrenArray(inner_prel);
+
+	for (i = 0; i < PrelChildrenCount(outer_prel); i++)
+	{
+		PartitionRelEntry  *outer_part,
+						   *inner_part;
+		Path			   *pair_path;
+
+		outer_part = (PartitionRelEntry *) hash_search(outer_parts,
+													   &outer_children[i],
+													   HASH_FIND, NULL);
+		inner_part = (PartitionRelEntry *) hash_search(inner_parts,
+													   &inner_children[i],
+													   HASH_FIND, NULL);
+
+		/* Outer partition has been excluded, nothing to join */
+		if (!outer_part)
+			continue;
+
+		if (!inner_part)
+		{
+			/* Inner join of this pair is empty */
+			if (jointype == JOIN_INNER)
+				continue;
+
+			/* LEFT JOIN would have to emit outer tuples as is */
+			give_up = true;
+			break;
+		}
+
+		pair_path = create_partition_pair_path(root, joinrel,
+											   outer_part, inner_part,
+											   jointype, extra);
+		if (!pair_path)
+		{
+			give_up = true;
+			break;
+		}
+
+		subpaths = lappend(subpaths, pair_path);
+	}
+
+	hash_destroy(outer_parts);
+	hash_destroy(inner_parts);
+
+	if (give_up || subpaths == NIL)
+		return;
+
+	add_path(joinrel, (Path *) create_append_path_compat(joinrel, subpaths,
+														 NULL, 0));
+}
+
+
+/*
+ * Fetch PartRelationInfo if 'rel' is a partitioned table
+ * which is suitable for partition-wise join.
+ */
+static const PartRelationInfo *
+get_joined_prel(PlannerInfo *root, RelOptInfo *rel)
+{
+	RangeTblEntry		   *rte;
+	const PartRelationInfo *prel;
+
+	if (rel->reloptkind != RELOPT_BASEREL)
+		return NULL;
+
+	/* Pairs of partitions can't reference other relations */
+	if (!bms_is_empty(rel->lateral_relids))
+		return NULL;
+
+	rte = root->simple_rte_array[rel->relid];
+	if (!rte->inh || !(prel = get_pathman_relation_info(rte->relid)))
+		return NULL;
+
+	/* Parent's tuples don't belong to any partition */
+	if (prel->enable_parent)
+		return NULL;
+
+	return prel;
+}
+
+/*
+ * Check that i-th partitions of both tables contain the same keys.
+ */
+static bool
+partitioning_schemes_match(const PartRelationInfo *prel1,
+						   const PartRelationInfo *prel2)
+{
+	if (prel1->parttype != prel2->parttype)
+		return false;
+
+	if (prel1->atttype != prel2->atttype ||
+		prel1->attcollid != prel2->attcollid)
+		return false;
+
+	if (PrelChildrenCount(prel1) != PrelChildrenCount(prel2))
+		return false;
+
+	switch (prel1->parttype)
+	{
+		case PT_HASH:
+			return prel1->hash_proc == prel2->hash_proc;
+
+		case PT_RANGE:
+			{
+				RangeEntry *ranges1 = PrelGetRangesArray(prel1),
+						   *ranges2 = PrelGetRangesArray(prel2);
+				FmgrInfo	cmp_func;
+				uint32		i;
+
+				fmgr_info(prel1->cmp_proc, &cmp_func);
+
+				for (i = 0; i < PrelChildrenCount(prel1); i++)
+				{
+					if (!bounds_are_equal(&cmp_func,
+										  &ranges1[i].min,
+										  &ranges2[i].min) ||
+						!bounds_are_equal(&cmp_func,
+										  &ranges1[i].max,
+										  &ranges2[i].max))
+						return false;
+				}
+			}
+			return true;
+
+		default:
+			elog(ERROR, "Unknown partitioning type %u", prel1->parttype);
+			return false; /* keep compiler happy */
+	}
+}
+
+static bool
+bounds_are_equal(FmgrInfo *cmp_func, const Bound *b1, const Bound *b2)
+{
+	if (IsInfinite(b1) || IsInfinite(b2))
+		return b1->is_infinite == b2->is_infinite;
+
+	return cmp_bounds(cmp_func, b1, b2) == 0;
+}
+
+/*
+ * Look for 'outer.key = inner.key' among join clauses.
+ */
+static bool
+have_partitioned_column_equijoin(List *restrictlist,
+								 RelOptInfo *outerrel,
+								 const PartRelationInfo *outer_prel,
+								 RelOptInfo *innerrel,
+								 const PartRelationInfo *inner_prel)
+{
+	TypeCacheEntry *tce = lookup_type_cache(outer_prel->atttype,
+											TYPECACHE_EQ_OPR);
+	ListCell	   *lc;
+
+	if (!OidIsValid(tce->eq_opr))
+		return false;
+
+	foreach (lc, restrictlist)
+	{
+		RestrictInfo   *rinfo = (RestrictInfo *) lfirst(lc);
+		OpExpr		   *expr = (OpExpr *) rinfo->clause;
+		Node		   *left,
+					   *right;
+
+		if (!IsA(expr, OpExpr) || list_length(expr->args) != 2)
+			continue;
+
+		if (expr->opno != tce->eq_opr)
+			continue;
+
+		left = (Node *) linitial(expr->args);
+		right = (Node *) lsecond(expr->args);
+
+		if ((is_partitioned_column(left, outerrel->relid, outer_prel) &&
+			 is_partitioned_column(right, innerrel->relid, inner_prel)) ||
+			(is_partitioned_column(left, innerrel->relid, inner_prel) &&
+			 is_partitioned_column(right, outerrel->relid, outer_prel)))
+			return true;
+	}
+
+	return false;
+}
+
+/* Does target list of 'rel' consist of Vars only? */
+static bool
+rel_target_is_plain(RelOptInfo *rel)
+{
+	ListCell   *lc;
+
+#if PG_VERSION_NUM >= 90600
+	foreach (lc, rel->reltarget->exprs)
+#else
+	foreach (lc, rel->reltargetlist)
+#endif
+	{
+		if (!IsA(lfirst(lc), Var))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Build a hash table (child Oid => PartitionRelEntry)
+ * of non-excluded partitions of 'rel'.
+ */
+static HTAB *
+build_partition_rels_table(PlannerInfo *root, RelOptInfo *rel)
+{
+	HTAB	   *parts_table;
+	HASHCTL		parts_table_config;
+	ListCell   *lc;
+
+	memset(&parts_table_config, 0, sizeof(HASHCTL));
+	parts_table_config.keysize = sizeof(Oid);
+	parts_table_config.entrysize = sizeof(PartitionRelEntry);
+	parts_table_config.hcxt = CurrentMemoryContext;
+
+	parts_table = hash_create("pg_pathman's partition-wise join storage",
+							  list_length(root->append_rel_list),
+							  &parts_table_config,
+							  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	foreach (lc, root->append_rel_list)
+	{
+		AppendRelInfo	   *appinfo = (AppendRelInfo *) lfirst(lc);
+		RelOptInfo		   *child_rel;
+		PartitionRelEntry  *part;
+		Oid					child_oid;
+
+		if (appinfo->parent_relid != rel->relid)
+			continue;
+
+		child_rel = find_base_rel(root, appinfo->child_relid);
+
+		/* Skip partitions excluded by constraints */
+		if (IS_DUMMY_REL(child_rel))
+			continue;
+
+		child_oid = root->simple_rte_array[appinfo->child_relid]->relid;
+
+		part = (PartitionRelEntry *) hash_search(parts_table, &child_oid,
+												 HASH_ENTER, NULL);
+		part->child_rel = child_rel;
+		part->appinfo = appinfo;
+	}
+
+	return parts_table;
+}
+
+/*
+ * Create a HashJoin of two partitions. The join relation of the pair
+ * is a copy of 'joinrel' with Vars & clauses translated to partitions.
+ */
+static Path *
+create_partition_pair_path(PlannerInfo *root,
+						   RelOptInfo *joinrel,
+						   PartitionRelEntry *outer_part,
+						   PartitionRelEntry *inner_part,
+						   JoinType jointype,
+						   JoinPathExtraData *extra)
+{
+	JoinCostWorkspace	workspace;
+	RelOptInfo		   *outer_child = outer_part->child_rel,
+					   *inner_child = inner_part->child_rel,
+					   *pair_rel;
+	Path			   *outer_path = outer_child->cheapest_total_path,
+					   *inner_path = inner_child->cheapest_total_path;
+	List			   *restrictlist,
+					   *hashclauses = NIL;
+	ListCell		   *lc;
+
+	/* Both partitions should have unparameterized paths */
+	if (!outer_path || PATH_REQ_OUTER(outer_path) ||
+		!inner_path || PATH_REQ_OUTER(inner_path))
+		return NULL;
+
+	/* Translate join clauses to partitions' Vars */
+	restrictlist = (List *) adjust_appendrel_attrs(root,
+												   (Node *) extra->restrictlist,
+												   outer_part->appinfo);
+	restrictlist = (List *) adjust_appendrel_attrs(root,
+												   (Node *) restrictlist,
+												   inner_part->appinfo);
+
+	/* Make a private join relation for this pair */
+	pair_rel = makeNode(RelOptInfo);
+	memcpy(pair_rel, joinrel, sizeof(RelOptInfo));
+
+	pair_rel->relids = bms_union(outer_child->relids, inner_child->relids);
+	pair_rel->pathlist = NIL;
+	pair_rel->ppilist = NIL;
+	pair_rel->cheapest_startup_path = NULL;
+	pair_rel->cheapest_total_path = NULL;
+	pair_rel->cheapest_unique_path = NULL;
+	pair_rel->cheapest_parameterized_paths = NIL;
+#if PG_VERSION_NUM >= 90600
+	pair_rel->partial_pathlist = NIL;
+	pair_rel->reltarget = copy_pathtarget(joinrel->reltarget);
+#endif
+
+	/* Output columns of the pair go in the same order as in 'joinrel' */
+	adjust_rel_targetlist_compat(root, pair_rel, joinrel, outer_part->appinfo);
+	adjust_rel_targetlist_compat(root, pair_rel, pair_rel, inner_part->appinfo);
+
+	set_joinrel_size_estimates(root, pair_rel, outer_child, inner_child,
+							   extra->sjinfo, restrictlist);
+
+	/* Select hashable clauses (see hash_inner_and_outer()) */
+	foreach (lc, restrictlist)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		if (IS_OUTER_JOIN(jointype) && rinfo->is_pushed_down)
+			continue;
+
+		if (!rinfo->can_join || !OidIsValid(rinfo->hashjoinoperator))
+			continue;
+
+		if (bms_is_subset(rinfo->left_relids, outer_child->relids) &&
+			bms_is_subset(rinfo->right_relids, inner_child->relids))
+			rinfo->outer_is_left = true;
+
+		else if (bms_is_subset(rinfo->left_relids, inner_child->relids) &&
+				 bms_is_subset(rinfo->right_relids, outer_child->relids))
+			rinfo->outer_is_left = false;
+
+		else continue;
+
+		hashclauses = lappend(hashclauses, rinfo);
+	}
+
+	if (hashclauses == NIL)
+		return NULL;
+
+	initial_cost_hashjoin(root, &workspace, jointype, hashclauses,
+						  outer_path, inner_path,
+						  extra->sjinfo, &extra->semifactors);
+
+	return (Path *) create_hashjoin_path(root, pair_rel, jointype, &workspace,
+										 extra->sjinfo, &extra->semifactors,
+										 outer_path, inner_path,
+										 restrictlist, NULL, hashclauses);
+}
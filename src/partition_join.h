@@ -0,0 +1,32 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_join.h
+ *		Partition-wise join of identically partitioned tables
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PARTITION_JOIN_H
+#define PARTITION_JOIN_H
+
+
+#include "postgres.h"
+#include "optimizer/paths.h"
+
+
+extern bool pg_pathman_enable_partitionwise_join;
+
+
+void init_partition_join_static_data(void);
+
+void add_partitionwise_join_path(PlannerInfo *root,
+								 RelOptInfo *joinrel,
+								 RelOptInfo *outerrel,
+								 RelOptInfo *innerrel,
+								 JoinType jointype,
+								 JoinPathExtraData *extra);
+
+
+#endif /* PARTITION_JOIN_H */
@@ -0,0 +1,496 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_router.c
+ *		Route UPDATE and DELETE to partitions selected at plan time
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "partition_filter.h"
+#include "partition_router.h"
+
+#include "access/htup_details.h"
+#include "commands/tablecmds.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "parser/parsetree.h"
+#include "storage/lmgr.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+
+bool				pg_pathman_enable_partition_router = true;
+bool				pg_pathman_enable_truncate_on_delete = false;
+
+CustomScanMethods	partition_router_plan_methods;
+CustomExecMethods	partition_router_exec_methods;
+
+
+static ResultRelInfo *open_partition_for_modify(PartitionRouterState *state,
+												RouterPartEntry *entry);
+
+static void truncate_partitions(List *partitions);
+
+static TupleTableSlot *fetch_next_tuple(PartitionRouterState *state,
+										PlanState *child_ps,
+										EState *estate);
+static bool epq_skips_subplan(PlanState *subplan, EState *estate);
+
+static List * prouter_build_tlist(List *tlist);
+
+
+void
+init_partition_router_static_data(void)
+{
+	partition_router_plan_methods.CustomName 			= "PartitionRouter";
+	partition_router_plan_methods.CreateCustomScanState	= partition_router_create_scan_state;
+
+	partition_router_exec_methods.CustomName			= "PartitionRouter";
+	partition_router_exec_methods.BeginCustomScan		= partition_router_begin;
+	partition_router_exec_methods.ExecCustomScan		= partition_router_exec;
+	partition_router_exec_methods.EndCustomScan			= partition_router_end;
+	partition_router_exec_methods.ReScanCustomScan		= partition_router_rescan;
+	partition_router_exec_methods.MarkPosCustomScan		= NULL;
+	partition_router_exec_methods.RestrPosCustomScan	= NULL;
+	partition_router_exec_methods.ExplainCustomScan		= partition_router_explain;
+
+	DefineCustomBoolVariable("pg_pathman.enable_partitionrouter",
+							 "Enables pruning of partitions for UPDATE and DELETE "
+							 "using PartitionRouter custom node.",
+							 NULL,
+							 &pg_pathman_enable_partition_router,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("pg_pathman.enable_truncate_on_delete",
+							 "Allows DELETE to truncate partitions "
+							 "which are fully covered by its WHERE clause.",
+							 NULL,
+							 &pg_pathman_enable_truncate_on_delete,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+}
+
+
+/*
+ * --------------------------------
+ *  PartitionRouter implementation
+ * --------------------------------
+ */
+
+Plan *
+make_partition_router(Plan *subplan, Oid parent_relid,
+					  CmdType command_type,
+					  AttrNumber tableoid_attno,
+					  List *child_rtis,
+					  List *truncated_parts)
+{
+	CustomScan *cscan = makeNode(CustomScan);
+
+	Assert(command_type == CMD_UPDATE || command_type == CMD_DELETE);
+
+	/* Copy costs etc */
+	cscan->scan.plan.startup_cost = subplan->startup_cost;
+	cscan->scan.plan.total_cost = subplan->total_cost;
+	cscan->scan.plan.plan_rows = subplan->plan_rows;
+	cscan->scan.plan.plan_width = subplan->plan_width;
+
+	/* Setup methods and child plan */
+	cscan->methods = &partition_router_plan_methods;
+	cscan->custom_plans = list_make1(subplan);
+
+	/* Junk attributes ('ctid' etc) are looked up by name */
+	cscan->scan.plan.targetlist = prouter_build_tlist(subplan->targetlist);
+
+	/* No physical relation will be scanned */
+	cscan->scan.scanrelid = 0;
+	cscan->custom_scan_tlist = subplan->targetlist;
+
+	/* Pack partitioned table's Oid, command type and partitions */
+	cscan->custom_private = list_make4(makeInteger(parent_relid),
+									   makeInteger(command_type),
+									   makeInteger(tableoid_attno),
+									   child_rtis);
+	cscan->custom_private = lappend(cscan->custom_private, truncated_parts);
+
+	return &cscan->scan.plan;
+}
+
+Node *
+partition_router_create_scan_state(CustomScan *node)
+{
+	PartitionRouterState   *state;
+
+	state = (PartitionRouterState *) palloc0(sizeof(PartitionRouterState));
+	NodeSetTag(state, T_CustomScanState);
+
+	state->css.flags = node->flags;
+	state->css.methods = &partition_router_exec_methods;
+
+	/* Extract necessary variables */
+	state->subplan = (Plan *) linitial(node->custom_plans);
+	state->partitioned_table = intVal(linitial(node->custom_private));
+	state->command_type = intVal(lsecond(node->custom_private));
+	state->tableoid_attno = intVal(lthird(node->custom_private));
+	state->child_rtis = lfourth(node->custom_private);
+	state->truncated_parts = (List *) list_nth(node->custom_private, 4);
+
+	/* There should be exactly one subplan */
+	Assert(list_length(node->custom_plans) == 1);
+
+	return (Node *) state;
+}
+
+void
+partition_router_begin(CustomScanState *node, EState *estate, int eflags)
+{
+	PartitionRouterState   *state = (PartitionRouterState *) node;
+	HASHCTL					ctl;
+	ListCell			   *lc;
+
+	/*
+	 * Partitions to be truncated have been locked by planner, but a cached
+	 * plan might be executed in another transaction. Take the same lock
+	 * before anything else, so that TRUNCATE won't have to upgrade it.
+	 * There's no need to do this if plan is not going to be executed.
+	 */
+	if (!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		foreach (lc, state->truncated_parts)
+			LockRelationOid(lfirst_oid(lc), AccessExclusiveLock);
+	}
+
+	/* It's convenient to store PlanState in 'custom_ps' */
+	node->custom_ps = list_make1(ExecInitNode(state->subplan, estate, eflags));
+
+	memset(&ctl, 0, sizeof(HASHCTL));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(RouterPartEntry);
+	ctl.hcxt = estate->es_query_cxt;
+
+	state->result_rels_table = hash_create("PartitionRouter storage",
+										   Max(list_length(state->child_rtis), 10),
+										   &ctl,
+										   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	/* Map partitions' Oids to their RangeTblEntries */
+	foreach (lc, state->child_rtis)
+	{
+		Index				rti = lfirst_int(lc);
+		Oid					partid = getrelid(rti, estate->es_range_table);
+		RouterPartEntry	   *entry;
+		bool				found;
+
+		entry = hash_search(state->result_rels_table,
+							(const void *) &partid,
+							HASH_ENTER, &found);
+
+		if (found && entry->rti != rti)
+			elog(ERROR, "partition \"%s\" is scanned more than once",
+				 get_rel_name_or_relid(partid));
+
+		entry->rti = rti;
+		entry->result_rel_info = NULL;
+	}
+}
+
+TupleTableSlot *
+partition_router_exec(CustomScanState *node)
+{
+	PartitionRouterState   *state = (PartitionRouterState *) node;
+
+	EState				   *estate = node->ss.ps.state;
+	PlanState			   *child_ps = (PlanState *) linitial(node->custom_ps);
+	TupleTableSlot		   *slot;
+
+	/* Empty partitions which are not scanned at all */
+	if (state->truncated_parts && !state->truncate_done &&
+		estate->es_epqTuple == NULL)
+	{
+		truncate_partitions(state->truncated_parts);
+		state->truncate_done = true;
+	}
+
+	for (;;)
+	{
+		RouterPartEntry	   *entry;
+		Datum				value;
+		bool				isnull;
+		Oid					partid;
+
+		slot = fetch_next_tuple(state, child_ps, estate);
+
+		if (TupIsNull(slot))
+			return NULL;
+
+		/* Extract partition's Oid */
+		value = slot_getattr(slot, state->tableoid_attno, &isnull);
+		Assert(!isnull);
+		partid = DatumGetObjectId(value);
+
+		entry = hash_search(state->result_rels_table,
+							(const void *) &partid,
+							HASH_FIND, NULL);
+		if (!entry)
+			elog(ERROR, "PartitionRouter got a tuple from unexpected relation %u",
+				 partid);
+
+		/*
+		 * EvalPlanQual rechecks a single tuple of a single partition, but
+		 * scans of other partitions don't know about it. Skip their tuples.
+		 */
+		if (estate->es_epqTuple != NULL)
+		{
+			if (!estate->es_epqTupleSet[entry->rti - 1])
+				continue;
+
+			return slot;
+		}
+
+		/* Save original ResultRelInfo */
+		if (!state->saved_rel_info)
+			state->saved_rel_info = estate->es_result_relation_info;
+
+		/* Open partition on first use */
+		if (!entry->result_rel_info)
+			entry->result_rel_info = open_partition_for_modify(state, entry);
+
+		/* Magic: replace parent's ResultRelInfo with ours */
+		estate->es_result_relation_info = entry->result_rel_info;
+
+		return slot;
+	}
+}
+
+void
+partition_router_end(CustomScanState *node)
+{
+	PartitionRouterState   *state = (PartitionRouterState *) node;
+	HASH_SEQ_STATUS			stat;
+	RouterPartEntry		   *entry;
+
+	/* Close partitions, but keep locks till transaction's end */
+	hash_seq_init(&stat, state->result_rels_table);
+	while ((entry = (RouterPartEntry *) hash_seq_search(&stat)) != NULL)
+	{
+		if (!entry->result_rel_info)
+			continue;
+
+		ExecCloseIndices(entry->result_rel_info);
+		heap_close(entry->result_rel_info->ri_RelationDesc, NoLock);
+	}
+
+	hash_destroy(state->result_rels_table);
+
+	Assert(list_length(node->custom_ps) == 1);
+	ExecEndNode((PlanState *) linitial(node->custom_ps));
+}
+
+void
+partition_router_rescan(CustomScanState *node)
+{
+	PartitionRouterState *state = (PartitionRouterState *) node;
+
+	/* EvalPlanQual rescans us before each recheck */
+	state->epq_next_plan = 0;
+
+	Assert(list_length(node->custom_ps) == 1);
+	ExecReScan((PlanState *) linitial(node->custom_ps));
+}
+
+void
+partition_router_explain(CustomScanState *node, List *ancestors, ExplainState *es)
+{
+	PartitionRouterState *state = (PartitionRouterState *) node;
+
+	/* Show how many partitions DELETE is going to truncate */
+	if (state->truncated_parts)
+		ExplainPropertyInteger("Partitions Truncated",
+							   list_length(state->truncated_parts), es);
+}
+
+
+/*
+ * Empty partitions which are fully covered by DELETE's
+ * quals (see select_partitions_to_truncate()).
+ */
+static void
+truncate_partitions(List *partitions)
+{
+	TruncateStmt   *stmt = makeNode(TruncateStmt);
+	ListCell	   *lc;
+
+	foreach (lc, partitions)
+	{
+		Oid			partid = lfirst_oid(lc);
+		char	   *relname = get_rel_name(partid);
+		RangeVar   *rv;
+
+		/* Partition has been dropped, nothing to delete */
+		if (!relname)
+			continue;
+
+		rv = makeRangeVar(get_namespace_name(get_rel_namespace(partid)),
+						  relname, -1);
+		rv->inhOpt = INH_NO;
+
+		stmt->relations = lappend(stmt->relations, rv);
+	}
+
+	stmt->restart_seqs = false;
+	stmt->behavior = DROP_RESTRICT;
+
+	/* Checks permissions, takes AccessExclusiveLock etc */
+	if (stmt->relations)
+		ExecuteTruncate(stmt);
+}
+
+/*
+ * Fetch next tuple from subplan. EvalPlanQual rechecks a single tuple
+ * of a single partition, so in this case we don't even start scans of
+ * partitions (subplans of Append) which have no test tuple.
+ */
+static TupleTableSlot *
+fetch_next_tuple(PartitionRouterState *state,
+				 PlanState *child_ps,
+				 EState *estate)
+{
+	AppendState *append;
+
+	if (estate->es_epqTuple == NULL || !IsA(child_ps, AppendState))
+		return ExecProcNode(child_ps);
+
+	append = (AppendState *) child_ps;
+	for (; state->epq_next_plan < append->as_nplans; state->epq_next_plan++)
+	{
+		PlanState	   *subplan = append->appendplans[state->epq_next_plan];
+		TupleTableSlot *slot;
+
+		if (epq_skips_subplan(subplan, estate))
+			continue;
+
+		slot = ExecProcNode(subplan);
+		if (!TupIsNull(slot))
+			return slot;
+	}
+
+	return NULL;
+}
+
+/*
+ * Check if subplan scans a partition which has no EvalPlanQual test tuple.
+ */
+static bool
+epq_skips_subplan(PlanState *subplan, EState *estate)
+{
+	Index scanrelid;
+
+	switch (nodeTag(subplan->plan))
+	{
+		case T_SeqScan:
+		case T_SampleScan:
+		case T_IndexScan:
+		case T_IndexOnlyScan:
+		case T_BitmapHeapScan:
+		case T_TidScan:
+			scanrelid = ((Scan *) subplan->plan)->scanrelid;
+			break;
+
+		/* Don't know which relations it scans, run it */
+		default:
+			return false;
+	}
+
+	return scanrelid > 0 && !estate->es_epqTupleSet[scanrelid - 1];
+}
+
+
+/*
+ * Build ResultRelInfo for partition using parent's one as a template.
+ *
+ * NOTE: partitions have already been checked by handle_modification_query(),
+ * so the parent's projections and junk filter are valid for them as well.
+ */
+static ResultRelInfo *
+open_partition_for_modify(PartitionRouterState *state, RouterPartEntry *entry)
+{
+#define CopyToResultRelInfo(field_name) \
+	( child_result_rel_info->field_name = parent_result_rel_info->field_name )
+
+	EState			   *estate = state->css.ss.ps.state;
+	ResultRelInfo	   *parent_result_rel_info = state->saved_rel_info,
+					   *child_result_rel_info;
+	Relation			child_rel;
+	TupleConversionMap *tuple_map;
+
+	child_rel = heap_open(entry->partid, RowExclusiveLock);
+	CheckValidResultRel(child_rel, state->command_type);
+
+	/* Tuples produced by subplan must fit partition as is */
+	tuple_map = build_part_tuple_map(parent_result_rel_info->ri_RelationDesc,
+									 child_rel);
+	if (tuple_map)
+		elog(ERROR, "partition \"%s\" has unexpected tuple descriptor",
+			 RelationGetRelationName(child_rel));
+
+	child_result_rel_info = makeNode(ResultRelInfo);
+
+	/* Use partition's RT index, EvalPlanQual relies on it */
+	InitResultRelInfo(child_result_rel_info,
+					  child_rel,
+					  entry->rti,
+					  estate->es_instrument);
+
+	if (state->command_type != CMD_DELETE)
+		ExecOpenIndices(child_result_rel_info, false);
+
+	/* Copy necessary fields from parent's ResultRelInfo */
+	CopyToResultRelInfo(ri_WithCheckOptions);
+	CopyToResultRelInfo(ri_WithCheckOptionExprs);
+	CopyToResultRelInfo(ri_junkFilter);
+	CopyToResultRelInfo(ri_projectReturning);
+
+	return child_result_rel_info;
+}
+
+/*
+ * Build partition router's target list pointing to subplan tuple's elements.
+ */
+static List *
+prouter_build_tlist(List *tlist)
+{
+	List	   *result_tlist = NIL;
+	ListCell   *lc;
+
+	foreach (lc, tlist)
+	{
+		TargetEntry	   *tle = (TargetEntry *) lfirst(lc);
+		Var			   *var;
+
+		var = makeVar(INDEX_VAR,	/* point to subplan's elements */
+					  tle->resno,
+					  exprType((Node *) tle->expr),
+					  exprTypmod((Node *) tle->expr),
+					  exprCollation((Node *) tle->expr),
+					  0);
+
+		result_tlist = lappend(result_tlist,
+							   makeTargetEntry((Expr *) var,
+											   tle->resno,
+											   tle->resname,
+											   tle->resjunk));
+	}
+
+	return result_tlist;
+}
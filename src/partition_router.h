@@ -0,0 +1,97 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_router.h
+ *		Route UPDATE and DELETE to partitions selected at plan time
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PARTITION_ROUTER_H
+#define PARTITION_ROUTER_H
+
+
+#include "relation_info.h"
+#include "utils.h"
+
+#include "postgres.h"
+#include "commands/explain.h"
+#include "optimizer/planner.h"
+
+#if PG_VERSION_NUM >= 90600
+#include "nodes/extensible.h"
+#endif
+
+
+/* Junk column which contains partition's Oid (see handle_modification_query()) */
+#define PARTITION_ROUTER_TABLEOID	"pathman_result_tableoid"
+
+/* Junk column which contains partitions to be truncated by DELETE */
+#define PARTITION_ROUTER_TRUNCATED	"pathman_truncated_partitions"
+
+
+/*
+ * Single element of 'result_rels_table'.
+ */
+typedef struct
+{
+	Oid					partid;				/* partition's relid */
+	Index				rti;				/* partition's RangeTblEntry index */
+	ResultRelInfo	   *result_rel_info;	/* opened on first use */
+} RouterPartEntry;
+
+typedef struct
+{
+	CustomScanState		css;
+
+	Oid					partitioned_table;
+	CmdType				command_type;		/* UPDATE or DELETE */
+	AttrNumber			tableoid_attno;		/* PARTITION_ROUTER_TABLEOID column */
+	List			   *child_rtis;			/* RT indices of partitions */
+	List			   *truncated_parts;	/* partitions to be truncated */
+	bool				truncate_done;		/* have we truncated them yet? */
+	int					epq_next_plan;		/* next Append's subplan for EPQ */
+
+	Plan			   *subplan;			/* proxy variable to store subplan */
+	HTAB			   *result_rels_table;	/* partition ResultRelInfo cache */
+	ResultRelInfo	   *saved_rel_info;		/* original ResultRelInfo (parent) */
+} PartitionRouterState;
+
+
+extern bool					pg_pathman_enable_partition_router;
+extern bool					pg_pathman_enable_truncate_on_delete;
+
+extern CustomScanMethods	partition_router_plan_methods;
+extern CustomExecMethods	partition_router_exec_methods;
+
+
+void init_partition_router_static_data(void);
+
+
+Plan * make_partition_router(Plan *subplan,
+							 Oid parent_relid,
+							 CmdType command_type,
+							 AttrNumber tableoid_attno,
+							 List *child_rtis,
+							 List *truncated_parts);
+
+
+Node * partition_router_create_scan_state(CustomScan *node);
+
+void partition_router_begin(CustomScanState *node,
+							EState *estate,
+							int eflags);
+
+TupleTableSlot * partition_router_exec(CustomScanState *node);
+
+void partition_router_end(CustomScanState *node);
+
+void partition_router_rescan(CustomScanState *node);
+
+void partition_router_explain(CustomScanState *node,
+							  List *ancestors,
+							  ExplainState *es);
+
+
+#endif /* PARTITION_ROUTER_H */
@@ -0,0 +1,518 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_selector.c
+ *		Select partitions of Hash Join's outer relation using
+ *		join keys of its build side
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "partition_selector.h"
+#include "pathman.h"
+#include "rangeset.h"
+#include "runtimeappend.h"
+
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/cost.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/subselect.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/typcache.h"
+
+
+bool				pg_pathman_enable_partition_selector = false;
+
+CustomPathMethods	partition_selector_path_methods;
+CustomScanMethods	partition_selector_plan_methods;
+CustomExecMethods	partition_selector_exec_methods;
+
+
+static Path *create_partition_selector_path(RelOptInfo *rel,
+											Path *subpath,
+											Oid partitioned_table,
+											Expr *key_expr,
+											int param_id);
+
+static void select_partition_for_value(PartitionSelectorState *state,
+									   Datum value);
+
+static void publish_selected_partitions(PartitionSelectorState *state);
+static void reset_selected_partitions(PartitionSelectorState *state);
+
+
+void
+init_partition_selector_static_data(void)
+{
+	partition_selector_path_methods.CustomName				= "PartitionSelector";
+	partition_selector_path_methods.PlanCustomPath			= create_partition_selector_plan;
+
+	partition_selector_plan_methods.CustomName 				= "PartitionSelector";
+	partition_selector_plan_methods.CreateCustomScanState	= partition_selector_create_scan_state;
+
+	partition_selector_exec_methods.CustomName				= "PartitionSelector";
+	partition_selector_exec_methods.BeginCustomScan			= partition_selector_begin;
+	partition_selector_exec_methods.ExecCustomScan			= partition_selector_exec;
+	partition_selector_exec_methods.EndCustomScan			= partition_selector_end;
+	partition_selector_exec_methods.ReScanCustomScan		= partition_selector_rescan;
+	partition_selector_exec_methods.MarkPosCustomScan		= NULL;
+	partition_selector_exec_methods.RestrPosCustomScan		= NULL;
+	partition_selector_exec_methods.ExplainCustomScan		= partition_selector_explain;
+
+	DefineCustomBoolVariable("pg_pathman.enable_partitionselector",
+							 "Enables pruning of Hash Join's outer partitions "
+							 "using PartitionSelector custom node.",
+							 NULL,
+							 &pg_pathman_enable_partition_selector,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+}
+
+
+/*
+ * ----------------------
+ *  Planning-time stuff
+ * ----------------------
+ */
+
+/*
+ * Add Hash Join path which scans only those partitions of 'outerrel'
+ * that might contain join keys of 'innerrel'. PartitionSelector collects
+ * them while Hash is being built, and then RuntimeAppend selects matching
+ * partitions before its first child is started.
+ */
+void
+add_partition_selector_path(PlannerInfo *root,
+							RelOptInfo *joinrel,
+							RelOptInfo *outerrel,
+							RelOptInfo *innerrel,
+							JoinType jointype,
+							JoinPathExtraData *extra)
+{
+	JoinCostWorkspace		workspace;
+	RangeTblEntry		   *outer_rte;
+	const PartRelationInfo *prel;
+	AppendPath			   *append_path = NULL;
+	Path				   *inner_path,
+						   *outer_path,
+						   *selector_path;
+	List				   *hashclauses = NIL;
+	Expr				   *inner_key = NULL;
+	Oid						eq_opr;
+	ListCell			   *lc;
+	double					sel;
+	int						param_id;
+
+	/* Outer tuples without a match should not be emitted */
+	if (jointype != JOIN_INNER &&
+		jointype != JOIN_SEMI &&
+		jointype != JOIN_RIGHT)
+		return;
+
+	/* Check that outerrel is a BASEREL with inheritors & PartRelationInfo */
+	outer_rte = root->simple_rte_array[outerrel->relid];
+	if (outerrel->reloptkind != RELOPT_BASEREL || !outer_rte->inh ||
+		!(prel = get_pathman_relation_info(outer_rte->relid)) ||
+		PrelChildrenCount(prel) == 0)
+		return;
+
+	/* Build side should not depend on other relations */
+	inner_path = innerrel->cheapest_total_path;
+	if (!inner_path || PATH_REQ_OUTER(inner_path))
+		return;
+
+	/* Find the cheapest unparameterized Append of partitions */
+	foreach (lc, outerrel->pathlist)
+	{
+		Path *path = (Path *) lfirst(lc);
+
+		if (IsA(path, AppendPath) && !PATH_REQ_OUTER(path) &&
+			(!append_path || path->total_cost < append_path->path.total_cost))
+			append_path = (AppendPath *) path;
+	}
+
+	if (!append_path)
+		return;
+
+	/* Partitions are selected by '=' of partitioned column's type */
+	eq_opr = lookup_type_cache(getBaseType(prel->atttype),
+							   TYPECACHE_EQ_OPR)->eq_opr;
+
+	/* Select hashable clauses (see hash_inner_and_outer()) */
+	foreach (lc, extra->restrictlist)
+	{
+		RestrictInfo   *rinfo = (RestrictInfo *) lfirst(lc);
+		Node		   *outer_arg,
+					   *inner_arg;
+
+		if (IS_OUTER_JOIN(jointype) && rinfo->is_pushed_down)
+			continue;
+
+		if (!rinfo->can_join || !OidIsValid(rinfo->hashjoinoperator))
+			continue;
+
+		if (bms_is_subset(rinfo->left_relids, outerrel->relids) &&
+			bms_is_subset(rinfo->right_relids, innerrel->relids))
+			rinfo->outer_is_left = true;
+
+		else if (bms_is_subset(rinfo->left_relids, innerrel->relids) &&
+				 bms_is_subset(rinfo->right_relids, outerrel->relids))
+			rinfo->outer_is_left = false;
+
+		else continue;
+
+		hashclauses = lappend(hashclauses, rinfo);
+
+		outer_arg = rinfo->outer_is_left ?
+						get_leftop(rinfo->clause) :
+						get_rightop(rinfo->clause);
+		inner_arg = rinfo->outer_is_left ?
+						get_rightop(rinfo->clause) :
+						get_leftop(rinfo->clause);
+
+		/* Look for 'partitioned column = inner key' */
+		if (!inner_key &&
+			rinfo->hashjoinoperator == eq_opr &&
+			is_partitioned_column(outer_arg, outerrel->relid, prel) &&
+			getBaseType(exprType(inner_arg)) == getBaseType(prel->atttype))
+		{
+			inner_key = (Expr *) inner_arg;
+		}
+	}
+
+	if (!inner_key)
+		return;
+
+	/* Selected partitions are passed via this param */
+	param_id = SS_assign_special_param(root);
+
+	selector_path = create_partition_selector_path(innerrel, inner_path,
+												   outer_rte->relid, inner_key,
+												   param_id);
+
+	/* Each inner key is contained by at most one partition */
+	sel = Min(1.0, inner_path->rows / PrelChildrenCount(prel));
+
+	outer_path = create_runtimeappend_path(root, append_path, NULL, sel);
+	((RuntimeAppendPath *) outer_path)->join_filter_param = param_id;
+
+	/*
+	 * Partitions can't be selected until Hash is built, make sure
+	 * ExecHashJoin() won't fetch the first outer tuple beforehand.
+	 */
+	outer_path->startup_cost = Max(outer_path->startup_cost,
+								   selector_path->total_cost);
+	outer_path->total_cost = Max(outer_path->total_cost,
+								 outer_path->startup_cost);
+
+	initial_cost_hashjoin(root, &workspace, jointype, hashclauses,
+						  outer_path, selector_path,
+						  extra->sjinfo, &extra->semifactors);
+
+	add_path(joinrel,
+			 (Path *) create_hashjoin_path(root, joinrel, jointype, &workspace,
+										   extra->sjinfo, &extra->semifactors,
+										   outer_path, selector_path,
+										   extra->restrictlist, NULL,
+										   hashclauses));
+}
+
+static Path *
+create_partition_selector_path(RelOptInfo *rel,
+							   Path *subpath,
+							   Oid partitioned_table,
+							   Expr *key_expr,
+							   int param_id)
+{
+	CustomPath *cpath = makeNode(CustomPath);
+
+	cpath->path.pathtype = T_CustomScan;
+	cpath->path.parent = rel;
+	cpath->path.param_info = NULL;
+	cpath->path.pathkeys = subpath->pathkeys;
+#if PG_VERSION_NUM >= 90600
+	cpath->path.pathtarget = subpath->pathtarget;
+#endif
+	cpath->path.rows = subpath->rows;
+
+	/* Each tuple is looked up in partitions' bounds */
+	cpath->path.startup_cost = subpath->startup_cost;
+	cpath->path.total_cost = subpath->total_cost +
+							 cpu_operator_cost * subpath->rows;
+
+	cpath->flags = 0;
+	cpath->methods = &partition_selector_path_methods;
+	cpath->custom_paths = list_make1(subpath);
+
+	/* Pack partitioned table's Oid, join key and param */
+	cpath->custom_private = list_make3(list_make1_oid(partitioned_table),
+									   key_expr,
+									   list_make1_int(param_id));
+
+	return &cpath->path;
+}
+
+Plan *
+create_partition_selector_plan(PlannerInfo *root, RelOptInfo *rel,
+							   CustomPath *best_path, List *tlist,
+							   List *clauses, List *custom_plans)
+{
+	CustomScan *cscan = makeNode(CustomScan);
+	Plan	   *subplan = (Plan *) linitial(custom_plans);
+	List	   *private = best_path->custom_private;
+
+	Assert(list_length(custom_plans) == 1);
+
+	cscan->methods = &partition_selector_plan_methods;
+	cscan->custom_plans = custom_plans;
+
+	/* Tuples are passed to Hash as is, 'clauses' are checked by subplan */
+	cscan->scan.plan.targetlist = (List *) copyObject(subplan->targetlist);
+	cscan->scan.plan.qual = NIL;
+
+	/* No physical relation will be scanned */
+	cscan->scan.scanrelid = 0;
+	cscan->custom_scan_tlist = subplan->targetlist;
+
+	/* Join key will be evaluated against subplan's tuples */
+	cscan->custom_exprs = list_make1(lsecond(private));
+	cscan->custom_private = list_make2(linitial(private), lthird(private));
+
+	return &cscan->scan.plan;
+}
+
+
+/*
+ * ----------------------------------
+ *  PartitionSelector implementation
+ * ----------------------------------
+ */
+
+Node *
+partition_selector_create_scan_state(CustomScan *node)
+{
+	PartitionSelectorState *state;
+
+	state = (PartitionSelectorState *) palloc0(sizeof(PartitionSelectorState));
+	NodeSetTag(state, T_CustomScanState);
+
+	state->css.flags = node->flags;
+	state->css.methods = &partition_selector_exec_methods;
+
+	/* Extract necessary variables */
+	state->subplan = (Plan *) linitial(node->custom_plans);
+	state->key_expr = (Expr *) linitial(node->custom_exprs);
+	state->partitioned_table = linitial_oid(linitial(node->custom_private));
+	state->param_id = linitial_int(lsecond(node->custom_private));
+
+	/* There should be exactly one subplan */
+	Assert(list_length(node->custom_plans) == 1);
+
+	return (Node *) state;
+}
+
+void
+partition_selector_begin(CustomScanState *node, EState *estate, int eflags)
+{
+	PartitionSelectorState *state = (PartitionSelectorState *) node;
+
+	/* It's convenient to store PlanState in 'custom_ps' */
+	node->custom_ps = list_make1(ExecInitNode(state->subplan, estate, eflags));
+
+	state->key_state = ExecInitExpr(state->key_expr, &node->ss.ps);
+
+	reset_selected_partitions(state);
+}
+
+TupleTableSlot *
+partition_selector_exec(CustomScanState *node)
+{
+	PartitionSelectorState *state = (PartitionSelectorState *) node;
+	ExprContext			   *econtext = node->ss.ps.ps_ExprContext;
+	PlanState			   *child_ps = (PlanState *) linitial(node->custom_ps);
+	TupleTableSlot		   *slot;
+	Datum					value;
+	bool					isnull;
+
+	slot = ExecProcNode(child_ps);
+
+	/* Hash has got all keys, let RuntimeAppend use them */
+	if (TupIsNull(slot))
+	{
+		if (state->nselected < 0)
+			publish_selected_partitions(state);
+
+		return NULL;
+	}
+
+	ResetExprContext(econtext);
+	econtext->ecxt_scantuple = slot;
+
+	value = ExecEvalExpr(state->key_state, econtext, &isnull, NULL);
+
+	/* NULL key won't match any outer tuple */
+	if (!isnull)
+		select_partition_for_value(state, value);
+
+	return slot;
+}
+
+void
+partition_selector_end(CustomScanState *node)
+{
+	Assert(list_length(node->custom_ps) == 1);
+	ExecEndNode((PlanState *) linitial(node->custom_ps));
+}
+
+void
+partition_selector_rescan(CustomScanState *node)
+{
+	PartitionSelectorState *state = (PartitionSelectorState *) node;
+
+	reset_selected_partitions(state);
+
+	Assert(list_length(node->custom_ps) == 1);
+	ExecReScan((PlanState *) linitial(node->custom_ps));
+}
+
+void
+partition_selector_explain(CustomScanState *node, List *ancestors, ExplainState *es)
+{
+	PartitionSelectorState *state = (PartitionSelectorState *) node;
+
+	/* Show how many partitions of outer relation will be scanned */
+	if (es->analyze && state->nselected >= 0)
+		ExplainPropertyInteger("Partitions Matched", state->nselected, es);
+}
+
+
+/* Add partition containing 'value' to the selected ones */
+static void
+select_partition_for_value(PartitionSelectorState *state, Datum value)
+{
+	const PartRelationInfo *prel;
+	ExprContext			   *econtext = state->css.ss.ps.ps_ExprContext;
+	MemoryContext			old_cxt;
+	uint32					idx;
+
+	prel = get_pathman_relation_info(state->partitioned_table);
+	if (!prel)
+		elog(ERROR, "table \"%s\" is not partitioned",
+			 get_rel_name_or_relid(state->partitioned_table));
+
+	switch (prel->parttype)
+	{
+		case PT_HASH:
+			{
+				Datum hash = OidFunctionCall1(prel->hash_proc, value);
+
+				idx = hash_to_part_index(DatumGetUInt32(hash),
+										 PrelChildrenCount(prel));
+			}
+			break;
+
+		case PT_RANGE:
+			{
+				WrapperNode	wrap;
+
+				if (!state->cmp_func_ready)
+				{
+					fill_prel_cmp_fmgr_info(&state->cmp_func,
+											exprType((Node *) state->key_expr),
+											prel);
+					state->cmp_func_ready = true;
+				}
+
+				/* Don't leak rangesets in query's context */
+				old_cxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+				select_range_partitions(value, &state->cmp_func,
+										PrelGetRangesArray(prel),
+										PrelChildrenCount(prel),
+										BTEqualStrategyNumber,
+										&wrap); /* output */
+
+				MemoryContextSwitchTo(old_cxt);
+
+				/* No partition contains this value */
+				if (wrap.rangeset == NIL)
+					return;
+
+				idx = irange_lower(linitial_irange(wrap.rangeset));
+			}
+			break;
+
+		default:
+			elog(ERROR, "Unknown partitioning type %u", prel->parttype);
+			return; /* keep compiler happy */
+	}
+
+	old_cxt = MemoryContextSwitchTo(state->css.ss.ps.state->es_query_cxt);
+	state->selected = bms_add_member(state->selected, (int) idx);
+	MemoryContextSwitchTo(old_cxt);
+}
+
+/* Pass selected partitions to RuntimeAppend as a rangeset */
+static void
+publish_selected_partitions(PartitionSelectorState *state)
+{
+	EState		   *estate = state->css.ss.ps.state;
+	ParamExecData  *prm = &estate->es_param_exec_vals[state->param_id];
+	List		   *ranges = NIL;
+	MemoryContext	old_cxt;
+	int				idx = -1,
+					lower = -1,
+					upper = -1;
+
+	old_cxt = MemoryContextSwitchTo(estate->es_query_cxt);
+
+	/* Merge adjacent partitions into IndexRanges */
+	while ((idx = bms_next_member(state->selected, idx)) >= 0)
+	{
+		if (upper >= 0 && idx == upper + 1)
+		{
+			upper = idx;
+			continue;
+		}
+
+		if (upper >= 0)
+			ranges = lappend_irange(ranges, make_irange(lower, upper, IR_LOSSY));
+
+		lower = upper = idx;
+	}
+
+	if (upper >= 0)
+		ranges = lappend_irange(ranges, make_irange(lower, upper, IR_LOSSY));
+
+	MemoryContextSwitchTo(old_cxt);
+
+	prm->execPlan = NULL;
+	prm->value = PointerGetDatum(ranges);
+	prm->isnull = false;
+
+	state->nselected = bms_num_members(state->selected);
+}
+
+/* RuntimeAppend will scan all partitions until we're done */
+static void
+reset_selected_partitions(PartitionSelectorState *state)
+{
+	EState		   *estate = state->css.ss.ps.state;
+	ParamExecData  *prm = &estate->es_param_exec_vals[state->param_id];
+
+	prm->execPlan = NULL;
+	prm->value = (Datum) 0;
+	prm->isnull = true;
+
+	bms_free(state->selected);
+	state->selected = NULL;
+	state->nselected = -1;
+}
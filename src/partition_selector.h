@@ -0,0 +1,90 @@
+/* ------------------------------------------------------------------------
+ *
+ * partition_selector.h
+ *		Select partitions of Hash Join's outer relation using
+ *		join keys of its build side
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PARTITION_SELECTOR_H
+#define PARTITION_SELECTOR_H
+
+
+#include "relation_info.h"
+#include "utils.h"
+
+#include "postgres.h"
+#include "commands/explain.h"
+#include "optimizer/paths.h"
+#include "optimizer/planner.h"
+
+#if PG_VERSION_NUM >= 90600
+#include "nodes/extensible.h"
+#endif
+
+
+typedef struct
+{
+	CustomScanState		css;
+
+	Oid					partitioned_table;	/* outer relation of Hash Join */
+	int					param_id;			/* PARAM_EXEC for RuntimeAppend */
+
+	Plan			   *subplan;			/* proxy variable to store subplan */
+	Expr			   *key_expr;			/* join key of the build side */
+	ExprState		   *key_state;
+
+	FmgrInfo			cmp_func;			/* compare key to RANGE bounds */
+	bool				cmp_func_ready;
+
+	Bitmapset		   *selected;			/* indices of selected partitions */
+	int					nselected;			/* -1 until subplan is finished */
+} PartitionSelectorState;
+
+
+extern bool					pg_pathman_enable_partition_selector;
+
+extern CustomPathMethods	partition_selector_path_methods;
+extern CustomScanMethods	partition_selector_plan_methods;
+extern CustomExecMethods	partition_selector_exec_methods;
+
+
+void init_partition_selector_static_data(void);
+
+
+void add_partition_selector_path(PlannerInfo *root,
+								 RelOptInfo *joinrel,
+								 RelOptInfo *outerrel,
+								 RelOptInfo *innerrel,
+								 JoinType jointype,
+								 JoinPathExtraData *extra);
+
+Plan * create_partition_selector_plan(PlannerInfo *root,
+									  RelOptInfo *rel,
+									  CustomPath *best_path,
+									  List *tlist,
+									  List *clauses,
+									  List *custom_plans);
+
+
+Node * partition_selector_create_scan_state(CustomScan *node);
+
+void partition_selector_begin(CustomScanState *node,
+							  EState *estate,
+							  int eflags);
+
+TupleTableSlot * partition_selector_exec(CustomScanState *node);
+
+void partition_selector_end(CustomScanState *node);
+
+void partition_selector_rescan(CustomScanState *node);
+
+void partition_selector_explain(CustomScanState *node,
+								List *ancestors,
+								ExplainState *es);
+
+
+#endif /* PARTITION_SELECTOR_H */
@@ -56,12 +56,25 @@
  * Definitions for the "pathman_config_params" table.
  */
 #define PATHMAN_CONFIG_PARAMS						"pathman_config_params"
-#define Natts_pathman_config_params					5
+#define Natts_pathman_config_params					7
 #define Anum_pathman_config_params_partrel			1	/* primary key */
 #define Anum_pathman_config_params_enable_parent	2	/* include parent into plan */
 #define Anum_pathman_config_params_auto				3	/* auto partitions creation */
 #define Anum_pathman_config_params_init_callback	4	/* partition action callback */
 #define Anum_pathman_config_params_spawn_using_bgw	5	/* should we use spawn BGW? */
+#define Anum_pathman_config_params_zone_map_columns	6	/* columns with zone maps */
+#define Anum_pathman_config_params_premake			7	/* partitions to keep ahead */
+
+/*
+ * Definitions for the "pathman_zone_maps" table.
+ */
+#define PATHMAN_ZONE_MAPS							"pathman_zone_maps"
+#define Natts_pathman_zone_maps						5
+#define Anum_pathman_zone_maps_partrel				1	/* partition (regclass) */
+#define Anum_pathman_zone_maps_attname				2	/* summarized column (text) */
+#define Anum_pathman_zone_maps_valid				3	/* is summary up to date? */
+#define Anum_pathman_zone_maps_min_value			4	/* min non-NULL value (text) */
+#define Anum_pathman_zone_maps_max_value			5	/* max non-NULL value (text) */
 
 /*
  * Definitions for the "pathman_partition_list" view.
@@ -81,12 +94,14 @@
  */
 extern Oid	pathman_config_relid;
 extern Oid	pathman_config_params_relid;
+extern Oid	pathman_zone_maps_relid;
 
 /*
  * Just to clarify our intentions (return the corresponding relid).
  */
 Oid get_pathman_config_relid(bool invalid_is_ok);
 Oid get_pathman_config_params_relid(bool invalid_is_ok);
+Oid get_pathman_zone_maps_relid(bool invalid_is_ok);
 
 /*
  * pg_pathman's global state structure.
@@ -146,6 +161,7 @@ typedef struct
 	const PartRelationInfo *prel;		/* main partitioning structure */
 	ExprContext			   *econtext;	/* for ExecEvalExpr() */
 	bool					for_insert;	/* are we in PartitionFilter now? */
+	double				   *part_weights; /* fractions of rows in partitions */
 } WalkerContext;
 
 /*
@@ -157,6 +173,7 @@ typedef struct
 		(context)->prel = (prel_info); \
 		(context)->econtext = (ecxt); \
 		(context)->for_insert = (for_ins); \
+		(context)->part_weights = NULL; \
 	} while (0)
 
 /* Check that WalkerContext contains ExprContext (plan execution stage) */
@@ -2,12 +2,14 @@
  *
  * pathman_workers.c
  *
- *		There are two purposes of this subsystem:
+ *		There are four purposes of this subsystem:
  *
  *			* Create new partitions for INSERT in separate transaction
  *			* Process concurrent partitioning operations
+ *			* Refresh zone maps of partitions in background
+ *			* Create RANGE partitions ahead of time
  *
- *		Background worker API is used for both cases.
+ *		Background worker API is used for all of them.
  *
  * Copyright (c) 2015-2016, Postgres Professional
  *
@@ -16,23 +18,30 @@
 
 #include "init.h"
 #include "partition_creation.h"
+#include "partition_filter.h"
 #include "pathman_workers.h"
 #include "relation_info.h"
 #include "utils.h"
 #include "xact_handling.h"
 
 #include "access/htup_details.h"
+#include "access/transam.h"
 #include "access/xact.h"
+#include "catalog/pg_authid.h"
+#include "catalog/pg_class.h"
 #include "catalog/pg_type.h"
 #include "executor/spi.h"
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "postmaster/bgworker.h"
-#include "storage/dsm.h"
 #include "storage/ipc.h"
 #include "storage/latch.h"
+#include "storage/lock.h"
 #include "storage/proc.h"
+#include "storage/procarray.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/inval.h"
 #include "utils/datum.h"
 #include "utils/memutils.h"
 #include "utils/lsyscache.h"
@@ -48,19 +57,35 @@ PG_FUNCTION_INFO_V1( partition_table_concurrently );
 PG_FUNCTION_INFO_V1( show_concurrent_part_tasks_internal );
 PG_FUNCTION_INFO_V1( stop_concurrent_part_task );
 
+/* Declarations for ZoneMapsWorker */
+PG_FUNCTION_INFO_V1( refresh_zone_maps_concurrently );
+
+/* Declarations for PremakeWorker */
+PG_FUNCTION_INFO_V1( start_premake_worker_pl );
+
 
 /*
  * Dynamically resolve functions (for BGW API).
  */
 extern PGDLLEXPORT void bgw_main_spawn_partitions(Datum main_arg);
 extern PGDLLEXPORT void bgw_main_concurrent_part(Datum main_arg);
+extern PGDLLEXPORT void bgw_main_refresh_zone_maps(Datum main_arg);
+extern PGDLLEXPORT void bgw_main_premake_partitions(Datum main_arg);
 
 
 static void handle_sigterm(SIGNAL_ARGS);
+static void handle_sighup(SIGNAL_ARGS);
 static void bg_worker_load_config(const char *bgw_name);
+static void init_bg_worker_struct(BackgroundWorker *worker,
+								  const char bgworker_name[BGW_MAXLEN],
+								  const char bgworker_proc[BGW_MAXLEN],
+								  Datum bgw_arg,
+								  const void *bgw_extra, Size bgw_extra_len);
 static void start_bg_worker(const char bgworker_name[BGW_MAXLEN],
 							const char bgworker_proc[BGW_MAXLEN],
-							Datum bgw_arg, bool wait_for_shutdown);
+							Datum bgw_arg,
+							const void *bgw_extra, Size bgw_extra_len,
+							bool wait_for_shutdown);
 
 
 /*
@@ -77,12 +102,37 @@ typedef struct
  */
 static ConcurrentPartSlot  *concurrent_part_slots;
 
+/*
+ * Pool of SpawnPartitionsWorkers and their requests.
+ */
+static SpawnPartitionsQueue *spawn_queue;
+
 
 /*
  * Available workers' names.
  */
 static const char		   *spawn_partitions_bgw	= "SpawnPartitionsWorker";
 static const char		   *concurrent_part_bgw		= "ConcurrentPartWorker";
+static const char		   *zone_maps_bgw			= "ZoneMapsWorker";
+static const char		   *premake_bgw				= "PremakeWorker";
+
+
+/*
+ * Seconds between two rounds of PremakeWorker.
+ */
+int							pg_pathman_premake_naptime = DEFAULT_PREMAKE_NAPTIME;
+
+/*
+ * Seconds before an idle SpawnPartitionsWorker exits.
+ */
+int							pg_pathman_spawn_worker_idle_timeout = DEFAULT_SPAWN_WORKER_IDLE_TIMEOUT;
+
+/* Set by SIGHUP handler of PremakeWorker */
+static volatile sig_atomic_t got_sighup = false;
+
+/* PremakeWorker has to be registered when transaction commits */
+static bool					premake_worker_pending = false;
+static bool					premake_worker_callback_registered = false;
 
 
 /*
@@ -117,6 +167,66 @@ init_concurrent_part_task_slots(void)
 	}
 }
 
+/*
+ * Estimate amount of shmem needed for the pool of SpawnPartitionsWorkers.
+ */
+Size
+estimate_spawn_partitions_queue_size(void)
+{
+	return sizeof(SpawnPartitionsQueue);
+}
+
+/*
+ * Initialize shared memory needed for the pool of SpawnPartitionsWorkers.
+ */
+void
+init_spawn_partitions_queue(void)
+{
+	bool	found;
+	Size	size = estimate_spawn_partitions_queue_size();
+
+	spawn_queue = (SpawnPartitionsQueue *)
+			ShmemInitStruct("pg_pathman's SpawnPartitionsQueue", size, &found);
+
+	/* Initialize 'spawn_queue' if needed */
+	if (!found)
+	{
+		memset(spawn_queue, 0, size);
+		SpinLockInit(&spawn_queue->mutex);
+	}
+}
+
+/*
+ * Define GUC variables of background workers.
+ */
+void
+init_pathman_workers_static_data(void)
+{
+	DefineCustomIntVariable("pg_pathman.premake_naptime",
+							"Sleep time between two rounds of PremakeWorker.",
+							NULL,
+							&pg_pathman_premake_naptime,
+							DEFAULT_PREMAKE_NAPTIME,
+							1, INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_pathman.spawn_worker_idle_timeout",
+							"Time after which an idle SpawnPartitionsWorker exits.",
+							NULL,
+							&pg_pathman_spawn_worker_idle_timeout,
+							DEFAULT_SPAWN_WORKER_IDLE_TIMEOUT,
+							1, INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+}
+
 
 /*
  * -------------------------------------------------
@@ -143,6 +253,20 @@ handle_sigterm(SIGNAL_ARGS)
 	errno = save_errno;
 }
 
+/*
+ * Handle SIGHUP in BGW's process (config will be reloaded).
+ */
+static void
+handle_sighup(SIGNAL_ARGS)
+{
+	int save_errno = errno;
+
+	got_sighup = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
 /*
  * Initialize pg_pathman's local config in BGW's process.
  */
@@ -158,13 +282,44 @@ bg_worker_load_config(const char *bgw_name)
 			 bgw_name, MyProcPid);
 }
 
+/*
+ * Fill BackgroundWorker struct for one of our workers.
+ */
+static void
+init_bg_worker_struct(BackgroundWorker *worker,
+					  const char bgworker_name[BGW_MAXLEN],
+					  const char bgworker_proc[BGW_MAXLEN],
+					  Datum bgw_arg,
+					  const void *bgw_extra, Size bgw_extra_len)
+{
+	memcpy(worker->bgw_name, bgworker_name, BGW_MAXLEN);
+	memcpy(worker->bgw_function_name, bgworker_proc, BGW_MAXLEN);
+	memcpy(worker->bgw_library_name, "pg_pathman", BGW_MAXLEN);
+
+	worker->bgw_flags			= BGWORKER_SHMEM_ACCESS |
+									BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker->bgw_start_time		= BgWorkerStart_RecoveryFinished;
+	worker->bgw_restart_time	= BGW_NEVER_RESTART;
+	worker->bgw_main			= NULL;
+	worker->bgw_main_arg		= bgw_arg;
+	worker->bgw_notify_pid		= MyProcPid;
+
+	Assert(bgw_extra_len <= BGW_EXTRALEN);
+	memset(worker->bgw_extra, 0, BGW_EXTRALEN);
+	if (bgw_extra)
+		memcpy(worker->bgw_extra, bgw_extra, bgw_extra_len);
+}
+
 /*
  * Common function to start background worker.
+ * Small args may be passed via 'bgw_extra'.
  */
 static void
 start_bg_worker(const char bgworker_name[BGW_MAXLEN],
 				const char bgworker_proc[BGW_MAXLEN],
-				Datum bgw_arg, bool wait_for_shutdown)
+				Datum bgw_arg,
+				const void *bgw_extra, Size bgw_extra_len,
+				bool wait_for_shutdown)
 {
 #define HandleError(condition, new_state) \
 	if (condition) { exec_state = (new_state); goto handle_exec_state; }
@@ -184,17 +339,8 @@ start_bg_worker(const char bgworker_name[BGW_MAXLEN],
 	pid_t					pid;
 
 	/* Initialize worker struct */
-	memcpy(worker.bgw_name, bgworker_name, BGW_MAXLEN);
-	memcpy(worker.bgw_function_name, bgworker_proc, BGW_MAXLEN);
-	memcpy(worker.bgw_library_name, "pg_pathman", BGW_MAXLEN);
-
-	worker.bgw_flags			= BGWORKER_SHMEM_ACCESS |
-									BGWORKER_BACKEND_DATABASE_CONNECTION;
-	worker.bgw_start_time		= BgWorkerStart_RecoveryFinished;
-	worker.bgw_restart_time		= BGW_NEVER_RESTART;
-	worker.bgw_main				= NULL;
-	worker.bgw_main_arg			= bgw_arg;
-	worker.bgw_notify_pid		= MyProcPid;
+	init_bg_worker_struct(&worker, bgworker_name, bgworker_proc,
+						  bgw_arg, bgw_extra, bgw_extra_len);
 
 	/* Start dynamic worker */
 	bgw_started = RegisterDynamicBackgroundWorker(&worker, &bgw_handle);
@@ -240,109 +386,621 @@ handle_exec_state:
  * --------------------------------------
  */
 
+/* Request which is being processed by this SpawnPartitionsWorker */
+static int current_spawn_request = -1;
+
 /*
- * Create args segment for partitions bgw.
+ * Count live SpawnPartitionsWorkers of a database.
+ * NOTE: caller must hold spawn_queue->mutex.
  */
-static dsm_segment *
-create_partitions_bg_worker_segment(Oid relid, Datum value, Oid value_type)
+static int
+count_spawn_workers(Oid dbid)
 {
-	TypeCacheEntry		   *typcache;
-	Size					datum_size;
-	Size					segment_size;
-	dsm_segment			   *segment;
-	SpawnPartitionArgs	   *args;
+	int		nworkers = 0,
+			i;
 
-	typcache = lookup_type_cache(value_type, 0);
+	for (i = 0; i < SPAWN_WORKER_SLOTS; i++)
+	{
+		SpawnWorkerSlot *slot = &spawn_queue->workers[i];
+
+		if (slot->worker_status != SPW_FREE && slot->dbid == dbid)
+			nworkers++;
+	}
+
+	return nworkers;
+}
 
-	/* Calculate segment size */
-	datum_size = datumGetSize(value, typcache->typbyval, typcache->typlen);
-	segment_size = offsetof(SpawnPartitionArgs, value) + datum_size;
+/*
+ * Set result of a request and wake up its waiters. If 'only_orphaned'
+ * is true, request is failed only if it's pending and there are no
+ * workers left to process it.
+ */
+static void
+finish_spawn_request(int request_idx, Oid result, bool only_orphaned)
+{
+	SpawnPartitionRequest  *request = &spawn_queue->requests[request_idx];
+	Latch				   *waiters[SPAWN_REQUEST_MAX_WAITERS];
+	int						nwaiters = 0,
+							i;
 
-	segment = dsm_create(segment_size, 0);
+	SpinLockAcquire(&spawn_queue->mutex);
 
-	/* Initialize BGW args */
-	args = (SpawnPartitionArgs *) dsm_segment_address(segment);
+	if (only_orphaned ?
+			(request->status == SPR_PENDING &&
+			 count_spawn_workers(request->dbid) == 0) :
+			(request->status == SPR_WORKING))
+	{
+		request->result = result;
 
-	args->userid = GetUserId();
-	args->result = InvalidOid;
-	args->dbid = MyDatabaseId;
-	args->partitioned_table = relid;
+		/* Nobody is waiting for this request anymore */
+		if (request->nwaiters == 0)
+			request->status = SPR_FREE;
+		else
+			request->status = SPR_DONE;
 
-#if PG_VERSION_NUM >= 90600
-	/* Initialize args for BecomeLockGroupMember() */
-	args->parallel_master_pgproc = MyProc;
-	args->parallel_master_pid = MyProcPid;
-#endif
+		nwaiters = request->nwaiters;
+		memcpy(waiters, request->waiters, nwaiters * sizeof(Latch *));
+	}
 
-	/* Write value-related stuff */
-	args->value_type = value_type;
-	args->value_size = datum_size;
-	args->value_byval = typcache->typbyval;
+	SpinLockRelease(&spawn_queue->mutex);
 
-	PackDatumToByteArray((void *) args->value, value,
-						 datum_size, args->value_byval);
+	for (i = 0; i < nwaiters; i++)
+		SetLatch(waiters[i]);
+}
+
+/*
+ * Fail requests which can't be processed since there are no workers.
+ * Their waiters will create partitions by themselves.
+ */
+static void
+fail_orphaned_spawn_requests(void)
+{
+	int i;
 
-	return segment;
+	for (i = 0; i < SPAWN_REQUEST_SLOTS; i++)
+		finish_spawn_request(i, InvalidOid, true);
 }
 
 /*
- * Starts background worker that will create new partitions,
- * waits till it finishes the job and returns the result (new partition oid)
+ * Add a request to the queue or join a request for the same table
+ * (it's 'merged' then). Returns index of request or -1 if the queue
+ * is full or there are no workers to process it.
+ *
+ * If a new worker is needed, its slot is reserved and returned
+ * via 'new_worker' (along with 'generation' of the slot).
+ */
+static int
+enqueue_spawn_request(Oid relid, Datum value, Oid value_type,
+					  Size value_size, bool value_byval,
+					  bool *merged, int *new_worker, uint32 *generation)
+{
+	SpawnPartitionRequest  *request = NULL;
+	Latch				   *idle_worker = NULL;
+	int						request_idx = -1,
+							free_request_idx = -1,
+							free_worker_idx = -1,
+							nworkers = 0,
+							i;
+
+	*merged = false;
+	*new_worker = -1;
+
+	SpinLockAcquire(&spawn_queue->mutex);
+
+	/* Look for a request for the same table */
+	for (i = 0; i < SPAWN_REQUEST_SLOTS; i++)
+	{
+		SpawnPartitionRequest *cur = &spawn_queue->requests[i];
+
+		if (cur->status == SPR_FREE)
+		{
+			if (free_request_idx < 0)
+				free_request_idx = i;
+		}
+		else if ((cur->status == SPR_PENDING || cur->status == SPR_WORKING) &&
+				 cur->dbid == MyDatabaseId &&
+				 cur->partitioned_table == relid &&
+				 cur->userid == GetUserId() &&
+				 cur->nwaiters < SPAWN_REQUEST_MAX_WAITERS)
+		{
+			request_idx = i;
+			*merged = true;
+			break;
+		}
+	}
+
+	/* Else create a new one */
+	if (request_idx < 0 && free_request_idx >= 0)
+	{
+		request_idx = free_request_idx;
+		request = &spawn_queue->requests[request_idx];
+
+		request->status = SPR_PENDING;
+		request->userid = GetUserId();
+		request->result = InvalidOid;
+		request->dbid = MyDatabaseId;
+		request->partitioned_table = relid;
+		request->nwaiters = 0;
+
+		/* Write value-related stuff */
+		request->value_type = value_type;
+		request->value_size = value_size;
+		request->value_byval = value_byval;
+
+		PackDatumToByteArray((void *) request->value, value,
+							 value_size, value_byval);
+	}
+
+	/* Queue is full */
+	if (request_idx < 0)
+	{
+		SpinLockRelease(&spawn_queue->mutex);
+		return -1;
+	}
+
+	request = &spawn_queue->requests[request_idx];
+	request->waiters[request->nwaiters++] = MyLatch;
+
+	/* Find an idle worker of this database (or a free slot) */
+	for (i = 0; i < SPAWN_WORKER_SLOTS; i++)
+	{
+		SpawnWorkerSlot *slot = &spawn_queue->workers[i];
+
+		if (slot->worker_status == SPW_FREE)
+		{
+			if (free_worker_idx < 0)
+				free_worker_idx = i;
+		}
+		else if (slot->dbid == MyDatabaseId)
+		{
+			if (slot->worker_status == SPW_IDLE && !idle_worker)
+				idle_worker = slot->latch;
+
+			nworkers++;
+		}
+	}
+
+	/* All workers are busy, start one more if possible */
+	if (request->status == SPR_PENDING && !idle_worker &&
+		nworkers < SPAWN_WORKERS_PER_DB && free_worker_idx >= 0)
+	{
+		SpawnWorkerSlot *slot = &spawn_queue->workers[free_worker_idx];
+
+		slot->worker_status = SPW_STARTING;
+		slot->dbid = MyDatabaseId;
+		slot->pid = 0;
+		slot->latch = NULL;
+		slot->generation++;
+
+		*new_worker = free_worker_idx;
+		*generation = slot->generation;
+		nworkers++;
+	}
+
+	/* Nobody will process this request, back off */
+	if (nworkers == 0)
+	{
+		request->nwaiters--;
+		if (request->nwaiters == 0)
+			request->status = SPR_FREE;
+
+		request_idx = -1;
+	}
+
+	SpinLockRelease(&spawn_queue->mutex);
+
+	/* Wake up the idle worker */
+	if (idle_worker)
+		SetLatch(idle_worker);
+
+	return request_idx;
+}
+
+/*
+ * Stop waiting for a request (free it if we were the last waiter).
+ */
+static void
+detach_spawn_request(int request_idx)
+{
+	SpawnPartitionRequest  *request = &spawn_queue->requests[request_idx];
+	int						i;
+
+	SpinLockAcquire(&spawn_queue->mutex);
+
+	for (i = 0; i < request->nwaiters; i++)
+	{
+		if (request->waiters[i] == MyLatch)
+		{
+			request->waiters[i] = request->waiters[--request->nwaiters];
+			break;
+		}
+	}
+
+	/* Worker will free a request which is being processed */
+	if (request->nwaiters == 0 &&
+		(request->status == SPR_PENDING || request->status == SPR_DONE))
+		request->status = SPR_FREE;
+
+	SpinLockRelease(&spawn_queue->mutex);
+}
+
+/*
+ * Detach from a request in case of ERROR.
+ */
+static void
+spawn_request_cleanup_callback(int code, Datum arg)
+{
+	detach_spawn_request(DatumGetInt32(arg));
+}
+
+/*
+ * Start a worker for the slot reserved by enqueue_spawn_request().
+ * We wait till it starts, since this happens once in a while.
+ */
+static void
+start_spawn_worker(int slot_idx, uint32 generation)
+{
+	SpawnWorkerSlot		   *slot = &spawn_queue->workers[slot_idx];
+	BackgroundWorker		worker;
+	BackgroundWorkerHandle *bgw_handle;
+	BgwHandleStatus			bgw_status = BGWH_STOPPED;
+	pid_t					pid;
+
+	init_bg_worker_struct(&worker, spawn_partitions_bgw,
+						  CppAsString(bgw_main_spawn_partitions),
+						  Int32GetDatum(slot_idx),
+						  &generation, sizeof(uint32));
+
+	if (RegisterDynamicBackgroundWorker(&worker, &bgw_handle))
+		bgw_status = WaitForBackgroundWorkerStartup(bgw_handle, &pid);
+
+	if (bgw_status == BGWH_POSTMASTER_DIED)
+		ereport(ERROR,
+				(errmsg("Postmaster died during the pg_pathman background worker process"),
+				 errhint("More details may be available in the server log.")));
+
+	/* Release the slot if worker has never run */
+	if (bgw_status != BGWH_STARTED)
+	{
+		SpinLockAcquire(&spawn_queue->mutex);
+		if (slot->worker_status == SPW_STARTING &&
+			slot->generation == generation &&
+			slot->pid == 0)
+		{
+			slot->worker_status = SPW_FREE;
+		}
+		SpinLockRelease(&spawn_queue->mutex);
+
+		elog(LOG, "Unable to create background %s for pg_pathman",
+			 spawn_partitions_bgw);
+
+		/* Waiters will have to do it by themselves */
+		fail_orphaned_spawn_requests();
+	}
+}
+
+/*
+ * Find partition for 'value' created by some worker.
+ */
+static Oid
+find_spawned_partition(Oid relid, Datum value, Oid value_type)
+{
+	const PartRelationInfo *prel;
+	Oid					   *parts;
+	int						nparts;
+	Oid						partid = InvalidOid;
+
+	/* Make sure we see new partitions */
+	AcceptInvalidationMessages();
+	invalidate_pathman_relation_info(relid, NULL);
+
+	prel = get_pathman_relation_info(relid);
+	shout_if_prel_is_invalid(relid, prel, PT_RANGE);
+
+	parts = find_partitions_for_value(value, value_type, prel, &nparts);
+	if (nparts == 1)
+		partid = parts[0];
+
+	pfree(parts);
+
+	return partid;
+}
+
+/*
+ * Ask the pool of background workers to create partitions for 'value',
+ * wait till it finishes the job and return the result (new partition oid).
+ * Partitions are created by backend if pool can't do this.
  *
  * NB: This function should not be called directly, use create_partitions() instead.
  */
 Oid
 create_partitions_for_value_bg_worker(Oid relid, Datum value, Oid value_type)
 {
-	dsm_segment			   *segment;
-	dsm_handle				segment_handle;
-	SpawnPartitionArgs	   *bgw_args;
-	Oid						child_oid = InvalidOid;
+	TypeCacheEntry		   *typcache;
+	Size					value_size;
+
+	typcache = lookup_type_cache(value_type, 0);
+	value_size = datumGetSize(value, typcache->typbyval, typcache->typlen);
+
+	/* Large values don't fit into the queue */
+	while (value_size <= SPAWN_REQUEST_VALUE_SIZE)
+	{
+		Oid		child_oid = InvalidOid;
+		bool	merged;
+		int		request_idx,
+				new_worker;
+		uint32	generation;
+
+		request_idx = enqueue_spawn_request(relid, value, value_type,
+											value_size, typcache->typbyval,
+											&merged, &new_worker, &generation);
+
+		/* Queue is full or there are no workers */
+		if (request_idx < 0)
+			break;
+
+		PG_ENSURE_ERROR_CLEANUP(spawn_request_cleanup_callback,
+								Int32GetDatum(request_idx));
+		{
+			if (new_worker >= 0)
+				start_spawn_worker(new_worker, generation);
+
+			/* Wait till some worker processes our request */
+			for (;;)
+			{
+				SpawnPartitionRequestStatus	status;
+				int							rc;
+
+				SpinLockAcquire(&spawn_queue->mutex);
+				status = spawn_queue->requests[request_idx].status;
+				child_oid = spawn_queue->requests[request_idx].result;
+				SpinLockRelease(&spawn_queue->mutex);
+
+				if (status == SPR_DONE)
+					break;
+
+				rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, 0);
+				ResetLatch(MyLatch);
+
+				if (rc & WL_POSTMASTER_DEATH)
+					ereport(ERROR,
+							(errmsg("Postmaster died during the pg_pathman background worker process"),
+							 errhint("More details may be available in the server log.")));
+
+				CHECK_FOR_INTERRUPTS();
+			}
+		}
+		PG_END_ENSURE_ERROR_CLEANUP(spawn_request_cleanup_callback,
+									Int32GetDatum(request_idx));
+
+		detach_spawn_request(request_idx);
+
+		/* Worker has failed, see server log */
+		if (!OidIsValid(child_oid))
+			break;
+
+		if (!merged)
+			return child_oid;
+
+		/* Joined request might have been issued for another value */
+		if ((child_oid = find_spawned_partition(relid, value, value_type)) != InvalidOid)
+			return child_oid;
+	}
+
+	elog(DEBUG2, "create_partitions(): pool of BGWorkers is not available [%u]",
+		 MyProcPid);
+
+	return create_partitions_for_value_internal(relid, value, value_type,
+												false); /* backend */
+}
+
+/*
+ * Take a pending request of this database (or become idle).
+ */
+static int
+take_spawn_request(int slot_idx)
+{
+	int		request_idx = -1,
+			i;
+
+	SpinLockAcquire(&spawn_queue->mutex);
+
+	for (i = 0; i < SPAWN_REQUEST_SLOTS; i++)
+	{
+		SpawnPartitionRequest *request = &spawn_queue->requests[i];
+
+		if (request->status == SPR_PENDING && request->dbid == MyDatabaseId)
+		{
+			request->status = SPR_WORKING;
+			request_idx = i;
+			break;
+		}
+	}
+
+	spawn_queue->workers[slot_idx].worker_status = (request_idx >= 0) ?
+														SPW_WORKING :
+														SPW_IDLE;
+
+	/* Exit callback will fail this request if we die */
+	current_spawn_request = request_idx;
+
+	SpinLockRelease(&spawn_queue->mutex);
+
+	return request_idx;
+}
+
+/*
+ * Free our slot unless there are pending requests.
+ */
+static bool
+retire_spawn_worker(int slot_idx)
+{
+	SpawnWorkerSlot	   *slot = &spawn_queue->workers[slot_idx];
+	bool				retired = true;
+	int					i;
+
+	SpinLockAcquire(&spawn_queue->mutex);
+
+	for (i = 0; i < SPAWN_REQUEST_SLOTS; i++)
+	{
+		SpawnPartitionRequest *request = &spawn_queue->requests[i];
+
+		if (request->status == SPR_PENDING && request->dbid == MyDatabaseId)
+		{
+			retired = false;
+			break;
+		}
+	}
+
+	if (retired)
+	{
+		slot->worker_status = SPW_FREE;
+		slot->pid = 0;
+		slot->latch = NULL;
+	}
+
+	SpinLockRelease(&spawn_queue->mutex);
+
+	return retired;
+}
+
+/*
+ * Free slot of SpawnPartitionsWorker and fail its request on exit.
+ */
+static void
+spawn_worker_shmem_exit(int code, Datum arg)
+{
+	SpawnWorkerSlot *slot = &spawn_queue->workers[DatumGetInt32(arg)];
+
+	SpinLockAcquire(&spawn_queue->mutex);
+	if (slot->pid == MyProcPid)
+	{
+		slot->worker_status = SPW_FREE;
+		slot->pid = 0;
+		slot->latch = NULL;
+	}
+	SpinLockRelease(&spawn_queue->mutex);
+
+	if (current_spawn_request >= 0)
+		finish_spawn_request(current_spawn_request, InvalidOid, false);
+
+	/* We might have been the last worker of this database */
+	fail_orphaned_spawn_requests();
+}
+
+/*
+ * Create partitions for a request in a separate transaction.
+ */
+static void
+process_spawn_request(int request_idx)
+{
+	SpawnPartitionRequest	args;
+	MemoryContext			old_mcxt;
+	Oid						result = InvalidOid,
+							save_userid;
+	int						save_sec_context;
+
+	/* Args are not modified while request is being processed */
+	SpinLockAcquire(&spawn_queue->mutex);
+	memcpy(&args, &spawn_queue->requests[request_idx], sizeof(args));
+	SpinLockRelease(&spawn_queue->mutex);
+
+	/* Start new transaction (syscache access etc.) */
+	StartTransactionCommand();
+
+	/* We'll need this to recover from errors */
+	old_mcxt = CurrentMemoryContext;
+
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+
+	PG_TRY();
+	{
+		Datum	value;
+
+		/* Finish invalidation jobs accumulated while we were idle */
+		if (IsPathmanReady())
+			finish_delayed_invalidation();
 
-	/* Create a dsm segment for the worker to pass arguments */
-	segment = create_partitions_bg_worker_segment(relid, value, value_type);
-	segment_handle = dsm_segment_handle(segment);
-	bgw_args = (SpawnPartitionArgs *) dsm_segment_address(segment);
+		/* pg_pathman might have been recreated */
+		if (!IsPathmanInitialized())
+			bg_worker_load_config(spawn_partitions_bgw);
 
-#if PG_VERSION_NUM >= 90600
-	/* Become locking group leader */
-	BecomeLockGroupLeader();
+		/* Partitions are created on behalf of the requesting user */
+		SetUserIdAndSecContext(args.userid, save_sec_context |
+											SECURITY_LOCAL_USERID_CHANGE);
+
+		/* Upack Datum from request to 'value' */
+		UnpackDatumFromByteArray(&value,
+								 args.value_size,
+								 args.value_byval,
+								 (const void *) args.value);
+
+/* Print 'arg->value' for debug purposes */
+#ifdef USE_ASSERT_CHECKING
+		elog(LOG, "%s: arg->value is '%s' [%u]",
+			 spawn_partitions_bgw,
+			 DebugPrintDatum(value, args.value_type), MyProcPid);
 #endif
 
-	/* Start worker and wait for it to finish */
-	start_bg_worker(spawn_partitions_bgw,
-					CppAsString(bgw_main_spawn_partitions),
-					UInt32GetDatum(segment_handle),
-					true);
+		/* Create partitions and save the Oid of the last one */
+		result = create_partitions_for_value_internal(args.partitioned_table,
+													  value, /* unpacked Datum */
+													  args.value_type,
+													  true); /* background woker */
+	}
+	PG_CATCH();
+	{
+		ErrorData  *error;
 
-	/* Save the result (partition Oid) */
-	child_oid = bgw_args->result;
+		/* Switch to the original context & copy edata */
+		MemoryContextSwitchTo(old_mcxt);
+		error = CopyErrorData();
+		FlushErrorState();
 
-	/* Free dsm segment */
-	dsm_detach(segment);
+		/* Print messsage for this BGWorker to server log */
+		ereport(LOG,
+				(errmsg("%s: %s", spawn_partitions_bgw, error->message),
+				 errdetail("relation: %u", args.partitioned_table)));
 
-	if (child_oid == InvalidOid)
-		ereport(ERROR,
-				(errmsg("Attempt to spawn new partitions of relation \"%s\" failed",
-						get_rel_name_or_relid(relid)),
-				 errhint("See server log for more details.")));
+		FreeErrorData(error);
+
+		result = InvalidOid;
+	}
+	PG_END_TRY();
+
+	/* Restore user's privileges */
+	SetUserIdAndSecContext(save_userid, save_sec_context);
 
-	return child_oid;
+	/* Finish transaction in an appropriate way */
+	if (result == InvalidOid)
+		AbortCurrentTransaction();
+	else
+		CommitTransactionCommand();
+
+	/* Wake up waiters (partitions have been committed) */
+	finish_spawn_request(request_idx, result, false);
+	current_spawn_request = -1;
 }
 
 /*
  * Entry point for SpawnPartitionsWorker's process.
+ * Worker serves requests of a single database until it's idle
+ * for "pg_pathman.spawn_worker_idle_timeout" seconds.
  */
 void
 bgw_main_spawn_partitions(Datum main_arg)
 {
-	dsm_handle				handle = DatumGetUInt32(main_arg);
-	dsm_segment			   *segment;
-	SpawnPartitionArgs	   *args;
-	Datum					value;
+	int					slot_idx = DatumGetInt32(main_arg);
+	SpawnWorkerSlot	   *slot = &spawn_queue->workers[slot_idx];
+	uint32				generation;
+	Oid					dbid;
+
+	/* Free our slot on exit */
+	before_shmem_exit(spawn_worker_shmem_exit, main_arg);
 
 	/* Establish signal handlers before unblocking signals. */
 	pqsignal(SIGTERM, handle_sigterm);
+	pqsignal(SIGHUP, handle_sighup);
 
 	/* We're now ready to receive signals */
 	BackgroundWorkerUnblockSignals();
@@ -350,58 +1008,68 @@ bgw_main_spawn_partitions(Datum main_arg)
 	/* Create resource owner */
 	CurrentResourceOwner = ResourceOwnerCreate(NULL, spawn_partitions_bgw);
 
-	if (!handle)
-		elog(ERROR, "%s: invalid dsm_handle [%u]",
-			 spawn_partitions_bgw, MyProcPid);
+	/* Fetch generation of our slot passed via 'bgw_extra' */
+	memcpy(&generation, MyBgworkerEntry->bgw_extra, sizeof(uint32));
 
-	/* Attach to dynamic shared memory */
-	if ((segment = dsm_attach(handle)) == NULL)
-		elog(ERROR, "%s: cannot attach to segment [%u]",
-			 spawn_partitions_bgw, MyProcPid);
-	args = dsm_segment_address(segment);
-
-#if PG_VERSION_NUM >= 90600
-	/* Join locking group. If we can't join the group, quit */
-	if (!BecomeLockGroupMember(args->parallel_master_pgproc,
-							   args->parallel_master_pid))
-		return;
-#endif
-	/* Establish connection and start transaction */
+	/* Occupy the slot reserved for us */
+	SpinLockAcquire(&spawn_queue->mutex);
+	if (slot->worker_status == SPW_STARTING && slot->generation == generation)
+	{
+		slot->pid = MyProcPid;
+		slot->latch = MyLatch;
+	}
+	dbid = slot->dbid;
+	SpinLockRelease(&spawn_queue->mutex);
 
-	BackgroundWorkerInitializeConnectionByOid(args->dbid, args->userid);
+	if (slot->pid != MyProcPid)
+		elog(ERROR, "%s: slot %d has been released [%u]",
+			 spawn_partitions_bgw, slot_idx, MyProcPid);
 
-	/* Start new transaction (syscache access etc.) */
-	StartTransactionCommand();
+	/* Establish connection (users are switched per request) */
+	BackgroundWorkerInitializeConnectionByOid(dbid, BOOTSTRAP_SUPERUSERID);
 
 	/* Initialize pg_pathman's local config */
+	StartTransactionCommand();
 	bg_worker_load_config(spawn_partitions_bgw);
+	CommitTransactionCommand();
 
-	/* Upack Datum from segment to 'value' */
-	UnpackDatumFromByteArray(&value,
-							 args->value_size,
-							 args->value_byval,
-							 (const void *) args->value);
+	for (;;)
+	{
+		int		request_idx,
+				rc;
 
-/* Print 'arg->value' for debug purposes */
-#ifdef USE_ASSERT_CHECKING
-	elog(LOG, "%s: arg->value is '%s' [%u]",
-		 spawn_partitions_bgw,
-		 DebugPrintDatum(value, args->value_type), MyProcPid);
-#endif
+		CHECK_FOR_INTERRUPTS();
+
+		/* Reload config file if we've been asked to */
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
 
-	/* Create partitions and save the Oid of the last one */
-	args->result = create_partitions_for_value_internal(args->partitioned_table,
-														value, /* unpacked Datum */
-														args->value_type,
-														true); /* background woker */
+		if ((request_idx = take_spawn_request(slot_idx)) >= 0)
+		{
+			process_spawn_request(request_idx);
+			continue;
+		}
 
-	/* Finish transaction in an appropriate way */
-	if (args->result == InvalidOid)
-		AbortCurrentTransaction();
-	else
-		CommitTransactionCommand();
+		/* Sleep till somebody needs us */
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   pg_pathman_spawn_worker_idle_timeout * 1000L);
+		ResetLatch(MyLatch);
+
+		/* Emergency bailout if postmaster has died */
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		/* Exit if we've been idle for too long */
+		if ((rc & WL_TIMEOUT) && retire_spawn_worker(slot_idx))
+			break;
+	}
 
-	dsm_detach(segment);
+	elog(LOG, "%s: exiting due to inactivity [%u]",
+		 spawn_partitions_bgw, MyProcPid);
 }
 
 
@@ -411,6 +1079,105 @@ bgw_main_spawn_partitions(Datum main_arg)
  * -------------------------------------
  */
 
+/*
+ * Disable parent of 'relid' once ConcurrentPartWorker has moved all of its
+ * rows, so that planner won't scan it anymore (see set_enable_parent()).
+ *
+ * Transactions which are older than the last batch might still see moved
+ * rows in the parent, so we wait for them first (like CREATE INDEX
+ * CONCURRENTLY does). Then we make sure that nobody has put new rows into
+ * the parent, holding a lock which blocks concurrent writes.
+ */
+static void
+cp_disable_empty_parent(Oid relid)
+{
+	MemoryContext	old_mcxt;
+	bool			failed = false;
+
+	/* Start new transaction (syscache access etc.) */
+	StartTransactionCommand();
+
+	/* We'll need this to recover from errors */
+	old_mcxt = CurrentMemoryContext;
+
+	PG_TRY();
+	{
+		const PartRelationInfo *prel = get_pathman_relation_info(relid);
+
+		if (prel && prel->enable_parent)
+		{
+			VirtualTransactionId   *old_snapshots;
+			int						n_old_snapshots,
+									i;
+			char				   *sql;
+
+			old_snapshots = GetCurrentVirtualXIDs(ReadNewTransactionId(),
+												  true, false,
+												  PROC_IS_AUTOVACUUM | PROC_IN_VACUUM,
+												  &n_old_snapshots);
+
+			for (i = 0; i < n_old_snapshots; i++)
+			{
+				CHECK_FOR_INTERRUPTS();
+
+				if (VirtualTransactionIdIsValid(old_snapshots[i]))
+					VirtualXactLock(old_snapshots[i], true);
+			}
+
+			/* Block writers until we're done */
+			LockRelationOid(relid, ShareLock);
+
+			sql = psprintf("SELECT %s.set_enable_parent($1, false) "
+						   "WHERE NOT EXISTS (SELECT * FROM ONLY %s)",
+						   quote_identifier(get_namespace_name(get_pathman_schema())),
+						   quote_qualified_identifier(get_namespace_name(get_rel_namespace(relid)),
+													  get_rel_name(relid)));
+
+			SPI_connect();
+			PushActiveSnapshot(GetTransactionSnapshot());
+
+			{
+				Oid		types[1]	= { REGCLASSOID };
+				Datum	vals[1]		= { ObjectIdGetDatum(relid) };
+				bool	nulls[1]	= { false };
+
+				SPI_execute_with_args(sql, 1, types, vals, nulls, false, 0);
+
+				if (SPI_processed > 0)
+					elog(LOG, "%s: parent of relation %u has been disabled",
+						 concurrent_part_bgw, relid);
+			}
+
+			PopActiveSnapshot();
+			SPI_finish();
+		}
+	}
+	PG_CATCH();
+	{
+		ErrorData  *error;
+
+		/* Switch to the original context & copy edata */
+		MemoryContextSwitchTo(old_mcxt);
+		error = CopyErrorData();
+		FlushErrorState();
+
+		/* Parent will be scanned as before */
+		ereport(LOG,
+				(errmsg("%s: %s", concurrent_part_bgw, error->message),
+				 errdetail("could not disable parent of relation %u", relid)));
+
+		FreeErrorData(error);
+
+		failed = true;
+	}
+	PG_END_TRY();
+
+	if (failed)
+		AbortCurrentTransaction();
+	else
+		CommitTransactionCommand();
+}
+
 /*
  * Entry point for ConcurrentPartWorker's process.
  */
@@ -418,7 +1185,8 @@ void
 bgw_main_concurrent_part(Datum main_arg)
 {
 	int					rows;
-	bool				failed;
+	bool				failed,
+						stopped = false;
 	int					failures_count = 0;
 	char			   *sql = NULL;
 	ConcurrentPartSlot *part_slot;
@@ -599,10 +1367,17 @@ bgw_main_concurrent_part(Datum main_arg)
 
 		/* If other backend requested to stop us, quit */
 		if (cps_check_status(part_slot) == CPS_STOPPING)
+		{
+			stopped = true;
 			break;
+		}
 	}
 	while(rows > 0 || failed); /* do while there's still rows to be relocated */
 
+	/* All rows have been moved, parent doesn't have to be scanned */
+	if (!stopped)
+		cp_disable_empty_parent(part_slot->relid);
+
 	/* Reclaim the resources */
 	pfree(sql);
 
@@ -715,6 +1490,7 @@ partition_table_concurrently(PG_FUNCTION_ARGS)
 	start_bg_worker(concurrent_part_bgw,
 					CppAsString(bgw_main_concurrent_part),
 					Int32GetDatum(empty_slot_idx),
+					NULL, 0,
 					false);
 
 	/* Tell user everything's fine */
@@ -878,3 +1654,517 @@ stop_concurrent_part_task(PG_FUNCTION_ARGS)
 		PG_RETURN_BOOL(false); /* keep compiler happy */
 	}
 }
+
+
+/*
+ * ---------------------------------
+ *  ZoneMapsWorker implementation
+ * ---------------------------------
+ */
+
+/*
+ * Entry point for ZoneMapsWorker's process.
+ * Each partition is refreshed in a separate transaction.
+ */
+void
+bgw_main_refresh_zone_maps(Datum main_arg)
+{
+	ZoneMapsWorkerArgs		args;
+	const PartRelationInfo *prel;
+	Oid					   *children = NULL;
+	uint32					nchildren = 0,
+							i;
+	int						refreshed = 0;
+	char				   *sql;
+
+	/* Establish signal handlers before unblocking signals. */
+	pqsignal(SIGTERM, handle_sigterm);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	/* Create resource owner */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, zone_maps_bgw);
+
+	/* Fetch args passed via 'bgw_extra' */
+	memcpy(&args, MyBgworkerEntry->bgw_extra, sizeof(ZoneMapsWorkerArgs));
+
+	/* Establish connection and start transaction */
+	BackgroundWorkerInitializeConnectionByOid(args.dbid, args.userid);
+
+	/* Initialize pg_pathman's local config */
+	StartTransactionCommand();
+	bg_worker_load_config(zone_maps_bgw);
+
+	/* Remember partitions, they will be refreshed one by one */
+	if ((prel = get_pathman_relation_info(args.relid)) != NULL)
+	{
+		nchildren = PrelChildrenCount(prel);
+		children = MemoryContextAlloc(TopMemoryContext,
+									  Max(nchildren, 1) * sizeof(Oid));
+		memcpy(children, PrelGetChildrenArray(prel), nchildren * sizeof(Oid));
+	}
+	else elog(LOG, "relation %u is not partitioned (or does not exist)",
+			  args.relid);
+
+	sql = MemoryContextStrdup(TopMemoryContext,
+							  psprintf("SELECT %s.refresh_partition_zone_map($1::regclass, true)",
+									   quote_identifier(get_namespace_name(get_pathman_schema()))));
+	CommitTransactionCommand();
+
+	for (i = 0; i < nchildren; i++)
+	{
+		MemoryContext	old_mcxt;
+		bool			failed = false;
+
+		Oid		types[1]	= { OIDOID };
+		Datum	vals[1]		= { ObjectIdGetDatum(children[i]) };
+		bool	nulls[1]	= { false };
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Start new transaction (syscache access etc.) */
+		StartTransactionCommand();
+
+		/* We'll need this to recover from errors */
+		old_mcxt = CurrentMemoryContext;
+
+		SPI_connect();
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		/* Exec ret = refresh_partition_zone_map() */
+		PG_TRY();
+		{
+			/* Partition might have been dropped */
+			if (SearchSysCacheExists1(RELOID, ObjectIdGetDatum(children[i])) &&
+				SPI_execute_with_args(sql, 1, types, vals, nulls,
+									  false, 0) == SPI_OK_SELECT)
+			{
+				bool	isnull;
+				Datum	ret;
+
+				Assert(SPI_processed == 1);
+
+				ret = SPI_getbinval(SPI_tuptable->vals[0],
+									SPI_tuptable->tupdesc,
+									1, &isnull);
+
+				if (!isnull && DatumGetBool(ret))
+					refreshed++;
+			}
+		}
+		PG_CATCH();
+		{
+			ErrorData  *error;
+
+			/* Switch to the original context & copy edata */
+			MemoryContextSwitchTo(old_mcxt);
+			error = CopyErrorData();
+			FlushErrorState();
+
+			/* Print messsage for this BGWorker to server log */
+			ereport(LOG,
+					(errmsg("%s: %s", zone_maps_bgw, error->message),
+					 errdetail("partition: %u", children[i])));
+
+			FreeErrorData(error);
+
+			/* Set 'failed' flag */
+			failed = true;
+		}
+		PG_END_TRY();
+
+		SPI_finish();
+		PopActiveSnapshot();
+
+		/* Skip this partition if we've failed */
+		if (failed)
+			AbortCurrentTransaction();
+		else
+			CommitTransactionCommand();
+	}
+
+	elog(LOG, "%s: refreshed zone maps of %d partitions of relation %u [%u]",
+		 zone_maps_bgw, refreshed, args.relid, MyProcPid);
+
+	/* Reclaim the resources */
+	pfree(sql);
+	if (children)
+		pfree(children);
+}
+
+/*
+ * Start a worker which refreshes stale zone maps of partitions.
+ * NOTE: this function returns immediately.
+ */
+Datum
+refresh_zone_maps_concurrently(PG_FUNCTION_ARGS)
+{
+	Oid					relid = PG_GETARG_OID(0);
+	ZoneMapsWorkerArgs	args;
+
+	/* Check if relation is a partitioned table */
+	shout_if_prel_is_invalid(relid,
+							 get_pathman_relation_info(relid),
+							 /* Partitioning type does not matter here */
+							 PT_INDIFFERENT);
+
+	args.userid	= GetUserId();
+	args.dbid	= MyDatabaseId;
+	args.relid	= relid;
+
+	/* Start worker (we should not wait) */
+	start_bg_worker(zone_maps_bgw,
+					CppAsString(bgw_main_refresh_zone_maps),
+					(Datum) 0,
+					&args, sizeof(ZoneMapsWorkerArgs),
+					false);
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * -------------------------------
+ *  PremakeWorker implementation
+ * -------------------------------
+ */
+
+/*
+ * PremakeWorker holds a session lock on this sub-object of
+ * PATHMAN_CONFIG_PARAMS, thus only one worker serves a database.
+ */
+#define PREMAKE_WORKER_LOCK_OBJSUBID	1
+
+/*
+ * Entry point for PremakeWorker's process.
+ *
+ * Each round we fetch tables which have 'premake' set in
+ * PATHMAN_CONFIG_PARAMS and create missing partitions for
+ * each of them in a separate transaction. Worker exits when
+ * there are no such tables left.
+ */
+void
+bgw_main_premake_partitions(Datum main_arg)
+{
+	PremakeWorkerArgs	args;
+	LOCKTAG				tag;
+	bool				lock_held = true;
+	char			   *select_sql,
+					   *premake_sql;
+
+	/* Establish signal handlers before unblocking signals. */
+	pqsignal(SIGTERM, handle_sigterm);
+	pqsignal(SIGHUP, handle_sighup);
+
+	/* We're now ready to receive signals */
+	BackgroundWorkerUnblockSignals();
+
+	/* Create resource owner */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, premake_bgw);
+
+	/* Fetch args passed via 'bgw_extra' */
+	memcpy(&args, MyBgworkerEntry->bgw_extra, sizeof(PremakeWorkerArgs));
+
+	/* Establish connection and start transaction */
+	BackgroundWorkerInitializeConnectionByOid(args.dbid, args.userid);
+
+	/* Initialize pg_pathman's local config */
+	StartTransactionCommand();
+	bg_worker_load_config(premake_bgw);
+
+	/* Exit if this database is already being served */
+	SET_LOCKTAG_OBJECT(tag, MyDatabaseId, RelationRelationId,
+					   get_pathman_config_params_relid(false),
+					   PREMAKE_WORKER_LOCK_OBJSUBID);
+	if (LockAcquire(&tag, ExclusiveLock, true, true) == LOCKACQUIRE_NOT_AVAIL)
+	{
+		CommitTransactionCommand();
+
+		elog(LOG, "%s: database %u is served by another worker [%u]",
+			 premake_bgw, MyDatabaseId, MyProcPid);
+		return;
+	}
+
+	select_sql = MemoryContextStrdup(TopMemoryContext,
+									 psprintf("SELECT partrel, premake FROM %s.%s "
+											  "WHERE premake IS NOT NULL AND auto",
+											  quote_identifier(get_namespace_name(get_pathman_schema())),
+											  PATHMAN_CONFIG_PARAMS));
+	premake_sql = MemoryContextStrdup(TopMemoryContext,
+									  psprintf("SELECT %s.premake_partitions($1::regclass, $2)",
+											   quote_identifier(get_namespace_name(get_pathman_schema()))));
+	CommitTransactionCommand();
+
+	for (;;)
+	{
+		Oid	   *relids = NULL;
+		int32  *premakes = NULL;
+		uint64	ntables = 0,
+				i;
+		int		rc;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Reload config file if we've been asked to */
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/* Fetch tables which need partitions in advance */
+		StartTransactionCommand();
+		SPI_connect();
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		/* pg_pathman might have been dropped */
+		if (OidIsValid(get_pathman_config_params_relid(true)) &&
+			SPI_execute(select_sql, true, 0) == SPI_OK_SELECT)
+		{
+			ntables = SPI_processed;
+
+			if (ntables > 0)
+			{
+				relids = MemoryContextAlloc(TopMemoryContext,
+											ntables * sizeof(Oid));
+				premakes = MemoryContextAlloc(TopMemoryContext,
+											  ntables * sizeof(int32));
+			}
+
+			for (i = 0; i < ntables; i++)
+			{
+				HeapTuple	tuple = SPI_tuptable->vals[i];
+				TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+				bool		isnull;
+
+				relids[i] = DatumGetObjectId(SPI_getbinval(tuple, tupdesc,
+														   1, &isnull));
+				premakes[i] = DatumGetInt32(SPI_getbinval(tuple, tupdesc,
+														  2, &isnull));
+			}
+		}
+
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+
+		/*
+		 * Nothing to do, worker will be restarted by set_premake(). However,
+		 * it exits if it sees our lock, so we have to look for new tables
+		 * once again after releasing it.
+		 */
+		if (ntables == 0)
+		{
+			if (lock_held)
+			{
+				LockRelease(&tag, ExclusiveLock, true);
+				lock_held = false;
+				continue;
+			}
+
+			elog(LOG, "%s: no tables to create partitions for in database %u [%u]",
+				 premake_bgw, MyDatabaseId, MyProcPid);
+			break;
+		}
+
+		/* Somebody might have taken over this database meanwhile */
+		if (!lock_held)
+		{
+			if (LockAcquire(&tag, ExclusiveLock, true, true) == LOCKACQUIRE_NOT_AVAIL)
+			{
+				pfree(relids);
+				pfree(premakes);
+
+				elog(LOG, "%s: database %u is served by another worker [%u]",
+					 premake_bgw, MyDatabaseId, MyProcPid);
+				break;
+			}
+
+			lock_held = true;
+		}
+
+		for (i = 0; i < ntables; i++)
+		{
+			MemoryContext	old_mcxt;
+			Oid				save_userid;
+			int				save_sec_context;
+			bool			failed = false;
+
+			Oid		types[2]	= { OIDOID, INT4OID };
+			Datum	vals[2]		= { ObjectIdGetDatum(relids[i]),
+									Int32GetDatum(premakes[i]) };
+			bool	nulls[2]	= { false, false };
+
+			CHECK_FOR_INTERRUPTS();
+
+			/* Start new transaction (syscache access etc.) */
+			StartTransactionCommand();
+
+			/* We'll need this to recover from errors */
+			old_mcxt = CurrentMemoryContext;
+
+			SPI_connect();
+			PushActiveSnapshot(GetTransactionSnapshot());
+
+			/* Partitions are created on behalf of table's owner */
+			GetUserIdAndSecContext(&save_userid, &save_sec_context);
+
+			/* Exec ret = premake_partitions() */
+			PG_TRY();
+			{
+				Oid		owner = get_rel_owner(relids[i]);
+
+				/* Table might have been dropped */
+				if (OidIsValid(owner))
+				{
+					SetUserIdAndSecContext(owner, save_sec_context |
+												  SECURITY_LOCAL_USERID_CHANGE);
+
+					SPI_execute_with_args(premake_sql, 2, types, vals, nulls,
+										  false, 0);
+				}
+			}
+			PG_CATCH();
+			{
+				ErrorData  *error;
+
+				/* Switch to the original context & copy edata */
+				MemoryContextSwitchTo(old_mcxt);
+				error = CopyErrorData();
+				FlushErrorState();
+
+				/* Print messsage for this BGWorker to server log */
+				ereport(LOG,
+						(errmsg("%s: %s", premake_bgw, error->message),
+						 errdetail("relation: %u", relids[i])));
+
+				FreeErrorData(error);
+
+				/* Set 'failed' flag */
+				failed = true;
+			}
+			PG_END_TRY();
+
+			/* Restore user's privileges */
+			SetUserIdAndSecContext(save_userid, save_sec_context);
+
+			SPI_finish();
+			PopActiveSnapshot();
+
+			/* Skip this table if we've failed */
+			if (failed)
+				AbortCurrentTransaction();
+			else
+				CommitTransactionCommand();
+		}
+
+		pfree(relids);
+		pfree(premakes);
+
+		/* Sleep till the next round */
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   pg_pathman_premake_naptime * 1000L);
+		ResetLatch(MyLatch);
+
+		/* Emergency bailout if postmaster has died */
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+	}
+
+	/* Reclaim the resources */
+	pfree(select_sql);
+	pfree(premake_sql);
+}
+
+/*
+ * Register PremakeWorker for current database (it will exit
+ * immediately if there's one already). Failure to register
+ * a worker is reported with 'elevel'.
+ */
+static void
+register_premake_worker(int elevel)
+{
+	BackgroundWorker		worker;
+	BackgroundWorkerHandle *bgw_handle;
+	PremakeWorkerArgs		args;
+
+	/* Worker has to see all tables of this database */
+	args.userid	= BOOTSTRAP_SUPERUSERID;
+	args.dbid	= MyDatabaseId;
+
+	init_bg_worker_struct(&worker, premake_bgw,
+						  CppAsString(bgw_main_premake_partitions),
+						  (Datum) 0,
+						  &args, sizeof(PremakeWorkerArgs));
+
+	if (!RegisterDynamicBackgroundWorker(&worker, &bgw_handle))
+		elog(elevel, "Unable to create background %s for pg_pathman",
+			 premake_bgw);
+}
+
+/*
+ * Register PremakeWorker once current transaction commits.
+ */
+static void
+premake_worker_xact_callback(XactEvent event, void *arg)
+{
+	if (!premake_worker_pending)
+		return;
+
+	switch (event)
+	{
+		/* We can't throw ERROR after commit */
+		case XACT_EVENT_COMMIT:
+			premake_worker_pending = false;
+			register_premake_worker(WARNING);
+			break;
+
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PREPARE:
+			premake_worker_pending = false;
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Start PremakeWorker for current database.
+ *
+ * If 'at_commit' is true, the worker is registered once current
+ * transaction commits, otherwise it might not see 'premake' set
+ * by this transaction and exit at once. Failure to register
+ * a worker is not an error.
+ * NOTE: this function does not wait for the worker.
+ */
+void
+start_premake_worker(bool at_commit)
+{
+	if (!at_commit)
+	{
+		register_premake_worker(LOG);
+		return;
+	}
+
+	if (!premake_worker_callback_registered)
+	{
+		RegisterXactCallback(premake_worker_xact_callback, NULL);
+		premake_worker_callback_registered = true;
+	}
+
+	premake_worker_pending = true;
+}
+
+/*
+ * Start PremakeWorker for current database.
+ */
+Datum
+start_premake_worker_pl(PG_FUNCTION_ARGS)
+{
+	start_premake_worker(true);
+
+	PG_RETURN_VOID();
+}
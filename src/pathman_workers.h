@@ -2,12 +2,14 @@
  *
  * pathman_workers.h
  *
- *		There are two purposes of this subsystem:
+ *		There are four purposes of this subsystem:
  *
  *			* Create new partitions for INSERT in separate transaction
  *			* Process concurrent partitioning operations
+ *			* Refresh zone maps of partitions in background
+ *			* Create RANGE partitions ahead of time
  *
- *		Background worker API is used for both cases.
+ *		Background worker API is used for all of them.
  *
  * Copyright (c) 2015-2016, Postgres Professional
  *
@@ -19,38 +21,98 @@
 
 
 #include "postgres.h"
+#include "storage/latch.h"
 #include "storage/spin.h"
 
-#if PG_VERSION_NUM >= 90600
-#include "storage/lock.h"
-#endif
 
+/* Total number of SpawnPartitionsWorkers (all databases) */
+#define SPAWN_WORKER_SLOTS			8
+
+/* Max number of SpawnPartitionsWorkers serving a single database */
+#define SPAWN_WORKERS_PER_DB		2
+
+/* Number of slots for requests to SpawnPartitionsWorkers */
+#define SPAWN_REQUEST_SLOTS			32
+
+/* Max number of backends waiting for a single request */
+#define SPAWN_REQUEST_MAX_WAITERS	32
+
+/* Max size of a value stored in request (larger ones are spawned by backend) */
+#define SPAWN_REQUEST_VALUE_SIZE	64
+
+/* Default value of "pg_pathman.spawn_worker_idle_timeout" (seconds) */
+#define DEFAULT_SPAWN_WORKER_IDLE_TIMEOUT	60
+
+
+typedef enum
+{
+	SPR_FREE = 0,	/* slot is empty */
+	SPR_PENDING,	/* waiting for a worker */
+	SPR_WORKING,	/* worker is creating partitions */
+	SPR_DONE		/* 'result' is ready */
+} SpawnPartitionRequestStatus;
 
 /*
- * Store args, result and execution status of CreatePartitionsWorker.
+ * Store args, result and execution status of a request to create
+ * partitions. Backends which need partitions of the same table at
+ * the same time share a single request.
  */
 typedef struct
 {
-	Oid		userid;			/* connect as a specified user */
+	SpawnPartitionRequestStatus status;
 
-	Oid		result;			/* target partition */
+	Oid		userid;			/* create partitions as a specified user */
+
+	Oid		result;			/* target partition (or InvalidOid on failure) */
 	Oid		dbid;			/* database which stores 'partitioned_table' */
 	Oid		partitioned_table;
 
-#if PG_VERSION_NUM >= 90600
-	/* Args for BecomeLockGroupMember() function */
-	PGPROC *parallel_master_pgproc;
-	pid_t	parallel_master_pid;
-#endif
+	/* Backends waiting for 'result' */
+	int		nwaiters;
+	Latch  *waiters[SPAWN_REQUEST_MAX_WAITERS];
 
 	/* Needed to decode Datum from 'values' */
 	Oid		value_type;
 	Size	value_size;
 	bool	value_byval;
 
-	/* Store Datum as flexible array */
-	uint8	value[FLEXIBLE_ARRAY_MEMBER];
-} SpawnPartitionArgs;
+	/* Store Datum as byte array */
+	uint8	value[SPAWN_REQUEST_VALUE_SIZE];
+} SpawnPartitionRequest;
+
+typedef enum
+{
+	SPW_FREE = 0,	/* slot is empty */
+	SPW_STARTING,	/* worker has been registered */
+	SPW_IDLE,		/* worker is waiting for requests */
+	SPW_WORKING		/* worker is processing a request */
+} SpawnWorkerSlotStatus;
+
+/*
+ * Store status of a single SpawnPartitionsWorker.
+ */
+typedef struct
+{
+	SpawnWorkerSlotStatus worker_status;
+
+	Oid		dbid;			/* database served by this worker */
+	pid_t	pid;			/* worker's PID */
+	Latch  *latch;			/* set it to wake up an idle worker */
+
+	uint32	generation;		/* incremented each time slot is occupied */
+} SpawnWorkerSlot;
+
+/*
+ * Pool of SpawnPartitionsWorkers and the queue of their requests.
+ * Critical sections are tiny, so a single spinlock protects everything.
+ */
+typedef struct
+{
+	slock_t					mutex;
+
+	SpawnWorkerSlot			workers[SPAWN_WORKER_SLOTS];
+	SpawnPartitionRequest	requests[SPAWN_REQUEST_SLOTS];
+} SpawnPartitionsQueue;
 
 
 typedef enum
@@ -141,6 +203,36 @@ Size estimate_concurrent_part_task_slots_size(void);
 void init_concurrent_part_task_slots(void);
 
 
+/*
+ * Args of ZoneMapsWorker (passed via BackgroundWorker::bgw_extra).
+ */
+typedef struct
+{
+	Oid		userid;			/* connect as a specified user */
+	Oid		dbid;			/* database which contains the relation */
+	Oid		relid;			/* partitioned table */
+} ZoneMapsWorkerArgs;
+
+
+/*
+ * Args of PremakeWorker (passed via BackgroundWorker::bgw_extra).
+ */
+typedef struct
+{
+	Oid		userid;			/* connect as a specified user */
+	Oid		dbid;			/* database to be served */
+} PremakeWorkerArgs;
+
+/* Default value of "pg_pathman.premake_naptime" (seconds) */
+#define DEFAULT_PREMAKE_NAPTIME		60
+
+extern int pg_pathman_premake_naptime;
+extern int pg_pathman_spawn_worker_idle_timeout;
+
+void init_pathman_workers_static_data(void);
+void start_premake_worker(bool at_commit);
+
+
 /*
  * Useful datum packing\unpacking functions for BGW.
  */
@@ -194,5 +286,11 @@ UnpackDatumFromByteArray(Datum *datum, Size datum_size, bool typbyval,
  */
 Oid create_partitions_for_value_bg_worker(Oid relid, Datum value, Oid value_type);
 
+/*
+ * Shmem for the pool of SpawnPartitionsWorkers.
+ */
+Size estimate_spawn_partitions_queue_size(void);
+void init_spawn_partitions_queue(void);
+
 
 #endif /* PATHMAN_WORKERS_H */
@@ -13,24 +13,42 @@
 
 #include "init.h"
 #include "hooks.h"
+#include "monotonic_funcs.h"
 #include "pathman.h"
+#include "partition_agg.h"
 #include "partition_filter.h"
+#include "partition_router.h"
+#include "partition_join.h"
+#include "partition_selector.h"
+#include "pathman_workers.h"
 #include "planner_tree_modification.h"
 #include "runtimeappend.h"
 #include "runtime_merge_append.h"
 
 #include "postgres.h"
+#include "access/htup_details.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_language.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_statistic.h"
 #include "foreign/fdwapi.h"
 #include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
 #include "optimizer/plancat.h"
 #include "optimizer/prep.h"
 #include "optimizer/restrictinfo.h"
 #include "optimizer/cost.h"
+#include "optimizer/var.h"
+#include "parser/parse_coerce.h"
+#include "utils/builtins.h"
 #include "utils/datum.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
+#include "utils/rangetypes.h"
 #include "utils/rel.h"
 #include "utils/selfuncs.h"
+#include "utils/syscache.h"
 #include "utils/typcache.h"
 
 
@@ -40,12 +58,25 @@ PG_MODULE_MAGIC;
 PathmanState   *pmstate;
 Oid				pathman_config_relid = InvalidOid;
 Oid				pathman_config_params_relid = InvalidOid;
+Oid				pathman_zone_maps_relid = InvalidOid;
 
 
 /* pg module functions */
 void _PG_init(void);
 
 
+/*
+ * Predicates which restrict KEY to an interval,
+ * but are not btree comparisons (see pull_bounded_param()).
+ */
+typedef enum
+{
+	BOUNDED_OP_RANGE = 0,	/* KEY is an element of a range */
+	BOUNDED_OP_LIKE,		/* KEY LIKE 'prefix%' */
+	BOUNDED_OP_REGEX		/* KEY ~ '^prefix' */
+} BoundedOpKind;
+
+
 /* Expression tree handlers */
 static Node *wrapper_make_expression(WrapperNode *wrap, int index, bool *alwaysTrue);
 
@@ -56,22 +87,64 @@ static void handle_binary_opexpr(WalkerContext *context,
 								 const Node *varnode,
 								 const Const *c);
 
-static void handle_binary_opexpr_param(const PartRelationInfo *prel,
+static void handle_binary_opexpr_param(WalkerContext *context,
 									   WrapperNode *result,
 									   const Node *varnode);
 
+static void handle_binary_opexpr_func(WalkerContext *context,
+									  WrapperNode *result,
+									  const Node *funcnode,
+									  const Const *c,
+									  bool commuted);
+
+static void handle_bounded_opexpr(WalkerContext *context,
+								  WrapperNode *result,
+								  BoundedOpKind kind,
+								  const Const *c);
+
+static bool bounded_op_is_supported(const PartRelationInfo *prel,
+									BoundedOpKind kind);
+
+static List *select_range_interval(const PartRelationInfo *prel,
+								   FmgrInfo *cmp_func,
+								   const Datum *lower,
+								   bool lower_inclusive,
+								   const Datum *upper,
+								   bool upper_inclusive);
+
 static WrapperNode *handle_opexpr(const OpExpr *expr, WalkerContext *context);
 static WrapperNode *handle_boolexpr(const BoolExpr *expr, WalkerContext *context);
 static WrapperNode *handle_arrexpr(const ScalarArrayOpExpr *expr, WalkerContext *context);
 
-static double estimate_paramsel_using_prel(const PartRelationInfo *prel,
+static double estimate_paramsel_using_prel(WalkerContext *context,
 										   int strategy);
 
+static const double *get_partition_weights(WalkerContext *context);
+static bool get_partition_weights_from_pg_class(const PartRelationInfo *prel,
+												double *weights);
+static bool get_partition_weights_from_histogram(const PartRelationInfo *prel,
+												 double *weights);
+
 static bool pull_var_param(const WalkerContext *ctx,
 						   const OpExpr *expr,
 						   Node **var_ptr,
 						   Node **param_ptr);
 
+static bool pull_func_param(const WalkerContext *ctx,
+							const OpExpr *expr,
+							Node **func_ptr,
+							Node **param_ptr,
+							bool *commuted);
+
+static bool pull_bounded_param(const WalkerContext *ctx,
+							   const OpExpr *expr,
+							   Node **param_ptr,
+							   BoundedOpKind *kind);
+
+static bool is_partitioned_key(const WalkerContext *ctx, const Node *node);
+static bool is_runtime_constant(const Node *node);
+static bool is_key_point_range(const WalkerContext *ctx, const Node *node);
+
 
 /* Misc */
 static void make_inh_translation_list(Relation oldrelation, Relation newrelation,
@@ -101,15 +174,18 @@ static Path *get_cheapest_parameterized_child_path(PlannerInfo *root,
 												   Relids required_outer);
 
 
-/* We can transform Param into Const provided that 'econtext' is available */
+/*
+ * We can transform Param or stable expression into Const
+ * provided that 'econtext' is available.
+ */
 #define IsConstValue(wcxt, node) \
-	( IsA((node), Const) || (WcxtHasExprContext(wcxt) ? IsA((node), Param) : false) )
+	( IsA((node), Const) || (WcxtHasExprContext(wcxt) ? is_runtime_constant(node) : false) )
 
 #define ExtractConst(wcxt, node) \
 	( \
-		IsA((node), Param) ? \
-				extract_const((wcxt), (Param *) (node)) : \
-				((Const *) (node)) \
+		IsA((node), Const) ? \
+				((Const *) (node)) : \
+				extract_const((wcxt), (Expr *) (node)) \
 	)
 
 
@@ -155,12 +231,21 @@ _PG_init(void)
 	planner_hook					= pathman_planner_hook;
 	process_utility_hook_next		= ProcessUtility_hook;
 	ProcessUtility_hook				= pathman_process_utility_hook;
+#if PG_VERSION_NUM >= 90600
+	create_upper_paths_hook_next	= create_upper_paths_hook;
+	create_upper_paths_hook			= pathman_create_upper_paths_hook;
+#endif
 
 	/* Initialize static data for all subsystems */
 	init_main_pathman_toggles();
 	init_runtimeappend_static_data();
 	init_runtime_merge_append_static_data();
 	init_partition_filter_static_data();
+	init_partition_router_static_data();
+	init_partition_join_static_data();
+	init_partition_selector_static_data();
+	init_partition_agg_static_data();
+	init_pathman_workers_static_data();
 }
 
 /*
@@ -782,6 +867,11 @@ handle_binary_opexpr(WalkerContext *context, WrapperNode *result,
 	if (strategy == 0)
 		goto binary_opexpr_return;
 
+	/* Only equality doesn't depend on collation */
+	if (strategy != BTEqualStrategyNumber &&
+		!prel_collation_matches(expr->inputcollid, prel))
+		goto binary_opexpr_return;
+
 	switch (prel->parttype)
 	{
 		case PT_HASH:
@@ -792,7 +882,8 @@ handle_binary_opexpr(WalkerContext *context, WrapperNode *result,
 				uint32	idx = hash_to_part_index(DatumGetInt32(value),
 												 PrelChildrenCount(prel));
 
-				result->paramsel = estimate_paramsel_using_prel(prel, strategy);
+				/* Partitions are selected exactly, nothing to estimate */
+				result->paramsel = 1.0;
 				result->rangeset = list_make1_irange(make_irange(idx, idx, IR_LOSSY));
 
 				return; /* exit on equal */
@@ -804,9 +895,7 @@ handle_binary_opexpr(WalkerContext *context, WrapperNode *result,
 			{
 				FmgrInfo cmp_func;
 
-				fill_type_cmp_fmgr_info(&cmp_func,
-										getBaseType(c->consttype),
-										getBaseType(prel->atttype));
+				fill_prel_cmp_fmgr_info(&cmp_func, c->consttype, prel);
 
 				select_range_partitions(c->constvalue,
 										&cmp_func,
@@ -815,7 +904,8 @@ handle_binary_opexpr(WalkerContext *context, WrapperNode *result,
 										strategy,
 										result); /* output */
 
-				result->paramsel = estimate_paramsel_using_prel(prel, strategy);
+				/* Partitions are selected exactly, nothing to estimate */
+				result->paramsel = 1.0;
 
 				return; /* done, now exit */
 			}
@@ -833,44 +923,573 @@ binary_opexpr_return:
  * Estimate selectivity of parametrized quals.
  */
 static void
-handle_binary_opexpr_param(const PartRelationInfo *prel,
+handle_binary_opexpr_param(WalkerContext *context,
 						   WrapperNode *result, const Node *varnode)
 {
-	const OpExpr	   *expr = (const OpExpr *) result->orig;
-	TypeCacheEntry	   *tce;
-	int					strategy;
-	Oid					vartype;
+	const OpExpr		   *expr = (const OpExpr *) result->orig;
+	const PartRelationInfo *prel = context->prel;
+	TypeCacheEntry		   *tce;
+	int						strategy;
 
-	Assert(IsA(varnode, Var) || IsA(varnode, RelabelType));
+	/* Determine operator type (KEY might be wrapped into a function) */
+	tce = lookup_type_cache(exprType(varnode), TYPECACHE_BTREE_OPFAMILY);
+	strategy = get_op_opfamily_strategy(expr->opno, tce->btree_opf);
 
-	vartype = !IsA(varnode, RelabelType) ?
-			((Var *) varnode)->vartype :
-			((RelabelType *) varnode)->resulttype;
+	result->rangeset = list_make1_irange(make_irange(0, PrelLastChild(prel), IR_LOSSY));
+	result->paramsel = estimate_paramsel_using_prel(context, strategy);
+}
 
-	/* Determine operator type */
-	tce = lookup_type_cache(vartype, TYPECACHE_BTREE_OPFAMILY);
+/*
+ * Select partitions for F(KEY) OP CONST, where F is a chain of monotonic
+ * functions (see monotonic_funcs.c). Predicate is converted into a range
+ * of KEY, so all selected partitions are lossy.
+ */
+static void
+handle_binary_opexpr_func(WalkerContext *context, WrapperNode *result,
+						  const Node *funcnode, const Const *c,
+						  bool commuted)
+{
+	const OpExpr		   *expr = (const OpExpr *) result->orig;
+	const PartRelationInfo *prel = context->prel;
+	TypeCacheEntry		   *tce;
+	int						strategy;
+	Oid						functype = exprType(funcnode);
+	List				   *ranges;
+	FmgrInfo				cmp_func;
+	Datum					value,
+							bound;
+	bool					strict;
+
+	/* Exit if Constant is NULL */
+	if (c->constisnull)
+	{
+		result->rangeset = NIL;
+		result->paramsel = 1.0;
+		return;
+	}
+
+	tce = lookup_type_cache(functype, TYPECACHE_BTREE_OPFAMILY);
 	strategy = get_op_opfamily_strategy(expr->opno, tce->btree_opf);
 
+	/* Only RANGE partitions could be selected this way */
+	if (strategy == 0 || prel->parttype != PT_RANGE)
+		goto binary_opexpr_func_return;
+
+	/* Bounds are computed for values of F's result type */
+	value = c->constvalue;
+	if (getBaseType(c->consttype) != getBaseType(functype))
+	{
+		bool	cast_success;
+		Oid		castfunc;
+
+		/* Don't risk errors caused by narrowing casts */
+		if (find_coercion_pathway(getBaseType(functype),
+								  getBaseType(c->consttype),
+								  COERCION_IMPLICIT,
+								  &castfunc) == COERCION_PATH_NONE)
+			goto binary_opexpr_func_return;
+
+		value = perform_type_cast(c->constvalue,
+								  getBaseType(c->consttype),
+								  getBaseType(functype),
+								  &cast_success);
+
+		if (!cast_success)
+			goto binary_opexpr_func_return;
+	}
+
+	/* CONST OP F(KEY) is the same as F(KEY) COMMUTATOR(OP) CONST */
+	if (commuted)
+		strategy = BTMaxStrategyNumber + 1 - strategy;
+
+	fill_prel_cmp_fmgr_info(&cmp_func, prel->atttype, prel);
+
+	ranges = list_make1_irange(make_irange(0, PrelLastChild(prel), IR_COMPLETE));
+
+	/* F(KEY) >= CONST, F(KEY) > CONST or F(KEY) = CONST */
+	if (strategy == BTGreaterStrategyNumber ||
+		strategy == BTGreaterEqualStrategyNumber ||
+		strategy == BTEqualStrategyNumber)
+	{
+		WrapperNode	wrap;
+
+		if (!monotonic_expr_get_key_bound((Node *) funcnode, false,
+										  value, &bound, &strict))
+			goto binary_opexpr_func_return;
+
+		select_range_partitions(bound, &cmp_func,
+								PrelGetRangesArray(prel),
+								PrelChildrenCount(prel),
+								strict ?
+									BTGreaterStrategyNumber :
+									BTGreaterEqualStrategyNumber,
+								&wrap); /* output */
+
+		ranges = irange_list_intersection(ranges, wrap.rangeset);
+	}
+
+	/* F(KEY) <= CONST, F(KEY) < CONST or F(KEY) = CONST */
+	if (strategy == BTLessStrategyNumber ||
+		strategy == BTLessEqualStrategyNumber ||
+		strategy == BTEqualStrategyNumber)
+	{
+		WrapperNode	wrap;
+
+		if (!monotonic_expr_get_key_bound((Node *) funcnode, true,
+										  value, &bound, &strict))
+			goto binary_opexpr_func_return;
+
+		select_range_partitions(bound, &cmp_func,
+								PrelGetRangesArray(prel),
+								PrelChildrenCount(prel),
+								strict ?
+									BTLessStrategyNumber :
+									BTLessEqualStrategyNumber,
+								&wrap); /* output */
+
+		ranges = irange_list_intersection(ranges, wrap.rangeset);
+	}
+
+	/* We can't tell which rows of F(KEY) match the predicate */
+	result->rangeset = irange_list_set_lossiness(ranges, IR_LOSSY);
+	result->paramsel = 1.0;
+	return;
+
+binary_opexpr_func_return:
+	result->rangeset = list_make1_irange(make_irange(0, PrelLastChild(prel), IR_LOSSY));
+	result->paramsel = 1.0;
+}
+
+/*
+ * Select partitions for predicates which restrict KEY to an interval:
+ * KEY <@ RANGE (and its equivalents), KEY LIKE 'prefix%' or KEY ~ '^prefix'.
+ */
+static void
+handle_bounded_opexpr(WalkerContext *context, WrapperNode *result,
+					  BoundedOpKind kind, const Const *c)
+{
+	const OpExpr		   *expr = (const OpExpr *) result->orig;
+	const PartRelationInfo *prel = context->prel;
+	List				   *ranges;
+	FmgrInfo				cmp_func;
+
+	/* Exit if Constant is NULL */
+	if (c->constisnull)
+	{
+		result->rangeset = NIL;
+		result->paramsel = 1.0;
+		return;
+	}
+
+	if (!bounded_op_is_supported(prel, kind))
+		goto bounded_opexpr_return;
+
+	switch (kind)
+	{
+		case BOUNDED_OP_RANGE:
+			{
+				TypeCacheEntry *tce;
+				RangeBound		lower,
+								upper;
+				bool			empty;
+
+				tce = lookup_type_cache(getBaseType(c->consttype),
+										TYPECACHE_RANGE_INFO);
+
+				/* Not a range type, go to end */
+				if (!tce->rngelemtype)
+					goto bounded_opexpr_return;
+
+				/* Range's bounds should be sorted like partitions */
+				if (!prel_collation_matches(tce->rng_collation, prel))
+					goto bounded_opexpr_return;
+
+				range_deserialize(tce, DatumGetRangeType(c->constvalue),
+								  &lower, &upper, &empty);
+
+				/* Empty range contains nothing */
+				if (empty)
+				{
+					result->rangeset = NIL;
+					result->paramsel = 1.0;
+					return;
+				}
+
+				fill_prel_cmp_fmgr_info(&cmp_func, tce->rngelemtype->type_id, prel);
+
+				/* Partitions are selected exactly */
+				ranges = select_range_interval(prel, &cmp_func,
+											   lower.infinite ? NULL : &lower.val,
+											   lower.inclusive,
+											   upper.infinite ? NULL : &upper.val,
+											   upper.inclusive);
+			}
+			break;
+
+		case BOUNDED_OP_LIKE:
+		case BOUNDED_OP_REGEX:
+			{
+				Const				   *prefix;
+				Pattern_Prefix_Status	pstatus;
+
+				pstatus = pattern_fixed_prefix((Const *) c,
+											   kind == BOUNDED_OP_LIKE ?
+												   Pattern_Type_Like :
+												   Pattern_Type_Regex,
+											   expr->inputcollid,
+											   &prefix, NULL);
+
+				/* Pattern is not left-anchored, go to end */
+				if (pstatus == Pattern_Prefix_None)
+					goto bounded_opexpr_return;
+
+				fill_prel_cmp_fmgr_info(&cmp_func, prefix->consttype, prel);
+
+				/* KEY = 'prefix' */
+				if (pstatus == Pattern_Prefix_Exact)
+					ranges = select_range_interval(prel, &cmp_func,
+												   &prefix->constvalue, true,
+												   &prefix->constvalue, true);
+
+				/* KEY >= 'prefix' AND KEY < next string after 'prefix' */
+				else
+				{
+					FmgrInfo	ltproc;
+					Const	   *greater;
+
+					fmgr_info(F_TEXT_LT, &ltproc);
+					greater = make_greater_string(prefix, &ltproc, prel->attcollid);
+
+					ranges = select_range_interval(prel, &cmp_func,
+												   &prefix->constvalue, true,
+												   greater ? &greater->constvalue : NULL,
+												   false);
+				}
+
+				/* We can't tell which rows match the pattern */
+				ranges = irange_list_set_lossiness(ranges, IR_LOSSY);
+			}
+			break;
+
+		default:
+			elog(ERROR, "Unknown bounded operator kind %u", kind);
+			ranges = NIL; /* keep compiler quiet */
+	}
+
+	result->rangeset = ranges;
+	result->paramsel = 1.0;
+	return;
+
+bounded_opexpr_return:
 	result->rangeset = list_make1_irange(make_irange(0, PrelLastChild(prel), IR_LOSSY));
-	result->paramsel = estimate_paramsel_using_prel(prel, strategy);
+	result->paramsel = 1.0;
+}
+
+/*
+ * Check that partitions of 'prel' could be selected using predicate 'kind'.
+ */
+static bool
+bounded_op_is_supported(const PartRelationInfo *prel, BoundedOpKind kind)
+{
+	/* Only RANGE partitions could be selected this way */
+	if (prel->parttype != PT_RANGE)
+		return false;
+
+	/* Prefix defines an interval only if texts are compared byte-wise */
+	if (kind == BOUNDED_OP_LIKE || kind == BOUNDED_OP_REGEX)
+		return prel->cmp_proc == F_BTTEXT_PATTERN_CMP;
+
+	return true;
+}
+
+/*
+ * Select RANGE partitions which might contain values between 'lower'
+ * and 'upper' (NULL stands for an infinite bound).
+ */
+static List *
+select_range_interval(const PartRelationInfo *prel, FmgrInfo *cmp_func,
+					  const Datum *lower, bool lower_inclusive,
+					  const Datum *upper, bool upper_inclusive)
+{
+	List	   *ranges;
+	WrapperNode	wrap;
+
+	ranges = list_make1_irange(make_irange(0, PrelLastChild(prel), IR_COMPLETE));
+
+	if (lower)
+	{
+		select_range_partitions(*lower, cmp_func,
+								PrelGetRangesArray(prel),
+								PrelChildrenCount(prel),
+								lower_inclusive ?
+									BTGreaterEqualStrategyNumber :
+									BTGreaterStrategyNumber,
+								&wrap); /* output */
+
+		ranges = irange_list_intersection(ranges, wrap.rangeset);
+	}
+
+	if (upper)
+	{
+		select_range_partitions(*upper, cmp_func,
+								PrelGetRangesArray(prel),
+								PrelChildrenCount(prel),
+								upper_inclusive ?
+									BTLessEqualStrategyNumber :
+									BTLessStrategyNumber,
+								&wrap); /* output */
+
+		ranges = irange_list_intersection(ranges, wrap.rangeset);
+	}
+
+	return ranges;
 }
 
 /*
  * Extracted common 'paramsel' estimator.
+ *
+ * Returns the expected fraction of parent's rows stored in partitions
+ * selected by 'KEY <strategy> $param', assuming that values of the
+ * param are distributed just like values of the partitioned column.
  */
 static double
-estimate_paramsel_using_prel(const PartRelationInfo *prel, int strategy)
+estimate_paramsel_using_prel(WalkerContext *context, int strategy)
+{
+	const PartRelationInfo *prel = context->prel;
+	const double		   *weights;
+	double					result = 0.0,
+							cumulative = 0.0;
+	uint32					i;
+
+	/* Estimates are useless for executor and PartitionFilter */
+	if (WcxtHasExprContext(context) || context->for_insert)
+		return 1.0;
+
+	/* Only "=" lets us skip HASH partitions */
+	if (strategy <= 0 || PrelChildrenCount(prel) == 0 ||
+		(prel->parttype == PT_HASH && strategy != BTEqualStrategyNumber))
+		return 1.0;
+
+	weights = get_partition_weights(context);
+
+	/*
+	 * Partition i contains the param's value with probability weights[i].
+	 * For "=" we'll scan just this partition, for "<" & "<=" we'll also
+	 * scan all partitions preceding it, for ">" & ">=" -- following it.
+	 */
+	for (i = 0; i < PrelChildrenCount(prel); i++)
+	{
+		switch (strategy)
+		{
+			case BTEqualStrategyNumber:
+				result += weights[i] * weights[i];
+				break;
+
+			case BTLessStrategyNumber:
+			case BTLessEqualStrategyNumber:
+				cumulative += weights[i];
+				result += weights[i] * cumulative;
+				break;
+
+			case BTGreaterStrategyNumber:
+			case BTGreaterEqualStrategyNumber:
+				result += weights[i] * (1.0 - cumulative);
+				cumulative += weights[i];
+				break;
+
+			default:
+				return 1.0;
+		}
+	}
+
+	/* Don't let rounding errors produce something strange */
+	return Min(result, 1.0);
+}
+
+/*
+ * Get fractions of parent's rows stored in each of its partitions.
+ *
+ * Weights are calculated once per WalkerContext. We use the partitions'
+ * pg_class entries if they have been analyzed or vacuumed, parent's
+ * histogram of the partitioned column if they haven't, and consider all
+ * partitions equal if there's no statistics at all.
+ */
+static const double *
+get_partition_weights(WalkerContext *context)
 {
-	/* If it's "=", divide by partitions number */
-	if (strategy == BTEqualStrategyNumber)
-		return 1.0 / (double) PrelChildrenCount(prel);
+	const PartRelationInfo *prel = context->prel;
+	uint32					nparts = PrelChildrenCount(prel),
+							i;
+	double				   *weights;
 
-	/* Default selectivity estimate for inequalities */
-	else if (prel->parttype == PT_RANGE && strategy > 0)
-		return DEFAULT_INEQ_SEL;
+	if (context->part_weights)
+		return context->part_weights;
 
-	/* Else there's not much to do */
-	else return 1.0;
+	weights = (double *) palloc(nparts * sizeof(double));
+
+	if (!get_partition_weights_from_pg_class(prel, weights) &&
+		!get_partition_weights_from_histogram(prel, weights))
+	{
+		for (i = 0; i < nparts; i++)
+			weights[i] = 1.0 / (double) nparts;
+	}
+
+	context->part_weights = weights;
+
+	return weights;
+}
+
+/*
+ * Use 'reltuples' of partitions, or 'relpages' multiplied by the average
+ * tuple density of the analyzed partitions if 'reltuples' is not set yet.
+ */
+static bool
+get_partition_weights_from_pg_class(const PartRelationInfo *prel,
+									double *weights)
+{
+	Oid		   *children = PrelGetChildrenArray(prel);
+	uint32		nparts = PrelChildrenCount(prel),
+				i;
+	BlockNumber *pages = (BlockNumber *) palloc(nparts * sizeof(BlockNumber));
+	double		analyzed_tuples = 0.0,
+				analyzed_pages = 0.0,
+				density = 0.0,
+				total = 0.0;
+
+	for (i = 0; i < nparts; i++)
+	{
+		HeapTuple	tp = SearchSysCache1(RELOID, ObjectIdGetDatum(children[i]));
+
+		weights[i] = 0.0;
+		pages[i] = 0;
+
+		if (HeapTupleIsValid(tp))
+		{
+			Form_pg_class reltup = (Form_pg_class) GETSTRUCT(tp);
+
+			weights[i] = Max(reltup->reltuples, 0.0);
+			pages[i] = reltup->relpages;
+
+			if (weights[i] > 0.0)
+			{
+				analyzed_tuples += weights[i];
+				analyzed_pages += pages[i];
+			}
+
+			ReleaseSysCache(tp);
+		}
+	}
+
+	if (analyzed_pages > 0.0)
+		density = analyzed_tuples / analyzed_pages;
+
+	for (i = 0; i < nparts; i++)
+	{
+		/* Partition has been vacuumed, but not analyzed */
+		if (weights[i] == 0.0)
+			weights[i] = pages[i] * density;
+
+		total += weights[i];
+	}
+
+	pfree(pages);
+
+	if (total <= 0.0)
+		return false;
+
+	for (i = 0; i < nparts; i++)
+		weights[i] /= total;
+
+	return true;
+}
+
+/*
+ * Count bounds of parent's (inheritance) histogram falling into each
+ * partition. Histogram is equi-depth, so each bound stands for the
+ * same number of rows.
+ */
+static bool
+get_partition_weights_from_histogram(const PartRelationInfo *prel,
+									 double *weights)
+{
+	uint32		nparts = PrelChildrenCount(prel),
+				i;
+	HeapTuple	statstuple;
+	Datum	   *values;
+	int			nvalues,
+				j;
+	FmgrInfo	cmp_func;
+	double		total = 0.0;
+
+	statstuple = SearchSysCache3(STATRELATTINH,
+								 ObjectIdGetDatum(PrelParentRelid(prel)),
+								 Int16GetDatum(prel->attnum),
+								 BoolGetDatum(true));
+	if (!HeapTupleIsValid(statstuple))
+		return false;
+
+	if (!get_attstatsslot(statstuple, prel->atttype, prel->atttypmod,
+						  STATISTIC_KIND_HISTOGRAM, InvalidOid, NULL,
+						  &values, &nvalues, NULL, NULL))
+	{
+		ReleaseSysCache(statstuple);
+		return false;
+	}
+
+	for (i = 0; i < nparts; i++)
+		weights[i] = 0.0;
+
+	if (prel->parttype == PT_RANGE)
+		fill_prel_cmp_fmgr_info(&cmp_func, prel->atttype, prel);
+
+	for (j = 0; j < nvalues; j++)
+	{
+		switch (prel->parttype)
+		{
+			case PT_HASH:
+				{
+					Datum	hash = OidFunctionCall1(prel->hash_proc, values[j]);
+					uint32	idx = hash_to_part_index(DatumGetUInt32(hash), nparts);
+
+					weights[idx] += 1.0;
+					total += 1.0;
+				}
+				break;
+
+			case PT_RANGE:
+				{
+					WrapperNode	wrap;
+
+					select_range_partitions(values[j], &cmp_func,
+											PrelGetRangesArray(prel),
+											nparts,
+											BTEqualStrategyNumber,
+											&wrap); /* output */
+
+					/* There's at most one partition containing the value */
+					if (wrap.rangeset != NIL)
+					{
+						weights[irange_lower(linitial_irange(wrap.rangeset))] += 1.0;
+						total += 1.0;
+					}
+				}
+				break;
+
+			default:
+				elog(ERROR, "Unknown partitioning type %u", prel->parttype);
+		}
+	}
+
+	free_attstatsslot(prel->atttype, values, nvalues, NULL, 0);
+	ReleaseSysCache(statstuple);
+
+	if (total <= 0.0)
+		return false;
+
+	for (i = 0; i < nparts; i++)
+		weights[i] /= total;
+
+	return true;
 }
 
 /*
@@ -929,15 +1548,16 @@ search_range_partition_eq(const Datum value,
 }
 
 static Const *
-extract_const(WalkerContext *wcxt, Param *param)
+extract_const(WalkerContext *wcxt, Expr *expr)
 {
-	ExprState  *estate = ExecInitExpr((Expr *) param, NULL);
+	ExprState  *estate = ExecInitExpr(expr, NULL);
 	bool		isnull;
 	Datum		value = ExecEvalExpr(estate, wcxt->econtext, &isnull, NULL);
+	Oid			type = exprType((Node *) expr);
 
-	return makeConst(param->paramtype, param->paramtypmod,
-					 param->paramcollid, get_typlen(param->paramtype),
-					 value, isnull, get_typbyval(param->paramtype));
+	return makeConst(type, exprTypmod((Node *) expr),
+					 exprCollation((Node *) expr), get_typlen(type),
+					 value, isnull, get_typbyval(type));
 }
 
 static WrapperNode *
@@ -990,7 +1610,7 @@ handle_const(const Const *c, WalkerContext *context)
 				idx = hash_to_part_index(DatumGetInt32(hash),
 										 PrelChildrenCount(prel));
 
-				result->paramsel = estimate_paramsel_using_prel(prel, strategy);
+				result->paramsel = 1.0;
 				result->rangeset = list_make1_irange(make_irange(idx, idx, IR_LOSSY));
 			}
 			break;
@@ -999,9 +1619,7 @@ handle_const(const Const *c, WalkerContext *context)
 			{
 				FmgrInfo cmp_finfo;
 
-				fill_type_cmp_fmgr_info(&cmp_finfo,
-										getBaseType(c->consttype),
-										getBaseType(prel->atttype));
+				fill_prel_cmp_fmgr_info(&cmp_finfo, c->consttype, prel);
 
 				select_range_partitions(c->constvalue,
 										&cmp_finfo,
@@ -1010,7 +1628,7 @@ handle_const(const Const *c, WalkerContext *context)
 										strategy,
 										result); /* output */
 
-				result->paramsel = estimate_paramsel_using_prel(prel, strategy);
+				result->paramsel = 1.0;
 			}
 			break;
 
@@ -1030,6 +1648,8 @@ handle_opexpr(const OpExpr *expr, WalkerContext *context)
 {
 	WrapperNode	*result = (WrapperNode *) palloc0(sizeof(WrapperNode));
 	Node		*var, *param;
+	bool		 commuted;
+	BoundedOpKind kind;
 	const PartRelationInfo *prel = context->prel;
 
 	result->orig = (const Node *) expr;
@@ -1037,16 +1657,51 @@ handle_opexpr(const OpExpr *expr, WalkerContext *context)
 
 	if (list_length(expr->args) == 2)
 	{
-		if (pull_var_param(context, expr, &var, &param))
+		if (pull_bounded_param(context, expr, &param, &kind))
+		{
+			if (IsConstValue(context, param))
+			{
+				handle_bounded_opexpr(context, result, kind,
+									  ExtractConst(context, param));
+				return result;
+			}
+			else if ((IsA(param, Var) || is_runtime_constant(param)) &&
+					 bounded_op_is_supported(prel, kind))
+			{
+				/* Interval is expected to be as narrow as KEY = $1 */
+				result->rangeset = list_make1_irange(make_irange(0, PrelLastChild(prel), IR_LOSSY));
+				result->paramsel = estimate_paramsel_using_prel(context,
+																BTEqualStrategyNumber);
+				return result;
+			}
+		}
+		else if (pull_var_param(context, expr, &var, &param))
 		{
 			if (IsConstValue(context, param))
 			{
 				handle_binary_opexpr(context, result, var, ExtractConst(context, param));
 				return result;
 			}
-			else if (IsA(param, Param) || IsA(param, Var))
+			else if (IsA(param, Var) || is_runtime_constant(param))
+			{
+				handle_binary_opexpr_param(context, result, var);
+				return result;
+			}
+		}
+		else if (pull_func_param(context, expr, &var, &param, &commuted))
+		{
+			if (IsConstValue(context, param))
 			{
-				handle_binary_opexpr_param(prel, result, var);
+				handle_binary_opexpr_func(context, result, var,
+										  ExtractConst(context, param),
+										  commuted);
+				return result;
+			}
+			/* Only RANGE partitions could be selected at runtime */
+			else if ((IsA(param, Var) || is_runtime_constant(param)) &&
+					 prel->parttype == PT_RANGE)
+			{
+				handle_binary_opexpr_param(context, result, var);
 				return result;
 			}
 		}
@@ -1112,6 +1767,197 @@ pull_var_param(const WalkerContext *ctx,
 	return false;
 }
 
+/*
+ * Checks if expression is a F(KEY) OP PARAM or PARAM OP F(KEY), where F is
+ * a chain of monotonic functions (see monotonic_funcs.c). Function returns
+ * F(KEY) and param via func_ptr and param_ptr pointers, 'commuted' is set
+ * if F(KEY) is on the right side.
+ */
+static bool
+pull_func_param(const WalkerContext *ctx,
+				const OpExpr *expr,
+				Node **func_ptr,
+				Node **param_ptr,
+				bool *commuted)
+{
+	Node   *left = linitial(expr->args),
+		   *right = lsecond(expr->args),
+		   *key;
+
+	/* Check the case when function is on the left side */
+	key = monotonic_expr_get_key(left);
+	if (key && IsA(key, Var) &&
+		((Var *) key)->varoattno == ctx->prel->attnum &&
+		((Var *) key)->varno == ctx->prel_varno)
+	{
+		*func_ptr = left;
+		*param_ptr = right;
+		*commuted = false;
+		return true;
+	}
+
+	/* ... function is on the right side */
+	key = monotonic_expr_get_key(right);
+	if (key && IsA(key, Var) &&
+		((Var *) key)->varoattno == ctx->prel->attnum &&
+		((Var *) key)->varno == ctx->prel_varno)
+	{
+		*func_ptr = right;
+		*param_ptr = left;
+		*commuted = true;
+		return true;
+	}
+
+	/* Function doesn't depend on partitioning key */
+	return false;
+}
+
+/*
+ * Checks if expression restricts KEY to an interval defined by PARAM:
+ *		KEY <@ PARAM, PARAM @> KEY,
+ *		rng(KEY, KEY, '[]') {<@, &&} PARAM, PARAM {@>, &&} rng(KEY, KEY, '[]'),
+ *		KEY LIKE PARAM, KEY ~ PARAM,
+ * where rng is a constructor of some range type. Function returns param
+ * and kind of predicate via param_ptr and kind pointers.
+ */
+static bool
+pull_bounded_param(const WalkerContext *ctx,
+				   const OpExpr *expr,
+				   Node **param_ptr,
+				   BoundedOpKind *kind)
+{
+	Node   *left = linitial(expr->args),
+		   *right = lsecond(expr->args);
+
+	switch (get_opcode(expr->opno))
+	{
+		/* KEY <@ PARAM */
+		case F_ELEM_CONTAINED_BY_RANGE:
+			*kind = BOUNDED_OP_RANGE;
+			*param_ptr = right;
+			return is_partitioned_key(ctx, left);
+
+		/* PARAM @> KEY */
+		case F_RANGE_CONTAINS_ELEM:
+			*kind = BOUNDED_OP_RANGE;
+			*param_ptr = left;
+			return is_partitioned_key(ctx, right);
+
+		/* rng(KEY, KEY, '[]') <@ PARAM */
+		case F_RANGE_CONTAINED_BY:
+			*kind = BOUNDED_OP_RANGE;
+			*param_ptr = right;
+			return is_key_point_range(ctx, left);
+
+		/* PARAM @> rng(KEY, KEY, '[]') */
+		case F_RANGE_CONTAINS:
+			*kind = BOUNDED_OP_RANGE;
+			*param_ptr = left;
+			return is_key_point_range(ctx, right);
+
+		/* Overlap is commutative */
+		case F_RANGE_OVERLAPS:
+			*kind = BOUNDED_OP_RANGE;
+			if (is_key_point_range(ctx, left))
+			{
+				*param_ptr = right;
+				return true;
+			}
+			*param_ptr = left;
+			return is_key_point_range(ctx, right);
+
+		/* KEY LIKE PARAM */
+		case F_TEXTLIKE:
+			*kind = BOUNDED_OP_LIKE;
+			*param_ptr = right;
+			return is_partitioned_key(ctx, left);
+
+		/* KEY ~ PARAM */
+		case F_TEXTREGEXEQ:
+			*kind = BOUNDED_OP_REGEX;
+			*param_ptr = right;
+			return is_partitioned_key(ctx, left);
+
+		default:
+			return false;
+	}
+}
+
+/*
+ * Checks if 'node' is partitioned column of 'prel' (maybe RelabelType'd).
+ */
+static bool
+is_partitioned_key(const WalkerContext *ctx, const Node *node)
+{
+	if (IsA(node, RelabelType))
+		node = (const Node *) ((const RelabelType *) node)->arg;
+
+	return IsA(node, Var) &&
+		   ((const Var *) node)->varoattno == ctx->prel->attnum &&
+		   ((const Var *) node)->varno == ctx->prel_varno;
+}
+
+/*
+ * Checks if 'node' doesn't depend on rows of the partitioned table and
+ * could be computed once for all of them, e.g. $1 or now() - '1 hour'.
+ */
+static bool
+is_runtime_constant(const Node *node)
+{
+	if (IsA(node, Param))
+		return true;
+
+	return !contain_var_clause((Node *) node) &&
+		   !contain_volatile_functions((Node *) node) &&
+		   !contain_subplans((Node *) node);
+}
+
+/*
+ * Checks if 'node' is rng(KEY, KEY, '[]'), i.e. a range containing KEY only.
+ */
+static bool
+is_key_point_range(const WalkerContext *ctx, const Node *node)
+{
+	const FuncExpr *func;
+	const Const	   *flags;
+	HeapTuple		tp;
+	bool			result = false;
+
+	if (!IsA(node, FuncExpr))
+		return false;
+
+	func = (const FuncExpr *) node;
+
+	if (list_length(func->args) != 3 ||
+		!is_partitioned_key(ctx, linitial(func->args)) ||
+		!is_partitioned_key(ctx, lsecond(func->args)))
+		return false;
+
+	/* Both bounds should be inclusive */
+	flags = (const Const *) lthird(func->args);
+	if (!IsA(flags, Const) || flags->constisnull ||
+		strcmp(TextDatumGetCString(flags->constvalue), "[]") != 0)
+		return false;
+
+	/* Finally, check that 'func' is a range type constructor */
+	tp = SearchSysCache1(PROCOID, ObjectIdGetDatum(func->funcid));
+	if (HeapTupleIsValid(tp))
+	{
+		Datum	prosrc;
+		bool	isnull;
+
+		prosrc = SysCacheGetAttr(PROCOID, tp, Anum_pg_proc_prosrc, &isnull);
+
+		result = ((Form_pg_proc) GETSTRUCT(tp))->prolang == INTERNALlanguageId &&
+				 !isnull &&
+				 strcmp(TextDatumGetCString(prosrc), "range_constructor3") == 0;
+
+		ReleaseSysCache(tp);
+	}
+
+	return result;
+}
+
 /*
  * Boolean expression handler
  */
@@ -1224,7 +2070,6 @@ handle_arrexpr(const ScalarArrayOpExpr *expr, WalkerContext *context)
 		int			num_elems;
 		Datum	   *elem_values;
 		bool	   *elem_nulls;
-		int			strategy = BTEqualStrategyNumber;
 
 		/* Extract values from array */
 		arrayval = DatumGetArrayTypeP(((Const *) arraynode)->constvalue);
@@ -1237,6 +2082,9 @@ handle_arrexpr(const ScalarArrayOpExpr *expr, WalkerContext *context)
 
 		result->rangeset = NIL;
 
+		/* Partitions are selected exactly, nothing to estimate */
+		result->paramsel = 1.0;
+
 		switch (prel->parttype)
 		{
 			case PT_HASH:
@@ -1250,7 +2098,6 @@ handle_arrexpr(const ScalarArrayOpExpr *expr, WalkerContext *context)
 						Datum		value;
 						uint32		idx;
 						List	   *irange;
-						double		cur_paramsel;
 
 						if (!elem_nulls[i])
 						{
@@ -1265,9 +2112,6 @@ handle_arrexpr(const ScalarArrayOpExpr *expr, WalkerContext *context)
 						else irange = NIL;
 
 						ranges = irange_list_union(ranges, irange);
-
-						cur_paramsel = estimate_paramsel_using_prel(prel, strategy);
-						result->paramsel = Max(result->paramsel, cur_paramsel);
 					}
 
 					result->rangeset = ranges;
@@ -1305,8 +2149,6 @@ handle_arrexpr(const ScalarArrayOpExpr *expr, WalkerContext *context)
 						ranges = irange_list_union(ranges, wrap->rangeset);
 
 						pfree(c);
-
-						result->paramsel = Max(result->paramsel, wrap->paramsel);
 					}
 
 					result->rangeset = ranges;
@@ -1929,6 +2771,44 @@ generate_mergeappend_paths(PlannerInfo *root, RelOptInfo *rel,
 																NULL));
 		}
 	}
+
+	/*
+	 * Query wants tuples sorted by partitioned column (e.g. it's a min() or
+	 * max() subquery built by planagg.c), but children can't provide such
+	 * ordering.  Build a MergeAppend of sorted children anyway, since it
+	 * will be replaced with RuntimeMergeAppend which scans partitions one
+	 * by one and stops at the first partition that yields enough tuples.
+	 */
+	if (live_childrels && root->query_pathkeys &&
+		bms_equal(rel->relids, root->all_baserels) &&
+		((pathkeyAsc && linitial(root->query_pathkeys) == pathkeyAsc) ||
+		 (pathkeyDesc && linitial(root->query_pathkeys) == pathkeyDesc)))
+	{
+		List	   *total_subpaths = NIL;
+		ListCell   *lcr;
+
+		/* Skip if we've already built such paths */
+		foreach(lcp, all_child_pathkeys)
+		{
+			if (compare_pathkeys((List *) lfirst(lcp),
+								 root->query_pathkeys) == PATHKEYS_EQUAL)
+				return;
+		}
+
+		foreach(lcr, live_childrels)
+		{
+			RelOptInfo *childrel = (RelOptInfo *) lfirst(lcr);
+
+			total_subpaths = accumulate_append_subpath(total_subpaths,
+													   childrel->cheapest_total_path);
+		}
+
+		add_path(rel, (Path *) create_merge_append_path(root,
+														rel,
+														total_subpaths,
+														root->query_pathkeys,
+														NULL));
+	}
 }
 
 /*
@@ -1964,3 +2844,20 @@ get_pathman_config_params_relid(bool invalid_is_ok)
 
 	return pathman_config_params_relid;
 }
+
+/*
+ * Get cached PATHMAN_ZONE_MAPS relation Oid.
+ */
+Oid
+get_pathman_zone_maps_relid(bool invalid_is_ok)
+{
+	/* Raise ERROR if Oid is invalid */
+	if (!OidIsValid(pathman_zone_maps_relid) && !invalid_is_ok)
+		elog(ERROR,
+			 (!IsPathmanInitialized() ?
+				"pg_pathman is not initialized yet" :
+				"unexpected error in function "
+						  CppAsString(get_pathman_zone_maps_relid)));
+
+	return pathman_zone_maps_relid;
+}
@@ -22,9 +22,6 @@
 #include "utils/array.h"
 
 
-static char **deconstruct_text_array(Datum array, int *array_size);
-
-
 /* Function declarations */
 
 PG_FUNCTION_INFO_V1( create_hash_partitions_internal );
@@ -100,17 +97,11 @@ create_hash_partitions_internal(PG_FUNCTION_ARGS)
 		}
 	}
 
-	/* Finally create HASH partitions */
-	for (i = 0; i < partitions_count; i++)
-	{
-		RangeVar   *partition_rv	= rangevars ? rangevars[i] : NULL;
-		char 	   *tablespace		= tablespaces ? tablespaces[i] : NULL;
-
-		/* Create a partition (copy FKs, invoke callbacks etc) */
-		create_single_hash_partition_internal(parent_relid, i, partitions_count,
-											  partitioned_col_type,
-											  partition_rv, tablespace);
-	}
+	/* Finally create HASH partitions (copy FKs, invoke callbacks etc) */
+	if (partitions_count > 0)
+		create_hash_partitions_bulk(parent_relid, partitions_count,
+									partitioned_col_type,
+									rangevars, tablespaces);
 
 	/* Free arrays */
 	DeepFreeArray(partition_names, partition_names_size);
@@ -181,64 +172,3 @@ build_hash_condition(PG_FUNCTION_ARGS)
 
 	PG_RETURN_TEXT_P(cstring_to_text(result));
 }
-
-
-/*
- * ------------------
- *  Helper functions
- * ------------------
- */
-
-/* Convert Datum into CSTRING array */
-static char **
-deconstruct_text_array(Datum array, int *array_size)
-{
-	ArrayType  *array_ptr = DatumGetArrayTypeP(array);
-	int16		elemlen;
-	bool		elembyval;
-	char		elemalign;
-
-	Datum	   *elem_values;
-	bool	   *elem_nulls;
-
-	int			arr_size = 0;
-
-	/* Check type invariant */
-	Assert(ARR_ELEMTYPE(array_ptr) == TEXTOID);
-
-	/* Check number of dimensions */
-	if (ARR_NDIM(array_ptr) > 1)
-		elog(ERROR, "'partition_names' and 'tablespaces' may contain only 1 dimension");
-
-	get_typlenbyvalalign(ARR_ELEMTYPE(array_ptr),
-						 &elemlen, &elembyval, &elemalign);
-
-	deconstruct_array(array_ptr,
-					  ARR_ELEMTYPE(array_ptr),
-					  elemlen, elembyval, elemalign,
-					  &elem_values, &elem_nulls, &arr_size);
-
-	/* If there are actual values, convert them into CSTRINGs */
-	if (arr_size > 0)
-	{
-		char  **strings = palloc(arr_size * sizeof(char *));
-		int		i;
-
-		for (i = 0; i < arr_size; i++)
-		{
-			if (elem_nulls[i])
-				elog(ERROR, "'partition_names' and 'tablespaces' may not contain NULLs");
-
-			strings[i] = TextDatumGetCString(elem_values[i]);
-		}
-
-		/* Return an array and it's size */
-		*array_size = arr_size;
-		return strings;
-	}
-	/* Else emit ERROR */
-	else elog(ERROR, "'partition_names' and 'tablespaces' may not be empty");
-
-	/* Keep compiler happy */
-	return NULL;
-}
@@ -53,11 +53,17 @@ static void drop_table_by_oid(Oid relid);
 static bool interval_is_trivial(Oid atttype,
 								Datum interval,
 								Oid interval_type);
+static void fill_bounds_cmp_fmgr_info(FmgrInfo *finfo,
+									  Oid parent_relid,
+									  Oid bounds_type);
 
 /* Function declarations */
 
 PG_FUNCTION_INFO_V1( create_single_range_partition_pl );
+PG_FUNCTION_INFO_V1( create_range_partitions_internal );
+PG_FUNCTION_INFO_V1( generate_range_bounds_pl );
 PG_FUNCTION_INFO_V1( find_or_create_range_partition );
+PG_FUNCTION_INFO_V1( premake_partitions );
 PG_FUNCTION_INFO_V1( check_range_available_pl );
 
 PG_FUNCTION_INFO_V1( get_part_range_by_oid );
@@ -143,6 +149,189 @@ create_single_range_partition_pl(PG_FUNCTION_ARGS)
 	PG_RETURN_OID(partition_relid);
 }
 
+/*
+ * Create RANGE partitions [bounds[i], bounds[i + 1]) at once.
+ * NULL in the first (last) element of 'bounds' stands for -inf (+inf).
+ */
+Datum
+create_range_partitions_internal(PG_FUNCTION_ARGS)
+{
+	Oid			parent_relid;
+	ArrayType  *bounds;
+	Oid			bounds_type;
+	int16		bounds_len;
+	bool		bounds_byval;
+	char		bounds_align;
+	Datum	   *bounds_values;
+	bool	   *bounds_nulls;
+	int			nbounds;
+
+	/* RANGE boundaries of each partition */
+	Bound	   *start_values,
+			   *end_values;
+	FmgrInfo	cmp_func;
+	int			nparts,
+				i;
+
+	/* Optional: names & tablespaces */
+	char	  **partition_names			= NULL,
+			  **tablespaces				= NULL;
+	int			partition_names_size	= 0,
+				tablespaces_size		= 0;
+	RangeVar  **rangevars				= NULL;
+
+
+	/* Handle 'parent_relid' */
+	if (PG_ARGISNULL(0))
+		elog(ERROR, "'parent_relid' should not be NULL");
+
+	/* Handle 'bounds' */
+	if (PG_ARGISNULL(1))
+		elog(ERROR, "'bounds' should not be NULL");
+
+	parent_relid = PG_GETARG_OID(0);
+	bounds = PG_GETARG_ARRAYTYPE_P(1);
+	bounds_type = ARR_ELEMTYPE(bounds);
+
+	/* Check number of dimensions */
+	if (ARR_NDIM(bounds) > 1)
+		elog(ERROR, "'bounds' may contain only 1 dimension");
+
+	get_typlenbyvalalign(bounds_type, &bounds_len,
+						 &bounds_byval, &bounds_align);
+
+	deconstruct_array(bounds, bounds_type,
+					  bounds_len, bounds_byval, bounds_align,
+					  &bounds_values, &bounds_nulls, &nbounds);
+
+	if (nbounds < 2)
+		elog(ERROR, "'bounds' must contain at least two elements");
+
+	nparts = nbounds - 1;
+
+	/* Extract partition names */
+	if (!PG_ARGISNULL(2))
+		partition_names = deconstruct_text_array(PG_GETARG_DATUM(2), &partition_names_size);
+
+	/* Extract partition tablespaces */
+	if (!PG_ARGISNULL(3))
+		tablespaces = deconstruct_text_array(PG_GETARG_DATUM(3), &tablespaces_size);
+
+	/* Validate size of 'partition_names' */
+	if (partition_names && partition_names_size != nparts)
+		elog(ERROR, "size of 'partition_names' must be equal to length of 'bounds' - 1");
+
+	/* Validate size of 'tablespaces' */
+	if (tablespaces && tablespaces_size != nparts)
+		elog(ERROR, "size of 'tablespaces' must be equal to length of 'bounds' - 1");
+
+	/* Convert partition names into RangeVars */
+	if (partition_names)
+	{
+		rangevars = palloc(sizeof(RangeVar *) * partition_names_size);
+		for (i = 0; i < partition_names_size; i++)
+		{
+			List *nl = stringToQualifiedNameList(partition_names[i]);
+
+			rangevars[i] = makeRangeVarFromNameList(nl);
+		}
+	}
+
+	/* Build boundaries of partitions and check that they ascend */
+	fill_bounds_cmp_fmgr_info(&cmp_func, parent_relid, bounds_type);
+
+	start_values = palloc(nparts * sizeof(Bound));
+	end_values = palloc(nparts * sizeof(Bound));
+
+	for (i = 0; i < nparts; i++)
+	{
+		/* Only the outermost bounds may be infinite */
+		if ((bounds_nulls[i] && i > 0) ||
+			(bounds_nulls[i + 1] && i + 1 < nparts))
+			elog(ERROR, "only first and last elements of 'bounds' may be NULL");
+
+		start_values[i] = bounds_nulls[i] ?
+							MakeBoundInf(MINUS_INFINITY) :
+							MakeBound(bounds_values[i]);
+
+		end_values[i] = bounds_nulls[i + 1] ?
+							MakeBoundInf(PLUS_INFINITY) :
+							MakeBound(bounds_values[i + 1]);
+
+		if (cmp_bounds(&cmp_func, &start_values[i], &end_values[i]) >= 0)
+			elog(ERROR, "'bounds' must be sorted in ascending order");
+	}
+
+	/* Check that new partitions won't overlap with existing ones */
+	check_range_available(parent_relid,
+						  &start_values[0],
+						  &end_values[nparts - 1],
+						  bounds_type,
+						  true);
+
+	/* Finally create RANGE partitions (copy FKs, invoke callbacks etc) */
+	create_range_partitions_bulk(parent_relid,
+								 start_values, end_values,
+								 bounds_type,
+								 rangevars, tablespaces,
+								 nparts, NULL);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Generate 'p_count' + 1 boundaries of RANGE partitions
+ * by adding 'p_interval' to 'p_start' over and over again.
+ */
+Datum
+generate_range_bounds_pl(PG_FUNCTION_ARGS)
+{
+	Datum		value = PG_GETARG_DATUM(0);
+	Datum		interval = PG_GETARG_DATUM(1);
+	int32		count = PG_GETARG_INT32(2);
+	Oid			value_type = getBaseType(get_fn_expr_argtype(fcinfo->flinfo, 0)),
+				interval_type = getBaseType(get_fn_expr_argtype(fcinfo->flinfo, 1));
+
+	Oid			plus_op_func,
+				plus_op_ret_type;
+	FmgrInfo	plus_op_finfo;
+
+	Datum	   *datums;
+	int16		elemlen;
+	bool		elembyval;
+	char		elemalign;
+	int			i;
+
+	if (count < 1)
+		elog(ERROR, "'p_count' must be greater than zero");
+
+	/* Find suitable addition operator for value and interval */
+	extract_op_func_and_ret_type("+", value_type, interval_type,
+								 &plus_op_func,
+								 &plus_op_ret_type);
+
+	fmgr_info(plus_op_func, &plus_op_finfo);
+
+	datums = palloc((count + 1) * sizeof(Datum));
+	datums[0] = value;
+
+	for (i = 1; i <= count; i++)
+	{
+		value = FunctionCall2(&plus_op_finfo, value, interval);
+
+		/* Cast result back to value's type (e.g. date + interval = timestamp) */
+		if (plus_op_ret_type != value_type)
+			value = perform_type_cast(value, plus_op_ret_type, value_type, NULL);
+
+		datums[i] = value;
+	}
+
+	get_typlenbyvalalign(value_type, &elemlen, &elembyval, &elemalign);
+
+	PG_RETURN_ARRAYTYPE_P(construct_array(datums, count + 1, value_type,
+										  elemlen, elembyval, elemalign));
+}
+
 /*
  * Returns partition oid for specified parent relid and value.
  * In case when partition doesn't exist try to create one.
@@ -161,9 +350,7 @@ find_or_create_range_partition(PG_FUNCTION_ARGS)
 	prel = get_pathman_relation_info(parent_relid);
 	shout_if_prel_is_invalid(parent_relid, prel, PT_RANGE);
 
-	fill_type_cmp_fmgr_info(&cmp_func,
-							getBaseType(value_type),
-							getBaseType(prel->atttype));
+	fill_prel_cmp_fmgr_info(&cmp_func, value_type, prel);
 
 	/* Use available PartRelationInfo to find partition */
 	search_state = search_range_partition_eq(value, &cmp_func, prel,
@@ -190,6 +377,47 @@ find_or_create_range_partition(PG_FUNCTION_ARGS)
 	}
 }
 
+/*
+ * Create RANGE partitions ahead of time. 'p_count' defaults
+ * to 'premake' column of PATHMAN_CONFIG_PARAMS.
+ * Returns the last created partition or NULL.
+ */
+Datum
+premake_partitions(PG_FUNCTION_ARGS)
+{
+	Oid		parent_relid;
+	int32	premake;
+	Oid		partition_relid;
+
+	if (PG_ARGISNULL(0))
+		elog(ERROR, "'parent_relid' should not be NULL");
+
+	parent_relid = PG_GETARG_OID(0);
+
+	if (!PG_ARGISNULL(1))
+		premake = PG_GETARG_INT32(1);
+	else
+	{
+		Datum	values[Natts_pathman_config_params];
+		bool	isnull[Natts_pathman_config_params];
+
+		/* Take 'premake' from PATHMAN_CONFIG_PARAMS */
+		if (!read_pathman_params(parent_relid, values, isnull) ||
+			isnull[Anum_pathman_config_params_premake - 1])
+			elog(ERROR, "'premake' is not set for relation \"%s\"",
+				 get_rel_name_or_relid(parent_relid));
+
+		premake = DatumGetInt32(values[Anum_pathman_config_params_premake - 1]);
+	}
+
+	partition_relid = premake_range_partitions(parent_relid, premake);
+
+	if (OidIsValid(partition_relid))
+		PG_RETURN_OID(partition_relid);
+	else
+		PG_RETURN_NULL();
+}
+
 /*
  * Checks if range overlaps with existing partitions.
  * Returns TRUE if overlaps and FALSE otherwise.
@@ -831,6 +1059,41 @@ interval_is_trivial(Oid atttype, Datum interval, Oid interval_type)
 	return false;
 }
 
+/*
+ * Get BTORDER_PROC for 'bounds_type' and partitioned column of 'parent_relid'
+ * which orders bounds just like PartRelationInfo does, even if parent has no
+ * partitions yet (see fill_prel_cmp_fmgr_info()).
+ */
+static void
+fill_bounds_cmp_fmgr_info(FmgrInfo *finfo, Oid parent_relid, Oid bounds_type)
+{
+	const PartRelationInfo *prel;
+	Datum					values[Natts_pathman_config];
+	bool					isnull[Natts_pathman_config];
+	char				   *attname;
+	Oid						atttype,
+							attcollid;
+	int32					atttypmod;
+
+	prel = get_pathman_relation_info(parent_relid);
+	if (prel)
+	{
+		fill_prel_cmp_fmgr_info(finfo, bounds_type, prel);
+		return;
+	}
+
+	if (!pathman_config_contains_relation(parent_relid, values, isnull, NULL))
+		elog(ERROR, "table \"%s\" is not partitioned",
+			 get_rel_name_or_relid(parent_relid));
+
+	attname = TextDatumGetCString(values[Anum_pathman_config_attname - 1]);
+	get_atttypetypmodcoll(parent_relid, get_attnum(parent_relid, attname),
+						  &atttype, &atttypmod, &attcollid);
+
+	fill_type_cmp_fmgr_info(finfo, getBaseType(bounds_type), getBaseType(atttype));
+	fmgr_info(get_collation_free_cmp_proc(finfo->fn_oid, attcollid), finfo);
+}
+
 /*
  * Drop old partition constraint and create
  * a new one with specified boundaries
@@ -10,14 +10,19 @@
 
 #include "nodes_common.h"
 #include "partition_filter.h"
+#include "partition_router.h"
 #include "planner_tree_modification.h"
 #include "rangeset.h"
+#include "runtimeappend.h"
 
 #include "access/sysattr.h"
 #include "catalog/pg_type.h"
 #include "miscadmin.h"
 #include "optimizer/clauses.h"
+#include "optimizer/var.h"
 #include "storage/lmgr.h"
+#include "utils/acl.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/syscache.h"
@@ -32,14 +37,37 @@ static bool pathman_transform_query_walker(Node *node, void *context);
 
 static void disable_standard_inheritance(Query *parse);
 static void rowmark_add_tableoids(Query *parse);
-static void handle_modification_query(Query *parse);
+static void handle_modification_query(Query *parse, bool is_top_level);
+static void prune_modification_query(Query *parse,
+									 const PartRelationInfo *prel,
+									 List *ranges,
+									 List *truncated);
+static bool delete_can_truncate_partitions(Query *parse, bool is_top_level);
+static List *select_partitions_to_truncate(const PartRelationInfo *prel,
+										   List **ranges);
+static bool partition_can_be_truncated(Oid partid);
+static bool quals_need_runtime_pruning(Expr *quals,
+									   const PartRelationInfo *prel,
+									   Index result_rel);
+static bool is_result_key_var(Node *node,
+							  const PartRelationInfo *prel,
+							  Index result_rel);
 
 static void partition_filter_visitor(Plan *plan, void *context);
 
+static void partition_router_visitor(Plan *plan, void *context);
+static void router_children_visitor(Plan *plan, void *context);
+
 static void lock_rows_visitor(Plan *plan, void *context);
 static List *get_tableoids_list(List *tlist);
 
 
+/*
+ * Set while EXPLAIN (without ANALYZE) is being processed,
+ * since such plans are never executed.
+ */
+bool			pathman_explain_only = false;
+
 /*
  * This table is used to ensure that partitioned relation
  * cant't be used with both and without ONLY modifiers.
@@ -145,7 +173,8 @@ plan_tree_walker(Plan *plan,
 void
 pathman_transform_query(Query *parse)
 {
-	pathman_transform_query_walker((Node *) parse, NULL);
+	/* Pass top-level Query as context */
+	pathman_transform_query_walker((Node *) parse, (void *) parse);
 }
 
 /* Walker for pathman_transform_query() */
@@ -165,7 +194,7 @@ pathman_transform_query_walker(Node *node, void *context)
 		/* Apply Query tree modifiers */
 		rowmark_add_tableoids(query);
 		disable_standard_inheritance(query);
-		handle_modification_query(query);
+		handle_modification_query(query, query == (Query *) context);
 
 		/* Handle Query node */
 		return query_tree_walker(query,
@@ -281,9 +310,11 @@ rowmark_add_tableoids(Query *parse)
 	}
 }
 
-/* Checks if query affects only one partition */
+/*
+ * Checks if query affects only one partition (or some of them)
+ */
 static void
-handle_modification_query(Query *parse)
+handle_modification_query(Query *parse, bool is_top_level)
 {
 	const PartRelationInfo *prel;
 	List				   *ranges;
@@ -292,6 +323,8 @@ handle_modification_query(Query *parse)
 	Expr				   *expr;
 	WalkerContext			context;
 	Index					result_rel;
+	List				   *truncated = NIL;
+	bool					can_truncate;
 
 	/* Fetch index of result relation */
 	result_rel = parse->resultRelation;
@@ -315,24 +348,33 @@ handle_modification_query(Query *parse)
 	/* Exit if we must include parent */
 	if (prel->enable_parent) return;
 
+	can_truncate = delete_can_truncate_partitions(parse, is_top_level);
+
 	/* Parse syntax tree and extract partition ranges */
 	ranges = list_make1_irange(make_irange(0, PrelLastChild(prel), false));
 	expr = (Expr *) eval_const_expressions(NULL, parse->jointree->quals);
 
-	/* Exit if there's no expr (no use) */
-	if (!expr) return;
+	if (expr)
+	{
+		/* Parse syntax tree and extract partition ranges */
+		InitWalkerContext(&context, result_rel, prel, NULL, false);
+		wrap = walk_expr_tree(expr, &context);
 
-	/* Parse syntax tree and extract partition ranges */
-	InitWalkerContext(&context, result_rel, prel, NULL, false);
-	wrap = walk_expr_tree(expr, &context);
+		ranges = irange_list_intersection(ranges, wrap->rangeset);
+	}
+	/* Exit if there's no expr (no use), unless we can TRUNCATE partitions */
+	else if (!can_truncate)
+		return;
 
-	ranges = irange_list_intersection(ranges, wrap->rangeset);
+	/* Partitions fully covered by DELETE's quals may be truncated instead */
+	if (can_truncate)
+		truncated = select_partitions_to_truncate(prel, &ranges);
 
 	/*
 	 * If only one partition is affected,
 	 * substitute parent table with partition.
 	 */
-	if (irange_list_length(ranges) == 1)
+	if (!truncated && irange_list_length(ranges) == 1)
 	{
 		IndexRange irange = linitial_irange(ranges);
 
@@ -380,8 +422,334 @@ handle_modification_query(Query *parse)
 
 			/* Finally disable standard planning */
 			rte->inh = false;
+
+			return;
+		}
+	}
+
+	/*
+	 * Nothing to prune if all partitions are affected,
+	 * unless RuntimeAppend could select them at execution time.
+	 */
+	if (!truncated &&
+		irange_list_length(ranges) == PrelChildrenCount(prel) &&
+		!quals_need_runtime_pruning(expr, prel, result_rel))
+		return;
+
+	/* Otherwise scan only selected partitions */
+	prune_modification_query(parse, prel, ranges, truncated);
+}
+
+/*
+ * Check if DELETE is allowed to TRUNCATE partitions. We don't do this
+ * if deleted rows could be seen by anyone (RETURNING, CTEs, subqueries),
+ * or if some of them could be hidden by row level security policies.
+ * DELETE nested in a data-modifying CTE is never allowed to do this,
+ * since the outer statement might still be reading the partitions.
+ */
+static bool
+delete_can_truncate_partitions(Query *parse, bool is_top_level)
+{
+	RangeTblEntry *rte;
+
+	if (!pg_pathman_enable_truncate_on_delete ||
+		!pg_pathman_enable_partition_router)
+		return false;
+
+	if (parse->commandType != CMD_DELETE || !is_top_level)
+		return false;
+
+	/* Result relation should be the only one (no USING) */
+	if (parse->returningList || parse->cteList ||
+		parse->hasSubLinks || list_length(parse->rtable) != 1)
+		return false;
+
+	rte = rt_fetch(parse->resultRelation, parse->rtable);
+
+	if (parse->hasRowSecurity || rte->securityQuals)
+		return false;
+
+	return true;
+}
+
+/*
+ * Pick partitions which are fully covered by DELETE's quals (IR_COMPLETE)
+ * and can be emptied by TRUNCATE. Remaining partitions are left in 'ranges'.
+ */
+static List *
+select_partitions_to_truncate(const PartRelationInfo *prel, List **ranges)
+{
+	Oid		   *children = PrelGetChildrenArray(prel);
+	List	   *truncated = NIL,
+			   *remaining = NIL;
+	ListCell   *lc;
+
+	foreach (lc, *ranges)
+	{
+		IndexRange	irange = lfirst_irange(lc);
+		uint32		i;
+
+		/* Edge partitions still have to be scanned */
+		if (is_irange_lossy(irange))
+		{
+			remaining = lappend_irange(remaining, irange);
+			continue;
+		}
+
+		for (i = irange_lower(irange); i <= irange_upper(irange); i++)
+		{
+			if (partition_can_be_truncated(children[i]))
+				truncated = lappend_oid(truncated, children[i]);
+			else
+				remaining = lappend_irange(remaining,
+										   make_irange(i, i, IR_COMPLETE));
+		}
+	}
+
+	*ranges = remaining;
+
+	return truncated;
+}
+
+/*
+ * TRUNCATE must have the same effect as DELETE of all rows.
+ *
+ * TRUNCATE needs AccessExclusiveLock, so we take it right away instead of
+ * upgrading a weaker lock in the middle of DELETE. If partition is busy,
+ * we don't wait for it and simply DELETE its rows. Plans which are only
+ * EXPLAINed don't need it (see partition_router_begin()).
+ */
+static bool
+partition_can_be_truncated(Oid partid)
+{
+	Relation	part_rel;
+	LOCKMODE	lockmode = pathman_explain_only ?
+							   RowExclusiveLock :
+							   AccessExclusiveLock;
+	bool		result;
+
+	if (!ConditionalLockRelationOid(partid, lockmode))
+		return false;
+
+	/* Make sure that partition exists */
+	if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(partid)))
+	{
+		UnlockRelationOid(partid, lockmode);
+		return false;
+	}
+
+	part_rel = heap_open(partid, NoLock);
+
+	/*
+	 * Triggers (including the ones of foreign keys) must not be skipped.
+	 * Partition must not be in use by an outer query of this backend
+	 * (e.g. if DELETE is executed by a function it has called).
+	 */
+	result = part_rel->rd_rel->relkind == RELKIND_RELATION &&
+			 part_rel->trigdesc == NULL &&
+			 part_rel->rd_refcnt == 1 &&
+			 pg_class_aclcheck(partid, GetUserId(), ACL_TRUNCATE) == ACLCHECK_OK;
+
+	heap_close(part_rel, NoLock);
+
+	/* DELETE will do with a weaker lock */
+	if (!result && lockmode != RowExclusiveLock)
+	{
+		LockRelationOid(partid, RowExclusiveLock);
+		UnlockRelationOid(partid, lockmode);
+	}
+
+	return result;
+}
+
+/*
+ * Check if quals contain conditions on partitioned column which can't
+ * be evaluated at planning time (e.g. 'id = $1' in a generic plan).
+ * Such conditions will become RuntimeAppend's clauses.
+ */
+static bool
+quals_need_runtime_pruning(Expr *quals,
+						   const PartRelationInfo *prel,
+						   Index result_rel)
+{
+	ListCell *lc;
+
+	if (!pg_pathman_enable_runtimeappend)
+		return false;
+
+	foreach (lc, make_ands_implicit(quals))
+	{
+		Node	   *clause = (Node *) lfirst(lc);
+		Bitmapset  *varattnos = NULL;
+		int			part_attno;
+
+		/* 'key OP (SELECT ...)', sublink will become InitPlan's Param */
+		if (contain_subplans(clause))
+		{
+			if (IsA(clause, OpExpr) &&
+				list_length(((OpExpr *) clause)->args) == 2)
+			{
+				Node   *left = linitial(((OpExpr *) clause)->args),
+					   *right = lsecond(((OpExpr *) clause)->args);
+
+				if ((is_result_key_var(left, prel, result_rel) && IsA(right, SubLink)) ||
+					(is_result_key_var(right, prel, result_rel) && IsA(left, SubLink)))
+					return true;
+			}
+
+			continue;
+		}
+
+		/* Check that clause references only partitioned column */
+		pull_varattnos(clause, result_rel, &varattnos);
+		if (!bms_get_singleton_member(varattnos, &part_attno) ||
+			part_attno + FirstLowInvalidHeapAttributeNumber != prel->attnum)
+			continue;
+
+		/* Params and stable functions */
+		if (clause_contains_params(clause) ||
+			(contain_mutable_functions(clause) &&
+			 !contain_volatile_functions(clause)))
+			return true;
+	}
+
+	return false;
+}
+
+/* Is 'node' a partitioned column of result relation? */
+static bool
+is_result_key_var(Node *node, const PartRelationInfo *prel, Index result_rel)
+{
+	if (IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+
+	return IsA(node, Var) &&
+		   ((Var *) node)->varno == result_rel &&
+		   ((Var *) node)->varlevelsup == 0 &&
+		   ((Var *) node)->varattno == prel->attnum;
+}
+
+/*
+ * Make planner scan only selected partitions of UPDATE's or DELETE's
+ * result relation, instead of planning the query for each child.
+ * PartitionRouter will then pass each tuple to the partition
+ * it came from (see add_partition_routers()).
+ */
+static void
+prune_modification_query(Query *parse,
+						 const PartRelationInfo *prel,
+						 List *ranges,
+						 List *truncated)
+{
+	RangeTblEntry  *rte = rt_fetch(parse->resultRelation, parse->rtable);
+	Oid			   *children = PrelGetChildrenArray(prel);
+	Relation		parent_rel;
+	Var			   *var;
+	TargetEntry	   *tle;
+	ListCell	   *lc;
+	bool			suitable = true;
+
+	/* Exit if PartitionRouter is disabled */
+	if (!pg_pathman_enable_partition_router)
+		return;
+
+	/* Parent has already been locked by rewriter */
+	parent_rel = heap_open(rte->relid, NoLock);
+
+	/* Check that PartitionRouter can modify all selected partitions */
+	foreach (lc, ranges)
+	{
+		IndexRange	irange = lfirst_irange(lc);
+		uint32		i;
+
+		for (i = irange_lower(irange); i <= irange_upper(irange); i++)
+		{
+			Oid					child = children[i];
+			Relation			child_rel;
+			TupleConversionMap *tuple_map;
+
+			/* Make sure that 'child' exists */
+			LockRelationOid(child, RowExclusiveLock);
+			if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(child)))
+			{
+				UnlockRelationOid(child, RowExclusiveLock);
+				suitable = false;
+				break;
+			}
+
+			child_rel = heap_open(child, NoLock);
+
+			/* FDW partitions require their own ModifyTable subplans */
+			if (child_rel->rd_rel->relkind != RELKIND_RELATION)
+				suitable = false;
+
+			/* Partitions should not require tuple conversion */
+			else if ((tuple_map = build_part_tuple_map(parent_rel, child_rel)) != NULL)
+			{
+				free_conversion_map(tuple_map);
+				suitable = false;
+			}
+
+			heap_close(child_rel, NoLock);
+
+			if (!suitable)
+				break;
 		}
+
+		if (!suitable)
+			break;
 	}
+
+	heap_close(parent_rel, NoLock);
+
+	/* Fall back to standard inheritance */
+	if (!suitable)
+		return;
+
+	/* Add junk 'tableoid' attribute, it will tell us the partition */
+	var = makeVar(parse->resultRelation,
+				  TableOidAttributeNumber,
+				  OIDOID,
+				  -1,
+				  InvalidOid,
+				  0);
+
+	tle = makeTargetEntry((Expr *) var,
+						  list_length(parse->targetList) + 1,
+						  pstrdup(PARTITION_ROUTER_TABLEOID),
+						  true);
+
+	/* There's no problem here since new attribute is junk */
+	parse->targetList = lappend(parse->targetList, tle);
+
+	/* Pass partitions to be truncated to hook and PartitionRouter */
+	if (truncated)
+	{
+		Datum	   *elems = palloc(list_length(truncated) * sizeof(Datum));
+		ArrayType  *array;
+		Const	   *con;
+		int			i = 0;
+
+		foreach (lc, truncated)
+			elems[i++] = ObjectIdGetDatum(lfirst_oid(lc));
+
+		array = construct_array(elems, i, OIDOID, sizeof(Oid), true, 'i');
+		con = makeConst(OIDARRAYOID, -1, InvalidOid, -1,
+						PointerGetDatum(array), false, false);
+
+		tle = makeTargetEntry((Expr *) con,
+							  list_length(parse->targetList) + 1,
+							  pstrdup(PARTITION_ROUTER_TRUNCATED),
+							  true);
+
+		parse->targetList = lappend(parse->targetList, tle);
+	}
+
+	/* Partitions will be selected by pathman_rel_pathlist_hook() */
+	rte->inh = false;
+	assign_rel_parenthood_status(parse->queryId,
+								 rte->relid,
+								 PARENTHOOD_ALLOWED);
 }
 
 
@@ -447,6 +815,165 @@ partition_filter_visitor(Plan *plan, void *context)
 }
 
 
+/*
+ * -------------------------------
+ *  PartitionRouter-related stuff
+ * -------------------------------
+ */
+
+/* Used by router_children_visitor() */
+typedef struct
+{
+	List   *rtable;
+	Oid		parent_relid;
+	List   *child_rtis;
+} router_children_cxt;
+
+/* Add PartitionRouter nodes to the plan tree */
+void
+add_partition_routers(List *rtable, Plan *plan)
+{
+	plan_tree_walker(plan, partition_router_visitor, rtable);
+}
+
+/*
+ * Add partition routers to ModifyTable node's children
+ * which have been pruned by prune_modification_query().
+ *
+ * 'context' should point to the PlannedStmt->rtable.
+ */
+static void
+partition_router_visitor(Plan *plan, void *context)
+{
+	List		   *rtable = (List *) context;
+	ModifyTable	   *modify_table = (ModifyTable *) plan;
+	ListCell	   *lc1,
+				   *lc2,
+				   *lc3;
+
+	/* Skip if not ModifyTable with 'UPDATE' or 'DELETE' command */
+	if (!IsA(modify_table, ModifyTable) ||
+			(modify_table->operation != CMD_UPDATE &&
+			 modify_table->operation != CMD_DELETE))
+		return;
+
+	Assert(rtable && IsA(rtable, List));
+
+	forboth (lc1, modify_table->plans, lc2, modify_table->resultRelations)
+	{
+		Plan				   *subplan = (Plan *) lfirst(lc1);
+		Index					rindex = lfirst_int(lc2);
+		TargetEntry			   *tableoid_tle = NULL;
+		router_children_cxt		cxt;
+
+		/* Look for a junk attribute added by prune_modification_query() */
+		foreach (lc3, subplan->targetlist)
+		{
+			TargetEntry *tle = (TargetEntry *) lfirst(lc3);
+
+			if (tle->resjunk && tle->resname &&
+				strcmp(tle->resname, PARTITION_ROUTER_TABLEOID) == 0)
+			{
+				tableoid_tle = tle;
+				break;
+			}
+		}
+
+		/* Partitions of this relation are planned by standard inheritance */
+		if (!tableoid_tle)
+			continue;
+
+		cxt.rtable = rtable;
+		cxt.parent_relid = getrelid(rindex, rtable);
+		cxt.child_rtis = NIL;
+
+		/* Collect RT indices of partitions which are going to be modified */
+		plan_tree_walker(subplan, router_children_visitor, (void *) &cxt);
+
+		lfirst(lc1) = make_partition_router(subplan,
+											cxt.parent_relid,
+											modify_table->operation,
+											tableoid_tle->resno,
+											cxt.child_rtis,
+											get_truncated_partitions(subplan->targetlist));
+	}
+}
+
+/*
+ * Fetch partitions which should be truncated instead of
+ * being scanned (see prune_modification_query()).
+ */
+List *
+get_truncated_partitions(List *tlist)
+{
+	ListCell *lc;
+
+	foreach (lc, tlist)
+	{
+		TargetEntry	   *tle = (TargetEntry *) lfirst(lc);
+		List		   *result = NIL;
+		Datum		   *elems;
+		int				nelems,
+						i;
+
+		if (!tle->resjunk || !tle->resname ||
+			strcmp(tle->resname, PARTITION_ROUTER_TRUNCATED) != 0)
+			continue;
+
+		if (!IsA(tle->expr, Const))
+			elog(ERROR, "could not fetch partitions to be truncated");
+
+		deconstruct_array(DatumGetArrayTypeP(((Const *) tle->expr)->constvalue),
+						  OIDOID, sizeof(Oid), true, 'i',
+						  &elems, NULL, &nelems);
+
+		for (i = 0; i < nelems; i++)
+			result = lappend_oid(result, DatumGetObjectId(elems[i]));
+
+		return result;
+	}
+
+	return NIL;
+}
+
+/*
+ * Find scans of result relation's partitions.
+ *
+ * Result relation is never a part of FROM, thus its partitions
+ * (unlike other occurrences of the same table) have !inFromCl.
+ */
+static void
+router_children_visitor(Plan *plan, void *context)
+{
+	router_children_cxt	   *cxt = (router_children_cxt *) context;
+	RangeTblEntry		   *rte;
+	Index					scanrelid;
+
+	switch (nodeTag(plan))
+	{
+		case T_SeqScan:
+		case T_SampleScan:
+		case T_IndexScan:
+		case T_IndexOnlyScan:
+		case T_BitmapHeapScan:
+		case T_TidScan:
+			scanrelid = ((Scan *) plan)->scanrelid;
+			break;
+
+		default:
+			return;
+	}
+
+	rte = rt_fetch(scanrelid, cxt->rtable);
+
+	if (rte->rtekind == RTE_RELATION && !rte->inFromCl &&
+		get_parent_of_partition(rte->relid, NULL) == cxt->parent_relid)
+	{
+		cxt->child_rtis = lappend_int(cxt->child_rtis, scanrelid);
+	}
+}
+
+
 /*
  * -----------------------
  *  Rowmark-related stuff
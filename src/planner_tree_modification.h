@@ -28,10 +28,16 @@ void plan_tree_walker(Plan *plan,
 /* Query tree rewriting utility */
 void pathman_transform_query(Query *parse);
 
+/* Are we planning a query for EXPLAIN (without ANALYZE)? */
+extern bool pathman_explain_only;
+
 /* These functions scribble on Plan tree */
 void add_partition_filters(List *rtable, Plan *plan);
+void add_partition_routers(List *rtable, Plan *plan);
 void postprocess_lock_rows(List *rtable, Plan *plan);
 
+List *get_truncated_partitions(List *tlist);
+
 
 /* used by assign_rel_parenthood_status() etc */
 typedef enum
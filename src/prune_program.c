@@ -0,0 +1,544 @@
+/* ------------------------------------------------------------------------
+ *
+ * prune_program.c
+ *		Flat programs which select partitions for RuntimeAppend's
+ *		clauses without walking their expression trees
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "prune_program.h"
+#include "pathman.h"
+#include "utils.h"
+
+#include "access/nbtree.h"
+#include "executor/executor.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/var.h"
+#include "parser/parse_coerce.h"
+#include "utils/array.h"
+#include "utils/lsyscache.h"
+#include "utils/typcache.h"
+
+
+/* Allocation settings */
+#define INITIAL_ALLOC_NUM	8
+#define ALLOC_EXP			2
+
+
+typedef struct
+{
+	const PartRelationInfo *prel;
+	Index					prel_varno;
+	PlanState			   *parent;		/* for ExecInitExpr() */
+
+	PruneStep			   *steps;
+	int						nsteps;
+	int						allocated;
+
+	int						depth;		/* current size of the stack */
+	int						max_depth;
+} PruneCompileContext;
+
+
+static void compile_clause(PruneCompileContext *ctx, Expr *clause);
+static bool compile_opexpr(PruneCompileContext *ctx, const OpExpr *expr);
+static bool compile_arrexpr(PruneCompileContext *ctx,
+							const ScalarArrayOpExpr *expr);
+
+static PruneStep *append_step(PruneCompileContext *ctx,
+							  PruneStepKind kind,
+							  int nargs);
+static void init_value_step(PruneCompileContext *ctx, PruneStep *step,
+							Node *value, Oid value_type, int strategy);
+
+static bool is_prel_key(const PruneCompileContext *ctx, const Node *node);
+static bool is_runtime_value(const Node *node);
+static bool can_select_by_type(const PartRelationInfo *prel, Oid value_type);
+
+static List *select_partitions_by_value(PruneStep *step,
+										const PartRelationInfo *prel,
+										Datum value);
+
+
+/*
+ * Compile 'clauses' (implicitly ANDed) into a program which could be
+ * executed by run_prune_program() many times, e.g. on each rescan of
+ * RuntimeAppend. Operator and type lookups, FmgrInfos and ExprStates
+ * of VALUEs are resolved once and for all.
+ *
+ * Returns NULL if there are no clauses.
+ */
+PruneProgram *
+compile_prune_program(List *clauses,
+					  const PartRelationInfo *prel,
+					  Index prel_varno,
+					  PlanState *parent)
+{
+	PruneCompileContext	ctx;
+	PruneProgram	   *prog;
+	ListCell		   *lc;
+
+	if (clauses == NIL)
+		return NULL;
+
+	ctx.prel = prel;
+	ctx.prel_varno = prel_varno;
+	ctx.parent = parent;
+	ctx.allocated = INITIAL_ALLOC_NUM;
+	ctx.steps = (PruneStep *) palloc(ctx.allocated * sizeof(PruneStep));
+	ctx.nsteps = 0;
+	ctx.depth = 0;
+	ctx.max_depth = 0;
+
+	foreach (lc, clauses)
+		compile_clause(&ctx, (Expr *) lfirst(lc));
+
+	/* Intersect rangesets of all clauses */
+	if (list_length(clauses) > 1)
+		append_step(&ctx, PRUNE_STEP_AND, list_length(clauses));
+
+	Assert(ctx.depth == 1);
+
+	prog = (PruneProgram *) palloc(sizeof(PruneProgram));
+	prog->parttype = prel->parttype;
+	prog->atttype = prel->atttype;
+	prog->prel_varno = prel_varno;
+	prog->steps = ctx.steps;
+	prog->nsteps = ctx.nsteps;
+	prog->max_depth = ctx.max_depth;
+
+	return prog;
+}
+
+/*
+ * Program depends on partitioning type and column type of the table,
+ * which might have been changed since it was compiled.
+ */
+bool
+prune_program_is_valid(const PruneProgram *prog, const PartRelationInfo *prel)
+{
+	return prog->parttype == prel->parttype &&
+		   prog->atttype == prel->atttype;
+}
+
+/*
+ * Execute the program and return indices of selected partitions
+ * (in the form of a rangeset). Memory is allocated in the current
+ * memory context.
+ */
+List *
+run_prune_program(PruneProgram *prog,
+				  const PartRelationInfo *prel,
+				  ExprContext *econtext)
+{
+	List	  **stack;
+	List	   *result;
+	int			depth = 0;
+	int			i;
+
+	stack = (List **) palloc(prog->max_depth * sizeof(List *));
+
+	for (i = 0; i < prog->nsteps; i++)
+	{
+		PruneStep *step = &prog->steps[i];
+
+		switch (step->kind)
+		{
+			case PRUNE_STEP_OP:
+				{
+					Datum	value;
+					bool	isnull;
+
+					value = ExecEvalExpr(step->value_state, econtext,
+										 &isnull, NULL);
+
+					/* KEY OP NULL doesn't select anything */
+					stack[depth++] = isnull ?
+										NIL :
+										select_partitions_by_value(step, prel,
+																   value);
+				}
+				break;
+
+			case PRUNE_STEP_ARRAY:
+				{
+					Datum		value;
+					bool		isnull;
+					ArrayType  *arrayval;
+					Datum	   *elem_values;
+					bool	   *elem_nulls;
+					int			num_elems,
+								j;
+					List	   *ranges = NIL;
+
+					value = ExecEvalExpr(step->value_state, econtext,
+										 &isnull, NULL);
+
+					if (!isnull)
+					{
+						arrayval = DatumGetArrayTypeP(value);
+						deconstruct_array(arrayval, step->value_type,
+										  step->elemlen, step->elembyval,
+										  step->elemalign,
+										  &elem_values, &elem_nulls,
+										  &num_elems);
+
+						/* NULL elements don't select anything */
+						for (j = 0; j < num_elems; j++)
+							if (!elem_nulls[j])
+								ranges = irange_list_union(ranges,
+														   select_partitions_by_value(step, prel,
+																					  elem_values[j]));
+					}
+
+					stack[depth++] = ranges;
+				}
+				break;
+
+			case PRUNE_STEP_WALK:
+				{
+					WalkerContext	wcxt;
+					WrapperNode	   *wrap;
+
+					InitWalkerContext(&wcxt, prog->prel_varno,
+									  prel, econtext, false);
+					wrap = walk_expr_tree(step->clause, &wcxt);
+
+					stack[depth++] = wrap->rangeset;
+				}
+				break;
+
+			case PRUNE_STEP_AND:
+			case PRUNE_STEP_OR:
+				{
+					List   *ranges;
+					int		j;
+
+					Assert(depth >= step->nargs);
+
+					ranges = stack[depth - step->nargs];
+					for (j = depth - step->nargs + 1; j < depth; j++)
+					{
+						if (step->kind == PRUNE_STEP_AND)
+							ranges = irange_list_intersection(ranges, stack[j]);
+						else
+							ranges = irange_list_union(ranges, stack[j]);
+					}
+
+					depth -= step->nargs;
+					stack[depth++] = ranges;
+				}
+				break;
+
+			default:
+				elog(ERROR, "Unknown prune step kind %u", step->kind);
+		}
+	}
+
+	Assert(depth == 1);
+
+	result = stack[0];
+	pfree(stack);
+
+	return result;
+}
+
+
+/*
+ * Emit steps for a single clause.
+ */
+static void
+compile_clause(PruneCompileContext *ctx, Expr *clause)
+{
+	PruneStep *step;
+
+	switch (nodeTag(clause))
+	{
+		case T_BoolExpr:
+			{
+				BoolExpr   *expr = (BoolExpr *) clause;
+				ListCell   *lc;
+
+				/* NOT is left to walk_expr_tree() */
+				if (expr->boolop == NOT_EXPR)
+					break;
+
+				foreach (lc, expr->args)
+					compile_clause(ctx, (Expr *) lfirst(lc));
+
+				append_step(ctx,
+							expr->boolop == AND_EXPR ?
+								PRUNE_STEP_AND :
+								PRUNE_STEP_OR,
+							list_length(expr->args));
+			}
+			return;
+
+		case T_OpExpr:
+			if (compile_opexpr(ctx, (OpExpr *) clause))
+				return;
+			break;
+
+		case T_ScalarArrayOpExpr:
+			if (compile_arrexpr(ctx, (ScalarArrayOpExpr *) clause))
+				return;
+			break;
+
+		default:
+			break;
+	}
+
+	/* Function keys, LIKE, range operators etc */
+	step = append_step(ctx, PRUNE_STEP_WALK, 0);
+	step->clause = clause;
+}
+
+/*
+ * KEY OP VALUE or VALUE OP KEY, where OP is a btree operator.
+ */
+static bool
+compile_opexpr(PruneCompileContext *ctx, const OpExpr *expr)
+{
+	const PartRelationInfo *prel = ctx->prel;
+	Node				   *key,
+						   *value;
+	Oid						opno = expr->opno,
+							value_type;
+	TypeCacheEntry		   *tce;
+	int						strategy;
+	PruneStep			   *step;
+
+	if (list_length(expr->args) != 2)
+		return false;
+
+	if (is_prel_key(ctx, linitial(expr->args)))
+	{
+		key = linitial(expr->args);
+		value = lsecond(expr->args);
+	}
+	else if (is_prel_key(ctx, lsecond(expr->args)))
+	{
+		key = lsecond(expr->args);
+		value = linitial(expr->args);
+
+		/* VALUE OP KEY is the same as KEY COMMUTATOR(OP) VALUE */
+		opno = get_commutator(opno);
+		if (!OidIsValid(opno))
+			return false;
+	}
+	else return false;
+
+	if (!is_runtime_value(value))
+		return false;
+
+	tce = lookup_type_cache(exprType(key), TYPECACHE_BTREE_OPFAMILY);
+	strategy = get_op_opfamily_strategy(opno, tce->btree_opf);
+
+	if (strategy == 0)
+		return false;
+
+	value_type = exprType(value);
+
+	/* HASH partitions could be selected by KEY = VALUE only */
+	if (prel->parttype == PT_HASH && strategy != BTEqualStrategyNumber)
+		return false;
+
+	/* Only equality doesn't depend on collation */
+	if (strategy != BTEqualStrategyNumber &&
+		!prel_collation_matches(expr->inputcollid, prel))
+		return false;
+
+	if (!can_select_by_type(prel, value_type))
+		return false;
+
+	step = append_step(ctx, PRUNE_STEP_OP, 0);
+	init_value_step(ctx, step, value, value_type, strategy);
+
+	return true;
+}
+
+/*
+ * KEY = ANY(VALUE), where VALUE is an array.
+ */
+static bool
+compile_arrexpr(PruneCompileContext *ctx, const ScalarArrayOpExpr *expr)
+{
+	const PartRelationInfo *prel = ctx->prel;
+	Node				   *key = linitial(expr->args),
+						   *value = lsecond(expr->args);
+	Oid						elem_type;
+	TypeCacheEntry		   *tce;
+	PruneStep			   *step;
+
+	if (!expr->useOr || !is_prel_key(ctx, key) || !is_runtime_value(value))
+		return false;
+
+	tce = lookup_type_cache(exprType(key), TYPECACHE_BTREE_OPFAMILY);
+	if (get_op_opfamily_strategy(expr->opno,
+								 tce->btree_opf) != BTEqualStrategyNumber)
+		return false;
+
+	elem_type = get_element_type(exprType(value));
+	if (!OidIsValid(elem_type) || !can_select_by_type(prel, elem_type))
+		return false;
+
+	step = append_step(ctx, PRUNE_STEP_ARRAY, 0);
+	init_value_step(ctx, step, value, elem_type, BTEqualStrategyNumber);
+	get_typlenbyvalalign(elem_type,
+						 &step->elemlen,
+						 &step->elembyval,
+						 &step->elemalign);
+
+	return true;
+}
+
+/*
+ * Append a new step and keep track of stack's size.
+ */
+static PruneStep *
+append_step(PruneCompileContext *ctx, PruneStepKind kind, int nargs)
+{
+	PruneStep *step;
+
+	if (ctx->allocated <= ctx->nsteps)
+	{
+		ctx->allocated = ctx->allocated * ALLOC_EXP + 1;
+		ctx->steps = repalloc(ctx->steps, ctx->allocated * sizeof(PruneStep));
+	}
+
+	step = &ctx->steps[ctx->nsteps++];
+	memset((void *) step, 0, sizeof(PruneStep));
+	step->kind = kind;
+	step->nargs = nargs;
+
+	/* AND & OR replace their arguments with a single result */
+	if (kind == PRUNE_STEP_AND || kind == PRUNE_STEP_OR)
+		ctx->depth -= nargs - 1;
+	else
+		ctx->depth++;
+
+	ctx->max_depth = Max(ctx->max_depth, ctx->depth);
+
+	return step;
+}
+
+/*
+ * Prepare VALUE's ExprState and functions which will process its value.
+ */
+static void
+init_value_step(PruneCompileContext *ctx, PruneStep *step,
+				Node *value, Oid value_type, int strategy)
+{
+	const PartRelationInfo *prel = ctx->prel;
+
+	step->value_state = ExecInitExpr((Expr *) value, ctx->parent);
+	step->value_type = value_type;
+	step->strategy = strategy;
+
+	if (prel->parttype == PT_HASH)
+		fmgr_info(prel->hash_proc, &step->hash_func);
+	else
+		fill_prel_cmp_fmgr_info(&step->cmp_func, value_type, prel);
+}
+
+/*
+ * Checks if 'node' is partitioned column (maybe RelabelType'd).
+ */
+static bool
+is_prel_key(const PruneCompileContext *ctx, const Node *node)
+{
+	if (IsA(node, RelabelType))
+		node = (const Node *) ((const RelabelType *) node)->arg;
+
+	return IsA(node, Var) &&
+		   ((const Var *) node)->varoattno == ctx->prel->attnum &&
+		   ((const Var *) node)->varno == ctx->prel_varno;
+}
+
+/*
+ * Checks if 'node' doesn't depend on rows of the partitioned table,
+ * e.g. outer Var of NestLoop replaced with PARAM_EXEC.
+ */
+static bool
+is_runtime_value(const Node *node)
+{
+	return !contain_var_clause((Node *) node) &&
+		   !contain_volatile_functions((Node *) node) &&
+		   !contain_subplans((Node *) node);
+}
+
+/*
+ * Checks if values of 'value_type' could be hashed by 'hash_proc'
+ * or compared to RANGE bounds without errors.
+ */
+static bool
+can_select_by_type(const PartRelationInfo *prel, Oid value_type)
+{
+	Oid				type1 = getBaseType(value_type),
+					type2 = getBaseType(prel->atttype);
+	TypeCacheEntry *tce1,
+				   *tce2;
+
+	/* HASH function accepts values of partitioned column's type only */
+	if (prel->parttype == PT_HASH)
+		return type1 == type2;
+
+	if (type1 == type2 ||
+		IsBinaryCoercible(type1, type2) ||
+		IsBinaryCoercible(type2, type1))
+		return true;
+
+	/* See fill_type_cmp_fmgr_info() */
+	tce1 = lookup_type_cache(type1, TYPECACHE_BTREE_OPFAMILY);
+	tce2 = lookup_type_cache(type2, TYPECACHE_BTREE_OPFAMILY);
+
+	return OidIsValid(tce1->btree_opf) &&
+		   tce1->btree_opf == tce2->btree_opf &&
+		   OidIsValid(get_opfamily_proc(tce1->btree_opf,
+										tce1->btree_opintype,
+										tce2->btree_opintype,
+										BTORDER_PROC));
+}
+
+/*
+ * Select partitions which may contain rows matching KEY OP 'value'.
+ */
+static List *
+select_partitions_by_value(PruneStep *step,
+						   const PartRelationInfo *prel,
+						   Datum value)
+{
+	switch (prel->parttype)
+	{
+		case PT_HASH:
+			{
+				Datum	hash = FunctionCall1(&step->hash_func, value);
+				uint32	idx = hash_to_part_index(DatumGetUInt32(hash),
+												 PrelChildrenCount(prel));
+
+				return list_make1_irange(make_irange(idx, idx, IR_LOSSY));
+			}
+
+		case PT_RANGE:
+			{
+				WrapperNode wrap;
+
+				select_range_partitions(value,
+										&step->cmp_func,
+										PrelGetRangesArray(prel),
+										PrelChildrenCount(prel),
+										step->strategy,
+										&wrap); /* output */
+
+				return wrap.rangeset;
+			}
+
+		default:
+			elog(ERROR, "Unknown partitioning type %u", prel->parttype);
+			return NIL; /* keep compiler happy */
+	}
+}
@@ -0,0 +1,84 @@
+/* ------------------------------------------------------------------------
+ *
+ * prune_program.h
+ *		Flat programs which select partitions for RuntimeAppend's
+ *		clauses without walking their expression trees
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef PRUNE_PROGRAM_H
+#define PRUNE_PROGRAM_H
+
+
+#include "relation_info.h"
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "nodes/execnodes.h"
+#include "nodes/pg_list.h"
+
+
+/*
+ * Kinds of program steps. Steps are stored in reverse Polish notation:
+ * each of the first three kinds pushes a rangeset onto the stack, while
+ * AND and OR replace 'nargs' topmost rangesets with their combination.
+ */
+typedef enum
+{
+	PRUNE_STEP_OP = 0,		/* KEY OP VALUE */
+	PRUNE_STEP_ARRAY,		/* KEY = ANY(VALUE) */
+	PRUNE_STEP_WALK,		/* anything else, see walk_expr_tree() */
+	PRUNE_STEP_AND,			/* intersect 'nargs' topmost rangesets */
+	PRUNE_STEP_OR			/* unite 'nargs' topmost rangesets */
+} PruneStepKind;
+
+typedef struct
+{
+	PruneStepKind	kind;
+
+	/* PRUNE_STEP_OP and PRUNE_STEP_ARRAY */
+	ExprState	   *value_state;	/* computes VALUE once per run */
+	Oid				value_type;		/* VALUE's type (or its element type) */
+	int				strategy;		/* btree strategy of OP */
+	FmgrInfo		cmp_func;		/* compares VALUE to RANGE bounds */
+	FmgrInfo		hash_func;		/* hashes VALUE for HASH partitioning */
+	int16			elemlen;		/* properties of array's elements */
+	bool			elembyval;
+	char			elemalign;
+
+	/* PRUNE_STEP_WALK */
+	Expr		   *clause;
+
+	/* PRUNE_STEP_AND and PRUNE_STEP_OR */
+	int				nargs;
+} PruneStep;
+
+typedef struct
+{
+	PartType		parttype;		/* partitioning type of the table */
+	Oid				atttype;		/* type of its partitioned column */
+	Index			prel_varno;		/* Var::varno of partitioned column */
+
+	PruneStep	   *steps;
+	int				nsteps;
+	int				max_depth;		/* required size of the stack */
+} PruneProgram;
+
+
+PruneProgram *compile_prune_program(List *clauses,
+									const PartRelationInfo *prel,
+									Index prel_varno,
+									PlanState *parent);
+
+bool prune_program_is_valid(const PruneProgram *prog,
+							const PartRelationInfo *prel);
+
+List *run_prune_program(PruneProgram *prog,
+						const PartRelationInfo *prel,
+						ExprContext *econtext);
+
+
+#endif /* PRUNE_PROGRAM_H */
@@ -409,3 +409,24 @@ irange_list_find(List *rangeset, int index, bool *lossy)
 	}
 	return false;
 }
+
+/* Set lossiness of all ranges in range list */
+List *
+irange_list_set_lossiness(List *rangeset, bool lossy)
+{
+	ListCell   *lc;
+	List	   *result = NIL;
+
+	foreach (lc, rangeset)
+	{
+		IndexRange	irange = lfirst_irange(lc);
+
+		/* Union will merge adjacent ranges */
+		result = irange_list_union(result,
+								   list_make1_irange(make_irange(irange_lower(irange),
+																 irange_upper(irange),
+																 lossy)));
+	}
+
+	return result;
+}
@@ -140,6 +140,7 @@ List *irange_list_intersection(List *a, List *b);
 /* Utility functions */
 int irange_list_length(List *rangeset);
 bool irange_list_find(List *rangeset, int index, bool *lossy);
+List *irange_list_set_lossiness(List *rangeset, bool lossy);
 
 
 #endif /* PATHMAN_RANGESET_H */
@@ -18,8 +18,10 @@
 #include "catalog/catalog.h"
 #include "catalog/indexing.h"
 #include "catalog/pg_inherits.h"
+#include "catalog/pg_type.h"
 #include "miscadmin.h"
 #include "storage/lmgr.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/hsearch.h"
@@ -53,6 +55,8 @@ static bool		delayed_shutdown = false; /* pathman was dropped */
 	} while (0)
 
 
+static void fill_prel_zone_map_columns(PartRelationInfo *prel,
+									   Datum columns_array);
 static bool try_perform_parent_refresh(Oid parent);
 static Oid try_syscache_parent_search(Oid partition, PartParentSearch *status);
 static Oid get_parent_of_partition_internal(Oid partition,
@@ -151,7 +155,8 @@ refresh_pathman_relation_info(Oid relid,
 	prel->attlen	= typcache->typlen;
 	prel->attalign	= typcache->typalign;
 
-	prel->cmp_proc	= typcache->cmp_proc;
+	prel->cmp_proc	= get_collation_free_cmp_proc(typcache->cmp_proc,
+												  prel->attcollid);
 	prel->hash_proc	= typcache->hash_proc;
 
 	/* Try searching for children (don't wait if we can't lock) */
@@ -214,10 +219,15 @@ refresh_pathman_relation_info(Oid relid,
 	if (prel_children)
 		pfree(prel_children);
 
-	/* Read additional parameters ('enable_parent' and 'auto' at the moment) */
+	/* Read additional parameters ('enable_parent' and zone maps at the moment) */
+	prel->zone_map_ncolumns = 0;
 	if (read_pathman_params(relid, param_values, param_isnull))
 	{
 		prel->enable_parent = param_values[Anum_pathman_config_params_enable_parent - 1];
+
+		if (!param_isnull[Anum_pathman_config_params_zone_map_columns - 1])
+			fill_prel_zone_map_columns(prel, param_values[
+								Anum_pathman_config_params_zone_map_columns - 1]);
 	}
 	/* Else set default values if they cannot be found */
 	else
@@ -231,6 +241,36 @@ refresh_pathman_relation_info(Oid relid,
 	return prel;
 }
 
+/*
+ * Resolve names of columns having zone maps (see set_zone_map_columns()).
+ * Unknown columns (e.g. dropped ones) are silently skipped.
+ */
+static void
+fill_prel_zone_map_columns(PartRelationInfo *prel, Datum columns_array)
+{
+	Datum	   *names;
+	int			nnames,
+				i;
+
+	deconstruct_array(DatumGetArrayTypeP(columns_array),
+					  TEXTOID, -1, false, 'i',
+					  &names, NULL, &nnames);
+
+	for (i = 0; i < nnames; i++)
+	{
+		char	   *attname = TextDatumGetCString(names[i]);
+		AttrNumber	attnum = get_attnum(PrelParentRelid(prel), attname);
+
+		if (attnum == InvalidAttrNumber)
+			continue;
+
+		if (prel->zone_map_ncolumns >= PART_ZONE_MAP_MAX_COLUMNS)
+			break;
+
+		prel->zone_map_attnums[prel->zone_map_ncolumns++] = attnum;
+	}
+}
+
 /* Invalidate PartRelationInfo cache entry. Create new entry if 'found' is NULL. */
 void
 invalidate_pathman_relation_info(Oid relid, bool *found)
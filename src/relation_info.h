@@ -108,6 +108,9 @@ typedef struct
 					max;
 } RangeEntry;
 
+/* Max number of columns with per-partition summaries (see zone_map.h) */
+#define PART_ZONE_MAP_MAX_COLUMNS	8
+
 /*
  * PartRelationInfo
  *		Per-relation partitioning information
@@ -133,6 +136,9 @@ typedef struct
 
 	Oid				cmp_proc,		/* comparison fuction for 'atttype' */
 					hash_proc;		/* hash function for 'atttype' */
+
+	int				zone_map_ncolumns;	/* columns with zone maps */
+	AttrNumber		zone_map_attnums[PART_ZONE_MAP_MAX_COLUMNS];
 } PartRelationInfo;
 
 /*
@@ -115,7 +115,8 @@ heap_compare_slots(Datum a, Datum b, void *arg)
 }
 
 static void
-pack_runtimemergeappend_private(CustomScan *cscan, MergeAppendGuts *mag)
+pack_runtimemergeappend_private(CustomScan *cscan, MergeAppendGuts *mag,
+								rma_scan_order scan_order)
 {
 	List   *runtimemergeappend_private = NIL;
 	List   *sortColIdx		= NIL,
@@ -132,11 +133,12 @@ pack_runtimemergeappend_private(CustomScan *cscan, MergeAppendGuts *mag)
 		nullsFirst		= lappend_int(nullsFirst, mag->nullsFirst[i]);
 	}
 
-	runtimemergeappend_private = list_make2(makeInteger(mag->numCols),
+	runtimemergeappend_private = list_make3(makeInteger(mag->numCols),
 											list_make4(sortColIdx,
 													   sortOperators,
 													   collations,
-													   nullsFirst));
+													   nullsFirst),
+											makeInteger(scan_order));
 
 	/*
 	 * Append RuntimeMergeAppend's data to the 'custom_private' (2nd).
@@ -189,6 +191,9 @@ unpack_runtimemergeappend_private(RuntimeMergeAppendState *scan_state,
 	FillStateField(sortOperators,	Oid,		lfirst_oid);
 	FillStateField(collations,		Oid,		lfirst_oid);
 	FillStateField(nullsFirst,		bool,		lfirst_int);
+
+	scan_state->scan_order = (rma_scan_order)
+			intVal(lthird(runtimemergeappend_private));
 }
 
 void
@@ -225,6 +230,7 @@ Path *
 create_runtimemergeappend_path(PlannerInfo *root,
 							   AppendPath *inner_append,
 							   ParamPathInfo *param_info,
+							   rma_scan_order scan_order,
 							   double sel)
 {
 	RelOptInfo *rel = inner_append->path.parent;
@@ -243,6 +249,28 @@ create_runtimemergeappend_path(PlannerInfo *root,
 		limit_tuples = -1.0;
 
 	((RuntimeMergeAppendPath *) path)->limit_tuples = limit_tuples;
+	((RuntimeMergeAppendPath *) path)->scan_order = scan_order;
+
+	/* Only the first child has to be started before we return a tuple */
+	if (scan_order != RMA_MERGE_CHILDREN && inner_append->subpaths)
+	{
+		Path   *first_child;
+
+		/*
+		 * MergeAppend's children are sorted by bounds in ascending order,
+		 * while ordered Append's children already follow the scan order.
+		 */
+		if (IsA(inner_append, MergeAppendPath) && scan_order == RMA_ORDERED_DESC)
+			first_child = (Path *) llast(inner_append->subpaths);
+		else
+			first_child = (Path *) linitial(inner_append->subpaths);
+
+		/* Child will be sorted if its ordering doesn't match */
+		if (pathkeys_contained_in(path->pathkeys, first_child->pathkeys))
+			path->startup_cost = first_child->startup_cost;
+		else
+			path->startup_cost = first_child->total_cost;
+	}
 
 	return path;
 }
@@ -334,7 +362,8 @@ create_runtimemergeappend_plan(PlannerInfo *root, RelOptInfo *rel,
 		lfirst(plan_cell) = subplan;
 	}
 
-	pack_runtimemergeappend_private(node, &mag);
+	pack_runtimemergeappend_private(node, &mag,
+									((RuntimeMergeAppendPath *) best_path)->scan_order);
 
 	return plan;
 }
@@ -349,6 +378,10 @@ runtimemergeappend_create_scan_state(CustomScan *node)
 
 	unpack_runtimemergeappend_private((RuntimeMergeAppendState *) state, node);
 
+	/* Children will be initialized one by one in ordered mode */
+	if (((RuntimeMergeAppendState *) state)->scan_order != RMA_MERGE_CHILDREN)
+		((RuntimeAppendState *) state)->lazy_init = true;
+
 	return state;
 }
 
@@ -427,9 +460,76 @@ fetch_next_tuple(CustomScanState *node)
 	}
 }
 
+/*
+ * Scan children one by one in bound order (partitions don't overlap,
+ * so there's no need to merge their tuples using a binary heap).
+ */
+static void
+fetch_next_tuple_ordered(CustomScanState *node)
+{
+	RuntimeMergeAppendState	   *scan_state = (RuntimeMergeAppendState *) node;
+	RuntimeAppendState		   *rstate = &scan_state->rstate;
+
+	while (rstate->running_idx < rstate->ncur_plans)
+	{
+		ChildScanCommon		child;
+		PlanState		   *ps;
+		int					i;
+
+		/* 'cur_plans' are sorted by bounds in ascending order */
+		if (scan_state->scan_order == RMA_ORDERED_ASC)
+			i = rstate->running_idx;
+		else
+			i = rstate->ncur_plans - rstate->running_idx - 1;
+
+		/* Initialize child only when the previous one is exhausted */
+		child = rstate->cur_plans[i];
+		ps = get_child_plan_state(node, child);
+
+		/* Warm up the next partition while this one is being scanned */
+		prefetch_append_child(node,
+							  scan_state->scan_order == RMA_ORDERED_ASC ?
+								  i + 1 :
+								  i - 1);
+
+		for (;;)
+		{
+			TupleTableSlot *slot;
+			bool			quals;
+
+			slot = ExecProcNode(ps);
+
+			if (TupIsNull(slot))
+				break;
+
+			node->ss.ps.ps_ExprContext->ecxt_scantuple = slot;
+			quals = ExecQual(rstate->custom_expr_states,
+							 node->ss.ps.ps_ExprContext, false);
+
+			ResetExprContext(node->ss.ps.ps_ExprContext);
+
+			if (quals)
+			{
+				rstate->slot = slot;
+				return;
+			}
+		}
+
+		rstate->running_idx++;
+	}
+
+	/* All the subplans are exhausted */
+	rstate->slot = NULL;
+}
+
 TupleTableSlot *
 runtimemergeappend_exec(CustomScanState *node)
 {
+	RuntimeMergeAppendState *scan_state = (RuntimeMergeAppendState *) node;
+
+	if (scan_state->scan_order != RMA_MERGE_CHILDREN)
+		return exec_append_common(node, fetch_next_tuple_ordered);
+
 	return exec_append_common(node, fetch_next_tuple);
 }
 
@@ -453,10 +553,36 @@ runtimemergeappend_rescan(CustomScanState *node)
 
 	rescan_append_common(node);
 
+	/* Ordered mode doesn't need any sort-related stuff */
+	if (scan_state->scan_order != RMA_MERGE_CHILDREN)
+		return;
+
 	nplans = scan_state->rstate.ncur_plans;
 
-	scan_state->ms_slots = (TupleTableSlot **) palloc0(sizeof(TupleTableSlot *) * nplans);
-	scan_state->ms_heap = binaryheap_allocate(nplans, heap_compare_slots, scan_state);
+	/* Reuse slots and heap of the previous run if they are big enough */
+	if (!scan_state->ms_heap || scan_state->ms_nslots < nplans)
+	{
+		if (scan_state->ms_heap)
+		{
+			pfree(scan_state->ms_slots);
+			binaryheap_free(scan_state->ms_heap);
+		}
+
+		scan_state->ms_nslots = Max(nplans, 1);
+		scan_state->ms_slots = (TupleTableSlot **)
+				palloc0(sizeof(TupleTableSlot *) * scan_state->ms_nslots);
+		scan_state->ms_heap = binaryheap_allocate(scan_state->ms_nslots,
+												  heap_compare_slots,
+												  scan_state);
+	}
+
+	/* Sort keys don't depend on selected partitions */
+	if (scan_state->ms_sortkeys)
+	{
+		binaryheap_reset(scan_state->ms_heap);
+		scan_state->ms_initialized = false;
+		return;
+	}
 
 	/*
 	 * initialize sort-key information
@@ -502,6 +628,13 @@ runtimemergeappend_explain(CustomScanState *node, List *ancestors, ExplainState
 						 scan_state->numCols, scan_state->sortColIdx,
 						 scan_state->sortOperators, scan_state->collations,
 						 scan_state->nullsFirst, ancestors, es);
+
+	/* Show that children are not merged */
+	if (scan_state->scan_order != RMA_MERGE_CHILDREN)
+		ExplainPropertyText("Partition Scan Order",
+							scan_state->scan_order == RMA_ORDERED_ASC ?
+								"Ascending" : "Descending",
+							es);
 }
 
 
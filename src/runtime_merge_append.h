@@ -20,11 +20,22 @@
 #include "postgres.h"
 
 
+/*
+ * Defines the way RuntimeMergeAppend combines its children.
+ */
+typedef enum
+{
+	RMA_MERGE_CHILDREN = 0,	/* merge all children using a binary heap */
+	RMA_ORDERED_ASC,		/* scan children one by one (ascending bounds) */
+	RMA_ORDERED_DESC		/* scan children one by one (descending bounds) */
+} rma_scan_order;
+
 typedef struct
 {
 	RuntimeAppendPath	rpath;
 
 	double				limit_tuples;
+	rma_scan_order		scan_order;
 } RuntimeMergeAppendPath;
 
 typedef struct
@@ -41,7 +52,10 @@ typedef struct
 	SortSupport			ms_sortkeys;
 	TupleTableSlot	  **ms_slots;
 	struct binaryheap  *ms_heap;
+	int					ms_nslots;		/* capacity of ms_slots and ms_heap */
 	bool				ms_initialized;
+
+	rma_scan_order		scan_order;		/* do we need a binary heap? */
 } RuntimeMergeAppendState;
 
 
@@ -57,6 +71,7 @@ void init_runtime_merge_append_static_data(void);
 Path * create_runtimemergeappend_path(PlannerInfo *root,
 									  AppendPath *inner_append,
 									  ParamPathInfo *param_info,
+									  rma_scan_order scan_order,
 									  double sel);
 
 Plan * create_runtimemergeappend_plan(PlannerInfo *root, RelOptInfo *rel,
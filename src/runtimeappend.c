@@ -11,11 +11,13 @@
 #include "runtimeappend.h"
 
 #include "postgres.h"
+#include "optimizer/cost.h"
 #include "utils/memutils.h"
 #include "utils/guc.h"
 
 
 bool				pg_pathman_enable_runtimeappend = true;
+int					pg_pathman_runtime_prefetch_depth = 0;
 
 CustomPathMethods	runtimeappend_path_methods;
 CustomScanMethods	runtimeappend_plan_methods;
@@ -39,6 +41,11 @@ init_runtimeappend_static_data(void)
 	runtimeappend_exec_methods.MarkPosCustomScan		= NULL;
 	runtimeappend_exec_methods.RestrPosCustomScan		= NULL;
 	runtimeappend_exec_methods.ExplainCustomScan		= runtimeappend_explain;
+#if PG_VERSION_NUM >= 90600
+	runtimeappend_exec_methods.EstimateDSMCustomScan	= runtimeappend_estimate_dsm;
+	runtimeappend_exec_methods.InitializeDSMCustomScan	= runtimeappend_initialize_dsm;
+	runtimeappend_exec_methods.InitializeWorkerCustomScan = runtimeappend_initialize_worker;
+#endif
 
 	DefineCustomBoolVariable("pg_pathman.enable_runtimeappend",
 							 "Enables the planner's use of RuntimeAppend custom node.",
@@ -50,6 +57,18 @@ init_runtimeappend_static_data(void)
 							 NULL,
 							 NULL,
 							 NULL);
+
+	DefineCustomIntVariable("pg_pathman.runtime_prefetch_depth",
+							"Number of blocks of the next partition to be prefetched by RuntimeAppend.",
+							NULL,
+							&pg_pathman_runtime_prefetch_depth,
+							0,
+							0, INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
 }
 
 Path *
@@ -65,6 +84,46 @@ create_runtimeappend_path(PlannerInfo *root,
 									 sel);
 }
 
+#if PG_VERSION_NUM >= 90600
+/*
+ * Create partial RuntimeAppend path. Its processes share the selected
+ * partitions, i.e. each partition is scanned by a single worker.
+ */
+Path *
+create_parallel_runtimeappend_path(PlannerInfo *root,
+								   AppendPath *inner_append,
+								   double sel)
+{
+	Path	   *path;
+	int			parallel_workers;
+	double		parallel_divisor,
+				leader_contribution;
+
+	parallel_workers = Min(list_length(inner_append->subpaths),
+						   max_parallel_workers_per_gather);
+	if (parallel_workers <= 0)
+		return NULL;
+
+	path = create_runtimeappend_path(root, inner_append, NULL, sel);
+
+	/* See get_parallel_divisor() in costsize.c */
+	parallel_divisor = parallel_workers;
+	leader_contribution = 1.0 - (0.3 * parallel_workers);
+	if (leader_contribution > 0)
+		parallel_divisor += leader_contribution;
+
+	path->rows /= parallel_divisor;
+	path->total_cost = path->startup_cost +
+					   (path->total_cost - path->startup_cost) / parallel_divisor;
+
+	path->parallel_aware = true;
+	path->parallel_safe = true;
+	path->parallel_workers = parallel_workers;
+
+	return path;
+}
+#endif
+
 Plan *
 create_runtimeappend_plan(PlannerInfo *root, RelOptInfo *rel,
 						  CustomPath *best_path, List *tlist,
@@ -79,9 +138,22 @@ create_runtimeappend_plan(PlannerInfo *root, RelOptInfo *rel,
 Node *
 runtimeappend_create_scan_state(CustomScan *node)
 {
-	return create_append_scan_state_common(node,
-										   &runtimeappend_exec_methods,
-										   sizeof(RuntimeAppendState));
+	RuntimeAppendState *scan_state;
+
+	scan_state = (RuntimeAppendState *)
+			create_append_scan_state_common(node,
+											&runtimeappend_exec_methods,
+											sizeof(RuntimeAppendState));
+
+	/*
+	 * Children are scanned one by one, so we initialize them on first
+	 * use (e.g. LIMIT or EXISTS might be satisfied by the first one).
+	 * Parallel scans benefit too, since each process scans only some
+	 * of selected partitions.
+	 */
+	scan_state->lazy_init = true;
+
+	return (Node *) scan_state;
 }
 
 void
@@ -90,18 +162,36 @@ runtimeappend_begin(CustomScanState *node, EState *estate, int eflags)
 	begin_append_common(node, estate, eflags);
 }
 
+/* Pick next partition to be scanned (maybe shared with other processes) */
+static int
+get_next_plan_idx(RuntimeAppendState *scan_state)
+{
+	if (scan_state->pstate)
+		return (int) pg_atomic_fetch_add_u32(&scan_state->pstate->next_plan, 1);
+
+	return scan_state->running_idx + 1;
+}
+
 static void
 fetch_next_tuple(CustomScanState *node)
 {
 	RuntimeAppendState	   *scan_state = (RuntimeAppendState *) node;
 	TupleTableSlot		   *slot = NULL;
 
+	/* Parallel scan has to take its first partition */
+	if (scan_state->running_idx < 0)
+		scan_state->running_idx = get_next_plan_idx(scan_state);
+
 	while (scan_state->running_idx < scan_state->ncur_plans)
 	{
 		ChildScanCommon		child = scan_state->cur_plans[scan_state->running_idx];
-		PlanState		   *state = child->content.plan_state;
+		PlanState		   *state = get_child_plan_state(node, child);
 		bool				quals;
 
+		/* Warm up the next partition while this one is being scanned */
+		if (!scan_state->pstate)
+			prefetch_append_child(node, scan_state->running_idx + 1);
+
 		for (;;)
 		{
 			slot = ExecProcNode(state);
@@ -122,7 +212,7 @@ fetch_next_tuple(CustomScanState *node)
 			}
 		}
 
-		scan_state->running_idx++;
+		scan_state->running_idx = get_next_plan_idx(scan_state);
 	}
 
 	scan_state->slot = slot;
@@ -144,7 +234,24 @@ runtimeappend_end(CustomScanState *node)
 void
 runtimeappend_rescan(CustomScanState *node)
 {
+	RuntimeAppendState *scan_state = (RuntimeAppendState *) node;
+
 	rescan_append_common(node);
+
+#if PG_VERSION_NUM >= 90600
+	if (scan_state->pstate)
+	{
+		/*
+		 * Gather shuts down its workers before ReScan, so leader
+		 * may reset the shared state. It has to do this even if
+		 * workers have taken all partitions without its help.
+		 */
+		if (!IsParallelWorker())
+			pg_atomic_write_u32(&scan_state->pstate->next_plan, 0);
+
+		scan_state->running_idx = -1; /* see fetch_next_tuple() */
+	}
+#endif
 }
 
 void
@@ -154,3 +261,36 @@ runtimeappend_explain(CustomScanState *node, List *ancestors, ExplainState *es)
 
 	explain_append_common(node, scan_state->children_table, es);
 }
+
+#if PG_VERSION_NUM >= 90600
+Size
+runtimeappend_estimate_dsm(CustomScanState *node, ParallelContext *pcxt)
+{
+	return sizeof(ParallelRuntimeAppendState);
+}
+
+void
+runtimeappend_initialize_dsm(CustomScanState *node,
+							 ParallelContext *pcxt,
+							 void *coordinate)
+{
+	RuntimeAppendState		   *scan_state = (RuntimeAppendState *) node;
+	ParallelRuntimeAppendState *pstate = (ParallelRuntimeAppendState *) coordinate;
+
+	pg_atomic_init_u32(&pstate->next_plan, 0);
+
+	scan_state->pstate = pstate;
+	scan_state->running_idx = -1;
+}
+
+void
+runtimeappend_initialize_worker(CustomScanState *node,
+								shm_toc *toc,
+								void *coordinate)
+{
+	RuntimeAppendState *scan_state = (RuntimeAppendState *) node;
+
+	scan_state->pstate = (ParallelRuntimeAppendState *) coordinate;
+	scan_state->running_idx = -1;
+}
+#endif
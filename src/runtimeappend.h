@@ -14,11 +14,18 @@
 
 #include "pathman.h"
 #include "nodes_common.h"
+#include "prune_program.h"
+#include "zone_map.h"
 
 #include "postgres.h"
 #include "optimizer/paths.h"
 #include "optimizer/pathnode.h"
 #include "commands/explain.h"
+#include "port/atomics.h"
+
+#if PG_VERSION_NUM >= 90600
+#include "access/parallel.h"
+#endif
 
 
 typedef struct
@@ -28,8 +35,20 @@ typedef struct
 
 	ChildScanCommon	   *children;		/* all available plans */
 	int					nchildren;
+
+	int					join_filter_param;	/* see PartitionSelector */
 } RuntimeAppendPath;
 
+/*
+ * Shared state of a parallel RuntimeAppend (lives in DSM).
+ * Each process selects the same set of partitions, which
+ * are then handed out one by one using 'next_plan'.
+ */
+typedef struct
+{
+	pg_atomic_uint32	next_plan;	/* index of the next partition to scan */
+} ParallelRuntimeAppendState;
+
 typedef struct
 {
 	CustomScanState		css;
@@ -43,22 +62,63 @@ typedef struct
 	HTAB			   *children_table;
 	HASHCTL				children_table_config;
 
+	/* Compiled 'custom_exprs' (NULL if selection is static) */
+	PruneProgram	   *prune_prog;
+
+	/* Values of clauses checked against zone maps and their states */
+	List			   *zone_map_exprs;
+	List			   *zone_map_states;
+	List			   *zone_map_info;	/* attnums, opnos, collations, sides */
+	ZoneMapQual		   *zone_map_quals;
+	int					nzone_map_quals;
+	ZoneMap			   *zone_map;		/* summaries visible to es_snapshot */
+
+	/* Children indexed like PrelGetChildrenArray() at executor startup */
+	ChildScanCommon	   *children_by_idx;
+	Oid				   *children_oids;
+	uint32				nchildren_by_idx;
+	ChildScanCommon		parent_child;	/* plan of the parent table (or NULL) */
+
 	/* Currently selected plans \ plan states */
 	ChildScanCommon	   *cur_plans;
 	int					ncur_plans;
+	int					cur_plans_allocated;
 
 	/* Should we include parent table? Cached for prepared statements */
 	bool				enable_parent;
 
+	/* Should we postpone ExecInitNode() until a child is reached? */
+	bool				lazy_init;
+
+	/* Are partitions selected by begin_append_common() final? */
+	bool				static_selection;
+
+	/* Children pruned by begin_append_common() (-1 if none were checked) */
+	int					nplans_pruned;
+
+	/* Children selected by all runs and those initialized (for EXPLAIN) */
+	long				nplans_selected;
+	long				nplans_initialized;
+
+	/* PARAM_EXEC containing partitions selected by PartitionSelector (or -1) */
+	int					join_filter_param;
+
 	/* Index of the selected plan state */
 	int					running_idx;
 
+	/* Index of the last child prefetched by prefetch_append_child() */
+	int					prefetched_idx;
+
+	/* Shared state of a parallel-aware scan (NULL otherwise) */
+	ParallelRuntimeAppendState *pstate;
+
 	/* Last saved tuple (for SRF projections) */
 	TupleTableSlot	   *slot;
 } RuntimeAppendState;
 
 
 extern bool					pg_pathman_enable_runtimeappend;
+extern int					pg_pathman_runtime_prefetch_depth;
 
 extern CustomPathMethods	runtimeappend_path_methods;
 extern CustomScanMethods	runtimeappend_plan_methods;
@@ -72,6 +132,12 @@ Path * create_runtimeappend_path(PlannerInfo *root,
 								 ParamPathInfo *param_info,
 								 double sel);
 
+#if PG_VERSION_NUM >= 90600
+Path * create_parallel_runtimeappend_path(PlannerInfo *root,
+										  AppendPath *inner_append,
+										  double sel);
+#endif
+
 Plan * create_runtimeappend_plan(PlannerInfo *root, RelOptInfo *rel,
 								 CustomPath *best_path, List *tlist,
 								 List *clauses, List *custom_plans);
@@ -92,5 +158,18 @@ void runtimeappend_explain(CustomScanState *node,
 						   List *ancestors,
 						   ExplainState *es);
 
+#if PG_VERSION_NUM >= 90600
+Size runtimeappend_estimate_dsm(CustomScanState *node,
+								ParallelContext *pcxt);
+
+void runtimeappend_initialize_dsm(CustomScanState *node,
+								  ParallelContext *pcxt,
+								  void *coordinate);
+
+void runtimeappend_initialize_worker(CustomScanState *node,
+									 shm_toc *toc,
+									 void *coordinate);
+#endif
+
 
 #endif /* RUNTIME_APPEND_H */
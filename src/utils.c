@@ -24,9 +24,11 @@
 #include "optimizer/var.h"
 #include "parser/parse_coerce.h"
 #include "parser/parse_oper.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
+#include "utils/pg_locale.h"
 #include "utils/syscache.h"
 #include "utils/typcache.h"
 
@@ -68,6 +70,27 @@ is_date_type_internal(Oid typid)
 		   typid == DATEOID;
 }
 
+/*
+ * Check if 'node' is a partitioned column of relation 'varno'.
+ */
+bool
+is_partitioned_column(Node *node, Index varno, const PartRelationInfo *prel)
+{
+	Var *var;
+
+	if (IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+
+	if (!IsA(node, Var))
+		return false;
+
+	var = (Var *) node;
+
+	return var->varno == varno &&
+		   var->varattno == prel->attnum &&
+		   var->varlevelsup == 0;
+}
+
 /*
  * Check if user can alter/drop specified relation. This function is used to
  * make sure that current user can change pg_pathman's config. Returns true
@@ -320,6 +343,51 @@ fill_type_cmp_fmgr_info_error:
 		 format_type_be(type1), format_type_be(type2));
 }
 
+/*
+ * Get BTORDER_PROC for 'value_type' and partitioned column of 'prel'.
+ * Prefers prel's own comparison function if types are compatible.
+ */
+void
+fill_prel_cmp_fmgr_info(FmgrInfo *finfo,
+						Oid value_type,
+						const PartRelationInfo *prel)
+{
+	Oid		type1 = getBaseType(value_type),
+			type2 = getBaseType(prel->atttype);
+
+	if (type1 == type2 || IsBinaryCoercible(type1, type2))
+		fmgr_info(prel->cmp_proc, finfo);
+	else
+		fill_type_cmp_fmgr_info(finfo, type1, type2);
+}
+
+/*
+ * Comparison functions are called without collation, so texts with
+ * "C" collation have to be compared byte-wise (like text_pattern_ops).
+ */
+Oid
+get_collation_free_cmp_proc(Oid cmp_proc, Oid collid)
+{
+	if (cmp_proc == F_BTTEXTCMP && lc_collate_is_c(collid))
+		return F_BTTEXT_PATTERN_CMP;
+
+	return cmp_proc;
+}
+
+/*
+ * Check that operator with input collation 'inputcollid' sorts
+ * values of partitioned column just like prel->cmp_proc does.
+ */
+bool
+prel_collation_matches(Oid inputcollid, const PartRelationInfo *prel)
+{
+	if (inputcollid == prel->attcollid)
+		return true;
+
+	/* Both sort byte-wise, see get_collation_free_cmp_proc() */
+	return lc_collate_is_c(inputcollid) && lc_collate_is_c(prel->attcollid);
+}
+
 /*
  * Fetch binary operator by name and return it's function and ret type.
  */
@@ -492,3 +560,57 @@ extract_binary_interval_from_text(Datum interval_text,	/* interval as TEXT */
 
 	return interval_binary;
 }
+
+/* Convert Datum into CSTRING array */
+char **
+deconstruct_text_array(Datum array, int *array_size)
+{
+	ArrayType  *array_ptr = DatumGetArrayTypeP(array);
+	int16		elemlen;
+	bool		elembyval;
+	char		elemalign;
+
+	Datum	   *elem_values;
+	bool	   *elem_nulls;
+
+	int			arr_size = 0;
+
+	/* Check type invariant */
+	Assert(ARR_ELEMTYPE(array_ptr) == TEXTOID);
+
+	/* Check number of dimensions */
+	if (ARR_NDIM(array_ptr) > 1)
+		elog(ERROR, "'partition_names' and 'tablespaces' may contain only 1 dimension");
+
+	get_typlenbyvalalign(ARR_ELEMTYPE(array_ptr),
+						 &elemlen, &elembyval, &elemalign);
+
+	deconstruct_array(array_ptr,
+					  ARR_ELEMTYPE(array_ptr),
+					  elemlen, elembyval, elemalign,
+					  &elem_values, &elem_nulls, &arr_size);
+
+	/* If there are actual values, convert them into CSTRINGs */
+	if (arr_size > 0)
+	{
+		char  **strings = palloc(arr_size * sizeof(char *));
+		int		i;
+
+		for (i = 0; i < arr_size; i++)
+		{
+			if (elem_nulls[i])
+				elog(ERROR, "'partition_names' and 'tablespaces' may not contain NULLs");
+
+			strings[i] = TextDatumGetCString(elem_values[i]);
+		}
+
+		/* Return an array and it's size */
+		*array_size = arr_size;
+		return strings;
+	}
+	/* Else emit ERROR */
+	else elog(ERROR, "'partition_names' and 'tablespaces' may not be empty");
+
+	/* Keep compiler happy */
+	return NULL;
+}
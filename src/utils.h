@@ -26,6 +26,8 @@
  */
 bool clause_contains_params(Node *clause);
 bool is_date_type_internal(Oid typid);
+bool is_partitioned_column(Node *node, Index varno,
+						   const PartRelationInfo *prel);
 bool check_security_policy_internal(Oid relid, Oid role);
 
 /*
@@ -49,6 +51,11 @@ char get_rel_persistence(Oid relid);
  */
 Operator get_binary_operator(char *opname, Oid arg1, Oid arg2);
 void fill_type_cmp_fmgr_info(FmgrInfo *finfo, Oid type1, Oid type2);
+void fill_prel_cmp_fmgr_info(FmgrInfo *finfo,
+							 Oid value_type,
+							 const PartRelationInfo *prel);
+Oid get_collation_free_cmp_proc(Oid cmp_proc, Oid collid);
+bool prel_collation_matches(Oid inputcollid, const PartRelationInfo *prel);
 void extract_op_func_and_ret_type(char *opname,
 								  Oid type1, Oid type2,
 								  Oid *op_func,
@@ -63,6 +70,7 @@ Datum perform_type_cast(Datum value, Oid in_type, Oid out_type, bool *success);
 Datum extract_binary_interval_from_text(Datum interval_text,
 										Oid part_atttype,
 										Oid *interval_type);
+char ** deconstruct_text_array(Datum array, int *array_size);
 
 
 
@@ -0,0 +1,985 @@
+/* ------------------------------------------------------------------------
+ *
+ * zone_map.c
+ *		Per-partition min/max summaries (zone maps) of columns
+ *		other than partitioning key
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#include "zone_map.h"
+#include "init.h"
+#include "pathman.h"
+#include "utils.h"
+
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/nbtree.h"
+#include "access/xact.h"
+#include "catalog/indexing.h"
+#include "catalog/pg_inherits.h"
+#include "catalog/pg_type.h"
+#include "commands/trigger.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/var.h"
+#include "storage/proc.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/fmgroids.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/typcache.h"
+
+
+PG_FUNCTION_INFO_V1( pathman_zone_map_trigger_func );
+PG_FUNCTION_INFO_V1( pathman_zone_maps_trigger_func );
+
+
+/*
+ * Valid summary of partition's column, used by pathman_zone_map_trigger_func()
+ * to check whether the new row spoils it.
+ */
+typedef struct
+{
+	AttrNumber		attnum;			/* column of the partition */
+	char		   *attname;
+	bool			has_values;
+	Datum			min_value,
+					max_value;
+	FmgrInfo		cmp_func;
+	Oid				collid;
+} PartZoneMapColumn;
+
+typedef struct
+{
+	Oid					partrel;	/* key */
+	int					ncolumns;	/* number of valid summaries */
+	PartZoneMapColumn	columns[PART_ZONE_MAP_MAX_COLUMNS];
+} PartZoneMap;
+
+
+/*
+ * Index of partition in ZoneMap's 'children' (see load_zone_map()).
+ */
+typedef struct
+{
+	Oid				relid;		/* key */
+	uint32			idx;
+} ZoneMapChildIndex;
+
+
+/*
+ * Valid summaries of partitions modified by the current transaction.
+ * Lives in TopTransactionContext, thus we have to check 'partition_zone_maps_lxid'.
+ */
+static HTAB				   *partition_zone_maps = NULL;
+static LocalTransactionId	partition_zone_maps_lxid = InvalidLocalTransactionId;
+static bool					zone_map_callback_registered = false;
+
+
+static Oid get_zone_maps_relid(void);
+static Oid get_inheritance_parent(Oid relid);
+
+static void zone_map_relcache_callback(Datum arg, Oid relid);
+static PartZoneMap *get_partition_zone_map(Relation partition);
+static void spoil_zone_maps(Oid partrel, List *attnames);
+
+static bool is_zone_map_column(const PartRelationInfo *prel, const Node *node,
+							   Index partitioned_rel, AttrNumber *attnum);
+static bool zone_map_excludes(const ZoneMapBounds *bounds,
+							  const ZoneMapQual *qual,
+							  Datum value);
+
+
+/*
+ * Oid of PATHMAN_ZONE_MAPS. Triggers have to work even
+ * if pg_pathman is disabled, so we can't rely on its cache.
+ */
+static Oid
+get_zone_maps_relid(void)
+{
+	if (IsPathmanInitialized())
+		return get_pathman_zone_maps_relid(true);
+
+	return get_relname_relid(PATHMAN_ZONE_MAPS, get_pathman_schema());
+}
+
+/*
+ * Find parent of 'relid' using pg_inherits (InvalidOid if there's none).
+ */
+static Oid
+get_inheritance_parent(Oid relid)
+{
+	Relation	inherits;
+	SysScanDesc	scan;
+	ScanKeyData	key[1];
+	HeapTuple	htup;
+	Oid			parent = InvalidOid;
+
+	ScanKeyInit(&key[0],
+				Anum_pg_inherits_inhrelid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(relid));
+
+	inherits = heap_open(InheritsRelationId, AccessShareLock);
+
+	scan = systable_beginscan(inherits, InheritsRelidSeqnoIndexId,
+							  true, NULL, 1, key);
+
+	if (HeapTupleIsValid(htup = systable_getnext(scan)))
+		parent = ((Form_pg_inherits) GETSTRUCT(htup))->inhparent;
+
+	systable_endscan(scan);
+	heap_close(inherits, AccessShareLock);
+
+	return parent;
+}
+
+
+/*
+ * ---------------------------------
+ *  Planning & execution (pruning)
+ * ---------------------------------
+ */
+
+/*
+ * Checks if 'node' is a tracked column of 'prel' (maybe RelabelType'd).
+ */
+static bool
+is_zone_map_column(const PartRelationInfo *prel, const Node *node,
+				   Index partitioned_rel, AttrNumber *attnum)
+{
+	const Var  *var;
+	int			i;
+
+	if (IsA(node, RelabelType))
+		node = (const Node *) ((const RelabelType *) node)->arg;
+
+	if (!IsA(node, Var))
+		return false;
+
+	var = (const Var *) node;
+	if (var->varno != partitioned_rel || var->varlevelsup != 0)
+		return false;
+
+	for (i = 0; i < prel->zone_map_ncolumns; i++)
+		if (prel->zone_map_attnums[i] == var->varattno)
+		{
+			*attnum = var->varattno;
+			return true;
+		}
+
+	return false;
+}
+
+/*
+ * Extract clauses "column OP value" which could be checked against
+ * zone maps. If 'consts_only' is set, 'value' must be a Const,
+ * otherwise it must not depend on rows of the partitioned table
+ * (outer Vars of NestLoop will be replaced with PARAM_EXEC).
+ */
+List *
+extract_zone_map_clauses(List *restrictinfo_list,
+						 const PartRelationInfo *prel,
+						 Index partitioned_rel,
+						 bool consts_only)
+{
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	foreach (lc, restrictinfo_list)
+	{
+		RestrictInfo   *rinfo = (RestrictInfo *) lfirst(lc);
+		OpExpr		   *expr;
+		Node		   *left,
+					   *right,
+					   *value;
+		AttrNumber		attnum;
+		bool			varonleft;
+		ZoneMapClause  *clause;
+
+		Assert(IsA(rinfo, RestrictInfo));
+
+		if (!IsA(rinfo->clause, OpExpr))
+			continue;
+
+		expr = (OpExpr *) rinfo->clause;
+		if (list_length(expr->args) != 2)
+			continue;
+
+		left = (Node *) linitial(expr->args);
+		right = (Node *) lsecond(expr->args);
+
+		if (is_zone_map_column(prel, left, partitioned_rel, &attnum))
+		{
+			varonleft = true;
+			value = right;
+		}
+		else if (is_zone_map_column(prel, right, partitioned_rel, &attnum))
+		{
+			varonleft = false;
+			value = left;
+		}
+		else continue;
+
+		if (consts_only ?
+				!IsA(value, Const) :
+				(bms_is_member(partitioned_rel, pull_varnos(value)) ||
+				 contain_volatile_functions(value) ||
+				 contain_subplans(value)))
+			continue;
+
+		clause = palloc(sizeof(ZoneMapClause));
+		clause->attnum		= attnum;
+		clause->opno		= expr->opno;
+		clause->inputcollid	= expr->inputcollid;
+		clause->varonleft	= varonleft;
+		clause->value		= (Expr *) value;
+
+		result = lappend(result, clause);
+	}
+
+	return result;
+}
+
+/*
+ * Prepare 'clause' for checks against summaries.
+ * Returns false if its operator doesn't agree with
+ * the ordering used to compute min/max values.
+ */
+bool
+init_zone_map_qual(ZoneMapQual *qual,
+				   const ZoneMapClause *clause,
+				   const PartRelationInfo *prel)
+{
+	Oid				coltype,
+					colcollid,
+					lefttype,
+					righttype,
+					cmp_proc;
+	int32			coltypmod;
+	int				strategy;
+	TypeCacheEntry *tce;
+
+	get_atttypetypmodcoll(PrelParentRelid(prel), clause->attnum,
+						  &coltype, &coltypmod, &colcollid);
+
+	/* Summaries are computed using column's default btree opclass */
+	tce = lookup_type_cache(coltype, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(tce->btree_opf) ||
+		!op_in_opfamily(clause->opno, tce->btree_opf))
+		return false;
+
+	/* ... and column's collation */
+	if (clause->inputcollid != colcollid)
+		return false;
+
+	get_op_opfamily_properties(clause->opno, tce->btree_opf, false,
+							   &strategy, &lefttype, &righttype);
+
+	/* Turn "value OP column" into "column OP value" */
+	if (!clause->varonleft)
+	{
+		Oid		tmp = lefttype;
+
+		lefttype = righttype;
+		righttype = tmp;
+		strategy = BTMaxStrategyNumber + 1 - strategy;
+	}
+
+	cmp_proc = get_opfamily_proc(tce->btree_opf, lefttype, righttype,
+								 BTORDER_PROC);
+	if (!OidIsValid(cmp_proc))
+		return false;
+
+	qual->attnum	= clause->attnum;
+	qual->strategy	= strategy;
+	qual->collid	= colcollid;
+	fmgr_info(cmp_proc, &qual->cmp_func);
+
+	return true;
+}
+
+/*
+ * Load summaries of all partitions of 'prel' visible to 'snapshot'.
+ */
+ZoneMap *
+load_zone_map(const PartRelationInfo *prel, Snapshot snapshot)
+{
+	ZoneMap		   *zmap;
+	Oid				typinput[PART_ZONE_MAP_MAX_COLUMNS],
+					typioparam[PART_ZONE_MAP_MAX_COLUMNS];
+	int32			typmod[PART_ZONE_MAP_MAX_COLUMNS];
+	HTAB		   *child_indices;
+	HASHCTL			ctl;
+	Relation		rel;
+	HeapScanDesc	scan;
+	HeapTuple		htup;
+	uint32			i;
+	int				j;
+
+	zmap = palloc0(sizeof(ZoneMap));
+	zmap->nchildren = PrelChildrenCount(prel);
+	zmap->children = palloc(zmap->nchildren * sizeof(Oid));
+	memcpy(zmap->children, PrelGetChildrenArray(prel),
+		   zmap->nchildren * sizeof(Oid));
+
+	/* Every summary is invalid unless we find it */
+	zmap->ncolumns = prel->zone_map_ncolumns;
+	for (j = 0; j < zmap->ncolumns; j++)
+	{
+		Oid		coltype,
+				colcollid;
+
+		zmap->columns[j].attnum = prel->zone_map_attnums[j];
+		zmap->columns[j].bounds = palloc0(Max(zmap->nchildren, 1) *
+										  sizeof(ZoneMapBounds));
+
+		get_atttypetypmodcoll(PrelParentRelid(prel), prel->zone_map_attnums[j],
+							  &coltype, &typmod[j], &colcollid);
+		getTypeInputInfo(coltype, &typinput[j], &typioparam[j]);
+	}
+
+	if (zmap->nchildren == 0 || zmap->ncolumns == 0)
+		return zmap;
+
+	/* Map partitions' Oids to their indices */
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(ZoneMapChildIndex);
+	ctl.hcxt = CurrentMemoryContext;
+
+	child_indices = hash_create("pg_pathman's zone map children",
+								zmap->nchildren, &ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	for (i = 0; i < zmap->nchildren; i++)
+	{
+		ZoneMapChildIndex *entry = hash_search(child_indices, &zmap->children[i],
+										HASH_ENTER, NULL);
+		entry->idx = i;
+	}
+
+	rel = heap_open(get_pathman_zone_maps_relid(false), AccessShareLock);
+	scan = heap_beginscan(rel, snapshot, 0, NULL);
+
+	while ((htup = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Datum				values[Natts_pathman_zone_maps];
+		bool				isnull[Natts_pathman_zone_maps];
+		ZoneMapChildIndex  *child;
+		AttrNumber			attnum;
+		ZoneMapBounds	   *bounds;
+		Oid					partrel;
+
+		heap_deform_tuple(htup, RelationGetDescr(rel), values, isnull);
+
+		partrel = DatumGetObjectId(values[Anum_pathman_zone_maps_partrel - 1]);
+		child = hash_search(child_indices, &partrel, HASH_FIND, NULL);
+
+		/* Not a partition of this table or not a valid summary */
+		if (!child || !DatumGetBool(values[Anum_pathman_zone_maps_valid - 1]))
+			continue;
+
+		attnum = get_attnum(PrelParentRelid(prel),
+							TextDatumGetCString(values[Anum_pathman_zone_maps_attname - 1]));
+
+		for (j = 0; j < zmap->ncolumns; j++)
+			if (zmap->columns[j].attnum == attnum)
+				break;
+
+		/* Column is not tracked anymore */
+		if (j == zmap->ncolumns)
+			continue;
+
+		bounds = &zmap->columns[j].bounds[child->idx];
+		bounds->valid = true;
+		bounds->has_values = !isnull[Anum_pathman_zone_maps_min_value - 1] &&
+							 !isnull[Anum_pathman_zone_maps_max_value - 1];
+
+		if (bounds->has_values)
+		{
+			bounds->min_value =
+				OidInputFunctionCall(typinput[j],
+									 TextDatumGetCString(values[Anum_pathman_zone_maps_min_value - 1]),
+									 typioparam[j], typmod[j]);
+			bounds->max_value =
+				OidInputFunctionCall(typinput[j],
+									 TextDatumGetCString(values[Anum_pathman_zone_maps_max_value - 1]),
+									 typioparam[j], typmod[j]);
+		}
+	}
+
+	heap_endscan(scan);
+	heap_close(rel, AccessShareLock);
+
+	hash_destroy(child_indices);
+
+	return zmap;
+}
+
+/*
+ * Checks if a partition summarized by 'bounds' contains
+ * no rows matching "column OP value".
+ */
+static bool
+zone_map_excludes(const ZoneMapBounds *bounds,
+				  const ZoneMapQual *qual,
+				  Datum value)
+{
+	FmgrInfo   *cmp_func = (FmgrInfo *) &qual->cmp_func;
+
+#define zm_cmp(a, b) \
+	( DatumGetInt32(FunctionCall2Coll(cmp_func, qual->collid, (a), (b))) )
+
+	/* We know nothing about this partition */
+	if (!bounds->valid)
+		return false;
+
+	/* There are only NULLs (or no rows at all) */
+	if (!bounds->has_values)
+		return true;
+
+	switch (qual->strategy)
+	{
+		case BTLessStrategyNumber:
+			return zm_cmp(bounds->min_value, value) >= 0;
+
+		case BTLessEqualStrategyNumber:
+			return zm_cmp(bounds->min_value, value) > 0;
+
+		case BTEqualStrategyNumber:
+			return zm_cmp(bounds->min_value, value) > 0 ||
+				   zm_cmp(bounds->max_value, value) < 0;
+
+		case BTGreaterEqualStrategyNumber:
+			return zm_cmp(bounds->max_value, value) < 0;
+
+		case BTGreaterStrategyNumber:
+			return zm_cmp(bounds->max_value, value) <= 0;
+
+		default:
+			return false;
+	}
+
+#undef zm_cmp
+}
+
+/*
+ * Remove partitions which can't contain rows matching 'quals' from 'ranges'.
+ * Partitions added or removed after 'zmap' had been loaded are kept.
+ */
+List *
+prune_by_zone_map(List *ranges,
+				  const PartRelationInfo *prel,
+				  const ZoneMap *zmap,
+				  const ZoneMapQual *quals,
+				  const Datum *values,
+				  const bool *isnull,
+				  int nquals)
+{
+	List		   *result = NIL;
+	Oid			   *children = PrelGetChildrenArray(prel);
+	uint32			nchildren = PrelChildrenCount(prel);
+	const ZoneMapBounds **qual_bounds;
+	ListCell	   *lc;
+	int				i,
+					nchecks = 0;
+
+	if (nquals == 0)
+		return ranges;
+
+	/* Find summaries for each qual, skip the useless ones */
+	qual_bounds = palloc0(nquals * sizeof(ZoneMapBounds *));
+	for (i = 0; i < nquals; i++)
+	{
+		int		j;
+
+		if (isnull[i])
+			continue;
+
+		for (j = 0; j < zmap->ncolumns; j++)
+			if (zmap->columns[j].attnum == quals[i].attnum)
+			{
+				qual_bounds[i] = zmap->columns[j].bounds;
+				nchecks++;
+			}
+	}
+
+	if (nchecks == 0)
+		return ranges;
+
+	foreach (lc, ranges)
+	{
+		IndexRange	irange = lfirst_irange(lc);
+		bool		lossy = is_irange_lossy(irange);
+		uint32		start = irange_lower(irange),
+					idx;
+
+		for (idx = irange_lower(irange); idx <= irange_upper(irange); idx++)
+		{
+			bool	excluded = false;
+
+			if (idx < zmap->nchildren && idx < nchildren &&
+				zmap->children[idx] == children[idx])
+			{
+				for (i = 0; i < nquals && !excluded; i++)
+					if (qual_bounds[i] != NULL)
+						excluded = zone_map_excludes(&qual_bounds[i][idx],
+													 &quals[i], values[i]);
+			}
+
+			if (excluded)
+			{
+				if (start < idx)
+					result = lappend_irange(result,
+											make_irange(start, idx - 1, lossy));
+				start = idx + 1;
+			}
+		}
+
+		if (start <= irange_upper(irange))
+			result = lappend_irange(result,
+									make_irange(start, irange_upper(irange), lossy));
+	}
+
+	return result;
+}
+
+/*
+ * Planning-time pruning using clauses "column OP Const".
+ */
+List *
+prune_by_zone_map_consts(List *ranges,
+						 const PartRelationInfo *prel,
+						 List *restrictinfo_list,
+						 Index partitioned_rel)
+{
+	List		   *clauses;
+	ZoneMapQual	   *quals;
+	Datum		   *values;
+	bool		   *isnull;
+	int				nquals = 0;
+	ZoneMap		   *zmap;
+	Snapshot		snapshot;
+	ListCell	   *lc;
+
+	/* Nothing to prune */
+	if (ranges == NIL)
+		return ranges;
+
+	clauses = extract_zone_map_clauses(restrictinfo_list, prel,
+									   partitioned_rel, true);
+	if (clauses == NIL)
+		return ranges;
+
+	quals	= palloc(list_length(clauses) * sizeof(ZoneMapQual));
+	values	= palloc(list_length(clauses) * sizeof(Datum));
+	isnull	= palloc(list_length(clauses) * sizeof(bool));
+
+	foreach (lc, clauses)
+	{
+		ZoneMapClause  *clause = (ZoneMapClause *) lfirst(lc);
+		Const		   *c = (Const *) clause->value;
+
+		if (!init_zone_map_qual(&quals[nquals], clause, prel))
+			continue;
+
+		values[nquals] = c->constvalue;
+		isnull[nquals] = c->constisnull;
+		nquals++;
+	}
+
+	if (nquals == 0)
+		return ranges;
+
+	/* Use the same snapshot as the query (if there's one) */
+	snapshot = RegisterSnapshot(ActiveSnapshotSet() ?
+									GetActiveSnapshot() :
+									GetLatestSnapshot());
+
+	zmap = load_zone_map(prel, snapshot);
+
+	UnregisterSnapshot(snapshot);
+
+	return prune_by_zone_map(ranges, prel, zmap, quals, values, isnull, nquals);
+}
+
+
+/*
+ * -------------------------------
+ *  Maintenance (writers' side)
+ * -------------------------------
+ */
+
+/*
+ * Forget cached summaries of 'relid' (or all of them).
+ */
+static void
+zone_map_relcache_callback(Datum arg, Oid relid)
+{
+	/* Cache belongs to another (finished) transaction */
+	if (!partition_zone_maps ||
+		partition_zone_maps_lxid != MyProc->lxid)
+		return;
+
+	if (OidIsValid(relid))
+		hash_search(partition_zone_maps, &relid, HASH_REMOVE, NULL);
+	else
+		partition_zone_maps = NULL;
+}
+
+/*
+ * Fetch valid summaries of 'partition' (cached until the end of transaction).
+ */
+static PartZoneMap *
+get_partition_zone_map(Relation partition)
+{
+	Oid				partrel = RelationGetRelid(partition);
+	TupleDesc		tupdesc = RelationGetDescr(partition);
+	PartZoneMap		pzm,
+				   *entry;
+	MemoryContext	old_mcxt;
+	Oid				zone_maps_relid;
+	Relation		rel;
+	HeapScanDesc	scan;
+	ScanKeyData		key[1];
+	Snapshot		snapshot;
+	HeapTuple		htup;
+
+	if (!zone_map_callback_registered)
+	{
+		CacheRegisterRelcacheCallback(zone_map_relcache_callback, (Datum) 0);
+		zone_map_callback_registered = true;
+	}
+
+	/* Cache of previous transaction is gone with TopTransactionContext */
+	if (partition_zone_maps_lxid != MyProc->lxid)
+	{
+		partition_zone_maps = NULL;
+		partition_zone_maps_lxid = MyProc->lxid;
+	}
+
+	if (partition_zone_maps &&
+		(entry = hash_search(partition_zone_maps, &partrel, HASH_FIND, NULL)))
+		return entry;
+
+	memset(&pzm, 0, sizeof(pzm));
+	pzm.partrel = partrel;
+
+	zone_maps_relid = get_zone_maps_relid();
+	if (!OidIsValid(zone_maps_relid))
+		elog(ERROR, "pg_pathman's table \"%s\" does not exist", PATHMAN_ZONE_MAPS);
+
+	old_mcxt = MemoryContextSwitchTo(TopTransactionContext);
+
+	ScanKeyInit(&key[0],
+				Anum_pathman_zone_maps_partrel,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(partrel));
+
+	rel = heap_open(zone_maps_relid, AccessShareLock);
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+	scan = heap_beginscan(rel, snapshot, 1, key);
+
+	while ((htup = heap_getnext(scan, ForwardScanDirection)) != NULL &&
+		   pzm.ncolumns < PART_ZONE_MAP_MAX_COLUMNS)
+	{
+		Datum				values[Natts_pathman_zone_maps];
+		bool				isnull[Natts_pathman_zone_maps];
+		PartZoneMapColumn  *col = &pzm.columns[pzm.ncolumns];
+		Form_pg_attribute	attr;
+		Oid					typinput,
+							typioparam;
+		TypeCacheEntry	   *tce;
+
+		heap_deform_tuple(htup, RelationGetDescr(rel), values, isnull);
+
+		/* Spoiled summaries stay spoiled until refresh */
+		if (!DatumGetBool(values[Anum_pathman_zone_maps_valid - 1]))
+			continue;
+
+		col->attname = TextDatumGetCString(values[Anum_pathman_zone_maps_attname - 1]);
+		col->attnum = get_attnum(partrel, col->attname);
+		if (col->attnum == InvalidAttrNumber)
+			continue;
+
+		attr = tupdesc->attrs[col->attnum - 1];
+
+		tce = lookup_type_cache(attr->atttypid, TYPECACHE_CMP_PROC_FINFO);
+		if (!OidIsValid(tce->cmp_proc_finfo.fn_oid))
+			continue;
+
+		col->cmp_func = tce->cmp_proc_finfo;
+		col->collid = attr->attcollation;
+
+		col->has_values = !isnull[Anum_pathman_zone_maps_min_value - 1] &&
+						  !isnull[Anum_pathman_zone_maps_max_value - 1];
+
+		if (col->has_values)
+		{
+			getTypeInputInfo(attr->atttypid, &typinput, &typioparam);
+
+			col->min_value =
+				OidInputFunctionCall(typinput,
+									 TextDatumGetCString(values[Anum_pathman_zone_maps_min_value - 1]),
+									 typioparam, attr->atttypmod);
+			col->max_value =
+				OidInputFunctionCall(typinput,
+									 TextDatumGetCString(values[Anum_pathman_zone_maps_max_value - 1]),
+									 typioparam, attr->atttypmod);
+		}
+
+		pzm.ncolumns++;
+	}
+
+	heap_endscan(scan);
+	UnregisterSnapshot(snapshot);
+	heap_close(rel, AccessShareLock);
+
+	/* Input functions might have invalidated the cache */
+	if (!partition_zone_maps)
+	{
+		HASHCTL ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(PartZoneMap);
+		ctl.hcxt = TopTransactionContext;
+
+		partition_zone_maps = hash_create("pg_pathman's partition zone maps",
+										  16, &ctl,
+										  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = hash_search(partition_zone_maps, &partrel, HASH_ENTER, NULL);
+	memcpy(entry, &pzm, sizeof(PartZoneMap));
+
+	MemoryContextSwitchTo(old_mcxt);
+
+	return entry;
+}
+
+/*
+ * Mark summaries of columns 'attnames' of 'partrel' as spoiled.
+ *
+ * Rows of PATHMAN_ZONE_MAPS are updated in place (like pg_class is updated
+ * by VACUUM), so that concurrent writers neither wait for each other's row
+ * locks nor get serialization failures. This is not undone if we abort,
+ * which is fine since spoiled summaries are never used. Min & max values
+ * are ignored for spoiled summaries, thus we don't reset them.
+ */
+static void
+spoil_zone_maps(Oid partrel, List *attnames)
+{
+	Relation		rel;
+	HeapScanDesc	scan;
+	ScanKeyData		key[1];
+	Snapshot		snapshot;
+	HeapTuple		htup;
+	bool			spoiled = false;
+	Oid				parent;
+
+	ScanKeyInit(&key[0],
+				Anum_pathman_zone_maps_partrel,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(partrel));
+
+	rel = heap_open(get_zone_maps_relid(), RowExclusiveLock);
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+	scan = heap_beginscan(rel, snapshot, 1, key);
+
+	while ((htup = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Datum		values[Natts_pathman_zone_maps];
+		bool		isnull[Natts_pathman_zone_maps],
+					replace[Natts_pathman_zone_maps] = { false };
+		char	   *attname;
+		HeapTuple	new_htup;
+		ListCell   *lc;
+
+		heap_deform_tuple(htup, RelationGetDescr(rel), values, isnull);
+
+		/* Somebody has already spoiled it */
+		if (!DatumGetBool(values[Anum_pathman_zone_maps_valid - 1]))
+			continue;
+
+		attname = TextDatumGetCString(values[Anum_pathman_zone_maps_attname - 1]);
+
+		foreach (lc, attnames)
+		{
+			if (strcmp((char *) lfirst(lc), attname) == 0)
+				break;
+		}
+
+		/* This summary is fine */
+		if (!lc)
+			continue;
+
+		/* Tuple's length doesn't change, so it can be updated in place */
+		values[Anum_pathman_zone_maps_valid - 1] = BoolGetDatum(false);
+		replace[Anum_pathman_zone_maps_valid - 1] = true;
+
+		new_htup = heap_modify_tuple(htup, RelationGetDescr(rel),
+									 values, isnull, replace);
+		heap_inplace_update(rel, new_htup);
+		heap_freetuple(new_htup);
+
+		spoiled = true;
+	}
+
+	heap_endscan(scan);
+	UnregisterSnapshot(snapshot);
+	heap_close(rel, RowExclusiveLock);
+
+	if (!spoiled)
+		return;
+
+	/* Cached plans might have pruned this partition (see the trigger below) */
+	CacheInvalidateRelcacheByRelid(partrel);
+
+	parent = get_inheritance_parent(partrel);
+	if (OidIsValid(parent))
+		CacheInvalidateRelcacheByRelid(parent);
+
+	/* Local invalidation is postponed till the end of command */
+	if (partition_zone_maps)
+		hash_search(partition_zone_maps, &partrel, HASH_REMOVE, NULL);
+}
+
+/*
+ * AFTER INSERT OR UPDATE trigger of partitions with zone maps. Marks
+ * summaries as spoiled if the new row doesn't fit them. It has to see
+ * rows modified by all BEFORE ROW triggers, which fire in name order.
+ * PartitionFilter and COPY FROM fire AFTER ROW triggers as well, so we
+ * don't miss any writes.
+ */
+Datum
+pathman_zone_map_trigger_func(PG_FUNCTION_ARGS)
+{
+	TriggerData	   *trigdata = (TriggerData *) fcinfo->context;
+	HeapTuple		tuple;
+	PartZoneMap	   *pzm;
+	List		   *spoiled = NIL;
+	int				i;
+
+	/* Handle user calls */
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "this function should not be called directly");
+
+	/* Handle wrong fire mode */
+	if (!TRIGGER_FIRED_FOR_ROW(trigdata->tg_event) ||
+		!TRIGGER_FIRED_AFTER(trigdata->tg_event) ||
+		TRIGGER_FIRED_BY_DELETE(trigdata->tg_event))
+		elog(ERROR, "%s: must be fired after insert or update of row",
+			 trigdata->tg_trigger->tgname);
+
+	tuple = TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event) ?
+				trigdata->tg_newtuple :
+				trigdata->tg_trigtuple;
+
+	pzm = get_partition_zone_map(trigdata->tg_relation);
+
+	for (i = 0; i < pzm->ncolumns; i++)
+	{
+		PartZoneMapColumn  *col = &pzm->columns[i];
+		Datum				value;
+		bool				isnull;
+
+		value = heap_getattr(tuple, col->attnum,
+							 RelationGetDescr(trigdata->tg_relation),
+							 &isnull);
+
+		/* NULLs never match btree operators, thus they're not summarized */
+		if (isnull)
+			continue;
+
+		if (!col->has_values ||
+			DatumGetInt32(FunctionCall2Coll(&col->cmp_func, col->collid,
+											value, col->min_value)) < 0 ||
+			DatumGetInt32(FunctionCall2Coll(&col->cmp_func, col->collid,
+											value, col->max_value)) > 0)
+			spoiled = lappend(spoiled, col->attname);
+	}
+
+	/* NOTE: 'pzm' might be gone after this call */
+	if (spoiled)
+		spoil_zone_maps(RelationGetRelid(trigdata->tg_relation), spoiled);
+
+	/* Result is ignored for AFTER triggers */
+	PG_RETURN_POINTER(NULL);
+}
+
+/*
+ * Trigger of PATHMAN_ZONE_MAPS. Invalidates relcache of both partition and
+ * its parent, so that cached plans and summaries could see the changes.
+ */
+Datum
+pathman_zone_maps_trigger_func(PG_FUNCTION_ARGS)
+{
+	TriggerData	   *trigdata = (TriggerData *) fcinfo->context;
+	Oid				pathman_zone_maps = get_zone_maps_relid();
+	HeapTuple		tuples[2];
+	int				i;
+
+	/* Handle user calls */
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "this function should not be called directly");
+
+	/* Handle wrong fire mode */
+	if (!TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+		elog(ERROR, "%s: must be fired for row",
+			 trigdata->tg_trigger->tgname);
+
+	/* Handle wrong relation */
+	if (RelationGetRelid(trigdata->tg_relation) != pathman_zone_maps)
+		elog(ERROR, "%s: must be fired for relation \"%s\"",
+			 trigdata->tg_trigger->tgname, PATHMAN_ZONE_MAPS);
+
+	tuples[0] = trigdata->tg_trigtuple;
+	tuples[1] = TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event) ?
+					trigdata->tg_newtuple :
+					NULL;
+
+	for (i = 0; i < lengthof(tuples) && tuples[i]; i++)
+	{
+		Datum	partrel_datum;
+		bool	partrel_isnull;
+		Oid		partrel,
+				parent;
+
+		/* Extract partition's Oid */
+		partrel_datum = heap_getattr(tuples[i],
+									 Anum_pathman_zone_maps_partrel,
+									 RelationGetDescr(trigdata->tg_relation),
+									 &partrel_isnull);
+		Assert(partrel_isnull == false); /* partrel should not be NULL! */
+
+		partrel = DatumGetObjectId(partrel_datum);
+
+		if (get_rel_type_id(partrel) == InvalidOid)
+			continue;
+
+		CacheInvalidateRelcacheByRelid(partrel);
+
+		/* Plans don't reference pruned partitions, invalidate parent as well */
+		parent = get_inheritance_parent(partrel);
+		if (OidIsValid(parent))
+			CacheInvalidateRelcacheByRelid(parent);
+	}
+
+	/* Return the tuple we've been given */
+	if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+		PG_RETURN_POINTER(trigdata->tg_newtuple);
+	else
+		PG_RETURN_POINTER(trigdata->tg_trigtuple);
+}
@@ -0,0 +1,105 @@
+/* ------------------------------------------------------------------------
+ *
+ * zone_map.h
+ *		Per-partition min/max summaries (zone maps) of columns
+ *		other than partitioning key
+ *
+ * Copyright (c) 2016, Postgres Professional
+ *
+ * ------------------------------------------------------------------------
+ */
+
+#ifndef ZONE_MAP_H
+#define ZONE_MAP_H
+
+
+#include "relation_info.h"
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "nodes/pg_list.h"
+#include "nodes/primnodes.h"
+#include "utils/snapshot.h"
+
+
+/*
+ * Summary of a column for a single partition. Summaries which have never
+ * been computed or have been spoiled by writes are not 'valid'.
+ */
+typedef struct
+{
+	bool			valid;
+	bool			has_values;		/* false if there are only NULLs */
+	Datum			min_value,
+					max_value;
+} ZoneMapBounds;
+
+typedef struct
+{
+	AttrNumber		attnum;			/* column of the partitioned table */
+	ZoneMapBounds  *bounds;			/* indexed like ZoneMap's 'children' */
+} ZoneMapColumn;
+
+/*
+ * Summaries of all partitions of a table (as seen by some snapshot).
+ */
+typedef struct
+{
+	Oid			   *children;		/* copy of PrelGetChildrenArray() */
+	uint32			nchildren;
+
+	int				ncolumns;
+	ZoneMapColumn	columns[PART_ZONE_MAP_MAX_COLUMNS];
+} ZoneMap;
+
+/*
+ * Clause "column OP value" (or "value OP column") where 'value'
+ * doesn't depend on the partitioned table.
+ */
+typedef struct
+{
+	AttrNumber		attnum;
+	Oid				opno;
+	Oid				inputcollid;
+	bool			varonleft;
+	Expr		   *value;
+} ZoneMapClause;
+
+/*
+ * ZoneMapClause prepared for checks against summaries.
+ */
+typedef struct
+{
+	AttrNumber		attnum;
+	int				strategy;		/* btree strategy of "column OP value" */
+	FmgrInfo		cmp_func;		/* compares column's value to 'value' */
+	Oid				collid;			/* collation for 'cmp_func' */
+} ZoneMapQual;
+
+
+List *extract_zone_map_clauses(List *restrictinfo_list,
+							   const PartRelationInfo *prel,
+							   Index partitioned_rel,
+							   bool consts_only);
+
+bool init_zone_map_qual(ZoneMapQual *qual,
+						const ZoneMapClause *clause,
+						const PartRelationInfo *prel);
+
+ZoneMap *load_zone_map(const PartRelationInfo *prel, Snapshot snapshot);
+
+List *prune_by_zone_map(List *ranges,
+						const PartRelationInfo *prel,
+						const ZoneMap *zmap,
+						const ZoneMapQual *quals,
+						const Datum *values,
+						const bool *isnull,
+						int nquals);
+
+List *prune_by_zone_map_consts(List *ranges,
+							   const PartRelationInfo *prel,
+							   List *restrictinfo_list,
+							   Index partitioned_rel);
+
+
+#endif /* ZONE_MAP_H */
@@ -24,6 +24,8 @@ static void test_irange_list_union_intersecting(void **state);
 
 static void test_irange_list_intersection(void **state);
 
+static void test_irange_list_set_lossiness(void **state);
+
 
 /* Entrypoint */
 int
@@ -38,6 +40,7 @@ main(void)
 		cmocka_unit_test(test_irange_list_union_complete_cov),
 		cmocka_unit_test(test_irange_list_union_intersecting),
 		cmocka_unit_test(test_irange_list_intersection),
+		cmocka_unit_test(test_irange_list_set_lossiness),
 	};
 
 	/* Run series of tests */
@@ -465,3 +468,29 @@ test_irange_list_intersection(void **state)
 	assert_string_equal(rangeset_print(intersection_result),
 						"21L, [22-25]C");
 }
+
+/* Set lossiness of all ranges */
+static void
+test_irange_list_set_lossiness(void **state)
+{
+	List	   *irange_list;
+
+
+	/* Subtest #0 */
+	irange_list = NIL;
+	irange_list = lappend_irange(irange_list, make_irange(0, 10, IR_COMPLETE));
+	irange_list = lappend_irange(irange_list, make_irange(11, 20, IR_LOSSY));
+	irange_list = lappend_irange(irange_list, make_irange(30, 40, IR_COMPLETE));
+
+	assert_string_equal(rangeset_print(irange_list_set_lossiness(irange_list,
+																 IR_LOSSY)),
+						"[0-20]L, [30-40]L");
+
+	/* Subtest #1 */
+	assert_string_equal(rangeset_print(irange_list_set_lossiness(irange_list,
+																 IR_COMPLETE)),
+						"[0-20]C, [30-40]C");
+
+	/* Subtest #2 */
+	assert_true(irange_list_set_lossiness(NIL, IR_LOSSY) == NIL);
+}
@@ -25,6 +25,16 @@ def ordered(obj):
 	else:
 		return obj
 
+# Helper function to find a plan node (depth-first)
+def find_plan_node(plan, pred):
+	if pred(plan):
+		return plan
+	for child in plan.get('Plans', []):
+		node = find_plan_node(child, pred)
+		if node is not None:
+			return node
+	return None
+
 def if_fdw_enabled(func):
 	"""To run tests with FDW support set environment variable TEST_FDW=1"""
 	def wrapper(*args, **kwargs):
@@ -109,6 +119,13 @@ class PartitioningTests(unittest.TestCase):
 			data = node.execute('postgres', 'select count(*) from abc')
 			self.assertEqual(data[0][0], 300000)
 
+			# parent is empty now, so it shouldn't be scanned anymore
+			data = node.execute(
+				'postgres',
+				'select enable_parent from pathman_config_params '
+				'where partrel = \'abc\'::regclass')
+			self.assertEqual(data[0][0], False)
+
 			node.stop()
 		except Exception, e:
 			self.printlog(node.logs_dir + '/postgresql.log')
@@ -645,6 +662,56 @@ class PartitioningTests(unittest.TestCase):
 			""")
 			self.assertEqual(ordered(plan), ordered(expected))
 
+			# Check parallel RuntimeAppend (generic plans use params)
+			con.execute('prepare q(int) as select count(*) from range_partitioned where i < $1')
+			for i in range(7):
+				count = con.execute('execute q(1500)')[0][0]
+				self.assertEqual(count, 1499)
+
+			# Gather must be placed over parallel-aware RuntimeAppend
+			plan = con.execute('''explain (analyze, costs off, timing off, format json)
+								 execute q(1500)''')[0][0]
+			if not isinstance(plan, list):
+				plan = json.loads(plan)
+			gather = find_plan_node(plan[0]['Plan'],
+									lambda n: n['Node Type'] == 'Gather')
+			self.assertIsNotNone(gather)
+			self.assertGreater(gather['Workers Launched'], 0)
+			rtappend = find_plan_node(gather,
+									  lambda n: n.get('Custom Plan Provider') == 'RuntimeAppend')
+			self.assertIsNotNone(rtappend)
+			self.assertTrue(rtappend['Parallel Aware'])
+			con.execute('deallocate q')
+
+			# Check rescans of parallel RuntimeAppend (Gather in a SubPlan)
+			con.execute('''prepare q(int) as
+						   select x, (select count(*) + x * 0 from range_partitioned
+									  where i < $1)
+						   from generate_series(1, 3) x''')
+			for i in range(7):
+				res = con.execute('execute q(1500)')
+				self.assertEqual(res, [(1, 1499), (2, 1499), (3, 1499)])
+
+			plan = con.execute('''explain (analyze, costs off, timing off, format json)
+								 execute q(1500)''')[0][0]
+			if not isinstance(plan, list):
+				plan = json.loads(plan)
+			gather = find_plan_node(plan[0]['Plan'],
+									lambda n: n['Node Type'] == 'Gather')
+			self.assertIsNotNone(gather)
+			self.assertEqual(gather['Actual Loops'], 3)
+			rtappend = find_plan_node(gather,
+									  lambda n: n.get('Custom Plan Provider') == 'RuntimeAppend')
+			self.assertIsNotNone(rtappend)
+			self.assertTrue(rtappend['Parallel Aware'])
+			con.execute('deallocate q')
+
+			con.execute('prepare q(int) as select count(*) from hash_partitioned where i = $1')
+			for i in range(7):
+				count = con.execute('execute q(100)')[0][0]
+				self.assertEqual(count, 1)
+			con.execute('deallocate q')
+
 		# Remove all objects for testing
 		node.psql('postgres', 'drop table range_partitioned cascade')
 		node.psql('postgres', 'drop table hash_partitioned cascade')
@@ -977,6 +1044,104 @@ class PartitioningTests(unittest.TestCase):
 		node.stop()
 		node.cleanup()
 
+	def test_runtime_append_rescans(self):
+		"""Microbenchmark: rescans of RuntimeAppend per second"""
+
+		num_partitions = 100
+		num_rescans = 100000
+
+		# Create and start new instance
+		node = self.start_new_pathman_cluster(allows_streaming=False)
+
+		node.safe_psql('postgres', """
+			create table range_rel(id int not null, val int);
+			insert into range_rel select g, g from generate_series(1, %i) g;
+			create index on range_rel(id);
+			select create_range_partitions('range_rel', 'id', 1, %i);
+			create table outer_rel as
+				select (random() * (%i - 1))::int + 1 as id
+				from generate_series(1, %i);
+			vacuum analyze;
+		""" % (num_partitions * 1000, 1000, num_partitions * 1000, num_rescans))
+
+		query = 'select count(*), sum(r.val) from outer_rel o ' \
+				'join range_rel r on r.id = o.id'
+
+		with node.connect() as con:
+			con.execute('set enable_hashjoin = off')
+			con.execute('set enable_mergejoin = off')
+
+			results = {}
+			for runtimeappend in ['on', 'off']:
+				con.execute('set pg_pathman.enable_runtimeappend = %s' % runtimeappend)
+
+				start = time.time()
+				results[runtimeappend] = con.execute(query)
+				elapsed = time.time() - start
+
+				print('RuntimeAppend %s: %.0f rescans per second' %
+					  (runtimeappend, num_rescans / elapsed))
+
+			# Both plans should produce the same result
+			self.assertEqual(results['on'], results['off'])
+			self.assertEqual(results['on'][0][0], num_rescans)
+
+		# Stop instance and finish work
+		node.stop()
+		node.cleanup()
+
+	def test_create_partitions_pgbench(self):
+		"""Measure TPS of INSERTs creating new partitions with 64 clients"""
+
+		num_clients = 64
+		test_interval = 10
+
+		insert_pgbench_script = os.path.dirname(os.path.realpath(__file__)) \
+					+ "/pgbench_scripts/insert_new_range.pgbench"
+
+		self.assertTrue(os.path.isfile(insert_pgbench_script),
+				msg="pgbench script with insert into new ranges doesn't exist")
+
+		# Create and start new instance
+		node = self.start_new_pathman_cluster(allows_streaming=False)
+
+		# Every 100 rows all clients need the same missing partition
+		node.safe_psql('postgres', """
+			create table range_rel(id int not null);
+			create sequence range_rel_ids;
+			select create_range_partitions('range_rel', 'id', 1, 100, 1);
+		""")
+
+		FNULL = open(os.devnull, 'w')
+		inserts = node.pgbench(stdout=subprocess.PIPE, stderr=FNULL, options=[
+				"-n",
+				"-M", "prepared",
+				"-j", "%i" % 8,
+				"-c", "%i" % num_clients,
+				"-f", insert_pgbench_script,
+				"-T", "%i" % test_interval
+			])
+		inserts.wait()
+
+		output = inserts.stdout.read()
+		tps = re.search("tps = ([0-9.]+) \(excluding", output)
+		self.assertIsNotNone(tps, msg="pgbench has failed")
+
+		# Each range should have been created exactly once
+		num_partitions = node.execute('postgres',
+				'select count(*) from pathman_partition_list')[0][0]
+		num_rows, max_id = node.execute('postgres',
+				'select count(*), max(id) from range_rel')[0]
+		self.assertEqual(num_rows, max_id)
+		self.assertEqual(num_partitions, (max_id - 1) // 100 + 1)
+
+		print('INSERTs into new ranges, %i clients: %s tps, %i partitions' %
+			  (num_clients, tps.group(1), num_partitions))
+
+		# Stop instance and finish work
+		node.stop()
+		node.cleanup()
+
 
 if __name__ == "__main__":
 	unittest.main()